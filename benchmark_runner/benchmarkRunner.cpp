@@ -0,0 +1,658 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <regex>
+#include <sstream>
+#include <unistd.h>
+
+#include <arrow/util/byte_size.h>
+
+#include "duckdb.hpp"
+#include "experimentsConfig.cpp"
+#include "partitioning/PartitioningFactory.h"
+#include "query/LayoutCostModel.h"
+#include "query/PartitionPruner.h"
+#include "storage/DataReader.h"
+#include "storage/DataWriter.h"
+#include "storage/ProgressJournal.h"
+#include "structures/PartitionManifest.h"
+
+// Runs the generated queries of a dataset against one layout (scheme, partition size, columns) inside a single
+// process, replacing the partitioner subprocess and the Python DuckDB bindings of benchmark/instance.py.
+// The results are appended in the CSV schema of benchmark/result.py, followed by the bytes read and the latency
+// percentiles. With --estimate, it only estimates the cost of the queries on the layouts (see estimateLayouts). With
+// --read-benchmark, it only measures how fast the dataset is scanned in every read mode (see benchmarkReadModes)
+
+// Scheme argument of the estimate mode standing for every partitioning scheme
+static const std::string allSchemesName = "all";
+
+struct QueryResult {
+    std::vector<double> latencies;
+    uint64_t fetchedRows = 0;
+    uint64_t fetchedRowGroups = 0;
+    uint64_t fetchedPartitions = 0;
+    uint64_t fetchedBytes = 0;
+    uint64_t fetchedPages = 0;
+    uint64_t skippedPages = 0;
+    std::vector<std::string> usedColumns;
+};
+
+// Selectivity of every query variant of the dataset, from queries/selectivities.csv (dataset, query, variant, selectivity)
+static std::map<std::string, std::string> loadSelectivities(const std::filesystem::path &selectivitiesFile,
+                                                            const std::string &datasetName) {
+    std::map<std::string, std::string> selectivities;
+    std::ifstream file(selectivitiesFile);
+    std::string line;
+    std::getline(file, line);
+    while (std::getline(file, line)) {
+        std::vector<std::string> fields;
+        std::string field;
+        std::stringstream ss(line);
+        while (std::getline(ss, field, ',')) {
+            field.erase(0, field.find_first_not_of(' '));
+            field.erase(field.find_last_not_of(" \r") + 1);
+            fields.emplace_back(field);
+        }
+        if (fields.size() == 4 && fields[0] == datasetName) {
+            selectivities[fields[1] + fields[2]] = fields[3];
+        }
+    }
+    return selectivities;
+}
+
+// Same rewrite as BenchmarkInstance.replace_from_clause: read the partitions of the layout instead of the dataset
+static std::string replaceFromClause(const std::string &query, const std::filesystem::path &layoutFolder) {
+    std::string fromClause = "FROM read_parquet('" + layoutFolder.string() + "/*" +
+                             common::Settings::fileExtension + "') where";
+    return std::regex_replace(query, std::regex("FROM[\\s\\S]*?where", std::regex::icase), fromClause,
+                              std::regex_constants::format_first_only);
+}
+
+static std::string getWhereClause(const std::string &query) {
+    std::smatch match;
+    if (!std::regex_search(query, match, std::regex("\\bwhere\\b([\\s\\S]*)", std::regex::icase))) {
+        return "";
+    }
+    auto whereClause = match[1].str();
+    whereClause.erase(whereClause.find_last_not_of(" \t\r\n;") + 1);
+    return whereClause;
+}
+
+// Query files of a dataset, e.g. queries/taxi/generated/1a.sql, sorted by name
+static std::vector<std::filesystem::path> getQueryFiles(const std::filesystem::path &queriesPath) {
+    std::vector<std::filesystem::path> queryFiles;
+    for (const auto &fileSystemItem: std::filesystem::directory_iterator(queriesPath)) {
+        if (fileSystemItem.is_regular_file() && fileSystemItem.path().extension() == ".sql") {
+            queryFiles.emplace_back(fileSystemItem.path());
+        }
+    }
+    std::sort(queryFiles.begin(), queryFiles.end());
+    return queryFiles;
+}
+
+// Drop the partitions from the OS page cache, so that a cold run reads them from the disk again
+static void evictFromPageCache(const std::filesystem::path &layoutFolder) {
+    for (const auto &fileSystemItem: std::filesystem::directory_iterator(layoutFolder)) {
+        if (!fileSystemItem.is_regular_file() || fileSystemItem.path().extension() != common::Settings::fileExtension) {
+            continue;
+        }
+        int fileDescriptor = open(fileSystemItem.path().c_str(), O_RDONLY);
+        if (fileDescriptor >= 0) {
+            posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_DONTNEED);
+            close(fileDescriptor);
+        }
+    }
+}
+
+// Python list formatting, as written by result.py
+static std::string formatList(const std::vector<std::string> &values) {
+    std::string formatted = "[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        formatted += (i == 0 ? "'" : ", '") + values[i] + "'";
+    }
+    return formatted + "]";
+}
+
+static std::string formatList(const std::vector<double> &values) {
+    std::stringstream formatted;
+    formatted << "[";
+    for (size_t i = 0; i < values.size(); ++i) {
+        formatted << (i == 0 ? "" : ", ") << values[i];
+    }
+    formatted << "]";
+    return formatted.str();
+}
+
+// Nearest-rank percentile
+static double getPercentile(std::vector<double> values, double percentile) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    auto rank = (size_t) std::ceil(percentile / 100 * (double) values.size());
+    return values[std::max<size_t>(rank, 1) - 1];
+}
+
+static std::string getTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    auto nowTime = std::chrono::system_clock::to_time_t(now);
+    auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count() % 1000000;
+    std::stringstream timestamp;
+    timestamp << std::put_time(std::localtime(&nowTime), "%Y-%m-%d %H:%M:%S") << "." << std::setw(6)
+              << std::setfill('0') << microseconds;
+    return timestamp.str();
+}
+
+// Partitions, row groups, rows and bytes the query has to read, from the manifest and the footers. Left at 0 when
+// the WHERE clause is not a conjunction of ranges (e.g. the joins of TPC-H)
+static void countReadData(query::PartitionPruner &pruner, const std::string &whereClause, QueryResult &queryResult) {
+    auto predicate = query::PartitionPruner::parsePredicate(whereClause);
+    if (!predicate.ok()) {
+        std::cout << "[BenchmarkRunner] Cannot count the data read, " << predicate.status().ToString() << std::endl;
+        return;
+    }
+    for (const auto &range: predicate.ValueOrDie()) {
+        if (std::find(queryResult.usedColumns.begin(), queryResult.usedColumns.end(), range.column) ==
+            queryResult.usedColumns.end()) {
+            queryResult.usedColumns.emplace_back(range.column);
+        }
+    }
+    auto matches = pruner.prune(predicate.ValueOrDie());
+    if (!matches.ok()) {
+        std::cout << "[BenchmarkRunner] Cannot count the data read, " << matches.status().ToString() << std::endl;
+        return;
+    }
+    for (const auto &match: matches.ValueOrDie()) {
+        queryResult.fetchedPartitions += 1;
+        queryResult.fetchedRowGroups += match.rowGroups.size();
+        queryResult.fetchedRows += match.numRows;
+        queryResult.fetchedBytes += match.numBytes;
+        queryResult.fetchedPages += match.numPages - match.numSkippedPages;
+        queryResult.skippedPages += match.numSkippedPages;
+    }
+}
+
+// Estimate mode: no layout is built and no query is run. The cost model replays the splits of the schemes on a
+// sample and estimates, for every query, the partitions, rows and bytes each layout would read
+static void estimateLayouts(const std::filesystem::path &datasetFilePath,
+                            const std::string &datasetName,
+                            const std::vector<partitioning::PartitioningScheme> &schemes,
+                            const std::vector<size_t> &partitionSizes,
+                            const std::vector<std::string> &partitioningColumns,
+                            const std::vector<std::filesystem::path> &queryFiles,
+                            const std::map<std::string, std::string> &selectivities,
+                            const std::filesystem::path &resultsFile) {
+    auto dataReader = std::make_shared<storage::DataReader>();
+    std::filesystem::path datasetFile = datasetFilePath;
+    auto loadStatus = dataReader->load(datasetFile);
+    if (!loadStatus.ok()) {
+        std::cout << "ERROR, LOADING DATASET FAILED - Got status " << loadStatus.ToString() << std::endl;
+        exit(1);
+    }
+    query::LayoutCostModel costModel(dataReader, partitioningColumns);
+    auto status = costModel.load();
+    if (!status.ok()) {
+        std::cout << "ERROR, SAMPLING FAILED - Got status " << status.ToString() << std::endl;
+        exit(1);
+    }
+
+    // The predicates are parsed once, the queries that are not conjunctions of ranges are skipped
+    std::vector<std::pair<std::string, query::RangePredicate>> predicates;
+    for (const auto &queryFile: queryFiles) {
+        std::ifstream queryStream(queryFile);
+        std::string query((std::istreambuf_iterator<char>(queryStream)), std::istreambuf_iterator<char>());
+        auto predicate = query::PartitionPruner::parsePredicate(getWhereClause(query));
+        if (!predicate.ok()) {
+            std::cout << "[BenchmarkRunner] Query " << queryFile.stem().string() << " skipped, "
+                      << predicate.status().ToString() << std::endl;
+            continue;
+        }
+        predicates.emplace_back(queryFile.stem().string(), predicate.ValueOrDie());
+    }
+
+    bool writeHeader = !std::filesystem::exists(resultsFile);
+    if (resultsFile.has_parent_path()) {
+        std::filesystem::create_directories(resultsFile.parent_path());
+    }
+    std::ofstream results(resultsFile, std::ios::app);
+    if (writeHeader) {
+        results << "dataset;partitioning;partition_size;partitioning_columns;num_partitioning_columns;query;"
+                   "selectivity;total_partitions;estimated_partitions;estimated_rows;estimated_bytes;"
+                   "estimated_matching_rows;sample_size;timestamp\n";
+    }
+    for (const auto &scheme: schemes) {
+        for (const auto &partitionSize: partitionSizes) {
+            auto layout = costModel.buildLayout(scheme, partitionSize);
+            if (!layout.ok()) {
+                std::cout << "[BenchmarkRunner] No estimate for " << partitioning::mapSchemeToName.at(scheme) << ", "
+                          << layout.status().ToString() << std::endl;
+                continue;
+            }
+            for (const auto &[queryName, predicate]: predicates) {
+                auto estimate = costModel.estimate(layout.ValueOrDie(), predicate);
+                auto selectivity = selectivities.find(queryName);
+                results << datasetName << ";" << partitioning::mapSchemeToName.at(scheme) << ";" << partitionSize << ";"
+                        << formatList(partitioningColumns) << ";" << partitioningColumns.size() << ";"
+                        << "q" << queryName << ";" << (selectivity != selectivities.end() ? selectivity->second : "0")
+                        << ";" << estimate.totalPartitions << ";" << estimate.numPartitions << ";" << estimate.numRows
+                        << ";" << estimate.numBytes << ";" << estimate.matchingRows << ";"
+                        << costModel.getSampleSize() << ";" << getTimestamp() << "\n";
+            }
+            results.flush();
+        }
+    }
+    std::cout << "[BenchmarkRunner] Estimates written to " << resultsFile << std::endl;
+}
+
+// Read benchmark: no layout is built and no query is run. The dataset is scanned (every column and batch, as the
+// first pass of the schemes) in every read mode, and the throughput is reported in GB/s of the file on disk and of the
+// decoded batches
+static void benchmarkReadModes(const std::filesystem::path &datasetFilePath,
+                               const std::string &datasetName,
+                               const std::vector<std::string> &readModeNames,
+                               int repetitions,
+                               bool coldCache,
+                               const std::filesystem::path &resultsFile) {
+    bool writeHeader = !std::filesystem::exists(resultsFile);
+    if (resultsFile.has_parent_path()) {
+        std::filesystem::create_directories(resultsFile.parent_path());
+    }
+    std::ofstream results(resultsFile, std::ios::app);
+    if (writeHeader) {
+        results << "dataset;read_mode;cache;num_rows;file_bytes;decoded_bytes;latencies;latency_avg;file_gbps;"
+                   "decoded_gbps;timestamp\n";
+    }
+    auto fileBytes = (int64_t) std::filesystem::file_size(datasetFilePath);
+    for (const auto &readModeName: readModeNames) {
+        auto readMode = storage::ReadMode::fromName(readModeName);
+        if (!readMode.ok()) {
+            std::cout << "[BenchmarkRunner] Read mode " << readModeName << " skipped, "
+                      << readMode.status().ToString() << std::endl;
+            continue;
+        }
+        storage::DataReader::setReadMode(readMode.ValueOrDie());
+        std::vector<double> latencies;
+        int64_t numRows = 0;
+        int64_t decodedBytes = 0;
+        // Warm runs are preceded by an unmeasured scan
+        for (int i = coldCache ? 0 : -1; i < repetitions; ++i) {
+            if (coldCache) {
+                evictFromPageCache(datasetFilePath.parent_path());
+            }
+            std::filesystem::path scannedFile = datasetFilePath;
+            numRows = 0;
+            decodedBytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            auto dataReader = std::make_shared<storage::DataReader>();
+            auto status = dataReader->load(scannedFile);
+            if (!status.ok()) {
+                std::cout << "[BenchmarkRunner] Cannot scan the dataset, " << status.ToString() << std::endl;
+                return;
+            }
+            auto batchReader = dataReader->getBatchReader();
+            if (!batchReader.ok()) {
+                std::cout << "[BenchmarkRunner] Cannot scan the dataset, " << batchReader.status().ToString() << std::endl;
+                return;
+            }
+            while (true) {
+                std::shared_ptr<arrow::RecordBatch> batch;
+                status = batchReader.ValueOrDie()->ReadNext(&batch);
+                if (!status.ok() || batch == nullptr) {
+                    break;
+                }
+                numRows += batch->num_rows();
+                decodedBytes += arrow::util::TotalBufferSize(*batch);
+            }
+            auto end = std::chrono::steady_clock::now();
+            if (!status.ok()) {
+                std::cout << "[BenchmarkRunner] Scan failed, " << status.ToString() << std::endl;
+                return;
+            }
+            if (i >= 0) {
+                latencies.emplace_back(std::chrono::duration<double>(end - start).count());
+            }
+        }
+        double latencyAvg = std::accumulate(latencies.begin(), latencies.end(), 0.0) / (double) latencies.size();
+        double fileThroughput = (double) fileBytes / latencyAvg / 1e9;
+        double decodedThroughput = (double) decodedBytes / latencyAvg / 1e9;
+        std::cout << "[BenchmarkRunner] Read mode " << readModeName << ": " << fileThroughput << " GB/s on disk, "
+                  << decodedThroughput << " GB/s decoded" << std::endl;
+        results << datasetName << ";" << readModeName << ";" << (coldCache ? "cold" : "warm") << ";" << numRows << ";"
+                << fileBytes << ";" << decodedBytes << ";" << formatList(latencies) << ";" << latencyAvg << ";"
+                << fileThroughput << ";" << decodedThroughput << ";" << getTimestamp() << "\n";
+        results.flush();
+    }
+    std::cout << "[BenchmarkRunner] Read throughputs written to " << resultsFile << std::endl;
+}
+
+int main(int argc, char **argv) {
+
+    // Check the overall number of arguments
+    if (argc < 6){
+        std::cout << "Insufficient number of arguments\n" << std::endl;
+        std::cout << "Expected syntax: benchmark_runner <benchmark_folder> <dataset_name> <partitioning_scheme>"
+                     " <partition_size> <columns> [--results=<file>] [--repetitions=<n>] [--cache=warm|cold]"
+                     " [--rebuild] [--order=<z-order|hilbert|columns>] [--order-columns=<columns>]"
+                     " [--writer-profile=<default|pruning>] [--estimate]"
+                     " [--read-mode=<default|mmap|prebuffer|parallel|parallel-unordered>] [--read-benchmark]\n"
+                  << std::endl;
+        exit(1);
+    }
+
+    // Validate the benchmark folder (the one with datasets/ and queries/)
+    std::filesystem::path argBenchmarkPath = std::filesystem::absolute(argv[1]);
+    if (!std::filesystem::exists(argBenchmarkPath)){
+        std::cout << "Benchmark folder " << argBenchmarkPath << " does not exist" << std::endl;
+        exit(1);
+    }
+
+    // Validate the dataset name
+    std::string argDatasetName = argv[2];
+    if (ExperimentsConfig::realDatasets.find(argDatasetName) == ExperimentsConfig::realDatasets.end()){
+        std::cout << "Dataset not available/recognized" << std::endl;
+        exit(1);
+    }
+
+    // Validate the partitioning scheme, "all" is accepted by the estimate mode
+    std::string argPartitioningScheme = argv[3];
+    bool allSchemes = argPartitioningScheme == allSchemesName;
+    if (!allSchemes && partitioning::mapNameToScheme.find(argPartitioningScheme) == partitioning::mapNameToScheme.end()){
+        std::cout << "Partitioning scheme not available/recognized" << std::endl;
+        exit(1);
+    }
+    partitioning::PartitioningScheme scheme = allSchemes ? partitioning::NO_PARTITION :
+                                              partitioning::mapNameToScheme.at(argPartitioningScheme);
+
+    // Load the partition size, a comma separated list is accepted by the estimate mode
+    std::vector<size_t> partitionSizes;
+    std::stringstream partitionSizesStream(argv[4]);
+    std::string partitionSizeValue;
+    while (std::getline(partitionSizesStream, partitionSizeValue, ',')) {
+        partitionSizes.push_back(std::stoul(partitionSizeValue));
+    }
+    auto partitionSize = (int) partitionSizes.front();
+
+    // Load the partitioning columns
+    std::string argColumns = argv[5];
+    std::vector<std::string> partitioningColumns;
+    std::string segment;
+    std::stringstream ss(argColumns);
+    while(std::getline(ss, segment, ','))
+    {
+        partitioningColumns.push_back(segment);
+    }
+
+    // Optional settings: results file, measured runs per query, cache mode, forced rebuild of the layout, order of
+    // the rows inside the partitions and writer profile (see the partitioner)
+    // Warm runs share one DuckDB instance and are preceded by an unmeasured run, cold runs open a new instance and
+    // evict the partitions from the page cache before every run
+    // With --estimate, the layouts are not built: the cost model estimates what the queries would read on them
+    // With --read-mode, the dataset and partitions are read in that mode (see the partitioner). With --read-benchmark,
+    // only the scan of the dataset is measured, in every read mode or in the one given
+    std::filesystem::path resultsFile = argBenchmarkPath / "results" / "results_runner.csv";
+    int repetitions = 5;
+    bool coldCache = false;
+    bool rebuild = false;
+    bool estimateOnly = false;
+    bool readBenchmarkOnly = false;
+    std::string readModeName;
+    bool resultsOptionGiven = false;
+    partitioning::IntraPartitionOrder intraPartitionOrder = partitioning::SPLIT_ORDER;
+    std::vector<std::string> orderColumns;
+    std::string writerProfileName = storage::WriterProfile::defaultName;
+    const std::string resultsOption = "--results=";
+    const std::string repetitionsOption = "--repetitions=";
+    const std::string cacheOption = "--cache=";
+    const std::string rebuildOption = "--rebuild";
+    const std::string estimateOption = "--estimate";
+    const std::string orderOption = "--order=";
+    const std::string orderColumnsOption = "--order-columns=";
+    const std::string writerProfileOption = "--writer-profile=";
+    const std::string readModeOption = "--read-mode=";
+    const std::string readBenchmarkOption = "--read-benchmark";
+    for (int i = 6; i < argc; ++i) {
+        std::string argOption = argv[i];
+        if (argOption.rfind(resultsOption, 0) == 0) {
+            resultsFile = argOption.substr(resultsOption.size());
+            resultsOptionGiven = true;
+        } else if (argOption.rfind(repetitionsOption, 0) == 0) {
+            repetitions = std::max(1, std::stoi(argOption.substr(repetitionsOption.size())));
+        } else if (argOption.rfind(cacheOption, 0) == 0) {
+            coldCache = argOption.substr(cacheOption.size()) == "cold";
+        } else if (argOption == rebuildOption) {
+            rebuild = true;
+        } else if (argOption == estimateOption) {
+            estimateOnly = true;
+        } else if (argOption.rfind(orderOption, 0) == 0) {
+            auto orderName = argOption.substr(orderOption.size());
+            if (partitioning::mapNameToOrder.find(orderName) == partitioning::mapNameToOrder.end()) {
+                std::cout << "Partition order not available/recognized" << std::endl;
+                exit(1);
+            }
+            intraPartitionOrder = partitioning::mapNameToOrder.at(orderName);
+        } else if (argOption.rfind(orderColumnsOption, 0) == 0) {
+            std::stringstream orderColumnsStream(argOption.substr(orderColumnsOption.size()));
+            while (std::getline(orderColumnsStream, segment, ',')) {
+                orderColumns.push_back(segment);
+            }
+        } else if (argOption.rfind(writerProfileOption, 0) == 0) {
+            writerProfileName = argOption.substr(writerProfileOption.size());
+        } else if (argOption.rfind(readModeOption, 0) == 0) {
+            readModeName = argOption.substr(readModeOption.size());
+        } else if (argOption == readBenchmarkOption) {
+            readBenchmarkOnly = true;
+        }
+    }
+    auto writerProfile = storage::WriterProfile::fromName(writerProfileName, partitioningColumns);
+    if (!writerProfile.ok()) {
+        std::cout << "Writer profile not available/recognized" << std::endl;
+        exit(1);
+    }
+    storage::DataWriter::setWriterProfile(writerProfile.ValueOrDie());
+    if (!readModeName.empty()) {
+        auto readMode = storage::ReadMode::fromName(readModeName);
+        if (!readMode.ok()) {
+            std::cout << "Read mode not available/recognized" << std::endl;
+            exit(1);
+        }
+        storage::DataReader::setReadMode(readMode.ValueOrDie());
+    }
+
+    // Validate the actual dataset file
+    std::filesystem::path datasetPath = argBenchmarkPath / "datasets" / argDatasetName;
+    std::filesystem::path datasetFilePath = datasetPath / ExperimentsConfig::noPartition / (argDatasetName + ExperimentsConfig::fileExtension);
+    if (!std::filesystem::exists(datasetFilePath)){
+        std::cout << "Not partitioned source dataset not found in " << datasetFilePath << std::endl;
+        exit(1);
+    }
+
+    // Query files of the dataset, e.g. queries/taxi/generated/1a.sql, and their selectivity
+    std::string queriesName = argDatasetName.substr(0, argDatasetName.find("-sf"));
+    std::filesystem::path queriesPath = argBenchmarkPath / "queries" / queriesName / "generated";
+    auto selectivities = loadSelectivities(argBenchmarkPath / "queries" / "selectivities.csv", argDatasetName);
+    auto queryFiles = getQueryFiles(queriesPath);
+
+    if (readBenchmarkOnly) {
+        if (!resultsOptionGiven) {
+            resultsFile = argBenchmarkPath / "results" / "results_read.csv";
+        }
+        auto readModeNames = readModeName.empty() ? storage::ReadMode::getNames() : std::vector<std::string>{readModeName};
+        benchmarkReadModes(datasetFilePath, argDatasetName, readModeNames, repetitions, coldCache, resultsFile);
+        return 0;
+    }
+    if (estimateOnly) {
+        std::vector<partitioning::PartitioningScheme> schemes = {scheme};
+        if (allSchemes) {
+            schemes.clear();
+            for (const auto &[schemeValue, schemeName]: partitioning::mapSchemeToName) {
+                schemes.emplace_back(schemeValue);
+            }
+        }
+        if (!resultsOptionGiven) {
+            resultsFile = argBenchmarkPath / "results" / "results_estimates.csv";
+        }
+        estimateLayouts(datasetFilePath, argDatasetName, schemes, partitionSizes, partitioningColumns, queryFiles,
+                        selectivities, resultsFile);
+        return 0;
+    }
+    if (allSchemes || partitionSizes.size() > 1) {
+        std::cout << "Several schemes or partition sizes are only accepted with " << estimateOption << std::endl;
+        exit(1);
+    }
+
+    // Reuse the layout when a finished run with the same settings is in the folder, otherwise build it
+    std::filesystem::path layoutPath = datasetPath / argPartitioningScheme;
+    int64_t timeToPartition = 0;
+    bool reuseLayout = scheme == partitioning::NO_PARTITION;
+    if (!reuseLayout && !rebuild && structures::PartitionManifest::exists(layoutPath) &&
+        !storage::ProgressJournal::canResume(layoutPath)) {
+        auto manifest = structures::PartitionManifest::load(layoutPath);
+        reuseLayout = manifest.ok() && manifest.ValueOrDie().scheme == argPartitioningScheme &&
+                      manifest.ValueOrDie().columns == partitioningColumns &&
+                      manifest.ValueOrDie().partitionSize == (uint64_t) partitionSize &&
+                      manifest.ValueOrDie().order == partitioning::mapOrderToName.at(intraPartitionOrder) &&
+                      manifest.ValueOrDie().writerProfile == writerProfileName &&
+                      (intraPartitionOrder == partitioning::SPLIT_ORDER || manifest.ValueOrDie().orderColumns ==
+                       (orderColumns.empty() ? partitioningColumns : orderColumns));
+    }
+    if (reuseLayout) {
+        std::cout << "[BenchmarkRunner] Reusing the layout in " << layoutPath << std::endl;
+    } else {
+        storage::DataWriter::cleanUpFolder(layoutPath);
+        auto dataReader = std::make_shared<storage::DataReader>();
+        auto loadStatus = dataReader->load(datasetFilePath);
+        if (!loadStatus.ok()) {
+            std::cout << "ERROR, LOADING DATASET FAILED - Got status " << loadStatus.ToString() << std::endl;
+            exit(1);
+        }
+        auto partitioningScheme = partitioning::PartitioningFactory::create(scheme, dataReader, partitioningColumns, partitionSize, layoutPath);
+        partitioningScheme->setIntraPartitionOrder(intraPartitionOrder, orderColumns);
+        auto start = std::chrono::steady_clock::now();
+        arrow::Status status = partitioningScheme->partition();
+        timeToPartition = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start).count();
+        if (!status.ok()) {
+            std::cout << "ERROR, PARTITIONING FAILED - Got status " << status.ToString() << std::endl;
+            exit(1);
+        }
+        std::cout << "[BenchmarkRunner] Partitioner took " << timeToPartition << " seconds" << std::endl;
+    }
+
+    // Layout figures: rows, partitions and their average size in MB
+    uint64_t numRows = 0;
+    uint64_t totalPartitions = 0;
+    double averagePartitionSize = 0;
+    for (const auto &fileSystemItem: std::filesystem::directory_iterator(layoutPath)) {
+        if (fileSystemItem.is_regular_file() && fileSystemItem.path().extension() == common::Settings::fileExtension) {
+            totalPartitions += 1;
+            averagePartitionSize += (double) std::filesystem::file_size(fileSystemItem.path());
+        }
+    }
+    if (totalPartitions > 0) {
+        averagePartitionSize = std::round(averagePartitionSize / (double) totalPartitions / (1024 * 1024) * 100) / 100;
+    }
+    query::PartitionPruner pruner(layoutPath);
+    if (pruner.load().ok()) {
+        auto manifest = structures::PartitionManifest::load(layoutPath).ValueOrDie();
+        for (const auto &partition: manifest.partitions) {
+            numRows += partition.numRows;
+        }
+    }
+
+    bool writeHeader = !std::filesystem::exists(resultsFile);
+    if (resultsFile.has_parent_path()) {
+        std::filesystem::create_directories(resultsFile.parent_path());
+    }
+    std::ofstream results(resultsFile, std::ios::app);
+    if (writeHeader) {
+        results << "dataset;num_rows;partitioning;time_to_partition;query;selectivity;partitioning_columns;"
+                   "num_partitioning_columns;used_columns;num_used_columns;latencies;latency_avg;latency_std;"
+                   "partition_size;partition_size_mb;fetched_rows;fetched_row_groups;fetched_partitions;"
+                   "total_partitions;timestamp;fetched_bytes;latency_p50;latency_p95;latency_p99;"
+                   "fetched_pages;skipped_pages\n";
+    }
+
+    std::unique_ptr<duckdb::DuckDB> db;
+    std::unique_ptr<duckdb::Connection> con;
+    auto openDatabase = [&db, &con]() {
+        con.reset();
+        db = std::make_unique<duckdb::DuckDB>(nullptr);
+        con = std::make_unique<duckdb::Connection>(*db);
+    };
+    openDatabase();
+
+    for (const auto &queryFile: queryFiles) {
+        std::ifstream queryStream(queryFile);
+        std::string query((std::istreambuf_iterator<char>(queryStream)), std::istreambuf_iterator<char>());
+        query = replaceFromClause(query, layoutPath);
+        auto queryName = queryFile.stem().string();
+
+        QueryResult queryResult;
+        countReadData(pruner, getWhereClause(query), queryResult);
+
+        if (!coldCache) {
+            auto warmUpResult = con->Query(query);
+            if (warmUpResult->HasError()) {
+                std::cout << "[BenchmarkRunner] Query " << queryName << " failed: " << warmUpResult->GetError() << std::endl;
+                continue;
+            }
+        }
+        for (int i = 0; i < repetitions; ++i) {
+            if (coldCache) {
+                evictFromPageCache(layoutPath);
+                openDatabase();
+            }
+            auto start = std::chrono::steady_clock::now();
+            auto queryResultSet = con->Query(query);
+            auto end = std::chrono::steady_clock::now();
+            if (queryResultSet->HasError()) {
+                std::cout << "[BenchmarkRunner] Query " << queryName << " failed: " << queryResultSet->GetError() << std::endl;
+                break;
+            }
+            queryResult.latencies.emplace_back(std::chrono::duration<double>(end - start).count());
+        }
+
+        // Same average and (sample) standard deviation as result.py
+        double latencyAvg = 0;
+        double latencyStd = 0;
+        auto &latencies = queryResult.latencies;
+        if (latencies.size() == 1) {
+            latencyAvg = latencies[0];
+            latencyStd = latencies[0];
+        } else if (latencies.size() > 1) {
+            latencyAvg = std::accumulate(latencies.begin(), latencies.end(), 0.0) / (double) latencies.size();
+            double squaredDeviations = 0;
+            for (const auto &latency: latencies) {
+                squaredDeviations += (latency - latencyAvg) * (latency - latencyAvg);
+            }
+            latencyStd = std::sqrt(squaredDeviations / (double) (latencies.size() - 1));
+        }
+
+        auto selectivity = selectivities.find(queryName);
+        results << argDatasetName << ";" << numRows << ";" << argPartitioningScheme << ";" << timeToPartition << ";"
+                << "q" << queryName << ";" << (selectivity != selectivities.end() ? selectivity->second : "0") << ";"
+                << formatList(partitioningColumns) << ";" << partitioningColumns.size() << ";"
+                << formatList(queryResult.usedColumns) << ";" << queryResult.usedColumns.size() << ";"
+                << formatList(latencies) << ";" << latencyAvg << ";" << latencyStd << ";"
+                << partitionSize << ";" << averagePartitionSize << ";" << queryResult.fetchedRows << ";"
+                << queryResult.fetchedRowGroups << ";" << queryResult.fetchedPartitions << ";"
+                << totalPartitions << ";" << getTimestamp() << ";" << queryResult.fetchedBytes << ";"
+                << getPercentile(latencies, 50) << ";" << getPercentile(latencies, 95) << ";"
+                << getPercentile(latencies, 99) << ";" << queryResult.fetchedPages << ";"
+                << queryResult.skippedPages << "\n";
+        results.flush();
+        std::cout << "[BenchmarkRunner] Query " << queryName << ": " << latencyAvg << " s on average, "
+                  << queryResult.fetchedPartitions << " partitions and " << queryResult.fetchedRowGroups
+                  << " row groups read" << std::endl;
+    }
+
+    std::cout << "[BenchmarkRunner] Results saved to " << resultsFile << std::endl;
+    return 0;
+}
@@ -8,6 +8,7 @@
 #include <set>
 
 #include <arrow/api.h>
+#include <arrow/array/concatenate.h>
 #include <arrow/compute/api.h>
 #include <arrow/dataset/api.h>
 #include <arrow/io/api.h>
@@ -15,52 +16,79 @@
 #include <arrow/status.h>
 #include <arrow/table.h>
 
+#include "KeyView.h"
 #include "Point.h"
+#include "PointSet.h"
 
 namespace common {
 
     class ColumnDataConverter {
     public:
 
-        // Columnar to row layout (given the chunked arrays of the columns)
+        // Columnar to row layout (given the chunked arrays of the columns, their chunks are concatenated)
         // Optionally add a field with the row index
-        std::vector<std::shared_ptr<Point>> toRows(std::vector<std::shared_ptr<arrow::ChunkedArray>> &columnsData,
-                                                   bool addIndex = false) {
+        arrow::Result<PointSet> toRows(std::vector<std::shared_ptr<arrow::ChunkedArray>> &columnsData,
+                                       bool addIndex = false, PointLayout layout = COLUMNAR) {
             std::vector<std::shared_ptr<arrow::Array>> columnsArrays = {};
             for (const auto &columnData: columnsData){
-                std::shared_ptr<arrow::Array> columnArray = std::static_pointer_cast<arrow::Array>(arrow::ChunkedArray(columnData->chunks()).chunk(0));
+                ARROW_ASSIGN_OR_RAISE(auto columnArray, arrow::Concatenate(columnData->chunks()));
                 columnsArrays.emplace_back(columnArray);
             }
-            if(addIndex){
+            if(addIndex && !columnsData.empty()){
                 std::vector<uint32_t> rowIndexesRaw(columnsData[0]->length());
                 std::iota(rowIndexesRaw.begin(), rowIndexesRaw.end(), 0);
                 arrow::UInt32Builder int32builder;
-                std::ignore = int32builder.AppendValues(rowIndexesRaw);
-                std::shared_ptr<arrow::Array> rowIndexes;
-                rowIndexes = int32builder.Finish().ValueOrDie();
+                ARROW_RETURN_NOT_OK(int32builder.AppendValues(rowIndexesRaw));
+                ARROW_ASSIGN_OR_RAISE(auto rowIndexes, int32builder.Finish());
                 columnsArrays.emplace_back(rowIndexes);
             }
-            std::vector<std::shared_ptr<common::Point>> columnDataDouble = toDouble(columnsArrays).ValueOrDie();
-            return toRows(columnDataDouble);
+            return toRows(columnsArrays, layout);
         }
 
-        // Columnar to row layout (given a columnar vectors of points)
-        static std::vector<std::shared_ptr<Point>> toRows(std::vector<std::shared_ptr<common::Point>> &columnData) {
-            std::vector<std::shared_ptr<Point>> points;
-            size_t numColumns = columnData.size();
-            size_t numRows = columnData[0]->size();
-            for (size_t i = 0; i < numRows; i++) {
-                std::shared_ptr<Point> point = std::make_shared<Point>();
-                for (size_t j = 0; j < numColumns; j++) {
-                    try{
-                        point->emplace_back(columnData[j]->at(i));
+        // Columnar to row layout (given the arrays of the columns)
+        // The keys are read in place and written once into the point set. A point has no position without all of
+        // its keys, a column with nulls is Invalid
+        template<typename T = double>
+        static arrow::Result<BasicPointSet<T>> toRows(const std::vector<std::shared_ptr<arrow::Array>> &columnsArrays,
+                                                      PointLayout layout = COLUMNAR) {
+            size_t numColumns = columnsArrays.size();
+            size_t numRows = columnsArrays.empty() ? 0 : columnsArrays[0]->length();
+            BasicPointSet<T> points(numColumns, numRows, layout);
+            for (size_t j = 0; j < numColumns; j++) {
+                if ((size_t) columnsArrays[j]->length() != numRows) {
+                    return arrow::Status::Invalid("Column ", j, " has ", columnsArrays[j]->length(), " values for ",
+                                                  numRows, " rows");
+                }
+                ARROW_RETURN_NOT_OK(visitKeys(*columnsArrays[j], [&points, j](const auto &keys) {
+                    if (keys.nullCount() > 0) {
+                        return arrow::Status::Invalid("Column ", j, " has ", keys.nullCount(), " null keys");
                     }
-                    catch (std::exception& e) {
-                        std::cout << "Could not perform row conversion " << e.what() << std::endl;
-                        continue;
+                    for (int64_t i = 0; i < keys.size(); i++) {
+                        points.set(i, j, static_cast<T>(keys[i]));
                     }
+                    return arrow::Status::OK();
+                }));
+            }
+            return points;
+        }
+
+        // Columnar to row layout (given a columnar vectors of points)
+        // The values are copied once into the flat buffer of the point set, missing values of a shorter column are 0
+        template<typename T = double>
+        static BasicPointSet<T> toRows(std::vector<std::shared_ptr<common::Point>> &columnData,
+                                       PointLayout layout = COLUMNAR) {
+            size_t numColumns = columnData.size();
+            size_t numRows = columnData.empty() ? 0 : columnData[0]->size();
+            BasicPointSet<T> points(numColumns, numRows, layout);
+            for (size_t j = 0; j < numColumns; j++) {
+                if (columnData[j]->size() < numRows) {
+                    std::cout << "Could not perform row conversion, column " << j << " has "
+                              << columnData[j]->size() << " values for " << numRows << " rows" << std::endl;
+                }
+                auto columnRows = std::min(numRows, columnData[j]->size());
+                for (size_t i = 0; i < columnRows; i++) {
+                    points.set(i, j, static_cast<T>((*columnData[j])[i]));
                 }
-                points.emplace_back(point);
             }
             return points;
         }
@@ -80,152 +108,46 @@ namespace common {
             return std::abs(3 * (mean - median) / stdev);
         }
 
-        arrow::Result<std::vector<std::shared_ptr<common::Point>>> toDouble(std::vector<std::shared_ptr<arrow::Array>> &columnData){
-            outputType = "double";
-            for (const auto &data: columnData){
-                ARROW_RETURN_NOT_OK(arrow::VisitArrayInline(*data, this));
-            }
-            return convertedData;
-        }
-
-        arrow::Result<std::vector<std::shared_ptr<common::Point>>> toInt32(std::vector<std::shared_ptr<arrow::Array>> &columnData){
-            outputType = "int32";
-            for (const auto &data: columnData){
-                ARROW_RETURN_NOT_OK(arrow::VisitArrayInline(*data, this));
-            }
-            return convertedData;
-        }
-
-        arrow::Result<std::vector<std::shared_ptr<common::Point>>> toInt64(std::vector<std::shared_ptr<arrow::Array>> &columnData){
-            outputType = "int64";
-            for (const auto &data: columnData){
-                ARROW_RETURN_NOT_OK(arrow::VisitArrayInline(*data, this));
-            }
-            return convertedData;
+        // Values of every column, one vector per column following the rows. A column with nulls is Invalid: the
+        // consumers that skip the nulls read the keys in place with visitKeys
+        static arrow::Result<std::vector<std::shared_ptr<common::Point>>> toDouble(
+                const std::vector<std::shared_ptr<arrow::Array>> &columnData){
+            return convert<double>(columnData);
         }
 
-        // Default implementation
-        arrow::Status Visit(const arrow::Array& array) {
-            return arrow::Status::NotImplemented("Cannot convert to double, for this array of type ",
-                                                 array.type()->ToString());
+        static arrow::Result<std::vector<std::shared_ptr<common::Point>>> toInt32(
+                const std::vector<std::shared_ptr<arrow::Array>> &columnData){
+            return convert<int32_t>(columnData);
         }
 
-        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass, typename CType = typename DataType::c_type>
-        arrow::enable_if_number<DataType, arrow::Status> Visit(const ArrayType &array) {
-            auto castedArray = std::make_shared<std::vector<double>>();
-            for (std::optional<CType> value: array) {
-                if (value.has_value()) {
-                    if (outputType == "int32"){
-                        castedArray->emplace_back(static_cast<int32_t>(value.value()));
-                    }
-                    else if (outputType == "int64"){
-                        castedArray->emplace_back(static_cast<int64_t>(value.value()));
-                    }
-                    else{
-                        castedArray->emplace_back(static_cast<double>(value.value()));
-                    }
-                }
-            }
-            if (!castedArray->empty()) {
-                convertedData.emplace_back(castedArray);
-            }
-            return arrow::Status::OK();
+        static arrow::Result<std::vector<std::shared_ptr<common::Point>>> toInt64(
+                const std::vector<std::shared_ptr<arrow::Array>> &columnData){
+            return convert<int64_t>(columnData);
         }
 
-        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass, typename CType = typename DataType::c_type>
-        arrow::enable_if_date<DataType, arrow::Status> Visit(const ArrayType &array) {
-            auto castedArray = std::make_shared<std::vector<double>>();
-            for (std::optional<CType> value: array) {
-                if (value.has_value()) {
-                    if (outputType == "int32"){
-                        castedArray->emplace_back(static_cast<int32_t>(value.value()));
-                    }
-                    else if (outputType == "int64"){
-                        castedArray->emplace_back(static_cast<int64_t>(value.value()));
-                    }
-                    else{
-                        castedArray->emplace_back(static_cast<double>(value.value()));
-                    }
-                }
-            }
-            if (!castedArray->empty()) {
-                convertedData.emplace_back(castedArray);
-            }
-            return arrow::Status::OK();
-        }
-
-        // From decimal conversion
-        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass, typename CType = typename DataType::c_type>
-        arrow::enable_if_decimal<DataType, arrow::Status> Visit(const ArrayType &array) {
-            auto castedArray = std::make_shared<std::vector<double>>();
-            for (std::optional<CType> value: array) {
-                if (value.has_value()) {
-                    if (outputType == "int32"){
-                        castedArray->emplace_back(static_cast<int32_t>(value.value()));
-                    }
-                    else if (outputType == "int64"){
-                        castedArray->emplace_back(static_cast<int64_t>(value.value()));
-                    }
-                    else{
-                        castedArray->emplace_back(static_cast<double>(value.value()));
-                    }
-                }
-            }
-            if (!castedArray->empty()) {
-                convertedData.emplace_back(castedArray);
-            }
-            return arrow::Status::OK();
-        }
-
-        // From fixed size binary conversion
-        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass, typename CType = typename DataType::c_type>
-        arrow::enable_if_fixed_size_binary<DataType, arrow::Status> Visit(const ArrayType &array) {
-            auto castedArray = std::make_shared<std::vector<double>>();
-            for (std::optional<CType> value: array) {
-                if (value.has_value()) {
-                    if (outputType == "int32"){
-                        castedArray->emplace_back(static_cast<int32_t>(value.value()));
-                    }
-                    else if (outputType == "int64"){
-                        castedArray->emplace_back(static_cast<int64_t>(value.value()));
-                    }
-                    else{
-                        castedArray->emplace_back(static_cast<double>(value.value()));
-                    }
-                }
-            }
-            if (!castedArray->empty()) {
-                convertedData.emplace_back(castedArray);
-            }
-            return arrow::Status::OK();
-        }
-
-        // From timestamp conversion
-        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass, typename CType = typename DataType::c_type>
-        arrow::enable_if_timestamp<DataType, arrow::Status> Visit(const ArrayType &array) {
-            auto castedArray = std::make_shared<std::vector<double>>();
-            for (std::optional<CType> value: array) {
-                if (value.has_value()) {
-                    if (outputType == "int32"){
-                        castedArray->emplace_back(static_cast<int32_t>(value.value()));
-                    }
-                    else if (outputType == "int64"){
-                        castedArray->emplace_back(static_cast<int64_t>(value.value()));
-                    }
-                    else{
-                        castedArray->emplace_back(static_cast<double>(value.value()));
-                    }
-                }
-            }
-            if (!castedArray->empty()) {
+    private:
+        // The output type is fixed at compile time and the key type once per array, nothing is decided per value
+        template<typename OutputType>
+        static arrow::Result<std::vector<std::shared_ptr<common::Point>>> convert(
+                const std::vector<std::shared_ptr<arrow::Array>> &columnData){
+            std::vector<std::shared_ptr<common::Point>> convertedData;
+            convertedData.reserve(columnData.size());
+            for (size_t j = 0; j < columnData.size(); j++){
+                auto castedArray = std::make_shared<std::vector<double>>();
+                ARROW_RETURN_NOT_OK(visitKeys(*columnData[j], [&castedArray, j](const auto &keys) {
+                    if (keys.nullCount() > 0) {
+                        return arrow::Status::Invalid("Column ", j, " has ", keys.nullCount(), " nulls");
+                    }
+                    castedArray->resize(keys.size());
+                    for (int64_t i = 0; i < keys.size(); i++) {
+                        (*castedArray)[i] = static_cast<double>(static_cast<OutputType>(keys[i]));
+                    }
+                    return arrow::Status::OK();
+                }));
                 convertedData.emplace_back(castedArray);
             }
-            return arrow::Status::OK();
+            return convertedData;
         }
-
-    private:
-        std::vector<std::shared_ptr<common::Point>> convertedData = {};
-        std::string outputType = "double";
     };
 }
 
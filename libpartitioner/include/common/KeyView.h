@@ -0,0 +1,153 @@
+#ifndef COMMON_KEY_VIEW_H
+#define COMMON_KEY_VIEW_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include <arrow/api.h>
+#include <arrow/result.h>
+#include <arrow/status.h>
+#include <arrow/util/bit_util.h>
+#include <arrow/visit_array_inline.h>
+
+namespace common {
+
+    // Typed, read-only view on the keys of an Arrow array, in place: the value buffer of the array and its validity
+    // bitmap, nothing is copied. The value of a null slot is whatever the buffer holds, check isValid first.
+    // Dates and timestamps are their integer count, in the unit of their Arrow type
+    template<typename CType>
+    class KeyView {
+    public:
+        using value_type = CType;
+
+        KeyView(const CType *rawValues, const uint8_t *validityBitmap, int64_t bitmapOffset, int64_t numValues,
+                int64_t numNulls) : values(rawValues), validity(validityBitmap), offset(bitmapOffset),
+                                    length(numValues), nulls(numNulls) {}
+        CType operator[](int64_t i) const {
+            return values[i];
+        }
+        bool isValid(int64_t i) const {
+            return validity == nullptr || arrow::bit_util::GetBit(validity, offset + i);
+        }
+        int64_t size() const {
+            return length;
+        }
+        int64_t nullCount() const {
+            return nulls;
+        }
+        const CType *data() const {
+            return values;
+        }
+    private:
+        const CType *values;
+        const uint8_t *validity;
+        int64_t offset;
+        int64_t length;
+        int64_t nulls;
+    };
+
+    // Keys of a decimal array, read from the fixed size values in place and scaled to their actual value, as in
+    // the column statistics
+    template<typename DecimalType>
+    class DecimalKeyView {
+    public:
+        using value_type = double;
+
+        DecimalKeyView(const uint8_t *rawValues, int32_t valueWidth, int32_t valueScale, const uint8_t *validityBitmap,
+                       int64_t bitmapOffset, int64_t numValues, int64_t numNulls) :
+                values(rawValues), byteWidth(valueWidth), scale(valueScale), validity(validityBitmap),
+                offset(bitmapOffset), length(numValues), nulls(numNulls) {}
+        double operator[](int64_t i) const {
+            return DecimalType(values + i * byteWidth).ToDouble(scale);
+        }
+        bool isValid(int64_t i) const {
+            return validity == nullptr || arrow::bit_util::GetBit(validity, offset + i);
+        }
+        int64_t size() const {
+            return length;
+        }
+        int64_t nullCount() const {
+            return nulls;
+        }
+    private:
+        const uint8_t *values;
+        int32_t byteWidth;
+        int32_t scale;
+        const uint8_t *validity;
+        int64_t offset;
+        int64_t length;
+        int64_t nulls;
+    };
+
+    // Dispatch on the type of an array, once per array: the kernel is instantiated for every key type and called
+    // with the typed view of the array. Kernels take (const auto &keys) and return arrow::Status
+    template<typename Kernel>
+    class KeyViewVisitor {
+    public:
+        explicit KeyViewVisitor(Kernel &keyKernel) : kernel(keyKernel) {}
+
+        // Default implementation
+        arrow::Status Visit(const arrow::Array &array) {
+            return arrow::Status::NotImplemented("Cannot read keys from an array of type ", array.type()->ToString());
+        }
+
+        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass>
+        arrow::enable_if_number<DataType, arrow::Status> Visit(const ArrayType &array) {
+            if constexpr (std::is_same_v<DataType, arrow::HalfFloatType>) {
+                return Visit(static_cast<const arrow::Array &>(array));
+            } else {
+                return visitPrimitive(array);
+            }
+        }
+
+        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass>
+        arrow::enable_if_date<DataType, arrow::Status> Visit(const ArrayType &array) {
+            return visitPrimitive(array);
+        }
+
+        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass>
+        arrow::enable_if_timestamp<DataType, arrow::Status> Visit(const ArrayType &array) {
+            return visitPrimitive(array);
+        }
+
+        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass>
+        arrow::enable_if_time<DataType, arrow::Status> Visit(const ArrayType &array) {
+            return visitPrimitive(array);
+        }
+
+        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass>
+        arrow::enable_if_duration<DataType, arrow::Status> Visit(const ArrayType &array) {
+            return visitPrimitive(array);
+        }
+
+        template<typename ArrayType, typename DataType = typename ArrayType::TypeClass>
+        arrow::enable_if_decimal<DataType, arrow::Status> Visit(const ArrayType &array) {
+            using DecimalValue = typename arrow::TypeTraits<DataType>::CType;
+            const auto &decimalType = static_cast<const DataType &>(*array.type());
+            DecimalKeyView<DecimalValue> keys(array.raw_values(), decimalType.byte_width(), decimalType.scale(),
+                                              array.null_bitmap_data(), array.offset(), array.length(),
+                                              array.null_count());
+            return kernel(keys);
+        }
+
+    private:
+        template<typename ArrayType>
+        arrow::Status visitPrimitive(const ArrayType &array) {
+            using CType = typename ArrayType::TypeClass::c_type;
+            KeyView<CType> keys(array.raw_values(), array.null_bitmap_data(), array.offset(), array.length(),
+                                array.null_count());
+            return kernel(keys);
+        }
+
+        Kernel &kernel;
+    };
+
+    // Run a kernel on the typed keys of an array
+    template<typename Kernel>
+    arrow::Status visitKeys(const arrow::Array &array, Kernel &&kernel) {
+        KeyViewVisitor<std::remove_reference_t<Kernel>> visitor(kernel);
+        return arrow::VisitArrayInline(array, &visitor);
+    }
+}
+
+#endif //COMMON_KEY_VIEW_H
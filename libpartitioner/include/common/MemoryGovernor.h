@@ -0,0 +1,145 @@
+#ifndef COMMON_MEMORY_GOVERNOR_H
+#define COMMON_MEMORY_GOVERNOR_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+
+#include "common/Settings.h"
+
+namespace common {
+
+    class MemoryGovernor;
+
+    // Memory granted to one consumer, given back to the governor when the reservation goes out of scope
+    class MemoryReservation {
+    public:
+        MemoryReservation(MemoryGovernor *memoryGovernor, int64_t grantedBytes) :
+                governor(memoryGovernor), bytes(grantedBytes) {};
+        MemoryReservation(const MemoryReservation &) = delete;
+        MemoryReservation &operator=(const MemoryReservation &) = delete;
+        MemoryReservation(MemoryReservation &&other) noexcept : governor(other.governor), bytes(other.bytes) {
+            other.bytes = 0;
+        };
+        virtual ~MemoryReservation();
+        int64_t getBytes() const {
+            return bytes;
+        }
+    private:
+        MemoryGovernor *governor;
+        int64_t bytes;
+    };
+
+    // Process-wide memory budget, shared by the readers, sorters, merges and writers. Consumers ask for a
+    // reservation before allocating their buffers and size them on the granted amount instead of fixed constants.
+    // The budget is Settings::memoryBudget when set, otherwise a share of the physical memory of the machine
+    class MemoryGovernor {
+    public:
+        static MemoryGovernor &getInstance() {
+            static MemoryGovernor governor;
+            return governor;
+        }
+
+        void setBudget(int64_t budgetBytes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            budget = std::max(budgetBytes, minimumReservation);
+            std::cout << "[MemoryGovernor] Memory budget set to " << budget / megabyte << " MB" << std::endl;
+        }
+
+        int64_t getBudget() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return budget;
+        }
+
+        int64_t getAvailable() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return std::max(budget - reserved, (int64_t) 0);
+        }
+
+        // Grant up to requestedBytes from the free budget. When the budget is exhausted the consumer still gets
+        // minimumBytes, so that progress is always possible: the overcommit is reported
+        MemoryReservation reserve(const std::string &consumer, int64_t requestedBytes,
+                                  int64_t minimumBytes = minimumReservation) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto available = std::max(budget - reserved, (int64_t) 0);
+            auto granted = std::max(std::min(requestedBytes, available), std::min(minimumBytes, requestedBytes));
+            if (granted > available) {
+                std::cout << "[MemoryGovernor] Overcommitting " << (granted - available) / megabyte
+                          << " MB for " << consumer << std::endl;
+            }
+            reserved += granted;
+            return {this, granted};
+        }
+
+        // Reserve a fraction of the whole budget (e.g. 0.5 for half of it)
+        MemoryReservation reserveShare(const std::string &consumer, double share,
+                                       int64_t minimumBytes = minimumReservation) {
+            return reserve(consumer, (int64_t) ((double) getBudget() * share), minimumBytes);
+        }
+
+        void release(int64_t bytes) {
+            std::lock_guard<std::mutex> lock(mutex);
+            reserved = std::max(reserved - bytes, (int64_t) 0);
+        }
+
+        // Reservation for numBatches record batches in memory at once (e.g. the prefetched batches and the one being
+        // processed). A batch is worth a fixed share of the budget and at least one row group of rows of the given
+        // width, so that the reader can always make progress
+        MemoryReservation reserveBatches(const std::string &consumer, int64_t rowWidth, int64_t numBatches) {
+            auto rowGroupBytes = std::max(rowWidth, (int64_t) 1) * Settings::rowGroupSize;
+            auto batchBytes = std::clamp((int64_t) ((double) getBudget() * batchShare), rowGroupBytes,
+                                         rowGroupBytes * maxRowGroupsPerBatch);
+            numBatches = std::max(numBatches, (int64_t) 1);
+            return reserve(consumer, batchBytes * numBatches, rowGroupBytes * numBatches);
+        }
+
+        // Rows per record batch for the memory granted to numBatches batches of the given row width. The result is
+        // a multiple of the row group size, bounded to [1, maxRowGroupsPerBatch] row groups
+        static size_t getBatchSize(const MemoryReservation &reservation, int64_t rowWidth, int64_t numBatches) {
+            auto batchBytes = reservation.getBytes() / std::max(numBatches, (int64_t) 1);
+            auto rowGroups = batchBytes / std::max(rowWidth, (int64_t) 1) / Settings::rowGroupSize;
+            rowGroups = std::clamp(rowGroups, (int64_t) 1, maxRowGroupsPerBatch);
+            return (size_t) (rowGroups * Settings::rowGroupSize);
+        }
+
+        // DuckDB memory_limit option for the given reservation
+        static std::string toDuckDBMemoryLimit(const MemoryReservation &reservation) {
+            return std::to_string(std::max(reservation.getBytes() / megabyte, (int64_t) 1)) + "MB";
+        }
+
+    private:
+        MemoryGovernor() {
+            if (Settings::memoryBudget > 0) {
+                budget = Settings::memoryBudget;
+            } else {
+                auto physicalPages = sysconf(_SC_PHYS_PAGES);
+                auto pageSize = sysconf(_SC_PAGE_SIZE);
+                int64_t physicalMemory = physicalPages > 0 && pageSize > 0 ?
+                                         (int64_t) physicalPages * pageSize : (int64_t) 16 << 30;
+                budget = (int64_t) ((double) physicalMemory * physicalMemoryShare);
+            }
+            std::cout << "[MemoryGovernor] Memory budget is " << budget / megabyte << " MB" << std::endl;
+        }
+
+        static inline const int64_t megabyte = (int64_t) 1 << 20;
+        static inline const int64_t minimumReservation = 64 * megabyte;
+        // Share of the physical memory used when no budget is configured, the rest is left to the OS page cache
+        static inline const double physicalMemoryShare = 0.75;
+        static inline const double batchShare = 1.0 / 32;
+        static inline const int64_t maxRowGroupsPerBatch = 64;
+        std::mutex mutex;
+        int64_t budget = 0;
+        int64_t reserved = 0;
+    };
+
+    inline MemoryReservation::~MemoryReservation() {
+        if (governor != nullptr && bytes > 0) {
+            governor->release(bytes);
+        }
+    }
+}
+
+#endif //COMMON_MEMORY_GOVERNOR_H
@@ -0,0 +1,189 @@
+#ifndef COMMON_POINT_SET_H
+#define COMMON_POINT_SET_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+#include "Point.h"
+
+namespace common {
+
+    // Order of the values in the buffer of a point set: one run per dimension (columnar, the order of the Arrow
+    // columns) or one run per row (row-major, the coordinates of a point next to each other, as the curve encoders
+    // take them)
+    enum PointLayout {
+        COLUMNAR,
+        ROW_MAJOR
+    };
+
+    template<typename T>
+    class BasicPointSet;
+
+    // Read-only view on one row of a point set, no copy of the coordinates
+    template<typename T>
+    class PointView {
+    public:
+        PointView(const BasicPointSet<T> *pointSet, uint32_t rowId) : points(pointSet), row(rowId) {}
+        T operator[](size_t dimension) const {
+            return points->value(row, dimension);
+        }
+        T at(size_t dimension) const {
+            if (dimension >= size()) {
+                throw std::out_of_range("Dimension out of range of the point");
+            }
+            return points->value(row, dimension);
+        }
+        size_t size() const {
+            return points->numDimensions();
+        }
+        uint32_t getRowId() const {
+            return row;
+        }
+        std::vector<T> toVector() const {
+            std::vector<T> point(size());
+            for (size_t dimension = 0; dimension < point.size(); ++dimension) {
+                point[dimension] = points->value(row, dimension);
+            }
+            return point;
+        }
+    private:
+        const BasicPointSet<T> *points;
+        uint32_t row;
+    };
+
+    // Multidimensional points stored flat in a single buffer, instead of one heap allocated vector per row: a row is
+    // a position in the buffer, the structures built on the points (trees, slices, cells) only move row ids around.
+    // Value (row, dimension) is at row * rowStride + dimension * dimensionStride
+    template<typename T>
+    class BasicPointSet {
+    public:
+        using RowIds = std::vector<uint32_t>;
+
+        class Iterator {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = PointView<T>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = void;
+            using reference = PointView<T>;
+
+            Iterator(const BasicPointSet<T> *pointSet, uint32_t rowId) : points(pointSet), row(rowId) {}
+            PointView<T> operator*() const { return {points, row}; }
+            PointView<T> operator[](difference_type n) const { return {points, (uint32_t) (row + n)}; }
+            Iterator &operator++() { row += 1; return *this; }
+            Iterator operator++(int) { auto previous = *this; row += 1; return previous; }
+            Iterator &operator--() { row -= 1; return *this; }
+            Iterator operator--(int) { auto previous = *this; row -= 1; return previous; }
+            Iterator &operator+=(difference_type n) { row += n; return *this; }
+            Iterator &operator-=(difference_type n) { row -= n; return *this; }
+            Iterator operator+(difference_type n) const { return {points, (uint32_t) (row + n)}; }
+            Iterator operator-(difference_type n) const { return {points, (uint32_t) (row - n)}; }
+            difference_type operator-(const Iterator &other) const { return (difference_type) row - other.row; }
+            bool operator==(const Iterator &other) const { return row == other.row; }
+            bool operator!=(const Iterator &other) const { return row != other.row; }
+            bool operator<(const Iterator &other) const { return row < other.row; }
+            bool operator>(const Iterator &other) const { return row > other.row; }
+            bool operator<=(const Iterator &other) const { return row <= other.row; }
+            bool operator>=(const Iterator &other) const { return row >= other.row; }
+        private:
+            const BasicPointSet<T> *points;
+            uint32_t row;
+        };
+
+        BasicPointSet() = default;
+
+        BasicPointSet(size_t numDimensions, size_t numRows, PointLayout pointLayout = COLUMNAR) :
+                dimensions(numDimensions), rows(numRows), layout(pointLayout), values(numDimensions * numRows) {
+            if (numRows > std::numeric_limits<uint32_t>::max()) {
+                throw std::length_error("Too many rows for a point set");
+            }
+            rowStride = layout == COLUMNAR ? 1 : dimensions;
+            dimensionStride = layout == COLUMNAR ? rows : 1;
+        }
+
+        T value(size_t row, size_t dimension) const {
+            return values[row * rowStride + dimension * dimensionStride];
+        }
+
+        void set(size_t row, size_t dimension, T value) {
+            values[row * rowStride + dimension * dimensionStride] = value;
+        }
+
+        PointView<T> operator[](size_t row) const {
+            return {this, (uint32_t) row};
+        }
+
+        // Coordinates of a row, contiguous in the row-major layout only
+        T *rowData(size_t row) {
+            return layout == ROW_MAJOR ? values.data() + row * dimensions : nullptr;
+        }
+
+        // Values of a dimension, contiguous in the columnar layout only
+        const T *columnData(size_t dimension) const {
+            return layout == COLUMNAR ? values.data() + dimension * rows : nullptr;
+        }
+
+        // Ids of all the rows, in order, for the structures to permute
+        RowIds getRowIds() const {
+            RowIds rowIds(rows);
+            std::iota(rowIds.begin(), rowIds.end(), 0);
+            return rowIds;
+        }
+
+        // Order a range of row ids by their value in one dimension, the points themselves are not moved
+        template<typename RowIt>
+        void sortRows(RowIt begin, RowIt end, size_t dimension, bool stable = false) const {
+            auto compare = [this, dimension](uint32_t a, uint32_t b) {
+                return value(a, dimension) < value(b, dimension);
+            };
+            if (stable) {
+                std::stable_sort(begin, end, compare);
+            } else {
+                std::sort(begin, end, compare);
+            }
+        }
+
+        Iterator begin() const {
+            return {this, 0};
+        }
+
+        Iterator end() const {
+            return {this, (uint32_t) rows};
+        }
+
+        size_t size() const {
+            return rows;
+        }
+
+        bool empty() const {
+            return rows == 0;
+        }
+
+        size_t numDimensions() const {
+            return dimensions;
+        }
+
+        PointLayout getLayout() const {
+            return layout;
+        }
+
+    private:
+        size_t dimensions = 0;
+        size_t rows = 0;
+        PointLayout layout = COLUMNAR;
+        size_t rowStride = 1;
+        size_t dimensionStride = 0;
+        std::vector<T> values;
+    };
+
+    using PointSet = BasicPointSet<double>;
+    using IntPointSet = BasicPointSet<int64_t>;
+}
+
+#endif //COMMON_POINT_SET_H
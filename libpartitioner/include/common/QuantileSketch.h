@@ -0,0 +1,172 @@
+#ifndef COMMON_QUANTILE_SKETCH_H
+#define COMMON_QUANTILE_SKETCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "common/Settings.h"
+
+namespace common {
+
+    // KLL sketch (Karnin, Lang, Liberty) of a stream of doubles. Level h keeps items standing for 2^h values each:
+    // a full level is sorted and every other item is promoted to the next level. Memory is O(k), the rank error of a
+    // quantile about 2.3 / k^0.97 of the count, and sketches of disjoint parts of the data merge into a sketch of the
+    // whole. Up to k values nothing is compacted and the quantiles are exact. Sketches merged together need
+    // different seeds, otherwise their compactions make the same choice and the errors add up instead of cancelling
+    class QuantileSketch {
+    public:
+        explicit QuantileSketch(uint32_t k = getK(Settings::quantileRankError), uint64_t seed = Settings::samplingSeed) :
+                k(std::max(k, minK)), generator(seed) {
+            grow();
+        }
+
+        // Smallest k whose rank error stays within the given fraction of the count
+        static uint32_t getK(double rankError) {
+            if (rankError <= 0) {
+                return maxK;
+            }
+            auto k = std::ceil(std::pow(2.296 / rankError, 1.0 / 0.9723));
+            return (uint32_t) std::clamp(k, (double) minK, (double) maxK);
+        }
+
+        void update(double value) {
+            levels[0].emplace_back(value);
+            count += 1;
+            numRetained += 1;
+            if (numRetained >= maxRetained) {
+                compress();
+            }
+        }
+
+        void update(const std::vector<double> &values) {
+            for (auto value: values) {
+                update(value);
+            }
+        }
+
+        void merge(const QuantileSketch &other) {
+            while (levels.size() < other.levels.size()) {
+                grow();
+            }
+            for (size_t level = 0; level < other.levels.size(); ++level) {
+                levels[level].insert(levels[level].end(), other.levels[level].begin(), other.levels[level].end());
+            }
+            count += other.count;
+            numRetained += other.numRetained;
+            while (numRetained >= maxRetained) {
+                compress();
+            }
+        }
+
+        // Value whose rank is q * count (0 for the minimum, 1 for the maximum). For q = 0.5 and an even count, the
+        // upper of the two middle values, like std::nth_element at count / 2
+        double getQuantile(double q) const {
+            return getQuantiles({q}).front();
+        }
+
+        std::vector<double> getQuantiles(const std::vector<double> &quantiles) const {
+            auto weightedValues = getWeightedValues();
+            std::vector<double> values;
+            values.reserve(quantiles.size());
+            for (auto q: quantiles) {
+                auto targetRank = std::clamp(q, 0.0, 1.0) * (double) count;
+                uint64_t cumulativeWeight = 0;
+                double value = weightedValues.empty() ? 0 : weightedValues.back().first;
+                for (const auto &[candidate, weight]: weightedValues) {
+                    cumulativeWeight += weight;
+                    if ((double) cumulativeWeight > targetRank) {
+                        value = candidate;
+                        break;
+                    }
+                }
+                values.emplace_back(value);
+            }
+            return values;
+        }
+
+        uint64_t getCount() const {
+            return count;
+        }
+
+        bool isEmpty() const {
+            return count == 0;
+        }
+
+    private:
+        inline static const uint32_t minK = 8;
+        inline static const uint32_t maxK = 65535;
+        // Capacity of a level shrinks by this factor at every level below the top one
+        inline static const double capacityDecay = 2.0 / 3.0;
+
+        uint32_t getCapacity(size_t level) const {
+            auto depth = levels.size() - level - 1;
+            return (uint32_t) std::ceil(std::pow(capacityDecay, (double) depth) * k) + 1;
+        }
+
+        void grow() {
+            levels.emplace_back();
+            maxRetained = 0;
+            for (size_t level = 0; level < levels.size(); ++level) {
+                maxRetained += getCapacity(level);
+            }
+        }
+
+        // Compact the lowest full level, and the following ones while the sketch is still over capacity
+        void compress() {
+            for (size_t level = 0; level < levels.size(); ++level) {
+                if (levels[level].size() < getCapacity(level)) {
+                    continue;
+                }
+                if (level + 1 == levels.size()) {
+                    grow();
+                }
+                auto &items = levels[level];
+                std::sort(items.begin(), items.end());
+                // An odd item out stays at its level
+                std::vector<double> kept;
+                if (items.size() % 2 == 1) {
+                    kept.emplace_back(items.back());
+                    items.pop_back();
+                }
+                size_t offset = generator() & 1;
+                for (size_t i = offset; i < items.size(); i += 2) {
+                    levels[level + 1].emplace_back(items[i]);
+                }
+                items = std::move(kept);
+                numRetained = 0;
+                for (const auto &levelItems: levels) {
+                    numRetained += levelItems.size();
+                }
+                if (numRetained < maxRetained) {
+                    break;
+                }
+            }
+        }
+
+        std::vector<std::pair<double, uint64_t>> getWeightedValues() const {
+            std::vector<std::pair<double, uint64_t>> weightedValues;
+            weightedValues.reserve(numRetained);
+            for (size_t level = 0; level < levels.size(); ++level) {
+                for (auto value: levels[level]) {
+                    weightedValues.emplace_back(value, (uint64_t) 1 << level);
+                }
+            }
+            std::sort(weightedValues.begin(), weightedValues.end(),
+                      [](const auto &a, const auto &b) { return a.first < b.first; });
+            return weightedValues;
+        }
+
+        uint32_t k;
+        std::vector<std::vector<double>> levels;
+        uint64_t count = 0;
+        size_t numRetained = 0;
+        size_t maxRetained = 0;
+        std::mt19937_64 generator;
+    };
+}
+
+#endif //COMMON_QUANTILE_SKETCH_H
@@ -1,6 +1,7 @@
 #ifndef COMMON_SETTINGS_H
 #define COMMON_SETTINGS_H
 
+#include <algorithm>
 #include <arrow/api.h>
 #include <arrow/compute/api.h>
 #include <arrow/dataset/api.h>
@@ -10,6 +11,7 @@
 #include <arrow/table.h>
 #include <iostream>
 #include <parquet/arrow/writer.h>
+#include <thread>
 #include <vector>
 
 namespace common {
@@ -20,13 +22,42 @@ namespace common {
         inline static const std::string libraryName = "Optimal Layout Partitioner";
         // Row group size is the optimal one
         inline static const int64_t rowGroupSize = 131072;
-        // Adjusted depending on the hardware, generally matching the row group size
+        // Default batch size, the readers derive the actual one from the row width (see MemoryGovernor)
         inline static const size_t batchSize = rowGroupSize * 7;
+        // Partitions sorted by a secondary key are split in about this many row groups (within the bounds below),
+        // so that the row group statistics can skip most of a partition
+        inline static const int64_t orderedRowGroupsPerPartition = 8;
+        inline static const int64_t minRowGroupSize = 8192;
         inline static const size_t bufferSize = 4096 * 4;
+        // Batches decoded ahead by the prefetching batch reader (2 = double buffering)
+        inline static const size_t prefetchDepth = 2;
+        // Upper bound of Parquet writers kept open at the same time by the writer pool (file descriptors)
+        inline static const size_t maxOpenWriters = 512;
+        // Upper bound of the rows buffered by the writer pool before they are forced to disk
+        inline static const int64_t writerPoolBufferBytes = (int64_t) 1 << 30;
         inline static const parquet::ParquetVersion::type version = parquet::ParquetVersion::PARQUET_2_6;
         inline static const arrow::Compression::type compression = arrow::Compression::SNAPPY;
+        // Number of workers of the task scheduler, one per core
+        inline static const size_t numWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+        // Requests kept in flight on the disk by the phases writing independent files (e.g. the partition merges)
+        inline static const size_t diskQueueDepth = 8;
+        // Datasets whose decoded size fits this budget (in bytes) are partitioned in memory. 0 disables the fast path
+        // and lets the memory governor size its budget on the physical memory
+        inline static const int64_t memoryBudget = 0;
+        // Rows sampled by the layout cost model
+        inline static const size_t costModelSampleSize = 100000;
+        // Fixed seed of the samplers, for reproducible estimates and layouts
+        inline static const uint64_t samplingSeed = 42;
+        // Sample-then-scatter build of the tree schemes: rows sampled to build the splits (at least
+        // sampledRowsPerLeaf per expected partition), and the relative deviation from the partition size tolerated
+        // before a leaf is merged with its siblings or split again
+        inline static const size_t sampledBuildSampleSize = 1000000;
+        inline static const size_t sampledRowsPerLeaf = 64;
+        inline static const double sampledLeafTolerance = 0.5;
+        // Rank error of the quantile sketches, as a fraction of the rows (0.01: the median lies between the 49th
+        // and 51st percentile)
+        inline static const double quantileRankError = 0.01;
         // DuckDB config
-        static inline const std::string memoryLimit = "300GB";
         static inline const std::string tempDirectory = "/tmp";
     };
 }
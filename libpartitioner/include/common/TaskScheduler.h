@@ -0,0 +1,222 @@
+#ifndef COMMON_TASK_SCHEDULER_H
+#define COMMON_TASK_SCHEDULER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <arrow/status.h>
+
+#include "common/Settings.h"
+
+namespace common {
+
+    using Task = std::function<void()>;
+
+    // Deque of tasks owned by one worker. The owner pushes and pops at the back (depth-first, the most recently
+    // created subtree is still hot in cache), while idle workers steal from the front (the oldest, usually the
+    // biggest subtrees)
+    class WorkStealingQueue {
+    public:
+        void push(Task task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back(std::move(task));
+        }
+
+        bool pop(Task &task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) {
+                return false;
+            }
+            task = std::move(tasks.back());
+            tasks.pop_back();
+            return true;
+        }
+
+        bool steal(Task &task) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (tasks.empty()) {
+                return false;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            return true;
+        }
+
+    private:
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // Shared scheduler with one worker (and one work-stealing deque) per core
+    class TaskScheduler {
+    public:
+        explicit TaskScheduler(size_t numWorkers = common::Settings::numWorkers) {
+            numWorkers = std::max(numWorkers, (size_t) 1);
+            for (size_t i = 0; i < numWorkers; ++i) {
+                queues.emplace_back(std::make_unique<WorkStealingQueue>());
+            }
+            for (size_t i = 0; i < numWorkers; ++i) {
+                workers.emplace_back([this, i]() { workerLoop(i); });
+            }
+        }
+
+        virtual ~TaskScheduler() {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            sleepCondition.notify_all();
+            for (auto &worker: workers) {
+                worker.join();
+            }
+        }
+
+        static TaskScheduler &getInstance() {
+            static TaskScheduler scheduler;
+            return scheduler;
+        }
+
+        // Tasks spawned by a worker go to its own deque, tasks from other threads are spread round-robin
+        void submit(Task task) {
+            size_t queueIndex;
+            if (currentScheduler == this) {
+                queueIndex = currentWorker;
+            } else {
+                queueIndex = nextQueue.fetch_add(1) % queues.size();
+            }
+            pendingTasks.fetch_add(1);
+            queues.at(queueIndex)->push(std::move(task));
+            notifyAll();
+        }
+
+        // Run one pending task, if any: first from the own deque, then stealing from the other workers
+        bool runPendingTask() {
+            Task task;
+            bool found = false;
+            size_t startIndex = currentScheduler == this ? currentWorker : nextQueue.load() % queues.size();
+            if (currentScheduler == this) {
+                found = queues.at(currentWorker)->pop(task);
+            }
+            for (size_t i = 1; i <= queues.size() && !found; ++i) {
+                found = queues.at((startIndex + i) % queues.size())->steal(task);
+            }
+            if (!found) {
+                return false;
+            }
+            pendingTasks.fetch_sub(1);
+            task();
+            return true;
+        }
+
+        // Run pending tasks until the condition holds. Once there is nothing left to steal, the thread sleeps until
+        // a task is submitted or finishes, instead of spinning while the other workers are busy in IO
+        template<typename Condition>
+        void runUntil(Condition done) {
+            while (!done()) {
+                if (runPendingTask()) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                sleepCondition.wait(lock, [this, &done]() { return done() || stopping || pendingTasks.load() > 0; });
+            }
+        }
+
+        // Wake up the sleeping workers and waiters. The mutex is taken so that a thread between the check of its
+        // condition and its wait cannot miss the notification
+        void notifyAll() {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+            }
+            sleepCondition.notify_all();
+        }
+
+        size_t getNumWorkers() {
+            return workers.size();
+        }
+
+    private:
+        void workerLoop(size_t index) {
+            currentScheduler = this;
+            currentWorker = index;
+            while (true) {
+                if (runPendingTask()) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                if (stopping) {
+                    break;
+                }
+                sleepCondition.wait_for(lock, std::chrono::milliseconds(10),
+                                        [this]() { return stopping || pendingTasks.load() > 0; });
+            }
+        }
+
+        inline static thread_local TaskScheduler *currentScheduler = nullptr;
+        inline static thread_local size_t currentWorker = 0;
+        std::vector<std::unique_ptr<WorkStealingQueue>> queues;
+        std::vector<std::thread> workers;
+        std::mutex sleepMutex;
+        std::condition_variable sleepCondition;
+        std::atomic<size_t> pendingTasks{0};
+        std::atomic<size_t> nextQueue{0};
+        bool stopping = false;
+    };
+
+    // Set of tasks that can be waited on together, e.g. the children of a node in a recursive split.
+    // While waiting, the calling thread keeps executing pending tasks: a task can then spawn and wait for its own
+    // sub-tasks without ever blocking a worker. With nothing left to run, the waiting thread sleeps
+    class TaskGroup {
+    public:
+        explicit TaskGroup(TaskScheduler &taskScheduler = TaskScheduler::getInstance()) : scheduler(taskScheduler) {};
+
+        virtual ~TaskGroup() {
+            std::ignore = wait();
+        }
+
+        void run(std::function<arrow::Status()> task) {
+            remaining.fetch_add(1);
+            // The scheduler outlives the group, which can be gone as soon as the last task is counted
+            auto &groupScheduler = scheduler;
+            scheduler.submit([this, &groupScheduler, task = std::move(task)]() {
+                arrow::Status taskStatus;
+                try {
+                    taskStatus = task();
+                } catch (std::exception &e) {
+                    taskStatus = arrow::Status::UnknownError(e.what());
+                }
+                if (!taskStatus.ok()) {
+                    std::lock_guard<std::mutex> lock(statusMutex);
+                    if (status.ok()) {
+                        status = taskStatus;
+                    }
+                }
+                remaining.fetch_sub(1);
+                groupScheduler.notifyAll();
+            });
+        }
+
+        // Returns the first error reported by the tasks of the group
+        arrow::Status wait() {
+            scheduler.runUntil([this]() { return remaining.load() == 0; });
+            std::lock_guard<std::mutex> lock(statusMutex);
+            return status;
+        }
+
+    private:
+        TaskScheduler &scheduler;
+        std::atomic<size_t> remaining{0};
+        std::mutex statusMutex;
+        arrow::Status status;
+    };
+}
+
+#endif //COMMON_TASK_SCHEDULER_H
@@ -3,6 +3,7 @@
 
 #include <iostream>
 #include <filesystem>
+#include <functional>
 #include <map>
 #include <regex>
 #include <set>
@@ -20,20 +21,26 @@
 #include <parquet/arrow/reader.h>
 #include <parquet/arrow/writer.h>
 
+#include "common/KeyView.h"
+#include "common/MemoryGovernor.h"
 #include "common/Settings.h"
 #include "partitioning/Partitioning.h"
 #include "storage/DataWriter.h"
+#include "storage/SpillFormat.h"
 
 namespace external {
+    // Opens a new reader of a sorted file, from its first batch
+    using BatchReaderFactory = std::function<arrow::Result<std::shared_ptr<arrow::RecordBatchReader>>()>;
+
     struct ExternalFileReader{
-        ExternalFileReader(std::shared_ptr<parquet::arrow::FileReader> &_fileReader,
+        ExternalFileReader(BatchReaderFactory _openReader,
                            std::shared_ptr<arrow::RecordBatchReader> &_recordBatchReader,
                            std::shared_ptr<arrow::RecordBatch> &_recordBatch,
                            int _recordBatchIndex, int _fragmentStartIndex, uint32_t _numRows):
-                           fileReader(_fileReader), recordBatchReader(_recordBatchReader), recordBatch(_recordBatch),
+                           openReader(std::move(_openReader)), recordBatchReader(_recordBatchReader), recordBatch(_recordBatch),
                            recordBatchIndex(_recordBatchIndex), fragmentStartIndex(_fragmentStartIndex),
                            numRows(_numRows) {};
-        std::shared_ptr<parquet::arrow::FileReader> fileReader;
+        BatchReaderFactory openReader;
         std::shared_ptr<arrow::RecordBatchReader> recordBatchReader;
         std::shared_ptr<arrow::RecordBatch> recordBatch;
         uint32_t recordBatchIndex;
@@ -54,12 +61,13 @@ namespace external {
     class ExternalMerge {
     public:
         static arrow::Status mergeFilesFromSortedBatches(const std::filesystem::path &folder, const std::string &columnName,
-                                                         const uint32_t batchSize){
+                                                         const uint32_t batchSize,
+                                                         const storage::SpillFormat &spillFormat = storage::SpillFormat::getDefaultFormat()){
             /*
              * External Merge Sort: merge a set of sorted files on disk
              * https://en.wikipedia.org/wiki/K-way_merge_algorithm
              * Idea:
-             * 1. Explore a folder with sorted Parquet file
+             * 1. Explore a folder with sorted files, in the spill format they were written in
              * 2. Load a vector of readers for those files. Also, keep track of the reading index within each reader
              * 3. Precompute the sum of number of rows of all the readers and maintain the current total read number of rows
              * 4. For each reader, load a fragment of rows. The fragment size is the batchSize / number of readers.
@@ -86,30 +94,19 @@ namespace external {
             // Prepare vector of file readers for each sorted batch
             // pair<arrow file reader, record batch index, fragment start index>
             std::vector<std::shared_ptr<ExternalFileReader>> readers;
-            parquet::arrow::FileReaderBuilder reader_builder;
 
             // Compute sum of rows of readers, so that later we can compare it with the total read rows
             uint32_t totalNumRows = 0;
             // List files in folder. The sorted parts are marked with an initial "s" in the filename
-            const std::regex regexFiles{R"(.*s\d+\.parquet)"};
+            const std::regex regexFiles{R"(.*s\d+\.)" + spillFormat.getExtension().substr(1)};
             for (const auto &folderFile : std::filesystem::directory_iterator(folder)) {
                 const std::filesystem::path& filePath = folderFile.path();
                 if (std::regex_match(filePath.string(), regexFiles)){
-                    // Define properties for the file readers
-                    auto reader_properties = parquet::ReaderProperties(arrow::default_memory_pool());
-                    reader_properties.set_buffer_size(common::Settings::bufferSize);
-                    reader_properties.enable_buffered_stream();
-                    auto arrow_reader_props = parquet::ArrowReaderProperties();
-                    arrow_reader_props.set_batch_size(batchSize);  // default 64 * 1024
-                    ARROW_RETURN_NOT_OK(reader_builder.OpenFile(filePath, /*memory_map=*/false, reader_properties));
-                    reader_builder.memory_pool(arrow::default_memory_pool());
-                    reader_builder.properties(arrow_reader_props);
-                    std::shared_ptr<parquet::arrow::FileReader> reader;
-                    ARROW_ASSIGN_OR_RAISE(reader, reader_builder.Build());
-                    std::shared_ptr<arrow::RecordBatchReader> recordBatchReader;
-                    std::shared_ptr<arrow::RecordBatchReader> firstRecordBatchReader;
-                    ARROW_RETURN_NOT_OK(reader->GetRecordBatchReader(&recordBatchReader));
-                    ARROW_RETURN_NOT_OK(reader->GetRecordBatchReader(&firstRecordBatchReader));
+                    BatchReaderFactory openReader = [spillFormat, filePath, batchSize]() {
+                        return spillFormat.openReader(filePath, batchSize);
+                    };
+                    ARROW_ASSIGN_OR_RAISE(auto recordBatchReader, openReader());
+                    ARROW_ASSIGN_OR_RAISE(auto firstRecordBatchReader, openReader());
                     std::shared_ptr<arrow::RecordBatch> currentRecordBatch;
                     std::shared_ptr<arrow::RecordBatch> firstRecordBatch;
                     uint32_t readerNumRows = 0;
@@ -122,7 +119,7 @@ namespace external {
                     }
                     totalNumRows += readerNumRows;
                     RETURN_NOT_OK(firstRecordBatchReader->ReadNext(&firstRecordBatch));
-                    readers.emplace_back(std::make_shared<ExternalFileReader>(reader, firstRecordBatchReader,
+                    readers.emplace_back(std::make_shared<ExternalFileReader>(openReader, firstRecordBatchReader,
                                                                               firstRecordBatch, 0, 0, readerNumRows));
                 }
             }
@@ -131,6 +128,10 @@ namespace external {
             std::cout << "[External Merge] Found " << numReaders << " files/readers to merge" << std::endl;
             std::cout << "[External Merge] Expected " << totalNumRows << " rows to merge in total" << std::endl;
 
+            // The merge keeps one fragment of each file in the min-heap, up to one batch of rows in total
+            auto heapReservation = common::MemoryGovernor::getInstance().reserve("External merge heap",
+                                                                                 (int64_t) batchSize * (int64_t) sizeof(ExternalRow));
+
             // Prepare a vector of empty columns matching the schema. It will be populated with the merged data
             if (numReaders > 0 ) {
 
@@ -175,8 +176,6 @@ namespace external {
                         }
                         std::shared_ptr<ExternalFileReader> currentReader = readers.at(i);
                         if (currentReader->fragmentStartIndex != readFinished){
-                            std::shared_ptr<arrow::RecordBatchReader> batchReader;
-                            ARROW_RETURN_NOT_OK(currentReader->fileReader->GetRecordBatchReader(&batchReader));
                             uint32_t recordBatchIndex = currentReader->recordBatchIndex;
                             uint32_t fragmentStart = currentReader->fragmentStartIndex;
                             // Load fragment-sized values from the reader
@@ -211,20 +210,23 @@ namespace external {
                                 numRowsRead += fragmentNumRows;
                                 numRowsFragments += fragmentNumRows;
                             }
-                            // Retrieve only the sorted column from the batch fragment
-                            std::vector<std::shared_ptr<arrow::Array>> arrowArray = {batchFragment->column(sortingColumnIndex)};
-                            // Convert the value to double
-                            auto converter = common::ColumnDataConverter();
-                            std::vector<std::shared_ptr<std::vector<double>>> castedArray = converter.toDouble({arrowArray}).ValueOrDie();
-                            std::shared_ptr<std::vector<double>> castedColumn = castedArray.at(0);
-                            assert(castedColumn->size() == batchFragment->num_rows());
-                            for (int j = 0; j < castedColumn->size(); ++j){
-                                auto columnValue = castedColumn->at(j);
-                                // Push the value, the index of the reader, the index of the record batch and the
-                                // fragment start index to the heap
-                                ExternalRow heapRow = ExternalRow(columnValue, i, recordBatchIndex, fragmentStart + j);
-                                q.push(heapRow);
-                            }
+                            // Retrieve only the sorted column from the batch fragment, its keys are read in place
+                            auto sortedColumn = batchFragment->column(sortingColumnIndex);
+                            RETURN_NOT_OK(common::visitKeys(*sortedColumn, [&q, i, recordBatchIndex, fragmentStart](const auto &keys) {
+                                // A null key has no place in the order of the heap
+                                if (keys.nullCount() > 0) {
+                                    return arrow::Status::Invalid("Sorted column has ", keys.nullCount(), " null keys");
+                                }
+                                for (int64_t j = 0; j < keys.size(); ++j){
+                                    // Convert the value to double
+                                    auto columnValue = static_cast<double>(keys[j]);
+                                    // Push the value, the index of the reader, the index of the record batch and the
+                                    // fragment start index to the heap
+                                    ExternalRow heapRow = ExternalRow(columnValue, i, recordBatchIndex, fragmentStart + j);
+                                    q.push(heapRow);
+                                }
+                                return arrow::Status::OK();
+                            }));
                         }
                     }
 
@@ -292,9 +294,12 @@ namespace external {
                 return arrow::Status::Invalid("Invalid partition size");
             }
 
-            // Initialize DuckDB
+            // Initialize DuckDB, its memory limit is the memory reserved for the sort (half of the budget at most,
+            // concurrent sorts share the rest)
+            auto sortReservation = common::MemoryGovernor::getInstance().reserveShare("DuckDB sort", sortMemoryShare,
+                                                                                      minimumSortMemory);
             duckdb::DBConfig config;
-            config.SetOption("memory_limit", partitioning::MultiDimensionalPartitioning::memoryLimit);
+            config.SetOption("memory_limit", common::MemoryGovernor::toDuckDBMemoryLimit(sortReservation));
             config.SetOption("temp_directory", partitioning::MultiDimensionalPartitioning::tempDirectory);
             config.options.preserve_insertion_order = false;
             duckdb::DuckDB db(":memory:", &config);
@@ -313,15 +318,18 @@ namespace external {
                 totalSize = row.GetValue<int>(0);
             }
 
-            // Remove parts
+            // Parts to remove, only once the sorted partitions are written: until then an interrupted merge
+            // can start over from them
+            std::vector<std::filesystem::path> partFiles;
             for (const auto & folderIter : std::filesystem::recursive_directory_iterator(folder))
             {
                 if (folderIter.path().extension() == ".parquet")
                 {
-                    std::filesystem::remove(folderIter.path());
+                    partFiles.emplace_back(folderIter.path().lexically_normal());
                 }
             }
 
+            std::set<std::filesystem::path> exportedFiles;
             size_t index = 0;
             size_t offset = 0;
             while (totalSize > 0){
@@ -335,6 +343,7 @@ namespace external {
                 auto exportQueryResult = con.Query(exportQuery);
                 // std::cout << "Executed query: " << exportQuery << std::endl;
                 std::cout << "Written to disk " << exportedFile << std::endl;
+                exportedFiles.emplace(std::filesystem::path(exportedFile).lexically_normal());
                 offset += partitionSize;
                 if (totalSize < partitionSize){
                      break;
@@ -343,10 +352,19 @@ namespace external {
                 index++;
             }
 
+            // Remove parts, except the ones overwritten by a sorted partition with the same name
+            for (const auto &partFile : partFiles) {
+                if (exportedFiles.find(partFile) == exportedFiles.end()) {
+                    std::filesystem::remove(partFile);
+                }
+            }
+
             return arrow::Status::OK();
         }
 
     private:
+        static inline const double sortMemoryShare = 0.5;
+        static inline const int64_t minimumSortMemory = (int64_t) 256 << 20;
         static arrow::Status exportTableToDisk(const std::shared_ptr<arrow::Table> &table,
                                                const std::filesystem::path &outputPath){
             // Export the batch to disk
@@ -382,9 +400,7 @@ namespace external {
             // If the index is lower than the current, we need to restart from the first record batch
             // Keep the currentRecordBatch variable uninitialized to do so.
             else{
-                std::shared_ptr<arrow::RecordBatchReader> firstRecordBatchReader;
-                ARROW_RETURN_NOT_OK(reader->fileReader->GetRecordBatchReader(&firstRecordBatchReader));
-                reader->recordBatchReader = firstRecordBatchReader;
+                ARROW_ASSIGN_OR_RAISE(reader->recordBatchReader, reader->openReader());
             };
             // Get the record batch reader
             // Iterate over the record batches
@@ -18,7 +18,10 @@
 #include <arrow/table.h>
 #include <parquet/arrow/writer.h>
 
+#include "common/MemoryGovernor.h"
+#include "common/Settings.h"
 #include "storage/DataWriter.h"
+#include "storage/SpillFormat.h"
 
 namespace external {
 
@@ -26,9 +29,10 @@ namespace external {
     public:
         static arrow::Status writeSortedBatch(const std::shared_ptr<arrow::RecordBatch> &recordBatch,
                                               const std::string &sortColumn,
-                                              const std::filesystem::path &outputPath){
+                                              const std::filesystem::path &outputPath,
+                                              const storage::SpillFormat &spillFormat = storage::SpillFormat::getDefaultFormat()){
             /*
-             * Helper method to sort a RecordBatch by a certain column and export it to a Parquet file
+             * Helper method to sort a RecordBatch by a certain column and export it to a file in the spill format
              */
             // Sort by the provided column name
             std::cout << "[ExternalSort] Starting to write sorted file " << outputPath << " for sort column "
@@ -37,33 +41,30 @@ namespace external {
                                  arrow::compute::SortIndices(recordBatch->GetColumnByName(sortColumn),
                                  arrow::compute::SortOptions({arrow::compute::SortKey{sortColumn}})));
             ARROW_ASSIGN_OR_RAISE(arrow::Datum sorted, arrow::compute::Take(recordBatch, sort_indices));
-            // Prepare the output file
-            std::shared_ptr<arrow::io::FileOutputStream> outfile;
-            ARROW_ASSIGN_OR_RAISE(outfile, arrow::io::FileOutputStream::Open(outputPath.string()));
-            // Prepare the Parquet writer
-            std::unique_ptr<parquet::arrow::FileWriter> writer;
-            ARROW_ASSIGN_OR_RAISE(writer, parquet::arrow::FileWriter::Open(*recordBatch->schema(),
-                                                                           arrow::default_memory_pool(),
-                                                                           outfile,
-                                                                           storage::DataWriter::getWriterProperties(),
-                                                                           storage::DataWriter::getArrowWriterProperties()));
             // Write the batch and close the file
             std::cout << "[ExternalSort] Writing " << sorted.record_batch()->num_rows() << " rows" << std::endl;
-            ARROW_RETURN_NOT_OK(writer->WriteRecordBatch(*sorted.record_batch()));
-            ARROW_RETURN_NOT_OK(writer->Close());
+            ARROW_RETURN_NOT_OK(spillFormat.writeBatch(sorted.record_batch(), outputPath));
             std::cout << "[ExternalSort] Completed, written sorted file to " << outputPath << std::endl;
             return arrow::Status::OK();
         }
         static arrow::Status writeSortedFile(const std::filesystem::path &inputPath,
                                              const std::string &sortColumn,
                                              const std::filesystem::path &outputPath) {
-            // Initialize DuckDB
-            duckdb::DuckDB db(nullptr);
+            // Initialize DuckDB, its memory limit is the memory reserved for the sort, it spills to disk beyond that
+            auto sortReservation = common::MemoryGovernor::getInstance().reserveShare("DuckDB file sort", sortMemoryShare,
+                                                                                      minimumSortMemory);
+            duckdb::DBConfig config;
+            config.SetOption("memory_limit", common::MemoryGovernor::toDuckDBMemoryLimit(sortReservation));
+            config.SetOption("temp_directory", common::Settings::tempDirectory);
+            duckdb::DuckDB db(":memory:", &config);
             duckdb::Connection con(db);
 
             // Load parquet file into memory and sort it
             std::string loadQuery = "CREATE TABLE tbl AS SELECT * FROM read_parquet('" + inputPath.string() + "') ORDER BY " + sortColumn;
             auto loadQueryResult = con.Query(loadQuery);
+            if (loadQueryResult->HasError()) {
+                return arrow::Status::IOError("Sorting ", inputPath.string(), " failed: ", loadQueryResult->GetError());
+            }
 
             // Write table to disk
             std::string exportQuery = "COPY (SELECT * FROM tbl) "
@@ -71,9 +72,14 @@ namespace external {
                                       "(FORMAT PARQUET, COMPRESSION SNAPPY, "
                                       " ROW_GROUP_SIZE " + std::to_string(common::Settings::rowGroupSize) + ")";
             auto exportQueryResult = con.Query(exportQuery);
+            if (exportQueryResult->HasError()) {
+                return arrow::Status::IOError("Writing ", outputPath.string(), " failed: ", exportQueryResult->GetError());
+            }
             return arrow::Status::OK();
         }
     private:
+        static inline const double sortMemoryShare = 0.5;
+        static inline const int64_t minimumSortMemory = (int64_t) 256 << 20;
     };
 }
 
@@ -43,6 +43,17 @@ namespace partitioning {
         arrow::Status partitionBatch(const uint32_t &batchId,
                                      std::shared_ptr<arrow::RecordBatch> &recordBatch,
                                      std::shared_ptr<storage::DataReader> &dataReader);
+        static arrow::Result<std::shared_ptr<arrow::RecordBatch>> addCellIndexes(
+                const std::shared_ptr<arrow::RecordBatch> &recordBatch,
+                const std::vector<std::string> &gridColumns,
+                double_t gridCellWidth,
+                const std::vector<double_t> &columnDomains);
+        static inline const std::string cellColumn = "cell_idx";
+        static inline const std::string cellWidthParameter = "cell_width";
+        static inline const std::string domainParameter = "domain_";
+    protected:
+        std::vector<std::string> getRoutingColumns() override;
+        std::map<std::string, double> getLayoutParameters() override;
     private:
         partitioning::PartitioningType type = GRID;
         size_t cellCapacity;
@@ -16,6 +16,8 @@
 #include <arrow/table.h>
 
 #include "common/ColumnDataConverter.h"
+#include "common/MemoryGovernor.h"
+#include "common/TaskScheduler.h"
 #include "partitioning/Partitioning.h"
 #include "partitioning/PartitioningType.h"
 #include "storage/DataWriter.h"
@@ -37,12 +39,32 @@ namespace partitioning {
         arrow::Status partition() override;
     private:
         partitioning::PartitioningType type = GRID;
-        void computeLinearScales(std::filesystem::path &partitionFile,
-                                 const uint32_t depth,
-                                 const std::vector<std::pair<double, double>> &dimensionRanges);
+        arrow::Status computeLinearScales(std::filesystem::path &partitionFile,
+                                          const uint32_t depth,
+                                          const std::vector<std::pair<double, double>> &dimensionRanges);
+        arrow::Status splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                    const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                    std::vector<std::pair<size_t, size_t>> &partitionRanges) override;
+        arrow::Status buildSplitTree(std::vector<uint64_t> &rowIndexes,
+                                     const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                     size_t leafCapacity,
+                                     structures::SplitTree &splitTree) override;
+        void splitCellInMemory(std::vector<uint64_t> &rowIndexes,
+                               const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                               std::vector<std::pair<size_t, size_t>> &partitionRanges,
+                               size_t begin,
+                               size_t end,
+                               uint32_t depth,
+                               const std::vector<std::pair<double, double>> &dimensionRanges,
+                               size_t leafCapacity,
+                               structures::SplitTree *splitTree = nullptr,
+                               uint32_t nodeId = 0);
         std::vector<std::vector<double>> linearScales;
         size_t cellCapacity;
         std::vector<std::pair<uint32_t, uint32_t>> rowIndexToPartitionId;
+        // Types of the partitioning columns, to write the split values of dates and timestamps as SQL literals
+        std::vector<std::shared_ptr<arrow::DataType>> columnTypes;
+        std::string getLiteral(uint32_t columnIndex, double value);
         std::string getTimestamp(double value);
     };
 }
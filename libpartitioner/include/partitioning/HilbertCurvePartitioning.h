@@ -27,8 +27,6 @@
 
 namespace partitioning {
 
-    using IntRow = std::vector<int64_t>;
-
     class HilbertCurvePartitioning : public MultiDimensionalPartitioning {
     public:
         HilbertCurvePartitioning(const std::shared_ptr<storage::DataReader> &reader,
@@ -44,6 +42,12 @@ namespace partitioning {
         arrow::Status partitionBatch(const uint64_t &batchId,
                                      std::shared_ptr<arrow::RecordBatch> &recordBatch,
                                      std::shared_ptr<storage::DataReader> &dataReader);
+        static arrow::Result<std::shared_ptr<arrow::RecordBatch>> addCurveValues(
+                const std::shared_ptr<arrow::RecordBatch> &recordBatch,
+                const std::vector<std::string> &curveColumns);
+        static inline const std::string curveColumn = "hilbert_curve";
+    protected:
+        std::vector<std::string> getRoutingColumns() override;
     private:
         partitioning::PartitioningType type = SPACE_FILLING_CURVE;
         std::unordered_map<uint8_t, uint64_t> columnToDomain;
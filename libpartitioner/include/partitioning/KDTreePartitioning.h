@@ -17,6 +17,7 @@
 #include <arrow/table.h>
 
 #include "common/ColumnDataConverter.h"
+#include "common/TaskScheduler.h"
 #include "structures/KDTree.h"
 #include "partitioning/Partitioning.h"
 #include "partitioning/PartitioningType.h"
@@ -37,7 +38,25 @@ namespace partitioning {
     private:
         partitioning::PartitioningType type = TREE;
         arrow::Status partitionBranches(std::filesystem::path &datasetFile, uint32_t depth);
-        arrow::Result<double> findMedian(std::filesystem::path &datasetFile, uint32_t columnIndex);
+        arrow::Result<double> findMedian(std::shared_ptr<storage::DataReader> &nodeReader,
+                                         std::filesystem::path &datasetFile,
+                                         uint32_t columnIndex);
+        arrow::Status splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                    const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                    std::vector<std::pair<size_t, size_t>> &partitionRanges) override;
+        arrow::Status buildSplitTree(std::vector<uint64_t> &rowIndexes,
+                                     const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                     size_t leafCapacity,
+                                     structures::SplitTree &splitTree) override;
+        void splitBranchInMemory(std::vector<uint64_t> &rowIndexes,
+                                 const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                 std::vector<std::pair<size_t, size_t>> &partitionRanges,
+                                 size_t begin,
+                                 size_t end,
+                                 uint32_t depth,
+                                 size_t leafCapacity,
+                                 structures::SplitTree *splitTree = nullptr,
+                                 uint32_t nodeId = 0);
     };
 }
 
@@ -0,0 +1,56 @@
+#ifndef PARTITIONING_LAYOUT_APPENDER_H
+#define PARTITIONING_LAYOUT_APPENDER_H
+
+#include <filesystem>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/result.h>
+#include <arrow/status.h>
+
+#include "partitioning/PartitioningType.h"
+#include "storage/ProgressJournal.h"
+#include "structures/PartitionLayout.h"
+#include "structures/PartitionManifest.h"
+
+namespace partitioning {
+
+    // Append mode: route the rows of a new file into the partitions of an existing folder, using the layout persisted
+    // by the partitioning run. Only the partitions receiving rows are rewritten, the ones growing past the partition
+    // size are split locally. The cost depends on the new rows and the touched partitions, not on the whole dataset.
+    // The append is all or nothing: the new files are prepared aside and committed at once, and the commit is
+    // journaled so that calling append again with the same file after an interruption completes it
+    class LayoutAppender {
+    public:
+        explicit LayoutAppender(const std::filesystem::path &partitionedFolder);
+        arrow::Status append(std::filesystem::path &newFile);
+    private:
+        arrow::Result<std::shared_ptr<arrow::RecordBatch>> addRoutingColumns(const std::shared_ptr<arrow::RecordBatch> &recordBatch);
+        arrow::Status mergePartition(uint32_t partitionId, std::filesystem::path &stagedFile);
+        arrow::Status splitTable(const std::shared_ptr<arrow::Table> &table,
+                                 const structures::PartitionRegion &region,
+                                 std::vector<std::pair<std::shared_ptr<arrow::Table>, structures::PartitionRegion>> &pieces);
+        arrow::Status writePartition(std::shared_ptr<arrow::Table> &table, uint32_t partitionId);
+        arrow::Status updateManifest();
+        arrow::Status commit();
+        static std::string getAppendFingerprint(const std::filesystem::path &newFile);
+        std::filesystem::path getRewrittenPath(uint32_t partitionId);
+        bool isSortedByKey();
+        std::filesystem::path folder;
+        structures::PartitionLayout layout;
+        std::set<uint32_t> rewrittenPartitions;
+        // Secondary order of the rows inside the partitions, kept by the rewritten ones
+        IntraPartitionOrder intraPartitionOrder = SPLIT_ORDER;
+        std::vector<std::string> intraPartitionColumns;
+        std::shared_ptr<storage::ProgressJournal> journal;
+        static inline const std::string stagingFolderName = "_append";
+        static inline const std::string rewrittenFolderName = "rewritten";
+        static inline const std::string preparedStep = "prepared";
+    };
+}
+
+#endif //PARTITIONING_LAYOUT_APPENDER_H
@@ -7,12 +7,19 @@
 #include <arrow/util/type_fwd.h>
 #include <iostream>
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <parquet/arrow/writer.h>
 #include <regex>
 #include <set>
 
 #include "partitioning/PartitioningType.h"
 #include "storage/DataReader.h"
+#include "storage/ProgressJournal.h"
+#include "structures/PartitionLayout.h"
+#include "structures/PartitionManifest.h"
+#include "structures/SplitTree.h"
 
 namespace partitioning {
 
@@ -30,20 +37,73 @@ namespace partitioning {
         void setColumns(const std::vector<std::string> &partitionColumns);
         void setDataReader(const std::shared_ptr<storage::DataReader> &reader);
         void setPartitionSize(size_t rowsPerPartition);
+        void setMemoryBudget(int64_t budgetBytes);
+        bool fitsInMemory();
+        // Continue an interrupted run from the progress journal in the output folder
+        void setResume(bool resumeRun);
+        // Name of the scheme recorded in the persisted layout
+        void setSchemeName(const std::string &name);
+        // Sort the rows of every final partition by a secondary key (a curve over the order columns, or the columns
+        // themselves), written in row groups sized for the statistics to prune. Order columns default to the
+        // partitioning columns
+        void setIntraPartitionOrder(IntraPartitionOrder order, const std::vector<std::string> &orderColumns = {});
+        static arrow::Result<std::shared_ptr<arrow::Table>> sortByOrderKey(const std::shared_ptr<arrow::Table> &table,
+                                                                          IntraPartitionOrder order,
+                                                                          const std::vector<std::string> &orderColumns);
+        static int64_t getOrderedRowGroupSize(int64_t partitionRows);
+        // Build the splits of the tree schemes on a sample and scatter the dataset to the leaves in a single pass
+        void setBuildMode(TreeBuildMode mode);
         bool isFinished();
         // DuckDB config
-        static inline const std::string memoryLimit = common::Settings::memoryLimit;
         static inline const std::string tempDirectory = common::Settings::tempDirectory;
     private:
         bool canSkipPartitioning();
         partitioning::PartitioningType type = OTHER;
     protected:
         arrow::Status copyOriginalToDestination();
+        // Late materialization: the splits run on the partitioning columns + row id, full rows are written once
+        arrow::Status writeNarrowProjection();
+        arrow::Status materializePartitions(std::filesystem::path &sourceFile);
         bool isFileCompleted(const std::filesystem::path &partitionFile);
         void deleteIntermediateFiles();
         std::set<std::filesystem::path> getCompletedFiles();
         void moveCompletedFiles();
         void deleteSubfolders();
+        arrow::Status finalizeCompletedFiles();
+        // Checkpoints: steps recorded in the progress journal are skipped when the run is resumed
+        arrow::Status openJournal();
+        std::string getRunFingerprint();
+        bool isCheckpointed(const std::string &step, const std::filesystem::path &file = {});
+        arrow::Status checkpoint(const std::string &step, const std::filesystem::path &file = {});
+        void discardUncheckpointedFiles(const std::string &step);
+        // Layout persisted for the append mode: the region of every partition over the routing columns
+        virtual std::vector<std::string> getRoutingColumns();
+        virtual std::map<std::string, double> getLayoutParameters();
+        void setNodeRegion(const std::filesystem::path &nodeFile, const structures::PartitionRegion &region);
+        std::optional<structures::PartitionRegion> getNodeRegion(const std::filesystem::path &nodeFile);
+        arrow::Status writeLayout(const std::vector<structures::PartitionRegion> &boundingRegions);
+        // Manifest of the partitions: rows, bytes and min/max of the partitioning columns of every file
+        arrow::Status writeManifestAndLayout();
+        arrow::Status orderPartitions();
+        // Bloom filters of the columns asked by the writer profile, next to every partition
+        arrow::Status writeBloomFilters();
+        // Write the manifest and the layout, then mark the run as finished
+        arrow::Status finishRun();
+        // In-memory fast path: load the dataset once, split a permutation of the row indexes, write partitions once
+        arrow::Status partitionInMemory();
+        virtual arrow::Status splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                            const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                            std::vector<std::pair<size_t, size_t>> &partitionRanges);
+        arrow::Result<std::vector<std::shared_ptr<std::vector<double>>>> getColumnsData(
+                const std::shared_ptr<arrow::Table> &table);
+        // Sample-then-scatter build: the scheme records its splits of the sample in the split tree, with leaves of
+        // the given capacity, then every row of the dataset is routed to a leaf of the tree
+        arrow::Status partitionSampled();
+        arrow::Status scatterToLeaves(const std::filesystem::path &scatterFolder);
+        virtual arrow::Status buildSplitTree(std::vector<uint64_t> &rowIndexes,
+                                             const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                             size_t leafCapacity,
+                                             structures::SplitTree &splitTree);
         std::shared_ptr<storage::DataReader> dataReader;
         std::shared_ptr<::arrow::RecordBatchReader> batchReader;
         std::vector<std::string> columns;
@@ -53,8 +113,34 @@ namespace partitioning {
         std::filesystem::path folder;
         uint32_t expectedNumBatches;
         bool addColumnPartitionId = true;
+        static inline const std::string rowIdColumn = "__row_id";
         std::string fileExtension = common::Settings::fileExtension;
         bool finished = false;
+        int64_t memoryBudget = common::Settings::memoryBudget;
+        std::shared_ptr<storage::ProgressJournal> journal;
+        bool resume = false;
+        std::string schemeName;
+        // Regions of the tree nodes known from the splits, keyed by the node file relative to the output folder
+        std::map<std::string, structures::PartitionRegion> nodeRegions;
+        std::mutex nodeRegionsMutex;
+        // Regions of the final partitions, by partition id, when known from the splits
+        std::vector<std::optional<structures::PartitionRegion>> partitionRegions;
+        IntraPartitionOrder intraPartitionOrder = SPLIT_ORDER;
+        TreeBuildMode buildMode = LEVEL_BY_LEVEL;
+        std::vector<std::string> intraPartitionColumns;
+        static inline const std::string narrowProjectionStep = "narrow_projection";
+        static inline const std::string splitStep = "split";
+        static inline const std::string intermediateFilesDeletedStep = "intermediate_files_deleted";
+        static inline const std::string treeFinalizedStep = "tree_finalized";
+        static inline const std::string narrowFilesMovedStep = "narrow_files_moved";
+        static inline const std::string materializedStep = "materialized";
+        static inline const std::string sortedRunStep = "sorted_run";
+        static inline const std::string mergedStep = "merged";
+        static inline const std::string orderedPartitionStep = "ordered_partition";
+        static inline const std::string scatteredStep = "scattered";
+        static inline const std::string scatterFolderName = "_scatter";
+        static inline const std::string narrowFolderName = "_narrow";
+        static inline const std::string completedPrefix = "completed";
         const uint32_t minNumberOfColumns = 2;
         const uint32_t minPartitionSize = 1;
     };
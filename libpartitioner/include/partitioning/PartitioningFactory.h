@@ -55,26 +55,37 @@ namespace partitioning{
                     const std::vector<std::string> &partitionColumns,
                     const size_t rowsPerPartition,
                     const std::filesystem::path &outputFolder) {
+                std::shared_ptr<MultiDimensionalPartitioning> partitioning;
                 switch (partitioningScheme) {
                     case NO_PARTITION:
-                        return std::make_shared<NoPartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        partitioning = std::make_shared<NoPartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        break;
                     case FIXED_GRID:
-                        return std::make_shared<FixedGridPartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        partitioning = std::make_shared<FixedGridPartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        break;
                     case GRID_FILE:
-                        return std::make_shared<GridFilePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        partitioning = std::make_shared<GridFilePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        break;
                     case KD_TREE:
-                        return std::make_shared<KDTreePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        partitioning = std::make_shared<KDTreePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        break;
                     case STR_TREE:
-                        return std::make_shared<STRTreePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        partitioning = std::make_shared<STRTreePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        break;
                     case QUAD_TREE:
-                        return std::make_shared<QuadTreePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        partitioning = std::make_shared<QuadTreePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        break;
                     case HILBERT_CURVE:
-                        return std::make_shared<HilbertCurvePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        partitioning = std::make_shared<HilbertCurvePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        break;
                     case Z_ORDER_CURVE:
-                        return std::make_shared<ZOrderCurvePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        partitioning = std::make_shared<ZOrderCurvePartitioning>(reader, partitionColumns, rowsPerPartition, outputFolder);
+                        break;
                     default:
                         return nullptr;
                 }
+                partitioning->setSchemeName(mapSchemeToName.at(partitioningScheme));
+                return partitioning;
             }
     };
 }
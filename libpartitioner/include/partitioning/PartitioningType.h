@@ -1,6 +1,9 @@
 #ifndef PARTITIONING_PARTITIONING_TYPE_H
 #define PARTITIONING_PARTITIONING_TYPE_H
 
+#include <map>
+#include <string>
+
 namespace partitioning {
 
     enum PartitioningType{
@@ -10,6 +13,47 @@ namespace partitioning {
         OTHER = 4
     };
 
+    // Order of the rows inside every partition. The splits leave the rows in an arbitrary order, sorting them by a
+    // secondary key gives each row group a narrow min/max, so queries touching part of a partition skip row groups
+    enum IntraPartitionOrder{
+        SPLIT_ORDER = 1,
+        Z_ORDER_KEY = 2,
+        HILBERT_KEY = 3,
+        COLUMNS_KEY = 4
+    };
+
+    const std::map<std::string, IntraPartitionOrder> mapNameToOrder = {
+            {"none", SPLIT_ORDER},
+            {"z-order", Z_ORDER_KEY},
+            {"hilbert", HILBERT_KEY},
+            {"columns", COLUMNS_KEY},
+    };
+
+    const std::map<IntraPartitionOrder, std::string> mapOrderToName = {
+            {SPLIT_ORDER, "none"},
+            {Z_ORDER_KEY, "z-order"},
+            {HILBERT_KEY, "hilbert"},
+            {COLUMNS_KEY, "columns"},
+    };
+
+    // How the tree schemes (kd-tree, quadtree, grid file) build their splits: level by level, reading every node of
+    // the tree from disk (or the dataset at once, when it fits the memory budget), or on a sample of the partitioning
+    // columns, then scattering the dataset to the leaves in a single pass
+    enum TreeBuildMode{
+        LEVEL_BY_LEVEL = 1,
+        SAMPLE_SCATTER = 2
+    };
+
+    const std::map<std::string, TreeBuildMode> mapNameToBuildMode = {
+            {"levels", LEVEL_BY_LEVEL},
+            {"sample-scatter", SAMPLE_SCATTER},
+    };
+
+    const std::map<TreeBuildMode, std::string> mapBuildModeToName = {
+            {LEVEL_BY_LEVEL, "levels"},
+            {SAMPLE_SCATTER, "sample-scatter"},
+    };
+
 }
 
 #endif //PARTITIONING_PARTITIONING_TYPE_H
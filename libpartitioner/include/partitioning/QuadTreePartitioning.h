@@ -17,6 +17,7 @@
 #include <arrow/table.h>
 
 #include "common/ColumnDataConverter.h"
+#include "common/TaskScheduler.h"
 #include "external/ExternalMerge.h"
 #include "partitioning/Partitioning.h"
 #include "partitioning/PartitioningType.h"
@@ -41,6 +42,24 @@ namespace partitioning {
                                          std::pair<double_t, double_t> columnStatsX,
                                          std::pair<double_t, double_t> columnStatsY,
                                          uint32_t depth);
+        arrow::Status splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                    const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                    std::vector<std::pair<size_t, size_t>> &partitionRanges) override;
+        arrow::Status buildSplitTree(std::vector<uint64_t> &rowIndexes,
+                                     const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                     size_t leafCapacity,
+                                     structures::SplitTree &splitTree) override;
+        void splitQuadrantInMemory(std::vector<uint64_t> &rowIndexes,
+                                   const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                   std::vector<std::pair<size_t, size_t>> &partitionRanges,
+                                   size_t begin,
+                                   size_t end,
+                                   std::pair<double_t, double_t> columnStatsX,
+                                   std::pair<double_t, double_t> columnStatsY,
+                                   uint32_t depth,
+                                   size_t leafCapacity,
+                                   structures::SplitTree *splitTree = nullptr,
+                                   uint32_t nodeId = 0);
         partitioning::PartitioningType type = TREE;
     };
 }
@@ -17,6 +17,7 @@
 
 #include "common/ColumnDataConverter.h"
 #include "common/Point.h"
+#include "common/TaskScheduler.h"
 #include "external/ExternalSort.h"
 #include "external/ExternalMerge.h"
 #include "partitioning/Partitioning.h"
@@ -48,6 +49,19 @@ namespace partitioning {
         arrow::Status slicePartition(std::filesystem::path &datasetFile,
                                      size_t sliceSize,
                                      uint32_t columnIndex);
+        arrow::Status setSliceRegions(const std::filesystem::path &datasetFile,
+                                      const std::filesystem::path &subFolder,
+                                      uint32_t columnIndex);
+        arrow::Status splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                    const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                    std::vector<std::pair<size_t, size_t>> &partitionRanges) override;
+        void sliceInMemory(std::vector<uint64_t> &rowIndexes,
+                           const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                           std::vector<std::pair<size_t, size_t>> &partitionRanges,
+                           size_t begin,
+                           size_t end,
+                           size_t sliceSize,
+                           uint32_t columnIndex);
         static bool isCompleted(const std::filesystem::path &partitionFile);
         PartitioningType type = TREE;
         size_t k;
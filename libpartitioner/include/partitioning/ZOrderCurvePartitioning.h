@@ -41,6 +41,12 @@ namespace partitioning {
         arrow::Status partitionBatch(const uint64_t &batchId,
                                      std::shared_ptr<arrow::RecordBatch> &recordBatch,
                                      std::shared_ptr<storage::DataReader> &dataReader);
+        static arrow::Result<std::shared_ptr<arrow::RecordBatch>> addCurveValues(
+                const std::shared_ptr<arrow::RecordBatch> &recordBatch,
+                const std::vector<std::string> &curveColumns);
+        static inline const std::string curveColumn = "z_order_curve";
+    protected:
+        std::vector<std::string> getRoutingColumns() override;
     private:
         partitioning::PartitioningType type = SPACE_FILLING_CURVE;
         std::unordered_map<uint8_t, uint64_t> columnToDomain;
@@ -0,0 +1,84 @@
+#ifndef QUERY_LAYOUT_COST_MODEL_H
+#define QUERY_LAYOUT_COST_MODEL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/result.h>
+#include <arrow/status.h>
+
+#include "common/PointSet.h"
+#include "common/Settings.h"
+#include "partitioning/PartitioningFactory.h"
+#include "query/PartitionPruner.h"
+#include "storage/DataReader.h"
+#include "structures/PartitionLayout.h"
+
+namespace query {
+
+    // Partitions of a scheme built on the sample: the bounding box of each one over the partitioning columns and
+    // the rows of the dataset it stands for
+    struct SampledLayout {
+        partitioning::PartitioningScheme scheme;
+        size_t partitionSize = 0;
+        std::vector<structures::PartitionRegion> regions;
+        std::vector<double> regionRows;
+    };
+
+    // Expected cost of a predicate on a layout, scaled to the whole dataset
+    struct LayoutEstimate {
+        size_t totalPartitions = 0;
+        // Partitions whose bounding box overlaps the predicate, with their rows and compressed bytes
+        double numPartitions = 0;
+        double numRows = 0;
+        double numBytes = 0;
+        // Rows satisfying the ranges on the partitioning columns
+        double matchingRows = 0;
+    };
+
+    // Cost model of the partitioning schemes: the splits of every scheme are replayed on a uniform sample of the
+    // partitioning columns (the in-memory kd-tree and quadtree, the curve and grid cell keys of the schemes), with a
+    // partition size scaled to the sample. The partitions and bytes read by a query are estimated from the bounding
+    // boxes, as the pruner would do on the manifest, in seconds instead of materializing the layout
+    class LayoutCostModel {
+    public:
+        LayoutCostModel(const std::shared_ptr<storage::DataReader> &reader,
+                        const std::vector<std::string> &partitionColumns,
+                        size_t maxSampleSize = common::Settings::costModelSampleSize);
+        // Draw the sample, a single pass over the partitioning columns of the dataset
+        arrow::Status load();
+        arrow::Result<SampledLayout> buildLayout(partitioning::PartitioningScheme scheme, size_t partitionSize);
+        LayoutEstimate estimate(const SampledLayout &layout, const RangePredicate &predicate) const;
+        size_t getSampleSize() const;
+    private:
+        // A group of sampled points, as row ids in the sample
+        using Points = common::PointSet::RowIds;
+        // Reservoir sampling (Algorithm L) of the row positions, sorted
+        std::vector<uint64_t> drawSamplePositions() const;
+        std::vector<Points> splitKDTree(size_t leafSize);
+        std::vector<Points> splitQuadTree(size_t leafSize);
+        std::vector<Points> splitSTRTree(size_t leafSize);
+        std::vector<Points> splitGridFile(size_t leafSize);
+        arrow::Result<std::vector<Points>> splitByKey(const std::shared_ptr<arrow::RecordBatch> &keyedBatch,
+                                                      size_t leafSize);
+        arrow::Result<std::shared_ptr<arrow::RecordBatch>> addFixedGridKeys();
+        void sliceSTR(Points &points, size_t begin, size_t end, size_t sliceSize, size_t leafSize, size_t numSlices,
+                      uint32_t columnIndex, std::vector<Points> &groups);
+        void halveGridCell(Points &points, size_t begin, size_t end, size_t leafSize, uint32_t depth,
+                           std::vector<std::pair<double, double>> dimensionRanges, std::vector<Points> &groups);
+        std::shared_ptr<storage::DataReader> dataReader;
+        std::vector<std::string> columns;
+        size_t sampleSize;
+        uint64_t numRows = 0;
+        uint64_t numSampledRows = 0;
+        double bytesPerRow = 0;
+        std::shared_ptr<arrow::RecordBatch> sampleBatch;
+        common::PointSet samplePoints;
+        // The grid file stops halving a cell after this depth, like the scheme
+        static inline const uint32_t maxGridFileDepth = 150;
+    };
+}
+
+#endif //QUERY_LAYOUT_COST_MODEL_H
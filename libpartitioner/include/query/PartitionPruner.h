@@ -0,0 +1,91 @@
+#ifndef QUERY_PARTITION_PRUNER_H
+#define QUERY_PARTITION_PRUNER_H
+
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/result.h>
+#include <arrow/status.h>
+
+#include "storage/BloomFilterIndex.h"
+#include "structures/PartitionManifest.h"
+
+namespace query {
+
+    // Range of values accepted by the predicate on one column. Values are compared as doubles, with the same
+    // conversion as the partitioning columns (e.g. dates as days, timestamps in their unit)
+    struct ColumnRange {
+        std::string column;
+        double lower = -std::numeric_limits<double>::infinity();
+        double upper = std::numeric_limits<double>::infinity();
+        bool lowerInclusive = true;
+        bool upperInclusive = true;
+        // Whether some value in [minValue, maxValue] satisfies the range
+        bool overlaps(double minValue, double maxValue) const;
+        bool isEquality() const;
+    };
+
+    // Conjunction of ranges, the shape of the benchmark queries (col > a AND col < b AND ...)
+    using RangePredicate = std::vector<ColumnRange>;
+
+    // Partition file to read for a predicate and, within it, the row groups to read
+    struct PartitionMatch {
+        uint32_t partitionId;
+        std::filesystem::path file;
+        std::vector<int> rowGroups;
+        // Rows and compressed bytes of the selected row groups
+        uint64_t numRows = 0;
+        uint64_t numBytes = 0;
+        // Pages of the predicate columns in the selected row groups, and those skipped by the page index
+        uint64_t numPages = 0;
+        uint64_t numSkippedPages = 0;
+    };
+
+    // Select the partitions and row groups of a partitioned folder that can hold rows matching a range predicate,
+    // without decoding any data. The partitions are pruned with the bounding boxes of the manifest, the row groups
+    // of the remaining partitions with the min/max statistics of their footers, which are read once and cached.
+    // Partitions written with the pruning profile are also pruned with their bloom filters on equalities, and their
+    // page index tells the pages of the selected row groups that a reader can skip
+    class PartitionPruner {
+    public:
+        explicit PartitionPruner(const std::filesystem::path &partitionedFolder);
+        arrow::Status load();
+        // Partitions whose bounding box overlaps the predicate, from the manifest only
+        std::vector<uint32_t> prunePartitions(const RangePredicate &predicate) const;
+        // Partitions and row groups to read, also pruned on the columns that are not partitioning columns
+        arrow::Result<std::vector<PartitionMatch>> prune(const RangePredicate &predicate);
+        size_t getNumPartitions() const;
+        // Parse a WHERE clause made of AND-ed comparisons between a column and a number (quotes allowed)
+        static arrow::Result<RangePredicate> parsePredicate(const std::string &whereClause);
+    private:
+        // Min/max of every numeric column, for each row group of a partition
+        struct FooterStats {
+            int numRowGroups = 0;
+            std::vector<uint64_t> rowGroupRows;
+            std::vector<uint64_t> rowGroupBytes;
+            std::unordered_map<std::string, std::vector<std::pair<double, double>>> columnBounds;
+            // Min/max of every page, for each row group, of the columns in the page index
+            std::unordered_map<std::string, std::vector<std::vector<std::pair<double, double>>>> pageBounds;
+            std::shared_ptr<storage::BloomFilterIndex> bloomFilters;
+        };
+        arrow::Result<std::shared_ptr<FooterStats>> getFooterStats(uint32_t partitionId);
+        static void countPages(const FooterStats &footerStats, const RangePredicate &predicate, int rowGroup,
+                               PartitionMatch &match);
+        static arrow::Result<std::shared_ptr<FooterStats>> readFooterStats(const std::filesystem::path &partitionFile);
+        std::filesystem::path folder;
+        structures::PartitionManifest manifest;
+        std::unordered_map<std::string, size_t> columnIndexes;
+        // Bounding boxes of all the partitions in one array: partition, then column, then min and max
+        std::vector<double> partitionBounds;
+        std::unordered_map<uint32_t, std::shared_ptr<FooterStats>> footerCache;
+        std::mutex footerCacheMutex;
+    };
+}
+
+#endif //QUERY_PARTITION_PRUNER_H
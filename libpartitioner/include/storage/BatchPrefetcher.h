@@ -0,0 +1,50 @@
+#ifndef STORAGE_BATCH_PREFETCHER_H
+#define STORAGE_BATCH_PREFETCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <arrow/api.h>
+
+#include "common/Settings.h"
+
+namespace storage {
+
+    // Record batch reader that decodes ahead on a background thread. Up to queueDepth batches are kept ready,
+    // so that reading (I/O + decompression + decoding) overlaps with the work done by the caller on the current batch
+    class BatchPrefetcher : public arrow::RecordBatchReader {
+    public:
+        explicit BatchPrefetcher(std::shared_ptr<arrow::RecordBatchReader> sourceReader,
+                                 size_t queueDepth = common::Settings::prefetchDepth);
+        ~BatchPrefetcher() override;
+        std::shared_ptr<arrow::Schema> schema() const override;
+        arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch> *batch) override;
+        arrow::Status Close() override;
+        // Time spent decoding in the background and time the caller spent waiting for a batch
+        double getDecodeSeconds();
+        double getWaitSeconds();
+        // Fraction of the decode time hidden behind the caller work: 1 when the caller never waited
+        double getOverlap();
+    private:
+        void prefetchLoop();
+        void stop();
+        std::shared_ptr<arrow::RecordBatchReader> source;
+        size_t maxQueuedBatches;
+        std::deque<std::shared_ptr<arrow::RecordBatch>> queue;
+        std::mutex queueMutex;
+        std::condition_variable queueNotEmpty;
+        std::condition_variable queueNotFull;
+        arrow::Status sourceStatus;
+        bool sourceFinished = false;
+        bool stopping = false;
+        std::chrono::nanoseconds decodeTime{0};
+        std::chrono::nanoseconds waitTime{0};
+        uint64_t numBatches = 0;
+        std::thread prefetchThread;
+    };
+} // storage
+
+#endif //STORAGE_BATCH_PREFETCHER_H
@@ -0,0 +1,42 @@
+#ifndef STORAGE_BLOOM_FILTER_INDEX_H
+#define STORAGE_BLOOM_FILTER_INDEX_H
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/result.h>
+#include <arrow/status.h>
+#include <parquet/bloom_filter.h>
+
+namespace storage {
+
+    // Bloom filters of some numeric columns of a partition, kept in a file next to it (<partition>.bloom): the
+    // Parquet writer of Arrow 15 cannot embed bloom filters in the file. Integer, date and timestamp values are
+    // hashed as int64, double values as double, the other types are not filtered
+    class BloomFilterIndex {
+    public:
+        static arrow::Status write(const std::filesystem::path &partitionFile,
+                                   const std::vector<std::string> &filterColumns,
+                                   double falsePositiveProbability);
+        static arrow::Result<std::shared_ptr<BloomFilterIndex>> load(const std::filesystem::path &partitionFile);
+        static bool exists(const std::filesystem::path &partitionFile);
+        static std::filesystem::path getPath(const std::filesystem::path &partitionFile);
+        std::vector<std::string> getColumns() const;
+        // False only when the value is surely not in the column. Columns without a filter may contain anything
+        bool mightContain(const std::string &column, double value) const;
+        static inline const std::string fileSuffix = ".bloom";
+    private:
+        struct ColumnFilter {
+            bool isInteger = true;
+            std::shared_ptr<parquet::BlockSplitBloomFilter> filter;
+        };
+        std::map<std::string, ColumnFilter> filters;
+        static inline const uint32_t magic = 0x4d4c4246;
+    };
+}
+
+#endif //STORAGE_BLOOM_FILTER_INDEX_H
@@ -0,0 +1,45 @@
+#ifndef STORAGE_COLUMN_STATISTICS_H
+#define STORAGE_COLUMN_STATISTICS_H
+
+#include <memory>
+#include <optional>
+#include <utility>
+
+#include <arrow/api.h>
+#include <arrow/result.h>
+#include <parquet/api/reader.h>
+
+namespace storage {
+
+    // Statistics of a column over all the row groups of a Parquet file. Values are doubles in the domain of
+    // common::ColumnDataConverter, so that they compare with the values seen by the splits: dates in days (date32) or
+    // milliseconds (date64), timestamps in the unit of their Arrow type. Decimals are scaled to their actual value
+    struct ColumnStatistics {
+        double min = 0;
+        double max = 0;
+        // False when a row group with values has no min/max in the footer
+        bool hasMinMax = false;
+        int64_t nullCount = 0;
+        // Sum of the distinct counts of the row groups (an upper bound), when all of them have one
+        std::optional<int64_t> distinctCount;
+        std::shared_ptr<arrow::DataType> type;
+
+        // Combine the statistics of the column chunks in the footer, without reading any page
+        static arrow::Result<ColumnStatistics> fromFooter(const parquet::FileMetaData &metadata,
+                                                          const std::shared_ptr<arrow::Field> &field);
+        // Min/max of the column in one row group, in the same domain. Empty when the footer cannot tell, inverted
+        // (min > max) when the row group only holds nulls
+        static arrow::Result<std::optional<std::pair<double, double>>> getRowGroupBounds(
+                const parquet::FileMetaData &metadata,
+                const std::shared_ptr<arrow::Field> &field,
+                int rowGroup);
+        // From a value as stored in the footer or the page index to the domain above
+        static double toArrowDomain(const parquet::ColumnDescriptor &descriptor, const arrow::DataType &type,
+                                    double value);
+        // Seconds since the epoch of a value of a date or timestamp column, the value itself for other types
+        static double toEpochSeconds(const arrow::DataType &type, double value);
+        static bool isTemporal(const arrow::DataType &type);
+    };
+} // storage
+
+#endif //STORAGE_COLUMN_STATISTICS_H
@@ -2,6 +2,9 @@
 #define STORAGE_DATA_READER_H
 
 #include <filesystem>
+#include <map>
+#include <mutex>
+#include <unordered_map>
 
 #include <arrow/api.h>
 #include <arrow/csv/api.h>
@@ -12,7 +15,12 @@
 #include <regex>
 
 #include "duckdb.hpp"
+#include "common/MemoryGovernor.h"
 #include "common/Settings.h"
+#include "storage/BatchPrefetcher.h"
+#include "storage/ColumnStatistics.h"
+#include "storage/ParallelBatchReader.h"
+#include "storage/ReadMode.h"
 
 namespace storage {
 
@@ -23,25 +31,63 @@ class DataReader {
         arrow::Status load(std::filesystem::path &filePath, bool useBatchRead = false);
         std::filesystem::path getReaderPath();
         arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> getBatchReader();
+        arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> getBatchReader(const std::vector<int> &columnIndexes);
+        arrow::Result<std::shared_ptr<BatchPrefetcher>> getPrefetchingBatchReader(size_t queueDepth = common::Settings::prefetchDepth);
+        // Batches in file order whatever the read mode, for the passes that number the rows by their position
+        arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> getOrderedBatchReader();
+        arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> getOrderedBatchReader(const std::vector<int> &columnIndexes);
         arrow::Result<std::vector<std::shared_ptr<arrow::ChunkedArray>>> getColumns(const std::vector<std::string> &columns);
         arrow::Result<std::shared_ptr<arrow::ChunkedArray>> getColumn(const std::string &columnName);
         void displayFileProperties();
         arrow::Result<std::pair<double_t, double_t>> getColumnStats(const std::string &columnName);
+        arrow::Result<ColumnStatistics> getColumnStatistics(const std::string &columnName);
+        // Sample of the given columns drawn batch by batch, in proportion to the rows of every batch
+        arrow::Result<std::shared_ptr<arrow::Table>> getStratifiedSample(const std::vector<std::string> &columns,
+                                                                         size_t sampleSize);
         int64_t getNumRows();
+        int64_t getRowWidth();
+        size_t getBatchSize();
         int64_t getExpectedNumBatches();
         static arrow::Result<std::shared_ptr<arrow::Table>> getTable(std::filesystem::path &inputFile);
         static std::filesystem::path getDatasetPath(const std::filesystem::path &folder, const std::string &datasetName,
                                                     const std::string &partitioningScheme);
         arrow::Result<int> getColumnIndex(const std::string &columnName);
+        // Approximate quantiles of a column (0 <= q <= 1) in a single pass over that column only, with one sketch per
+        // row group merged at the end. The rank of every answer is off by at most rankError of the rows
+        arrow::Result<std::vector<double>> getQuantiles(const std::string &columnName,
+                                                        const std::vector<double> &quantiles,
+                                                        double rankError = common::Settings::quantileRankError);
         arrow::Result<double_t> getMedian(const std::string &columnName);
+        // Copy to destinationFile the rows with a value in [lower, upper] on every column of the box, in the domain of
+        // common::ColumnDataConverter. Row groups outside the box by their footer statistics are not read
+        arrow::Status rangeFilter(const std::map<std::string, std::pair<double, double>> &box,
+                                  const std::filesystem::path &destinationFile);
         arrow::Status rangeFilter(const std::string &columnName, const std::filesystem::path &destinationFile,
                                   const std::pair<double, double> range);
+        // Read mode of the files loaded from now on, shared by all the readers of the process
+        static void setReadMode(const ReadMode &mode);
+        static ReadMode getReadMode();
     private:
+        static arrow::Result<std::unique_ptr<parquet::arrow::FileReader>> openFileReader(const std::filesystem::path &filePath,
+                                                                                         const ReadMode &mode,
+                                                                                         int64_t readerBatchSize);
+        arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> getParallelBatchReader(const std::vector<int> &columnIndexes,
+                                                                                          bool orderedBatches);
         std::filesystem::path path;
         bool batchRead = false;
         bool isFolder = false;
         std::unique_ptr<parquet::arrow::FileReader> reader;
         std::shared_ptr<parquet::FileMetaData> metadata;
+        size_t batchSize = common::Settings::batchSize;
+        // Memory of the batches of this reader, the prefetched ones and the one being processed
+        std::unique_ptr<common::MemoryReservation> batchReservation;
+        static inline const int64_t batchesInMemory = common::Settings::prefetchDepth + 1;
+        // Statistics of the columns of the loaded file, computed on first use
+        std::unordered_map<std::string, ColumnStatistics> columnStatistics;
+        std::mutex columnStatisticsMutex;
+        ReadMode readMode = ReadMode::getDefaultMode();
+        static inline ReadMode processReadMode = ReadMode::getDefaultMode();
+        static inline std::mutex readModeMutex;
 };
 } // storage
 
@@ -2,6 +2,7 @@
 #define STORAGE_DATA_WRITER_H
 
 #include <filesystem>
+#include <mutex>
 
 #include <arrow/api.h>
 #include <arrow/csv/api.h>
@@ -14,6 +15,8 @@
 
 #include "common/Settings.h"
 #include "partitioning/Partitioning.h"
+#include "storage/SpillFormat.h"
+#include "storage/WriterProfile.h"
 
 namespace storage {
 
@@ -22,13 +25,31 @@ class DataWriter {
         DataWriter() = default;
         virtual ~DataWriter() = default;
         static arrow::Status WriteTableToDisk(std::shared_ptr<arrow::Table>& table,
-                                              std::filesystem::path &outputPath);
-        static std::shared_ptr<parquet::WriterProperties> getWriterProperties();
+                                              std::filesystem::path &outputPath,
+                                              int64_t rowGroupSize = common::Settings::rowGroupSize);
+        static std::shared_ptr<parquet::WriterProperties> getWriterProperties(
+                int64_t rowGroupSize = common::Settings::rowGroupSize);
         static std::shared_ptr<parquet::ArrowWriterProperties> getArrowWriterProperties();
+        // Profile of the writer properties, shared by all the files written by the process
+        static void setWriterProfile(const WriterProfile &profile);
+        static WriterProfile getWriterProfile();
+        // Format of the intermediate files, shared by all the runs of the process
+        static void setSpillFormat(const SpillFormat &format);
+        static SpillFormat getSpillFormat();
         static arrow::Status mergeBatches(const std::filesystem::path &basePath, const std::set<uint32_t> &partitionIds);
         static arrow::Status mergeBatchesInFolder(const std::shared_ptr<arrow::fs::FileSystem> &filesystem,
-                                                  const std::string &base_dir);
+                                                  const std::string &base_dir,
+                                                  const SpillFormat &fragmentFormat = SpillFormat::getDefaultFormat());
         static void cleanUpFolder(const std::filesystem::path &folder);
+        // Memory reserved by one partition merge of mergeBatches
+        static inline const int64_t mergeReservationBytes = (int64_t) 256 << 20;
+    private:
+        static size_t getNumConcurrentMerges(size_t numPartitions);
+        static inline const int64_t megabyte = (int64_t) 1 << 20;
+        static inline WriterProfile writerProfile = WriterProfile::getDefaultProfile();
+        static inline std::mutex writerProfileMutex;
+        static inline SpillFormat spillFormat = SpillFormat::getDefaultFormat();
+        static inline std::mutex spillFormatMutex;
         };
 } // storage
 
@@ -0,0 +1,67 @@
+#ifndef STORAGE_PARALLEL_BATCH_READER_H
+#define STORAGE_PARALLEL_BATCH_READER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <arrow/api.h>
+#include <parquet/arrow/reader.h>
+
+#include "common/Settings.h"
+
+namespace storage {
+
+    // Opens a new reader of the file, every decoding thread has its own
+    using FileReaderFactory = std::function<arrow::Result<std::unique_ptr<parquet::arrow::FileReader>>()>;
+
+    // Record batch reader decoding the row groups of a file on several threads. Every thread claims the next row
+    // group not taken yet and decodes it batch by batch. Ordered, the batches come in file order: the threads ahead
+    // of the row group being delivered stop once maxQueuedBatches are waiting. Unordered, any decoded batch is
+    // delivered, so a slow row group does not hold back the others
+    class ParallelBatchReader : public arrow::RecordBatchReader {
+    public:
+        ParallelBatchReader(FileReaderFactory readerFactory,
+                            std::shared_ptr<arrow::Schema> schema,
+                            std::vector<int> rowGroups,
+                            std::vector<int> columnIndexes,
+                            bool orderedBatches,
+                            size_t numThreads = common::Settings::numWorkers,
+                            size_t maxQueuedBatches = common::Settings::numWorkers * common::Settings::prefetchDepth);
+        ~ParallelBatchReader() override;
+        std::shared_ptr<arrow::Schema> schema() const override;
+        arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch> *batch) override;
+        arrow::Status Close() override;
+    private:
+        struct RowGroupBatches {
+            std::deque<std::shared_ptr<arrow::RecordBatch>> batches;
+            bool finished = false;
+        };
+        void decodeLoop();
+        void stop();
+        FileReaderFactory factory;
+        std::shared_ptr<arrow::Schema> outputSchema;
+        std::vector<int> rowGroupIndexes;
+        std::vector<int> columns;
+        bool ordered;
+        size_t maxQueued;
+        // Decoded batches not delivered yet, by position of their row group in rowGroupIndexes
+        std::map<size_t, RowGroupBatches> pending;
+        size_t nextClaimed = 0;
+        size_t nextDelivered = 0;
+        size_t queuedBatches = 0;
+        uint64_t numBatches = 0;
+        arrow::Status decodeStatus;
+        bool stopping = false;
+        std::mutex mutex;
+        std::condition_variable batchReady;
+        std::condition_variable queueNotFull;
+        std::vector<std::thread> decoders;
+    };
+} // storage
+
+#endif //STORAGE_PARALLEL_BATCH_READER_H
@@ -0,0 +1,30 @@
+#ifndef STORAGE_PARQUET_CONCATENATOR_H
+#define STORAGE_PARQUET_CONCATENATOR_H
+
+#include <filesystem>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/result.h>
+#include <parquet/metadata.h>
+
+namespace storage {
+
+    // Concatenation of Parquet files with the same schema, without decoding them: the column chunks of every file are
+    // copied byte for byte one after the other, and a single footer lists all their row groups, with the offsets
+    // moved to the new positions. The row groups are the ones of the input files, not resized.
+    // Files with a page index, bloom filters, encryption or column chunks in other files have offsets outside the
+    // row groups, they are not concatenated
+    class ParquetConcatenator {
+    public:
+        // False, with nothing written, when the files cannot be concatenated and need to be re-encoded
+        static arrow::Result<bool> concatenate(const std::vector<std::filesystem::path> &inputPaths,
+                                               const std::filesystem::path &outputPath);
+        // Size of the copies from the input files to the output file
+        inline static const int64_t copyBufferSize = 8 * 1024 * 1024;
+    private:
+        static bool haveSameSchema(const std::vector<std::shared_ptr<parquet::FileMetaData>> &metadata);
+    };
+}
+
+#endif //STORAGE_PARQUET_CONCATENATOR_H
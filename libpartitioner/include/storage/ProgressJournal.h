@@ -0,0 +1,46 @@
+#ifndef STORAGE_PROGRESS_JOURNAL_H
+#define STORAGE_PROGRESS_JOURNAL_H
+
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <arrow/api.h>
+
+namespace storage {
+
+    // Append-only log of the steps completed by a partitioning run (split nodes, sorted runs, written partitions),
+    // kept in the output folder next to the files it describes. Every entry is synced to disk before the step is
+    // considered done, so after a crash the journal lists exactly the steps whose output is complete.
+    // The first line is the fingerprint of the run: a restarted run only reuses the entries of the same run
+    class ProgressJournal {
+    public:
+        explicit ProgressJournal(const std::filesystem::path &outputFolder);
+        ~ProgressJournal();
+        ProgressJournal(const ProgressJournal &) = delete;
+        ProgressJournal &operator=(const ProgressJournal &) = delete;
+        // Start a new journal, or continue the existing one when resuming a run with the same fingerprint
+        arrow::Status open(const std::string &runFingerprint, bool resume);
+        arrow::Status record(const std::string &step, const std::string &key = "");
+        bool contains(const std::string &step, const std::string &key = "");
+        bool isResumed();
+        // An interrupted run left a journal in the folder
+        static bool canResume(const std::filesystem::path &outputFolder);
+        static inline const std::string fileName = "_progress.journal";
+        static inline const std::string finishedStep = "finished";
+    private:
+        static std::vector<std::pair<std::string, std::string>> readEntries(const std::filesystem::path &path,
+                                                                            size_t &validLength);
+        std::filesystem::path journalPath;
+        std::set<std::pair<std::string, std::string>> entries;
+        std::mutex mutex;
+        int fileDescriptor = -1;
+        bool resumed = false;
+        static inline const std::string fingerprintStep = "fingerprint";
+    };
+} // storage
+
+#endif //STORAGE_PROGRESS_JOURNAL_H
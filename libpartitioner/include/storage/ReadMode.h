@@ -0,0 +1,42 @@
+#ifndef STORAGE_READ_MODE_H
+#define STORAGE_READ_MODE_H
+
+#include <string>
+#include <vector>
+
+#include <arrow/io/caching.h>
+#include <arrow/result.h>
+#include <parquet/properties.h>
+
+#include "common/Settings.h"
+
+namespace storage {
+
+    // How the readers of a run open and decode the Parquet files. The default mode is the historical one (buffered
+    // stream of 16 KiB, a single thread). The mmap mode maps the file instead of reading it, the prebuffer mode issues
+    // one coalesced read for the column chunks of a row group, and the parallel modes decode the row groups on several
+    // threads, delivering the batches in file order or as soon as they are ready
+    class ReadMode {
+    public:
+        static ReadMode getDefaultMode();
+        static arrow::Result<ReadMode> fromName(const std::string &modeName);
+        static std::vector<std::string> getNames();
+        parquet::ReaderProperties getReaderProperties() const;
+        parquet::ArrowReaderProperties getArrowReaderProperties(int64_t batchSize) const;
+        std::string name = defaultName;
+        bool memoryMap = false;
+        bool bufferedStream = true;
+        int64_t bufferSize = common::Settings::bufferSize;
+        bool preBuffer = false;
+        bool parallelRowGroups = false;
+        // Parallel modes only: batches in file order, otherwise in the order the row groups are decoded
+        bool orderedBatches = true;
+        static inline const std::string defaultName = "default";
+        static inline const std::string memoryMapName = "mmap";
+        static inline const std::string preBufferName = "prebuffer";
+        static inline const std::string parallelName = "parallel";
+        static inline const std::string parallelUnorderedName = "parallel-unordered";
+    };
+}
+
+#endif //STORAGE_READ_MODE_H
@@ -0,0 +1,50 @@
+#ifndef STORAGE_SPILL_FORMAT_H
+#define STORAGE_SPILL_FORMAT_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/dataset/api.h>
+#include <arrow/filesystem/api.h>
+#include <arrow/ipc/api.h>
+#include <arrow/result.h>
+#include <arrow/util/compression.h>
+
+namespace storage {
+
+    // Format of the intermediate files of a run (sorted runs, fragments of a node split), read back once and deleted.
+    // The default format is the historical one (Parquet with the writer profile). The IPC formats write the Arrow
+    // batches as they are, with no encoding to undo when reading them back: uncompressed, compressed with LZ4 frames,
+    // or uncompressed and memory mapped on read, so the columns are served from the page cache without a copy.
+    // The partitions themselves are always written as Parquet
+    class SpillFormat {
+    public:
+        static SpillFormat getDefaultFormat();
+        static arrow::Result<SpillFormat> fromName(const std::string &formatName);
+        static std::vector<std::string> getNames();
+        bool isParquet() const;
+        std::string getExtension() const;
+        arrow::Status writeTable(const std::shared_ptr<arrow::Table> &table, const std::filesystem::path &outputPath) const;
+        arrow::Status writeBatch(const std::shared_ptr<arrow::RecordBatch> &recordBatch,
+                                 const std::filesystem::path &outputPath) const;
+        // Reader of the batches of a spilled file, the Parquet ones in batches of batchSize rows
+        arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> openReader(const std::filesystem::path &inputPath,
+                                                                           int64_t batchSize) const;
+        // Dataset format and file system to scan a folder of spilled files
+        std::shared_ptr<arrow::dataset::FileFormat> getFileFormat() const;
+        std::shared_ptr<arrow::fs::FileSystem> getFileSystem(const std::shared_ptr<arrow::fs::FileSystem> &filesystem) const;
+        std::string name = parquetName;
+        bool ipc = false;
+        arrow::Compression::type compression = arrow::Compression::UNCOMPRESSED;
+        bool memoryMap = false;
+        static inline const std::string parquetName = "parquet";
+        static inline const std::string ipcName = "ipc";
+        static inline const std::string ipcLz4Name = "ipc-lz4";
+        static inline const std::string ipcMemoryMapName = "ipc-mmap";
+        static inline const std::string ipcExtension = ".arrow";
+    };
+}
+
+#endif //STORAGE_SPILL_FORMAT_H
@@ -0,0 +1,73 @@
+#ifndef STORAGE_WRITER_POOL_H
+#define STORAGE_WRITER_POOL_H
+
+#include <filesystem>
+#include <list>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/io/api.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/arrow/writer.h>
+
+#include "common/MemoryGovernor.h"
+#include "common/Settings.h"
+
+namespace storage {
+
+    // State of a single output partition inside the pool
+    struct PartitionSink {
+        // Rows received but not yet written, flushed as one row group once the threshold is reached
+        std::vector<std::shared_ptr<arrow::Table>> bufferedTables;
+        int64_t bufferedRows = 0;
+        int64_t bufferedBytes = 0;
+        // Open Parquet writer, if any, and its position in the LRU list
+        std::shared_ptr<arrow::io::FileOutputStream> outFile;
+        std::unique_ptr<parquet::arrow::FileWriter> writer;
+        std::list<uint32_t>::iterator lruPosition;
+        // Number of part files already sealed (closed writers)
+        uint32_t numParts = 0;
+        int64_t totalRows = 0;
+    };
+
+    class WriterPool {
+    public:
+        explicit WriterPool(const std::filesystem::path &outputFolder,
+                            size_t maxOpenWriters = common::Settings::maxOpenWriters,
+                            int64_t maxBufferedBytes = common::Settings::writerPoolBufferBytes,
+                            std::shared_ptr<parquet::WriterProperties> writerProperties = nullptr);
+        virtual ~WriterPool();
+        arrow::Status append(uint32_t partitionId, const std::shared_ptr<arrow::Table> &rows);
+        arrow::Status append(uint32_t partitionId, const std::shared_ptr<arrow::RecordBatch> &rows);
+        arrow::Status finish();
+        void abort();
+        std::map<uint32_t, int64_t> getPartitionsNumRows();
+        std::filesystem::path getPartitionPath(uint32_t partitionId);
+    private:
+        arrow::Status flush(uint32_t partitionId);
+        arrow::Status flushLargestBuffers();
+        arrow::Status openWriter(uint32_t partitionId, const std::shared_ptr<arrow::Schema> &schema);
+        arrow::Status closeWriter(uint32_t partitionId);
+        arrow::Status mergeParts(uint32_t partitionId);
+        std::filesystem::path getPartPath(uint32_t partitionId, uint32_t partIndex);
+        // Memory for the buffered rows, taken from the process-wide budget
+        common::MemoryReservation bufferReservation;
+        std::filesystem::path folder;
+        std::filesystem::path partsFolder;
+        size_t maxWriters;
+        int64_t maxBytes;
+        int64_t rowGroupSize;
+        int64_t totalBufferedBytes = 0;
+        std::shared_ptr<parquet::WriterProperties> properties;
+        std::shared_ptr<parquet::ArrowWriterProperties> arrowProperties;
+        std::unordered_map<uint32_t, PartitionSink> sinks;
+        // Most recently used writers at the front, eviction candidates at the back
+        std::list<uint32_t> openWriters;
+        bool finished = false;
+        bool aborted = false;
+    };
+} // storage
+
+#endif //STORAGE_WRITER_POOL_H
@@ -0,0 +1,50 @@
+#ifndef STORAGE_WRITER_PROFILE_H
+#define STORAGE_WRITER_PROFILE_H
+
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <arrow/api.h>
+#include <arrow/result.h>
+#include <parquet/properties.h>
+
+#include "common/Settings.h"
+
+namespace storage {
+
+    // Writer options of a single column, the unset ones follow the profile
+    struct ColumnWriterOptions {
+        std::optional<bool> dictionary;
+        std::optional<bool> pageIndex;
+        bool bloomFilter = false;
+    };
+
+    // Parquet writer options shared by all the files of a run. The default profile is the historical one (row group
+    // length, version, Snappy). The pruning profile writes the page index (column and offset index) with smaller
+    // pages, so readers can skip pages inside a row group, lowers the dictionary threshold and adds bloom filters on
+    // the partitioning columns for the equality predicates
+    class WriterProfile {
+    public:
+        static WriterProfile getDefaultProfile();
+        static WriterProfile getPruningProfile(const std::vector<std::string> &partitioningColumns);
+        static arrow::Result<WriterProfile> fromName(const std::string &profileName,
+                                                     const std::vector<std::string> &partitioningColumns);
+        std::shared_ptr<parquet::WriterProperties> getWriterProperties(int64_t rowGroupSize = common::Settings::rowGroupSize) const;
+        std::vector<std::string> getBloomFilterColumns() const;
+        std::string name = defaultName;
+        bool pageIndex = false;
+        int64_t dataPageSize = parquet::kDefaultDataPageSize;
+        int64_t dictionaryPageSizeLimit = parquet::DEFAULT_DICTIONARY_PAGE_SIZE_LIMIT;
+        double bloomFilterFpp = 0.01;
+        std::map<std::string, ColumnWriterOptions> columnOptions;
+        static inline const std::string defaultName = "default";
+        static inline const std::string pruningName = "pruning";
+        // Pruning profile: pages of 64 KiB, dictionaries given up after 256 KiB
+        static inline const int64_t pruningDataPageSize = 64 * 1024;
+        static inline const int64_t pruningDictionaryPageSizeLimit = 256 * 1024;
+    };
+}
+
+#endif //STORAGE_WRITER_PROFILE_H
@@ -16,27 +16,29 @@
 #include "arrow/status.h"
 #include "arrow/table.h"
 
-#include "common/Point.h"
+#include "common/PointSet.h"
 
 namespace structures {
 
     struct KDNode {
         double splitValue;
-        std::vector<std::shared_ptr<common::Point>> data;
+        // Row ids of the points of a leaf, in the point set of the tree
+        common::PointSet::RowIds data;
         std::shared_ptr<KDNode> left;
         std::shared_ptr<KDNode> right;
 
         // Leaf node constructor, has associated points
-        KDNode(std::vector<std::shared_ptr<common::Point>> values) : left(nullptr), right(nullptr), splitValue(0), data(std::move(values)) {};
+        KDNode(common::PointSet::RowIds values) : left(nullptr), right(nullptr), splitValue(0), data(std::move(values)) {};
         // Empty node constructor, only define a split value
         KDNode(double &splitNum) : left(nullptr), right(nullptr), splitValue(splitNum), data({}) {};
     };
 
     class KDTree {
     public:
-        KDTree(std::vector<std::shared_ptr<common::Point>> &rows, size_t partitionSize);
-        std::shared_ptr<KDNode> buildTree(std::vector<std::shared_ptr<common::Point>>::iterator start,
-                                          std::vector<std::shared_ptr<common::Point>>::iterator end,
+        // The points are not copied, they must outlive the tree
+        KDTree(const common::PointSet &rows, size_t partitionSize);
+        std::shared_ptr<KDNode> buildTree(common::PointSet::RowIds::iterator start,
+                                          common::PointSet::RowIds::iterator end,
                                           uint32_t depth);
         virtual ~KDTree() = default;
         std::shared_ptr<KDNode> getRoot();
@@ -46,7 +48,8 @@ namespace structures {
         uint32_t pointDimensions;
         std::shared_ptr<KDNode> root;
         std::vector<std::shared_ptr<KDNode>> leaves;
-        std::vector<std::shared_ptr<common::Point>> points;
+        const common::PointSet &points;
+        common::PointSet::RowIds rowIds;
     };
 
 }
@@ -0,0 +1,58 @@
+#ifndef STRUCTURES_PARTITION_LAYOUT_H
+#define STRUCTURES_PARTITION_LAYOUT_H
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arrow/api.h"
+#include "arrow/result.h"
+#include "arrow/status.h"
+
+namespace structures {
+
+    // Part of the space owned by a partition: a box over the routing columns (the partitioning columns, or the
+    // curve value / cell index for the curve and fixed grid schemes). Bounds are inclusive, unbounded sides are
+    // -inf / +inf. For the tree schemes the boxes come from the split boundaries and cover the whole space
+    struct PartitionRegion {
+        std::vector<double> lower;
+        std::vector<double> upper;
+
+        static PartitionRegion unbounded(size_t numDimensions);
+        bool contains(const std::vector<double> &point) const;
+        // L1 distance from the point to the box, 0 when the point is inside
+        double distance(const std::vector<double> &point) const;
+        void extend(const std::vector<double> &point);
+        PartitionRegion withLower(size_t dimension, double value) const;
+        PartitionRegion withUpper(size_t dimension, double value) const;
+    };
+
+    // Description of a partitioned folder persisted next to the partitions: what the append mode needs to route
+    // new rows into the existing partitions without repartitioning the dataset
+    class PartitionLayout {
+    public:
+        arrow::Status save(const std::filesystem::path &folder) const;
+        static arrow::Result<PartitionLayout> load(const std::filesystem::path &folder);
+        static bool exists(const std::filesystem::path &folder);
+        // Values of the routing columns of a table, one vector per column, converted to double
+        static arrow::Result<std::vector<std::shared_ptr<std::vector<double>>>> getRoutingValues(
+                const std::shared_ptr<arrow::Table> &table, const std::vector<std::string> &routingColumns);
+        // Smallest region containing all the rows of a table
+        static arrow::Result<PartitionRegion> getBoundingRegion(const std::shared_ptr<arrow::Table> &table,
+                                                                const std::vector<std::string> &routingColumns);
+        // Partition owning the point: the first region containing it, otherwise the closest one
+        uint32_t route(const std::vector<double> &point) const;
+        std::string scheme;
+        std::vector<std::string> columns;
+        std::vector<std::string> routingColumns;
+        size_t partitionSize = 0;
+        // Scheme specific values needed to recompute the routing columns (e.g. the fixed grid cell width)
+        std::map<std::string, double> parameters;
+        std::vector<PartitionRegion> regions;
+        static inline const std::string fileName = "_layout.txt";
+    };
+}
+
+#endif //STRUCTURES_PARTITION_LAYOUT_H
@@ -0,0 +1,54 @@
+#ifndef STRUCTURES_PARTITION_MANIFEST_H
+#define STRUCTURES_PARTITION_MANIFEST_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "arrow/api.h"
+#include "arrow/result.h"
+#include "arrow/status.h"
+
+namespace structures {
+
+    // What a partition file contains: size and the min/max of every partitioning column (its MBR)
+    struct PartitionSummary {
+        std::string fileName;
+        uint64_t numRows = 0;
+        uint64_t numBytes = 0;
+        std::vector<double> min;
+        std::vector<double> max;
+    };
+
+    // Summaries of all the partitions of a folder, written once at the end of the partitioning run so that the
+    // readers (pruning, benchmarks) do not need to open every file. Saved twice: a compact binary file, loaded by
+    // the library, and the same content as JSON for the scripts
+    class PartitionManifest {
+    public:
+        arrow::Status save(const std::filesystem::path &folder) const;
+        static arrow::Result<PartitionManifest> load(const std::filesystem::path &folder);
+        static bool exists(const std::filesystem::path &folder);
+        // Read the row count from the footer and the min/max of the given columns from the file
+        static arrow::Result<PartitionSummary> summarize(std::filesystem::path &partitionFile,
+                                                         const std::vector<std::string> &summaryColumns);
+        std::string scheme;
+        std::vector<std::string> columns;
+        uint64_t partitionSize = 0;
+        // Secondary order of the rows inside the partitions ("none" when they keep the order of the split)
+        std::string order = "none";
+        std::vector<std::string> orderColumns;
+        // Writer profile of the partitions (page index, bloom filters), see storage::WriterProfile
+        std::string writerProfile = "default";
+        std::vector<PartitionSummary> partitions;
+        static inline const std::string binaryFileName = "_manifest.bin";
+        static inline const std::string jsonFileName = "_manifest.json";
+    private:
+        arrow::Status saveBinary(const std::filesystem::path &path) const;
+        arrow::Status saveJson(const std::filesystem::path &path) const;
+        static inline const uint32_t magic = 0x4d4c504f;
+        static inline const uint32_t version = 3;
+    };
+}
+
+#endif //STRUCTURES_PARTITION_MANIFEST_H
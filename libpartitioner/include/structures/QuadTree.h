@@ -16,20 +16,21 @@
 #include "arrow/result.h"
 #include "arrow/status.h"
 #include "arrow/table.h"
-#include "common/Point.h"
+#include "common/PointSet.h"
 
 namespace structures {
 
     struct QuadNode {
         std::pair<double, double> splitValues;
-        std::vector<std::shared_ptr<common::Point>> data;
+        // Row ids of the points of a leaf, in the point set of the tree
+        common::PointSet::RowIds data;
         std::shared_ptr<QuadNode> northWest;
         std::shared_ptr<QuadNode> northEast;
         std::shared_ptr<QuadNode> southWest;
         std::shared_ptr<QuadNode> southEast;
 
         // Leaf node constructor, has associated points
-        QuadNode(std::vector<std::shared_ptr<common::Point>> &values) : northWest(nullptr), northEast(nullptr), southWest(nullptr),
+        QuadNode(common::PointSet::RowIds &values) : northWest(nullptr), northEast(nullptr), southWest(nullptr),
         southEast(nullptr), splitValues(0, 0), data(values) {};
         // Empty node constructor, only define a split value
         QuadNode(std::pair<double, double> &splitNums) : northWest(nullptr), northEast(nullptr), southWest(nullptr),
@@ -38,8 +39,9 @@ namespace structures {
 
     class QuadTree {
     public:
-        QuadTree(std::vector<std::shared_ptr<common::Point>> &rows, size_t partitionSize, size_t numColumns);
-        std::shared_ptr<QuadNode> buildTree(std::vector<std::shared_ptr<common::Point>> &points, uint32_t depth);
+        // The points are not copied, they must outlive the tree
+        QuadTree(const common::PointSet &rows, size_t partitionSize, size_t numColumns);
+        std::shared_ptr<QuadNode> buildTree(common::PointSet::RowIds &rowIds, uint32_t depth);
         virtual ~QuadTree() = default;
         std::shared_ptr<QuadNode> getRoot();
         std::vector<std::shared_ptr<QuadNode>> getLeaves();
@@ -47,7 +49,7 @@ namespace structures {
         std::shared_ptr<QuadNode> root;
         std::vector<std::shared_ptr<QuadNode>> leaves;
         uint32_t leafSize;
-        std::vector<std::shared_ptr<common::Point>> points;
+        const common::PointSet &points;
         size_t numDims;
     };
 
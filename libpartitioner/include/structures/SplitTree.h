@@ -0,0 +1,64 @@
+#ifndef STRUCTURES_SPLIT_TREE_H
+#define STRUCTURES_SPLIT_TREE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "structures/PartitionLayout.h"
+
+namespace structures {
+
+    // How an inner node sends the rows to its children, the same rules as the splits of the schemes
+    enum SplitKind {
+        // kd-tree: values greater or equal than the split value go to child 0, the others to child 1
+        GREATER_EQUAL_FIRST = 1,
+        // Grid file: values up to the split value go to child 0, the others to child 1
+        LESS_EQUAL_FIRST = 2,
+        // Quadtree: child (x >= split x ? 1 : 0) + (y < split y ? 2 : 0)
+        QUADRANTS = 3
+    };
+
+    struct SplitNode {
+        SplitKind kind = GREATER_EQUAL_FIRST;
+        uint32_t columnX = 0;
+        uint32_t columnY = 0;
+        double valueX = 0;
+        double valueY = 0;
+        // Child nodes, none for a leaf
+        std::vector<uint32_t> children;
+        // Position of the leaf, from left to right, assigned by finalize
+        int32_t leafId = -1;
+        PartitionRegion region;
+    };
+
+    // Splits of a tree scheme kept in memory instead of materialized as files: built on a sample of the partitioning
+    // columns, then used to route every row of the dataset to its leaf in a single pass
+    class SplitTree {
+    public:
+        explicit SplitTree(size_t numDimensions);
+        static uint32_t getRoot();
+        // Turn a leaf into an inner node and return its children, with the regions derived from the split
+        std::vector<uint32_t> split(uint32_t nodeId, SplitKind kind, uint32_t columnX, double valueX,
+                                    uint32_t columnY = 0, double valueY = 0);
+        // Number the leaves from left to right, in the same order the schemes number their partitions
+        void finalize();
+        size_t getNumLeaves() const;
+        const PartitionRegion &getLeafRegion(uint32_t leafId) const;
+        // Leaf of a row, given the partitioning columns converted to double
+        uint32_t route(const std::vector<std::shared_ptr<std::vector<double>>> &columnsData, size_t rowIndex) const;
+        // Group the leaves bottom-up: the children of a node are merged when one of them holds less than minRows
+        // and all together hold at most maxRows. Every group is a list of leaf ids, from left to right
+        std::vector<std::vector<uint32_t>> mergeLeaves(const std::vector<int64_t> &leafRows,
+                                                       int64_t minRows,
+                                                       int64_t maxRows) const;
+    private:
+        void numberLeaves(uint32_t nodeId);
+        std::vector<std::vector<uint32_t>> mergeNode(uint32_t nodeId, const std::vector<int64_t> &leafRows,
+                                                     int64_t minRows, int64_t maxRows) const;
+        std::vector<SplitNode> nodes;
+        std::vector<uint32_t> leaves;
+    };
+}
+
+#endif //STRUCTURES_SPLIT_TREE_H
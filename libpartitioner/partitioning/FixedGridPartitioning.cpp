@@ -33,18 +33,30 @@ namespace partitioning {
         cellWidth = maxColumnDomain / 10;
         std::cout << "[FixedGridPartitioning] Computed cell width is: " << cellWidth << std::endl;
 
-        // Read the table in batches
+        // Record the progress, to resume from the last checkpoint if the run gets interrupted
+        ARROW_RETURN_NOT_OK(openJournal());
+
+        // The sorted runs are intermediate files, written in the spill format
+        auto spillFormat = storage::DataWriter::getSpillFormat();
+
+        // Read the table in batches, decoding the next ones while the current one is processed
+        ARROW_ASSIGN_OR_RAISE(auto prefetchingReader, dataReader->getPrefetchingBatchReader());
         uint32_t batchId = 0;
         uint32_t totalNumRows = 0;
         while (true) {
             // Try to load a new batch, when possible
             std::shared_ptr<arrow::RecordBatch> record_batch;
-            ARROW_RETURN_NOT_OK(batchReader->ReadNext(&record_batch));
+            ARROW_RETURN_NOT_OK(prefetchingReader->ReadNext(&record_batch));
             if (record_batch == nullptr) {
                 break;
             }
             totalNumRows += record_batch->num_rows();
-            ARROW_RETURN_NOT_OK(partitionBatch(batchId, record_batch, dataReader));
+            // A resumed run skips the sorted runs already written
+            auto sortedRunPath = folder / ("s" + std::to_string(batchId) + spillFormat.getExtension());
+            if (!isCheckpointed(sortedRunStep, sortedRunPath)) {
+                ARROW_RETURN_NOT_OK(partitionBatch(batchId, record_batch, dataReader));
+                ARROW_RETURN_NOT_OK(checkpoint(sortedRunStep, sortedRunPath));
+            }
             std::cout << "[FixedGridPartitioning] Batch " << batchId << " out of " << expectedNumBatches << " completed" << std::endl;
             std::cout << "[FixedGridPartitioning] Imported " << totalNumRows << " out of " << numRows << " rows" << std::endl;
             batchId += 1;
@@ -53,66 +65,100 @@ namespace partitioning {
         assert(totalNumRows == numRows);
 
         // Merge the files to create globally sorted partitions
-        ARROW_RETURN_NOT_OK(external::ExternalMerge::mergeFilesFromSortedBatches(folder, "cell_idx", partitionSize));
+        // Files without a checkpoint are leftovers of an interrupted batch or merge, the merge starts over without them
+        if (!isCheckpointed(mergedStep)) {
+            discardUncheckpointedFiles(sortedRunStep);
+            ARROW_RETURN_NOT_OK(external::ExternalMerge::mergeFilesFromSortedBatches(folder, cellColumn, partitionSize,
+                                                                                     spillFormat));
+            ARROW_RETURN_NOT_OK(checkpoint(mergedStep));
+        }
         std::cout << "[FixedGridPartitioning] Partitioning of " << batchId << " batches completed" << std::endl;
 
         deleteSubfolders();
 
-        return arrow::Status::OK();
+        return finishRun();
     }
 
     arrow::Status FixedGridPartitioning::partitionBatch(const uint32_t &batchId,
                                                         std::shared_ptr<arrow::RecordBatch> &recordBatch,
                                                         std::shared_ptr<storage::DataReader> &dataReader) {
-        auto converter = common::ColumnDataConverter();
         partitionIds = {};
+        std::vector<double_t> columnDomains;
+        for (size_t j = 0; j < numColumns; j++){
+            columnDomains.emplace_back(columnToDomain[j]);
+        }
+
+        // Add to the record batch the new column with the cell index values
+        ARROW_ASSIGN_OR_RAISE(auto updatedRecordBatch, addCellIndexes(recordBatch, columns, cellWidth, columnDomains));
+        std::cout << "[FixedGridPartitioning] Added column with cell index values " << std::endl;
+
+        // Write out a sorted batch
+        auto spillFormat = storage::DataWriter::getSpillFormat();
+        std::filesystem::path sortedBatchPath = folder / ("s" + std::to_string(batchId) + spillFormat.getExtension());
+        ARROW_RETURN_NOT_OK(external::ExternalSort::writeSortedBatch(updatedRecordBatch, cellColumn, sortedBatchPath,
+                                                                     spillFormat));
+        return arrow::Status::OK();
+    }
+
+    // Compute the index of the grid cell of every row, added as the first column of the batch.
+    // Shared with the append mode, which routes new rows with the cell width and domains of the partitioning run
+    arrow::Result<std::shared_ptr<arrow::RecordBatch>> FixedGridPartitioning::addCellIndexes(
+            const std::shared_ptr<arrow::RecordBatch> &recordBatch,
+            const std::vector<std::string> &gridColumns,
+            double_t gridCellWidth,
+            const std::vector<double_t> &columnDomains) {
+        if (columnDomains.size() < gridColumns.size()) {
+            return arrow::Status::Invalid("No domain for some of the ", gridColumns.size(), " grid columns");
+        }
         std::vector<std::shared_ptr<arrow::Array>> batchColumns;
-        batchColumns.reserve(columns.size());
-        for (const auto &columnName: columns){
-            batchColumns.emplace_back(recordBatch->column(dataReader->getColumnIndex(columnName).ValueOrDie()));
+        batchColumns.reserve(gridColumns.size());
+        for (const auto &columnName: gridColumns){
+            auto batchColumn = recordBatch->GetColumnByName(columnName);
+            if (batchColumn == nullptr) {
+                return arrow::Status::Invalid("Column <", columnName, "> not found in batch");
+            }
+            batchColumns.emplace_back(batchColumn);
         }
-        auto columnData = converter.toDouble(batchColumns).ValueOrDie();
-        size_t batchNumRows = columnData[0]->size();
-        size_t batchNumCols = columnData.size();
-        batchColumns.clear();
-
-        std::vector<uint64_t> cellIndexes = {};
-        for (size_t i = 0; i < batchNumRows; i++){
-            uint64_t cellIndex = 0;
-            uint64_t multiplier = 1;
-            for (size_t j = 0; j < batchNumCols; j++){
-                try{
-                    auto dimensionDomain = columnToDomain[j];
-                    auto dimensionNumCells = (uint64_t) std::ceil(dimensionDomain / cellWidth);
-                    auto column = columnData[j];
-                    double_t columnValue = column->at(i);
-                    auto cellDimensionIndex = (uint64_t) std::floor(columnValue / cellWidth);
-                    // assert(cellDimensionIndex < columnToDomain[j]);
-                    cellIndex += cellDimensionIndex * multiplier;
-                    multiplier *= dimensionNumCells;
+
+        // The cell index is accumulated column by column, on the keys of the batch read in place. A null key has no
+        // cell, the batch is Invalid
+        std::vector<uint64_t> cellIndexes(recordBatch->num_rows(), 0);
+        uint64_t multiplier = 1;
+        for (size_t j = 0; j < batchColumns.size(); j++){
+            auto dimensionNumCells = (uint64_t) std::ceil(columnDomains[j] / gridCellWidth);
+            auto columnName = gridColumns[j];
+            ARROW_RETURN_NOT_OK(common::visitKeys(*batchColumns[j], [&cellIndexes, gridCellWidth, multiplier, &columnName](const auto &keys) {
+                if (keys.nullCount() > 0) {
+                    return arrow::Status::Invalid("Column <", columnName, "> has ", keys.nullCount(), " null keys");
                 }
-                catch (std::exception& e) {
-                    std::cout << "Could not compute cell index " << e.what() << std::endl;
-                    cellIndexes.emplace_back(0);
-                    continue;
+                for (int64_t i = 0; i < keys.size(); i++){
+                    auto columnValue = static_cast<double_t>(keys[i]);
+                    auto cellDimensionIndex = (uint64_t) std::floor(columnValue / gridCellWidth);
+                    cellIndexes[i] += cellDimensionIndex * multiplier;
                 }
-            }
-            cellIndexes.emplace_back(cellIndex);
+                return arrow::Status::OK();
+            }));
+            multiplier *= dimensionNumCells;
         }
 
-        // Add to the record batch the new column with the cell index values
         arrow::UInt64Builder uint64Builder;
         ARROW_RETURN_NOT_OK(uint64Builder.AppendValues(cellIndexes));
         std::shared_ptr<arrow::Array> cellIndexValuesArrow;
         ARROW_ASSIGN_OR_RAISE(cellIndexValuesArrow, uint64Builder.Finish());
-        std::shared_ptr<arrow::RecordBatch> updatedRecordBatch;
-        ARROW_ASSIGN_OR_RAISE(updatedRecordBatch, recordBatch->AddColumn(0, "cell_idx", cellIndexValuesArrow));
-        std::cout << "[FixedGridPartitioning] Added column with cell index values " << std::endl;
+        return recordBatch->AddColumn(0, cellColumn, cellIndexValuesArrow);
+    }
 
-        // Write out a sorted batch
-        std::filesystem::path sortedBatchPath = folder / ("s" + std::to_string(batchId) + fileExtension);
-        ARROW_RETURN_NOT_OK(external::ExternalSort::writeSortedBatch(updatedRecordBatch, "cell_idx", sortedBatchPath));
-        return arrow::Status::OK();
+    std::vector<std::string> FixedGridPartitioning::getRoutingColumns() {
+        return {cellColumn};
+    }
+
+    // The cell width and the domains fix the cell of every value, new rows need the same ones
+    std::map<std::string, double> FixedGridPartitioning::getLayoutParameters() {
+        std::map<std::string, double> parameters = {{cellWidthParameter, cellWidth}};
+        for (size_t j = 0; j < numColumns; j++){
+            parameters[domainParameter + std::to_string(j)] = columnToDomain[j];
+        }
+        return parameters;
     }
 
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <limits>
 
 #include "partitioning/GridFilePartitioning.h"
 
@@ -28,64 +31,86 @@ namespace partitioning {
          *  6. Merge the batches into partition files
         */
 
-        // Copy original files to destination and work there
+        // Record the progress, to resume from the last checkpoint if the run gets interrupted
+        ARROW_RETURN_NOT_OK(openJournal());
+
+        // Fast path: the whole dataset fits the memory budget, split the row indexes instead of the files
+        if (fitsInMemory()) {
+            auto inMemoryStatus = partitionInMemory();
+            if (inMemoryStatus.ok()) {
+                return finishRun();
+            }
+            std::cout << "[GridFilePartitioning] Falling back to disk, " << inMemoryStatus.ToString() << std::endl;
+        }
+
+        // Two passes: build the splits on a sample of the partitioning columns, then scatter the rows to the leaves
+        if (buildMode == SAMPLE_SCATTER) {
+            auto sampledStatus = partitionSampled();
+            if (sampledStatus.ok()) {
+                return finishRun();
+            }
+            std::cout << "[GridFilePartitioning] Falling back to the level by level build, " << sampledStatus.ToString()
+                      << std::endl;
+        }
+
+        // Work on a narrow copy (partitioning columns + row id) of the original file in the destination folder
         // This way all the batch readers will point to the right folder from the start
-        ARROW_RETURN_NOT_OK(copyOriginalToDestination());
+        auto sourceFile = dataReader->getReaderPath();
+        ARROW_RETURN_NOT_OK(writeNarrowProjection());
 
-        // Initialize the reader, slice size and column index
+        // Compute linear scales, a resumed run skips the cells already split (all of them, when the whole dataset
+        // was a single completed cell)
         auto datasetFile = folder / ("0" + fileExtension);
-        std::ignore = dataReader->load(datasetFile);
+        if (!isCheckpointed(intermediateFilesDeletedStep) && std::filesystem::exists(datasetFile)) {
+            // Initialize the reader, slice size and column index
+            setNodeRegion(datasetFile, structures::PartitionRegion::unbounded(numColumns));
+            auto narrowReader = std::make_shared<storage::DataReader>();
+            ARROW_RETURN_NOT_OK(narrowReader->load(datasetFile));
 
-        // Retrieve domain values
-        std::vector<std::pair<double, double>> dimensionRanges;
-        for (const auto &column: columns){
-            auto minMaxColumn = dataReader->getColumnStats(column);
-            dimensionRanges.emplace_back(minMaxColumn->first, minMaxColumn->second);
-        }
+            // Retrieve domain values
+            std::vector<std::pair<double, double>> dimensionRanges;
+            columnTypes.clear();
+            for (const auto &column: columns){
+                ARROW_ASSIGN_OR_RAISE(auto columnStatistics, narrowReader->getColumnStatistics(column));
+                if (!columnStatistics.hasMinMax) {
+                    return arrow::Status::Invalid("No min/max for column <", column, ">");
+                }
+                dimensionRanges.emplace_back(columnStatistics.min, columnStatistics.max);
+                columnTypes.emplace_back(columnStatistics.type);
+            }
 
-        // Compute linear scales
-        auto datasetPath = dataReader->getReaderPath();
-        computeLinearScales(datasetPath, 0, dimensionRanges);
+            auto datasetPath = narrowReader->getReaderPath();
+            ARROW_RETURN_NOT_OK(computeLinearScales(datasetPath, 0, dimensionRanges));
+        }
 
         // Finalize the files
-        deleteIntermediateFiles();
-        moveCompletedFiles();
-        deleteSubfolders();
+        ARROW_RETURN_NOT_OK(finalizeCompletedFiles());
 
-        return arrow::Status::OK();
+        // Write the full rows once, following the row ids of the narrow partitions
+        ARROW_RETURN_NOT_OK(materializePartitions(sourceFile));
+
+        return finishRun();
     }
 
-    void GridFilePartitioning::computeLinearScales(std::filesystem::path &partitionFile,
-                                                   const uint32_t depth,
-                                                   const std::vector<std::pair<double, double>> &dimensionRanges) {
+    arrow::Status GridFilePartitioning::computeLinearScales(std::filesystem::path &partitionFile,
+                                                            const uint32_t depth,
+                                                            const std::vector<std::pair<double, double>> &dimensionRanges) {
 
         // Base case: reached partition size
         std::cout << "Computing linear scales, depth " << depth << std::endl;
-        std::ignore = dataReader->load(partitionFile);
-        auto currentNumRows = dataReader->getNumRows();
+        // Cells are split as concurrent tasks: use a reader local to this cell
+        auto cellReader = std::make_shared<storage::DataReader>();
+        ARROW_RETURN_NOT_OK(cellReader->load(partitionFile));
+        auto currentNumRows = cellReader->getNumRows();
         if (currentNumRows == 0){
-            return;
-        }
-        if (depth > 150){
-            std::cout << "[GridFilePartitioning] Have to stop, we reached excessive depth" << std::endl;
-            while(!std::filesystem::exists(partitionFile)){
-                if (partitionFile.parent_path() == "/"){
-                    return;
-                }
-                partitionFile = partitionFile.parent_path().parent_path() / partitionFile.filename().string();
-            }
-            // Rename the processed slice file
-            auto basePath = partitionFile.parent_path();
-            auto renamedDatasetFile = basePath / ("completed" + partitionFile.filename().string());
-            std::filesystem::rename(partitionFile, renamedDatasetFile);
-            return;
+            return arrow::Status::OK();
         }
-        if (currentNumRows <= cellCapacity){
+        if (currentNumRows <= cellCapacity || depth > 150){
             // Rename the processed slice file
             auto basePath = partitionFile.parent_path();
             auto renamedDatasetFile = basePath / ("completed" + partitionFile.filename().string());
             std::filesystem::rename(partitionFile, renamedDatasetFile);
-            return;
+            return arrow::Status::OK();
         }
 
         // Extract partition id from the file name
@@ -96,6 +121,12 @@ namespace partitioning {
         // Generate new sub folder (with this partition id) for this processing iteration
         auto baseFolder = partitionFile.parent_path();
         auto subFolder = baseFolder / partitionId;
+        // A cell split before an interruption only needs its halves to be processed
+        bool isAlreadySplit = isCheckpointed(splitStep, partitionFile);
+        if (!isAlreadySplit && std::filesystem::exists(subFolder)) {
+            // Partial output of an interrupted split
+            std::filesystem::remove_all(subFolder);
+        }
         if (!std::filesystem::exists(subFolder)) {
             std::filesystem::create_directory(subFolder);
         }
@@ -112,86 +143,197 @@ namespace partitioning {
         minValue = dimensionRanges.at(columnIndex).first;
         maxValue = dimensionRanges.at(columnIndex).second;
         midValue = (maxValue + minValue) / 2;
+        dimensionRanges1.at(columnIndex).first = minValue;
+        dimensionRanges1.at(columnIndex).second = midValue;
+        dimensionRanges2.at(columnIndex).first = midValue;
+        dimensionRanges2.at(columnIndex).second = maxValue;
         std::cout << "[GridFilePartitioning] Splitting left branch on mid value " << midValue << std::endl;
 
         // Split and recurse
-        // Setup DuckDB
-        duckdb::DBConfig config;
-        config.SetOption("memory_limit", memoryLimit);
-        config.SetOption("temp_directory", tempDirectory);
-        duckdb::DuckDB db(":memory:", &config);
-        config.options.preserve_insertion_order = false;
-        duckdb::Connection con(db);
-
-        // Load parquet file into memory
-        std::string loadQuery = "CREATE TABLE tbl AS "
-                                "SELECT * FROM read_parquet('" + partitionFile.string() + "')";
-        auto loadQueryResult = con.Query(loadQuery);
-
-        // Apply filter
-        std::string whereClause;
         auto destinationFile1 = subFolder / ("0" + fileExtension);
-        minValue = dimensionRanges.at(columnIndex).first;
-        maxValue = dimensionRanges.at(columnIndex).second;
-        midValue = (maxValue + minValue) / 2;
-        dimensionRanges1.at(columnIndex).first = minValue;
-        dimensionRanges1.at(columnIndex).second = midValue;
-        // TODO: replace with inferring types from schema. Timestamps and datetimes shall be detected
-        //  This is a temporary patch
-        std::set<std::string> timeColumns = {"tpep_pickup_datetime", "tpep_dropoff_datetime",
-                                             "created_at",
-                                             "o_orderdate", "l_shipdate"};
-        if (timeColumns.find(columnName) != timeColumns.end()){
-
-            std::string minValueTS = getTimestamp(minValue);
-            std::string midValueTS = getTimestamp(midValue);
-
-            whereClause = "      WHERE " + columnName + " >= '" + minValueTS + "' AND "
-                                         + columnName + " <= '" + midValueTS + "') ";
-        }
-        else{
-            whereClause = "      WHERE " + columnName + " >= " + std::to_string(minValue) + " AND "
-                                         + columnName + " <= " + std::to_string(midValue) + ") ";
-        }
-        std::string filterQuery1 = "COPY (SELECT * "
-                                   "      FROM tbl " + whereClause +
-                                   "TO '" + destinationFile1.string() + "' "
-                                   "(FORMAT PARQUET, COMPRESSION SNAPPY, "
-                                   " ROW_GROUP_SIZE " + std::to_string(common::Settings::rowGroupSize) + ")";
-        auto filterQueryResult1 = con.Query(filterQuery1);
-
         auto destinationFile2 = subFolder / ("1" + fileExtension);
-        minValue = dimensionRanges.at(columnIndex).first;
-        maxValue = dimensionRanges.at(columnIndex).second;
-        midValue = (maxValue + minValue) / 2;
+        if (!isAlreadySplit) {
+            // Setup DuckDB, released before recursing so that the children do not hold the parent table in memory
+            // Cells are split concurrently, each of them gets its share of the memory budget
+            auto splitReservation = common::MemoryGovernor::getInstance().reserveShare(
+                    "DuckDB grid file split", 1.0 / (double) common::TaskScheduler::getInstance().getNumWorkers());
+            duckdb::DBConfig config;
+            config.SetOption("memory_limit", common::MemoryGovernor::toDuckDBMemoryLimit(splitReservation));
+            config.SetOption("temp_directory", tempDirectory);
+            duckdb::DuckDB db(":memory:", &config);
+            config.options.preserve_insertion_order = false;
+            duckdb::Connection con(db);
+
+            // Load parquet file into memory
+            std::string loadQuery = "CREATE TABLE tbl AS "
+                                    "SELECT * FROM read_parquet('" + partitionFile.string() + "')";
+            auto loadQueryResult = con.Query(loadQuery);
+            if (loadQueryResult->HasError()) {
+                return arrow::Status::IOError("Loading cell ", partitionFile.string(), " failed: ",
+                                              loadQueryResult->GetError());
+            }
+
+            // Apply filter
+            std::string whereClause;
+            minValue = dimensionRanges.at(columnIndex).first;
+            maxValue = dimensionRanges.at(columnIndex).second;
+            midValue = (maxValue + minValue) / 2;
+            whereClause = "      WHERE " + columnName + " >= " + getLiteral(columnIndex, minValue) + " AND "
+                                         + columnName + " <= " + getLiteral(columnIndex, midValue) + ") ";
+            std::string filterQuery1 = "COPY (SELECT * "
+                                       "      FROM tbl " + whereClause +
+                                       "TO '" + destinationFile1.string() + "' "
+                                       "(FORMAT PARQUET, COMPRESSION SNAPPY, "
+                                       " ROW_GROUP_SIZE " + std::to_string(common::Settings::rowGroupSize) + ")";
+            auto filterQueryResult1 = con.Query(filterQuery1);
+            if (filterQueryResult1->HasError()) {
+                return arrow::Status::IOError("Writing half ", destinationFile1.string(), " failed: ",
+                                              filterQueryResult1->GetError());
+            }
+
+            minValue = dimensionRanges.at(columnIndex).first;
+            maxValue = dimensionRanges.at(columnIndex).second;
+            midValue = (maxValue + minValue) / 2;
+            whereClause = "      WHERE " + columnName + " > " + getLiteral(columnIndex, midValue) + " AND "
+                                         + columnName + " <= " + getLiteral(columnIndex, maxValue) + ") ";
+            std::string filterQuery2 = "COPY (SELECT * "
+                                       "      FROM tbl " + whereClause +
+                                       "TO '" + destinationFile2.string() + "' "
+                                       "(FORMAT PARQUET, COMPRESSION SNAPPY, "
+                                       " ROW_GROUP_SIZE " + std::to_string(common::Settings::rowGroupSize) + ")";
+            auto filterQueryResult2 = con.Query(filterQuery2);
+            if (filterQueryResult2->HasError()) {
+                return arrow::Status::IOError("Writing half ", destinationFile2.string(), " failed: ",
+                                              filterQueryResult2->GetError());
+            }
+            ARROW_RETURN_NOT_OK(checkpoint(splitStep, partitionFile));
+            // The left half keeps the mid value, the right half starts right after it
+            auto cellRegion = getNodeRegion(partitionFile);
+            if (cellRegion.has_value()) {
+                auto aboveMidValue = std::nextafter(midValue, std::numeric_limits<double>::infinity());
+                setNodeRegion(destinationFile1, cellRegion->withUpper(columnIndex, midValue));
+                setNodeRegion(destinationFile2, cellRegion->withLower(columnIndex, aboveMidValue));
+            }
+        }
+
+        // Determine the halves to process next from the sub folder: a resumed run skips the completed ones
+        // Both halves are independent, split them as concurrent tasks
+        common::TaskGroup halves;
+        for (auto &file : std::filesystem::directory_iterator(subFolder)) {
+            auto halfPath = file.path();
+            if (halfPath.extension() != fileExtension || isFileCompleted(halfPath)) {
+                continue;
+            }
+            auto halfRanges = halfPath.filename() == destinationFile1.filename() ? dimensionRanges1 : dimensionRanges2;
+            halves.run([this, halfPath, depth, halfRanges]() {
+                std::filesystem::path halfFile = halfPath;
+                return computeLinearScales(halfFile, depth + 1, halfRanges);
+            });
+        }
+        return halves.wait();
+    }
+
+    arrow::Status GridFilePartitioning::splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                                      const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                      std::vector<std::pair<size_t, size_t>> &partitionRanges) {
+        std::vector<std::pair<double, double>> dimensionRanges;
+        for (const auto &columnData: columnsData) {
+            auto [minValue, maxValue] = std::minmax_element(columnData->begin(), columnData->end());
+            dimensionRanges.emplace_back(*minValue, *maxValue);
+        }
+        splitCellInMemory(rowIndexes, columnsData, partitionRanges, 0, rowIndexes.size(), 0, dimensionRanges,
+                          cellCapacity);
+        return arrow::Status::OK();
+    }
+
+    arrow::Status GridFilePartitioning::buildSplitTree(std::vector<uint64_t> &rowIndexes,
+                                                       const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                       size_t leafCapacity,
+                                                       structures::SplitTree &splitTree) {
+        if (rowIndexes.empty()) {
+            return arrow::Status::OK();
+        }
+        std::vector<std::pair<double, double>> dimensionRanges;
+        for (const auto &columnData: columnsData) {
+            auto [minValue, maxValue] = std::minmax_element(columnData->begin(), columnData->end());
+            dimensionRanges.emplace_back(*minValue, *maxValue);
+        }
+        std::vector<std::pair<size_t, size_t>> leafRanges;
+        splitCellInMemory(rowIndexes, columnsData, leafRanges, 0, rowIndexes.size(), 0, dimensionRanges, leafCapacity,
+                          &splitTree, structures::SplitTree::getRoot());
+        return arrow::Status::OK();
+    }
+
+    // Same split as computeLinearScales, on the range [begin, end) of the row indexes: halve the range of the
+    // current column, rows up to the mid value go first. The partitioning is stable, so the rows of a cell keep
+    // their original order. The splits are also recorded in the split tree, if any
+    void GridFilePartitioning::splitCellInMemory(std::vector<uint64_t> &rowIndexes,
+                                                 const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                 std::vector<std::pair<size_t, size_t>> &partitionRanges,
+                                                 size_t begin,
+                                                 size_t end,
+                                                 uint32_t depth,
+                                                 const std::vector<std::pair<double, double>> &dimensionRanges,
+                                                 size_t leafCapacity,
+                                                 structures::SplitTree *splitTree,
+                                                 uint32_t nodeId) {
+        if (begin == end) {
+            return;
+        }
+        if (end - begin <= leafCapacity || depth > 150) {
+            partitionRanges.emplace_back(begin, end);
+            return;
+        }
+
+        // Find mid-point
+        uint32_t columnIndex = depth % numColumns;
+        const auto &values = *columnsData.at(columnIndex);
+        double midValue = (dimensionRanges.at(columnIndex).first + dimensionRanges.at(columnIndex).second) / 2;
+        auto dimensionRanges1 = dimensionRanges;
+        auto dimensionRanges2 = dimensionRanges;
+        dimensionRanges1.at(columnIndex).second = midValue;
         dimensionRanges2.at(columnIndex).first = midValue;
-        dimensionRanges2.at(columnIndex).second = maxValue;
-        if (timeColumns.find(columnName) != timeColumns.end()){
-            std::string midValueTS = getTimestamp(midValue);
-            std::string maxValueTS = getTimestamp(maxValue);
-            whereClause = "      WHERE " + columnName + " > '" + midValueTS + "' AND "
-                                         + columnName + " <= '" + maxValueTS + "') ";
-        }
-        else{
-            whereClause = "      WHERE " + columnName + " > " + std::to_string(midValue) + " AND "
-                                         + columnName + " <= " + std::to_string(maxValue) + ") ";
-        }
-        std::string filterQuery2 = "COPY (SELECT * "
-                                   "      FROM tbl " + whereClause +
-                                   "TO '" + destinationFile2.string() + "' "
-                                   "(FORMAT PARQUET, COMPRESSION SNAPPY, "
-                                   " ROW_GROUP_SIZE " + std::to_string(common::Settings::rowGroupSize) + ")";
-        auto filterQueryResult2 = con.Query(filterQuery2);
-
-        computeLinearScales(destinationFile1, depth + 1, dimensionRanges1);
-        computeLinearScales(destinationFile2, depth + 1, dimensionRanges2);
+
+        // Split and recurse
+        auto splitPosition = std::stable_partition(rowIndexes.begin() + begin, rowIndexes.begin() + end,
+                                                   [&values, midValue](uint64_t rowIndex) {
+                                                       return values[rowIndex] <= midValue;
+                                                   });
+        size_t split = splitPosition - rowIndexes.begin();
+        std::vector<uint32_t> children = {0, 0};
+        if (splitTree != nullptr) {
+            children = splitTree->split(nodeId, structures::LESS_EQUAL_FIRST, columnIndex, midValue);
+        }
+        splitCellInMemory(rowIndexes, columnsData, partitionRanges, begin, split, depth + 1, dimensionRanges1,
+                          leafCapacity, splitTree, children[0]);
+        splitCellInMemory(rowIndexes, columnsData, partitionRanges, split, end, depth + 1, dimensionRanges2,
+                          leafCapacity, splitTree, children[1]);
+    }
+
+    // SQL literal of a split value. Dates and timestamps are written as timestamps, with the microseconds, so that
+    // the halves do not lose the rows within the last second of the cell
+    std::string GridFilePartitioning::getLiteral(uint32_t columnIndex, double value) {
+        if (columnIndex >= columnTypes.size() || !storage::ColumnStatistics::isTemporal(*columnTypes.at(columnIndex))) {
+            return std::to_string(value);
+        }
+        double seconds = storage::ColumnStatistics::toEpochSeconds(*columnTypes.at(columnIndex), value);
+        double wholeSeconds = std::floor(seconds);
+        auto microseconds = (int64_t) std::llround((seconds - wholeSeconds) * 1e6);
+        if (microseconds == 1000000) {
+            wholeSeconds += 1;
+            microseconds = 0;
+        }
+        char fraction[8];
+        snprintf(fraction, sizeof(fraction), ".%06lld", (long long) microseconds);
+        return "'" + getTimestamp(wholeSeconds) + fraction + "'";
     }
 
     // Trick from https://stackoverflow.com/questions/31000677/convert-double-to-struct-tm
     std::string GridFilePartitioning::getTimestamp(double value) {
         time_t timeValue = std::chrono::system_clock::to_time_t(std::chrono::system_clock::time_point(
                     std::chrono::duration_cast<std::chrono::seconds>(std::chrono::duration<double>(value))));
-        struct tm tmValue = *gmtime(&timeValue);
+        struct tm tmValue{};
+        gmtime_r(&timeValue, &tmValue);
         char buffer[20];
         strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &tmValue);
         std::string valueTimestamp1(buffer);
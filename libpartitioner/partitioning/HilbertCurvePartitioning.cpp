@@ -9,7 +9,11 @@ namespace partitioning {
          * 3. Sort-merge the sorted batches
          */
 
-        // Read the table in batches
+        // Record the progress, to resume from the last checkpoint if the run gets interrupted
+        ARROW_RETURN_NOT_OK(openJournal());
+
+        // Read the table in batches, decoding the next ones while the current one is processed
+        ARROW_ASSIGN_OR_RAISE(auto prefetchingReader, dataReader->getPrefetchingBatchReader());
         uint32_t batchId = 0;
         uint32_t totalNumRows = 0;
 
@@ -17,7 +21,7 @@ namespace partitioning {
 
             // Try to load a new batch, when possible
             std::shared_ptr<arrow::RecordBatch> record_batch;
-            ARROW_RETURN_NOT_OK(batchReader->ReadNext(&record_batch));
+            ARROW_RETURN_NOT_OK(prefetchingReader->ReadNext(&record_batch));
             if (record_batch == nullptr) {
                 break;
             }
@@ -25,75 +29,81 @@ namespace partitioning {
             totalNumRows += record_batch->num_rows();
 
             // Work on current batch
-            ARROW_RETURN_NOT_OK(partitionBatch(batchId, record_batch, dataReader));
+            // A resumed run skips the sorted runs already written
+            auto sortedRunPath = folder / ("s" + std::to_string(batchId) + fileExtension);
+            if (!isCheckpointed(sortedRunStep, sortedRunPath)) {
+                ARROW_RETURN_NOT_OK(partitionBatch(batchId, record_batch, dataReader));
+                ARROW_RETURN_NOT_OK(checkpoint(sortedRunStep, sortedRunPath));
+            }
             std::cout << "[HilbertCurvePartitioning] Batch " << batchId << " completed" << std::endl;
             std::cout << "[HilbertCurvePartitioning] Imported " << totalNumRows << " out of " << numRows << " rows" << std::endl;
             batchId += 1;
         }
         assert(totalNumRows == numRows);
         // Merge the files to create globally sorted partitions
-        ARROW_RETURN_NOT_OK(external::ExternalMerge::sortMergeFiles(folder, "hilbert_curve", partitionSize));
+        // Files without a checkpoint are leftovers of an interrupted batch or merge, the merge starts over without them
+        if (!isCheckpointed(mergedStep)) {
+            discardUncheckpointedFiles(sortedRunStep);
+            ARROW_RETURN_NOT_OK(external::ExternalMerge::sortMergeFiles(folder, curveColumn, partitionSize));
+            ARROW_RETURN_NOT_OK(checkpoint(mergedStep));
+        }
         std::cout << "[HilbertCurvePartitioning] Partitioning of " << batchId << " batches completed" << std::endl;
-        return arrow::Status::OK();
+        return finishRun();
     }
 
     arrow::Status HilbertCurvePartitioning::partitionBatch(const uint64_t &batchId,
                                                            std::shared_ptr<arrow::RecordBatch> &recordBatch,
                                                            std::shared_ptr<storage::DataReader> &dataReader) {
+        // Add to the record batch the new column with the Hilbert values
+        ARROW_ASSIGN_OR_RAISE(auto updatedRecordBatch, addCurveValues(recordBatch, columns));
+        std::cout << "[HilbertCurvePartitioning] Added column with hilbert curve values " << std::endl;
+
+        // Write out a sorted batch
+        std::filesystem::path sortedBatchPath = folder / ("s" + std::to_string(batchId) + fileExtension);
+        ARROW_RETURN_NOT_OK(
+                external::ExternalSort::writeSortedBatch(updatedRecordBatch, curveColumn, sortedBatchPath));
+        return arrow::Status::OK();
+    }
+
+    // Compute the Hilbert value of every row on the given columns, added as the first column of the batch.
+    // Shared with the append mode, which routes new rows by the same values
+    arrow::Result<std::shared_ptr<arrow::RecordBatch>> HilbertCurvePartitioning::addCurveValues(
+            const std::shared_ptr<arrow::RecordBatch> &recordBatch,
+            const std::vector<std::string> &curveColumns) {
         std::vector<std::shared_ptr<arrow::Array>> batchColumns;
-        batchColumns.reserve(columns.size());
-        for (const auto &columnName: columns){
-            batchColumns.emplace_back(recordBatch->column(dataReader->getColumnIndex(columnName).ValueOrDie()));
+        batchColumns.reserve(curveColumns.size());
+        for (const auto &columnName: curveColumns){
+            auto batchColumn = recordBatch->GetColumnByName(columnName);
+            if (batchColumn == nullptr) {
+                return arrow::Status::Invalid("Column <", columnName, "> not found in batch");
+            }
+            batchColumns.emplace_back(batchColumn);
         }
-        auto converter = common::ColumnDataConverter();
-        auto columnData = converter.toInt64(batchColumns).ValueOrDie();
-        std::shared_ptr<arrow::Array> partitionIdsArrow;
         auto hilbertCurve = structures::HilbertCurve();
         int numBits = 8;
-        auto batchNumRows = recordBatch->num_rows();
-        assert(columnData.size() == numColumns);
-        assert(batchNumRows == columnData[0]->size());
-        std::map<IntRow, int64_t> rowToHilbertValue;
-        std::vector<IntRow> rows;
+        auto numCurveColumns = (int) curveColumns.size();
         std::vector<uint64_t> hilbertValues = {};
+        hilbertValues.reserve(recordBatch->num_rows());
 
         // Convert columnar format to rows and compute Hilbert value for each for them
-        // Append Hilbert values to one vector
-        for (size_t i = 0; i < columnData[0]->size(); i++) {
-            IntRow rowVector;
-            for (const auto& column : columnData) {
-                try{
-                    auto value = column->at(i);
-                    rowVector.emplace_back(value);
-                }
-                catch (std::exception& e) {
-                    std::cout << "Could not perform row conversion " << e.what() << std::endl;
-                    hilbertValues.emplace_back(0);
-                    continue;
-                }
-            }
-            rows.emplace_back(rowVector);
-            auto coordinatesVector = IntRow(rowVector);
-            int64_t* coordinates = coordinatesVector.data();
-            hilbertCurve.axesToTranspose(coordinates, numBits, (int) numColumns);
-            unsigned int hilbertValue = hilbertCurve.interleaveBits(coordinates, numBits, (int) numColumns);
+        // The coordinates are transposed in place, the rows are a scratch copy of the columns
+        ARROW_ASSIGN_OR_RAISE(auto rows, common::ColumnDataConverter::toRows<int64_t>(batchColumns, common::ROW_MAJOR));
+        for (size_t i = 0; i < rows.size(); i++) {
+            int64_t* coordinates = rows.rowData(i);
+            hilbertCurve.axesToTranspose(coordinates, numBits, numCurveColumns);
+            unsigned int hilbertValue = hilbertCurve.interleaveBits(coordinates, numBits, numCurveColumns);
             hilbertValues.emplace_back(hilbertValue);
         }
 
-        // Add to the record batch the new column with the Hilbert values
         arrow::UInt64Builder uint64Builder;
         ARROW_RETURN_NOT_OK(uint64Builder.AppendValues(hilbertValues));
         std::shared_ptr<arrow::Array> hilbertValuesArrow;
         ARROW_ASSIGN_OR_RAISE(hilbertValuesArrow, uint64Builder.Finish());
-        std::shared_ptr<arrow::RecordBatch> updatedRecordBatch;
-        ARROW_ASSIGN_OR_RAISE(updatedRecordBatch, recordBatch->AddColumn(0, "hilbert_curve", hilbertValuesArrow));
-        std::cout << "[HilbertCurvePartitioning] Added column with hilbert curve values " << std::endl;
+        return recordBatch->AddColumn(0, curveColumn, hilbertValuesArrow);
+    }
 
-        // Write out a sorted batch
-        std::filesystem::path sortedBatchPath = folder / ("s" + std::to_string(batchId) + fileExtension);
-        ARROW_RETURN_NOT_OK(
-                external::ExternalSort::writeSortedBatch(updatedRecordBatch, "hilbert_curve", sortedBatchPath));
-        return arrow::Status::OK();
+    std::vector<std::string> HilbertCurvePartitioning::getRoutingColumns() {
+        return {curveColumn};
     }
 
 }
\ No newline at end of file
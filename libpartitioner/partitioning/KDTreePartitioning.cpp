@@ -1,3 +1,6 @@
+#include <cmath>
+#include <limits>
+
 #include "partitioning/KDTreePartitioning.h"
 
 namespace partitioning {
@@ -5,38 +8,70 @@ namespace partitioning {
     arrow::Status KDTreePartitioning::partition(){
         /* Idea:
          * 1. (First pass) Read in batches
-         * 2. Find the median from the batches
+         * 2. Find the median with a quantile sketch of the split column
          * 3. (Second pass) Assign left or right of median for each batch
          * 4. Write to disk left and right
          * 5. Repeat for both left and right on the new dimension
          */
 
-        // Copy original files to destination and work there
+        // Record the progress, to resume from the last checkpoint if the run gets interrupted
+        ARROW_RETURN_NOT_OK(openJournal());
+
+        // Fast path: the whole dataset fits the memory budget, split the row indexes instead of the files
+        if (fitsInMemory()) {
+            auto inMemoryStatus = partitionInMemory();
+            if (inMemoryStatus.ok()) {
+                std::cout << "[KDTreePartitioning] Completed" << std::endl;
+                return finishRun();
+            }
+            std::cout << "[KDTreePartitioning] Falling back to disk, " << inMemoryStatus.ToString() << std::endl;
+        }
+
+        // Two passes: build the splits on a sample of the partitioning columns, then scatter the rows to the leaves
+        if (buildMode == SAMPLE_SCATTER) {
+            auto sampledStatus = partitionSampled();
+            if (sampledStatus.ok()) {
+                std::cout << "[KDTreePartitioning] Completed" << std::endl;
+                return finishRun();
+            }
+            std::cout << "[KDTreePartitioning] Falling back to the level by level build, " << sampledStatus.ToString()
+                      << std::endl;
+        }
+
+        // Work on a narrow copy (partitioning columns + row id) of the original file in the destination folder
         // This way all the batch readers will point to the right folder from the start
-        ARROW_RETURN_NOT_OK(copyOriginalToDestination());
+        auto sourceFile = dataReader->getReaderPath();
+        ARROW_RETURN_NOT_OK(writeNarrowProjection());
 
         // Initialize the reader, slice size and column index
         auto datasetFile = folder / ("0" + fileExtension);
         uint32_t columnIndex = 0;
+        setNodeRegion(datasetFile, structures::PartitionRegion::unbounded(numColumns));
 
-        // Call the recursive partitioning method
-        std::ignore = partitionBranches(datasetFile, columnIndex);
+        // Call the recursive partitioning method, a resumed run skips the branches already split
+        if (!isCheckpointed(intermediateFilesDeletedStep)) {
+            ARROW_RETURN_NOT_OK(partitionBranches(datasetFile, columnIndex));
+        }
 
         // Finalize the files
-        deleteIntermediateFiles();
-        moveCompletedFiles();
-        deleteSubfolders();
+        ARROW_RETURN_NOT_OK(finalizeCompletedFiles());
+
+        // Write the full rows once, following the row ids of the narrow partitions
+        ARROW_RETURN_NOT_OK(materializePartitions(sourceFile));
 
         // Finished
         std::cout << "[KDTreePartitioning] Completed" << std::endl;
-        return arrow::Status::OK();
+        return finishRun();
     }
 
     arrow::Status KDTreePartitioning::partitionBranches(std::filesystem::path &datasetFile,
                                                         uint32_t depth){
+        // Every subtree runs as its own task: use a reader local to this node instead of the shared one
+        auto nodeReader = std::make_shared<storage::DataReader>();
+
         // Base case: created a node of size = partition size
-        std::ignore = dataReader->load(datasetFile);
-        auto nodeSize = dataReader->getNumRows();
+        ARROW_RETURN_NOT_OK(nodeReader->load(datasetFile));
+        auto nodeSize = nodeReader->getNumRows();
         if (nodeSize <= partitionSize){
             // Rename the processed slice file
             auto basePath = datasetFile.parent_path();
@@ -45,17 +80,24 @@ namespace partitioning {
             return arrow::Status::OK();
         }
 
+        // A branch split before an interruption only needs its children to be processed
+        bool isAlreadySplit = isCheckpointed(splitStep, datasetFile);
+
         // Compute the median of current file to partition
         uint32_t columnIndex = depth % numColumns;
-        double median = findMedian(datasetFile, columnIndex).ValueOrDie();
+        double median = 0;
+        if (!isAlreadySplit) {
+            ARROW_ASSIGN_OR_RAISE(median, findMedian(nodeReader, datasetFile, columnIndex));
+        }
 
         // Read the table in batches
         uint32_t batchId = 0;
+        auto spillFormat = storage::DataWriter::getSpillFormat();
         std::string columnName = columns.at(columnIndex);
 
         // Update readers for current file
-        std::ignore = dataReader->load(datasetFile);
-        auto currentBatchReader = dataReader->getBatchReader().ValueOrDie();
+        ARROW_RETURN_NOT_OK(nodeReader->load(datasetFile));
+        auto currentBatchReader = nodeReader->getBatchReader().ValueOrDie();
 
         // Extract partition id from the file name
         std::string filename = datasetFile.filename();
@@ -65,6 +107,10 @@ namespace partitioning {
         // Generate new sub folder (with this partition id) for this processing iteration
         auto baseFolder = datasetFile.parent_path();
         auto subFolder = baseFolder / partitionId;
+        if (!isAlreadySplit && std::filesystem::exists(subFolder)) {
+            // Partial output of an interrupted split
+            std::filesystem::remove_all(subFolder);
+        }
         if (!std::filesystem::exists(subFolder)) {
             std::filesystem::create_directory(subFolder);
         }
@@ -72,7 +118,7 @@ namespace partitioning {
         std::vector<arrow::Expression> filterExpressions;
 
         // Load and sort batches
-        while (true) {
+        while (!isAlreadySplit) {
 
             // Try to load a new batch, when possible
             std::shared_ptr<arrow::RecordBatch> recordBatch;
@@ -93,7 +139,7 @@ namespace partitioning {
             auto toInt32 = arrow::compute::CastOptions::Safe(arrow::int32());
             auto toInt64 = arrow::compute::CastOptions::Safe(arrow::int64());
             arrow::Expression columnExpression;
-            auto columnXType = recordBatch->column(dataReader->getColumnIndex(columnName).ValueOrDie())->type();
+            auto columnXType = recordBatch->column(nodeReader->getColumnIndex(columnName).ValueOrDie())->type();
             if (columnXType->id() == arrow::date32()->id()) {
                 columnExpression = arrow::compute::call("cast",
                                                          {arrow::compute::field_ref(columnName)},
@@ -141,9 +187,9 @@ namespace partitioning {
                     if (!std::filesystem::exists(filteredFragmentPath)) {
                         std::filesystem::create_directory(filteredFragmentPath);
                     }
-                    std::filesystem::path filteredBatchPath = filteredFragmentPath / (std::to_string(batchId) + fileExtension);
-                    // Write out filtered batch
-                    ARROW_RETURN_NOT_OK(storage::DataWriter::WriteTableToDisk(filteredBatchTable, filteredBatchPath));
+                    std::filesystem::path filteredBatchPath = filteredFragmentPath / (std::to_string(batchId) + spillFormat.getExtension());
+                    // Write out filtered batch, as an intermediate file read back by the merge below
+                    ARROW_RETURN_NOT_OK(spillFormat.writeTable(filteredBatchTable, filteredBatchPath));
                     std::cout << "[KDTreePartitioning] Exported fragment " << std::to_string(i) << " for batch " << batchId << std::endl;
                 }
             }
@@ -156,7 +202,7 @@ namespace partitioning {
             if (std::filesystem::exists(fragmentPartsPath)) {
                 std::string rootPath;
                 ARROW_ASSIGN_OR_RAISE(auto fs, arrow::fs::FileSystemFromUriOrPath(fragmentPartsPath, &rootPath));
-                ARROW_RETURN_NOT_OK(storage::DataWriter::mergeBatchesInFolder(fs, rootPath));
+                ARROW_RETURN_NOT_OK(storage::DataWriter::mergeBatchesInFolder(fs, rootPath, spillFormat));
                 try {
                     std::filesystem::remove_all(fragmentPartsPath);
                 } catch (std::exception& e) {
@@ -165,6 +211,16 @@ namespace partitioning {
                 std::cout << "[KDTreePartitioning] Merged into fragments" << std::endl;
             }
         }
+        if (!isAlreadySplit) {
+            ARROW_RETURN_NOT_OK(checkpoint(splitStep, datasetFile));
+            // Branch 0 holds the values greater or equal than the median, branch 1 the smaller ones
+            auto nodeRegion = getNodeRegion(datasetFile);
+            if (nodeRegion.has_value()) {
+                auto belowMedian = std::nextafter(median, -std::numeric_limits<double>::infinity());
+                setNodeRegion(subFolder / ("0" + fileExtension), nodeRegion->withLower(columnIndex, median));
+                setNodeRegion(subFolder / ("1" + fileExtension), nodeRegion->withUpper(columnIndex, belowMedian));
+            }
+        }
 
         // Determine partitions to process next from the current folder
         std::vector<std::filesystem::path> partitionPaths;
@@ -189,67 +245,97 @@ namespace partitioning {
         }
 
         // Recursively split the files in the folder
+        // Sibling subtrees do not share any data, so each of them is a task for the scheduler
+        common::TaskGroup subtrees;
         for (auto &partitionPath: partitionPaths){
             // Only for files still to be processed
             bool isValidFile = partitionPath.extension() == common::Settings::fileExtension;
             bool isAlreadyCompleted = isFileCompleted(partitionPath);
             if (isValidFile && !isAlreadyCompleted) {
-                std::filesystem::path partitionFile = partitionPath;
-                std::ignore = partitionBranches(partitionFile, depth + 1);
+                subtrees.run([this, partitionPath, depth]() {
+                    std::filesystem::path partitionFile = partitionPath;
+                    return partitionBranches(partitionFile, depth + 1);
+                });
             }
         }
-        return arrow::Status::OK();
+        return subtrees.wait();
     }
 
-    arrow::Result<double> KDTreePartitioning::findMedian(std::filesystem::path &datasetFile, uint32_t columnIndex) {
-        // Initialize readers for current file
-        std::ignore = dataReader->load(datasetFile);
-        auto currentBatchReader = dataReader->getBatchReader().ValueOrDie();
-        std::vector<double> medians;
-        std::string sortColumn = columns.at(columnIndex);
+    // Median from a quantile sketch of the split column, the other columns of the file are not read
+    arrow::Result<double> KDTreePartitioning::findMedian(std::shared_ptr<storage::DataReader> &nodeReader,
+                                                         std::filesystem::path &datasetFile,
+                                                         uint32_t columnIndex) {
+        ARROW_RETURN_NOT_OK(nodeReader->load(datasetFile));
+        ARROW_ASSIGN_OR_RAISE(auto median, nodeReader->getQuantiles(columns.at(columnIndex), {0.5}));
+        return median.front();
+    }
 
-        // Load and sort batches
-        while (true) {
+    arrow::Status KDTreePartitioning::splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                                    const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                    std::vector<std::pair<size_t, size_t>> &partitionRanges) {
+        splitBranchInMemory(rowIndexes, columnsData, partitionRanges, 0, rowIndexes.size(), 0, partitionSize);
+        return arrow::Status::OK();
+    }
 
-            // Try to load a new batch, when possible
-            std::shared_ptr<arrow::RecordBatch> recordBatch;
-            ARROW_RETURN_NOT_OK(currentBatchReader->ReadNext(&recordBatch));
-            if (recordBatch == nullptr) {
-                break;
-            }
+    arrow::Status KDTreePartitioning::buildSplitTree(std::vector<uint64_t> &rowIndexes,
+                                                     const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                     size_t leafCapacity,
+                                                     structures::SplitTree &splitTree) {
+        std::vector<std::pair<size_t, size_t>> leafRanges;
+        splitBranchInMemory(rowIndexes, columnsData, leafRanges, 0, rowIndexes.size(), 0, leafCapacity, &splitTree,
+                            structures::SplitTree::getRoot());
+        return arrow::Status::OK();
+    }
 
-            ARROW_ASSIGN_OR_RAISE(auto sort_indices,
-                                  arrow::compute::SortIndices(recordBatch->GetColumnByName(sortColumn),
-                                                              arrow::compute::SortOptions({arrow::compute::SortKey{sortColumn}})));
-            ARROW_ASSIGN_OR_RAISE(arrow::Datum sorted, arrow::compute::Take(recordBatch, sort_indices));
-            auto batchRows = recordBatch->num_rows();
-            uint32_t medianRows;
-            if (batchRows % 2 == 0){
-                medianRows = 2;
-            } else{
-                medianRows = 1;
-            }
-            auto medianBatch = sorted.record_batch()->Slice((recordBatch->num_rows() / 2) - 1, medianRows);
-            auto batchColumnIndex = dataReader->getColumnIndex(sortColumn).ValueOrDie();
-            std::vector<std::shared_ptr<arrow::Array>> medianColumns = { medianBatch->column(batchColumnIndex)};
-            auto converter = common::ColumnDataConverter();
-            auto columnData = converter.toDouble(medianColumns).ValueOrDie();
-            double medianValue;
-            if (batchRows % 2 == 0){
-                medianValue = (columnData[0]->at(0) + columnData[0]->at(1)) / 2;
-            } else {
-                medianValue = columnData[0]->at(0);
-            }
-            medians.emplace_back(medianValue);
+    // Same split as partitionBranches, on the range [begin, end) of the row indexes: rows greater or equal than the
+    // median go first (branch 0), rows less than the median after (branch 1). The partitioning is stable, so the
+    // rows of a leaf keep their original order. The splits are also recorded in the split tree, if any
+    void KDTreePartitioning::splitBranchInMemory(std::vector<uint64_t> &rowIndexes,
+                                                 const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                 std::vector<std::pair<size_t, size_t>> &partitionRanges,
+                                                 size_t begin,
+                                                 size_t end,
+                                                 uint32_t depth,
+                                                 size_t leafCapacity,
+                                                 structures::SplitTree *splitTree,
+                                                 uint32_t nodeId) {
+        // Base case: created a node of size = partition size
+        if (end - begin <= leafCapacity) {
+            partitionRanges.emplace_back(begin, end);
+            return;
         }
 
-        std::sort(medians.begin(), medians.end(),
-                  [&](const double &a, const double &b) {
-                      return a < b;
-                  });
-        auto medianIdx = std::max((int) medians.size() / 2, 0);
-        return medians.at(medianIdx);
+        // Compute the median of the current node
+        uint32_t columnIndex = depth % numColumns;
+        const auto &values = *columnsData.at(columnIndex);
+        std::vector<double> nodeValues;
+        nodeValues.reserve(end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            nodeValues.emplace_back(values[rowIndexes[i]]);
+        }
+        auto medianPosition = nodeValues.begin() + nodeValues.size() / 2;
+        std::nth_element(nodeValues.begin(), medianPosition, nodeValues.end());
+        double median = *medianPosition;
+
+        // Split on the median
+        auto splitPosition = std::stable_partition(rowIndexes.begin() + begin, rowIndexes.begin() + end,
+                                                   [&values, median](uint64_t rowIndex) {
+                                                       return values[rowIndex] >= median;
+                                                   });
+        size_t split = splitPosition - rowIndexes.begin();
+
+        // Cannot partition further, set as completed
+        if (split == begin || split == end) {
+            partitionRanges.emplace_back(begin, end);
+            return;
+        }
+        std::vector<uint32_t> children = {0, 0};
+        if (splitTree != nullptr) {
+            children = splitTree->split(nodeId, structures::GREATER_EQUAL_FIRST, columnIndex, median);
+        }
+        splitBranchInMemory(rowIndexes, columnsData, partitionRanges, begin, split, depth + 1, leafCapacity,
+                            splitTree, children[0]);
+        splitBranchInMemory(rowIndexes, columnsData, partitionRanges, split, end, depth + 1, leafCapacity,
+                            splitTree, children[1]);
     }
-
-
-}
\ No newline at end of file
+}
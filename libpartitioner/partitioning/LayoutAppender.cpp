@@ -0,0 +1,352 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <sstream>
+
+#include <arrow/compute/api.h>
+
+#include "partitioning/FixedGridPartitioning.h"
+#include "partitioning/HilbertCurvePartitioning.h"
+#include "partitioning/LayoutAppender.h"
+#include "partitioning/Partitioning.h"
+#include "partitioning/ZOrderCurvePartitioning.h"
+#include "storage/BloomFilterIndex.h"
+#include "storage/DataReader.h"
+#include "storage/DataWriter.h"
+#include "storage/WriterPool.h"
+
+namespace partitioning {
+
+    LayoutAppender::LayoutAppender(const std::filesystem::path &partitionedFolder) {
+        folder = partitionedFolder;
+    }
+
+    /* Idea:
+     * 1. Read the new file in batches, compute the routing columns of every row
+     * 2. Route each row to the partition whose region contains it (or the closest one)
+     * 3. Stage the routed rows, grouped by partition
+     * 4. Merge the staged rows of every touched partition with its current rows, split the overflowing ones, and write
+     *    the rewritten partitions, the updated layout and manifest to the staging folder
+     * 5. Commit: move them over the files of the partitioned folder
+     * The folder is only modified by the commit, which is journaled: an interrupted append is either discarded (not
+     * prepared yet) or completed (prepared) by the next call with the same file, so the rows are never added twice
+     */
+    arrow::Status LayoutAppender::append(std::filesystem::path &newFile) {
+        auto stagingFolder = folder / stagingFolderName;
+        std::filesystem::create_directories(stagingFolder);
+        journal = std::make_shared<storage::ProgressJournal>(stagingFolder);
+        ARROW_RETURN_NOT_OK(journal->open(getAppendFingerprint(newFile), true));
+        if (journal->contains(storage::ProgressJournal::finishedStep)) {
+            std::cout << "[LayoutAppender] " << newFile << " is already appended to " << folder << std::endl;
+            return arrow::Status::OK();
+        }
+        if (journal->contains(preparedStep)) {
+            std::cout << "[LayoutAppender] Resuming the commit of " << newFile << std::endl;
+            return commit();
+        }
+        // Leftovers of an append interrupted before its commit, the partitioned folder was not modified
+        for (const auto &file: std::filesystem::directory_iterator(stagingFolder)) {
+            if (file.path().filename() != storage::ProgressJournal::fileName) {
+                std::filesystem::remove_all(file.path());
+            }
+        }
+        std::filesystem::create_directories(stagingFolder / rewrittenFolderName);
+
+        ARROW_ASSIGN_OR_RAISE(layout, structures::PartitionLayout::load(folder));
+        if (layout.regions.empty()) {
+            return arrow::Status::Invalid("Layout of ", folder.string(), " has no partitions");
+        }
+        if (structures::PartitionManifest::exists(folder)) {
+            ARROW_ASSIGN_OR_RAISE(auto manifest, structures::PartitionManifest::load(folder));
+            auto order = mapNameToOrder.find(manifest.order);
+            if (order == mapNameToOrder.end()) {
+                return arrow::Status::Invalid("Unknown partition order <", manifest.order, ">");
+            }
+            intraPartitionOrder = order->second;
+            intraPartitionColumns = manifest.orderColumns;
+            ARROW_ASSIGN_OR_RAISE(auto writerProfile, storage::WriterProfile::fromName(manifest.writerProfile,
+                                                                                      layout.columns));
+            storage::DataWriter::setWriterProfile(writerProfile);
+        }
+        std::cout << "[LayoutAppender] Appending " << newFile << " to " << layout.regions.size() << " "
+                  << layout.scheme << " partitions" << std::endl;
+
+        auto newReader = std::make_shared<storage::DataReader>();
+        ARROW_RETURN_NOT_OK(newReader->load(newFile));
+        ARROW_ASSIGN_OR_RAISE(auto batchReader, newReader->getPrefetchingBatchReader());
+
+        // Route the new rows and stage them by partition
+        storage::WriterPool stagingPool(stagingFolder);
+        auto numDimensions = layout.routingColumns.size();
+        uint64_t numAppendedRows = 0;
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> recordBatch;
+            ARROW_RETURN_NOT_OK(batchReader->ReadNext(&recordBatch));
+            if (recordBatch == nullptr) {
+                break;
+            }
+            ARROW_ASSIGN_OR_RAISE(auto routedBatch, addRoutingColumns(recordBatch));
+            ARROW_ASSIGN_OR_RAISE(auto routedTable, arrow::Table::FromRecordBatches({routedBatch}));
+            ARROW_ASSIGN_OR_RAISE(auto routingValues,
+                                  structures::PartitionLayout::getRoutingValues(routedTable, layout.routingColumns));
+            auto batchRows = routedBatch->num_rows();
+            std::vector<uint32_t> batchPartitions(batchRows);
+            std::vector<double> point(numDimensions);
+            for (int64_t i = 0; i < batchRows; ++i) {
+                for (size_t d = 0; d < numDimensions; ++d) {
+                    point[d] = routingValues[d]->at(i);
+                }
+                batchPartitions[i] = layout.route(point);
+            }
+            std::vector<uint64_t> batchOrder(batchRows);
+            std::iota(batchOrder.begin(), batchOrder.end(), 0);
+            std::stable_sort(batchOrder.begin(), batchOrder.end(), [&batchPartitions](uint64_t a, uint64_t b) {
+                return batchPartitions[a] < batchPartitions[b];
+            });
+            arrow::UInt64Builder batchOrderBuilder;
+            ARROW_RETURN_NOT_OK(batchOrderBuilder.AppendValues(batchOrder));
+            ARROW_ASSIGN_OR_RAISE(auto batchOrderArray, batchOrderBuilder.Finish());
+            ARROW_ASSIGN_OR_RAISE(arrow::Datum gathered, arrow::compute::Take(routedBatch, batchOrderArray));
+            auto groupedBatch = gathered.record_batch();
+            int64_t runBegin = 0;
+            for (int64_t i = 1; i <= batchRows; ++i) {
+                if (i == batchRows || batchPartitions[batchOrder[i]] != batchPartitions[batchOrder[runBegin]]) {
+                    auto partitionId = batchPartitions[batchOrder[runBegin]];
+                    ARROW_RETURN_NOT_OK(stagingPool.append(partitionId, groupedBatch->Slice(runBegin, i - runBegin)));
+                    runBegin = i;
+                }
+            }
+            numAppendedRows += batchRows;
+        }
+        ARROW_RETURN_NOT_OK(stagingPool.finish());
+
+        // Rewrite the partitions that received rows
+        auto stagedPartitions = stagingPool.getPartitionsNumRows();
+        auto numPartitionsBefore = layout.regions.size();
+        for (const auto &[partitionId, numStagedRows]: stagedPartitions) {
+            auto stagedFile = stagingPool.getPartitionPath(partitionId);
+            ARROW_RETURN_NOT_OK(mergePartition(partitionId, stagedFile));
+        }
+        ARROW_RETURN_NOT_OK(layout.save(stagingFolder));
+        ARROW_RETURN_NOT_OK(updateManifest());
+        ARROW_RETURN_NOT_OK(journal->record(preparedStep));
+        std::cout << "[LayoutAppender] Prepared " << numAppendedRows << " rows for " << stagedPartitions.size()
+                  << " partitions, " << layout.regions.size() - numPartitionsBefore << " new partitions from splits"
+                  << std::endl;
+        return commit();
+    }
+
+    // Move the prepared partitions (with their bloom filters), layout and manifest over the ones of the folder.
+    // A file already moved by an interrupted commit is no longer in the staging folder, so the commit can be repeated
+    arrow::Status LayoutAppender::commit() {
+        auto stagingFolder = folder / stagingFolderName;
+        uint32_t numMovedFiles = 0;
+        for (const auto &file: std::filesystem::directory_iterator(stagingFolder / rewrittenFolderName)) {
+            std::filesystem::rename(file.path(), folder / file.path().filename());
+            numMovedFiles += 1;
+        }
+        for (const auto &fileName: {structures::PartitionManifest::binaryFileName,
+                                    structures::PartitionManifest::jsonFileName,
+                                    structures::PartitionLayout::fileName}) {
+            if (std::filesystem::exists(stagingFolder / fileName)) {
+                std::filesystem::rename(stagingFolder / fileName, folder / fileName);
+            }
+        }
+        ARROW_RETURN_NOT_OK(journal->record(storage::ProgressJournal::finishedStep));
+        // The journal stays, a repeated call with the same file is recognized as done
+        for (const auto &file: std::filesystem::directory_iterator(stagingFolder)) {
+            if (file.path().filename() != storage::ProgressJournal::fileName) {
+                std::filesystem::remove_all(file.path());
+            }
+        }
+        std::cout << "[LayoutAppender] Committed " << numMovedFiles << " files to " << folder << std::endl;
+        return arrow::Status::OK();
+    }
+
+    // Identifies the appended file: its path, size and modification time
+    std::string LayoutAppender::getAppendFingerprint(const std::filesystem::path &newFile) {
+        std::stringstream fingerprint;
+        fingerprint << std::filesystem::absolute(newFile).string() << "|" << std::filesystem::file_size(newFile) << "|"
+                    << std::filesystem::last_write_time(newFile).time_since_epoch().count();
+        return fingerprint.str();
+    }
+
+    // Curve and fixed grid partitions carry their key as first column: compute it for the new rows, with the
+    // parameters of the partitioning run
+    arrow::Result<std::shared_ptr<arrow::RecordBatch>> LayoutAppender::addRoutingColumns(const std::shared_ptr<arrow::RecordBatch> &recordBatch) {
+        if (!isSortedByKey() || recordBatch->GetColumnByName(layout.routingColumns.at(0)) != nullptr) {
+            return recordBatch;
+        }
+        const auto &keyColumn = layout.routingColumns.at(0);
+        if (keyColumn == HilbertCurvePartitioning::curveColumn) {
+            return HilbertCurvePartitioning::addCurveValues(recordBatch, layout.columns);
+        }
+        if (keyColumn == ZOrderCurvePartitioning::curveColumn) {
+            return ZOrderCurvePartitioning::addCurveValues(recordBatch, layout.columns);
+        }
+        if (keyColumn == FixedGridPartitioning::cellColumn) {
+            auto cellWidth = layout.parameters.find(FixedGridPartitioning::cellWidthParameter);
+            if (cellWidth == layout.parameters.end()) {
+                return arrow::Status::Invalid("Layout has no cell width");
+            }
+            std::vector<double_t> columnDomains;
+            for (size_t j = 0; j < layout.columns.size(); ++j) {
+                auto columnDomain = layout.parameters.find(FixedGridPartitioning::domainParameter + std::to_string(j));
+                if (columnDomain == layout.parameters.end()) {
+                    return arrow::Status::Invalid("Layout has no domain for column ", layout.columns.at(j));
+                }
+                columnDomains.emplace_back(columnDomain->second);
+            }
+            return FixedGridPartitioning::addCellIndexes(recordBatch, layout.columns, cellWidth->second, columnDomains);
+        }
+        return arrow::Status::NotImplemented("Unknown routing column <", keyColumn, ">");
+    }
+
+    // The schemes routing on a derived key (curve value, cell index) keep their partitions sorted by it
+    bool LayoutAppender::isSortedByKey() {
+        return layout.routingColumns != layout.columns;
+    }
+
+    // Merge the staged rows into the partition. A partition over the partition size is split, the first piece keeps
+    // the partition id and the others are added after the last partition
+    arrow::Status LayoutAppender::mergePartition(uint32_t partitionId, std::filesystem::path &stagedFile) {
+        auto partitionPath = folder / (std::to_string(partitionId) + common::Settings::fileExtension);
+        ARROW_ASSIGN_OR_RAISE(auto partitionTable, storage::DataReader::getTable(partitionPath));
+        ARROW_ASSIGN_OR_RAISE(auto stagedTable, storage::DataReader::getTable(stagedFile));
+        if (!partitionTable->schema()->Equals(*stagedTable->schema(), false)) {
+            return arrow::Status::Invalid("Schema of the new rows ", stagedTable->schema()->ToString(),
+                                          " does not match partition ", partitionId, " ",
+                                          partitionTable->schema()->ToString());
+        }
+        ARROW_ASSIGN_OR_RAISE(auto mergedTable, arrow::ConcatenateTables({partitionTable, stagedTable}));
+        if (isSortedByKey()) {
+            arrow::compute::SortOptions sortOptions({arrow::compute::SortKey{layout.routingColumns.at(0)}});
+            ARROW_ASSIGN_OR_RAISE(auto sortIndices, arrow::compute::SortIndices(arrow::Datum(mergedTable), sortOptions));
+            ARROW_ASSIGN_OR_RAISE(arrow::Datum sorted, arrow::compute::Take(mergedTable, sortIndices));
+            mergedTable = sorted.table();
+        }
+
+        // Rows routed to the closest partition fall outside of its region, which grows to include them
+        auto region = layout.regions.at(partitionId);
+        ARROW_ASSIGN_OR_RAISE(auto stagedRegion,
+                              structures::PartitionLayout::getBoundingRegion(stagedTable, layout.routingColumns));
+        region.extend(stagedRegion.lower);
+        region.extend(stagedRegion.upper);
+
+        std::vector<std::pair<std::shared_ptr<arrow::Table>, structures::PartitionRegion>> pieces;
+        ARROW_RETURN_NOT_OK(splitTable(mergedTable, region, pieces));
+        for (size_t pieceIndex = 0; pieceIndex < pieces.size(); ++pieceIndex) {
+            auto &[pieceTable, pieceRegion] = pieces.at(pieceIndex);
+            uint32_t pieceId = partitionId;
+            if (pieceIndex == 0) {
+                layout.regions.at(partitionId) = pieceRegion;
+            } else {
+                pieceId = layout.regions.size();
+                layout.regions.emplace_back(pieceRegion);
+            }
+            ARROW_RETURN_NOT_OK(writePartition(pieceTable, pieceId));
+            rewrittenPartitions.emplace(pieceId);
+        }
+        std::cout << "[LayoutAppender] Partition " << partitionId << " has now " << mergedTable->num_rows()
+                  << " rows in " << pieces.size() << " pieces" << std::endl;
+        return arrow::Status::OK();
+    }
+
+    // Local split: halve the rows on the routing dimension with the widest spread until every piece fits the
+    // partition size. Rows equal to the split value stay on the same side, so the regions of the pieces do not overlap.
+    // Rows with identical routing values cannot be separated and are kept together
+    arrow::Status LayoutAppender::splitTable(const std::shared_ptr<arrow::Table> &table,
+                                             const structures::PartitionRegion &region,
+                                             std::vector<std::pair<std::shared_ptr<arrow::Table>, structures::PartitionRegion>> &pieces) {
+        auto numTableRows = (size_t) table->num_rows();
+        if (numTableRows <= layout.partitionSize) {
+            pieces.emplace_back(table, region);
+            return arrow::Status::OK();
+        }
+        ARROW_ASSIGN_OR_RAISE(auto routingValues,
+                              structures::PartitionLayout::getRoutingValues(table, layout.routingColumns));
+        size_t splitDimension = 0;
+        double widestSpread = 0;
+        for (size_t d = 0; d < routingValues.size(); ++d) {
+            auto [minValue, maxValue] = std::minmax_element(routingValues[d]->begin(), routingValues[d]->end());
+            if (*maxValue - *minValue > widestSpread) {
+                widestSpread = *maxValue - *minValue;
+                splitDimension = d;
+            }
+        }
+        if (widestSpread == 0) {
+            pieces.emplace_back(table, region);
+            return arrow::Status::OK();
+        }
+
+        const auto &values = *routingValues[splitDimension];
+        std::vector<uint64_t> rowOrder(numTableRows);
+        std::iota(rowOrder.begin(), rowOrder.end(), 0);
+        std::stable_sort(rowOrder.begin(), rowOrder.end(), [&values](uint64_t a, uint64_t b) {
+            return values[a] < values[b];
+        });
+        auto splitValue = values[rowOrder[numTableRows / 2]];
+        auto leftRegion = region;
+        auto rightRegion = region;
+        auto isLeft = [&values, splitValue](uint64_t rowIndex) { return values[rowIndex] < splitValue; };
+        auto numLeftRows = (size_t) std::count_if(rowOrder.begin(), rowOrder.end(), isLeft);
+        if (numLeftRows == 0) {
+            // The lower half only holds the minimum: keep it on the left
+            numLeftRows = std::count_if(rowOrder.begin(), rowOrder.end(),
+                                        [&values, splitValue](uint64_t rowIndex) { return values[rowIndex] <= splitValue; });
+            leftRegion.upper[splitDimension] = splitValue;
+            rightRegion.lower[splitDimension] = std::nextafter(splitValue, std::numeric_limits<double>::infinity());
+        } else {
+            leftRegion.upper[splitDimension] = std::nextafter(splitValue, -std::numeric_limits<double>::infinity());
+            rightRegion.lower[splitDimension] = splitValue;
+        }
+
+        arrow::UInt64Builder rowOrderBuilder;
+        ARROW_RETURN_NOT_OK(rowOrderBuilder.AppendValues(rowOrder));
+        ARROW_ASSIGN_OR_RAISE(auto rowOrderArray, rowOrderBuilder.Finish());
+        ARROW_ASSIGN_OR_RAISE(arrow::Datum gathered, arrow::compute::Take(table, rowOrderArray));
+        auto sortedTable = gathered.table();
+        ARROW_RETURN_NOT_OK(splitTable(sortedTable->Slice(0, (int64_t) numLeftRows), leftRegion, pieces));
+        return splitTable(sortedTable->Slice((int64_t) numLeftRows), rightRegion, pieces);
+    }
+
+    // Refresh the manifest entries (and bloom filters) of the rewritten and new partitions, the others are unchanged.
+    // Everything is written to the staging folder, the commit moves it over the folder
+    arrow::Status LayoutAppender::updateManifest() {
+        if (!structures::PartitionManifest::exists(folder)) {
+            return arrow::Status::OK();
+        }
+        ARROW_ASSIGN_OR_RAISE(auto manifest, structures::PartitionManifest::load(folder));
+        manifest.partitions.resize(layout.regions.size());
+        auto writerProfile = storage::DataWriter::getWriterProfile();
+        for (const auto &partitionId: rewrittenPartitions) {
+            auto partitionPath = getRewrittenPath(partitionId);
+            if (!writerProfile.getBloomFilterColumns().empty()) {
+                ARROW_RETURN_NOT_OK(storage::BloomFilterIndex::write(partitionPath, writerProfile.getBloomFilterColumns(),
+                                                                     writerProfile.bloomFilterFpp));
+            }
+            ARROW_ASSIGN_OR_RAISE(manifest.partitions.at(partitionId),
+                                  structures::PartitionManifest::summarize(partitionPath, manifest.columns));
+        }
+        return manifest.save(folder / stagingFolderName);
+    }
+
+    // Written to the staging folder, the commit renames it over the partition. Sorted partitions stay sorted by
+    // their order key
+    arrow::Status LayoutAppender::writePartition(std::shared_ptr<arrow::Table> &table, uint32_t partitionId) {
+        auto rewrittenPath = getRewrittenPath(partitionId);
+        if (intraPartitionOrder != SPLIT_ORDER) {
+            ARROW_ASSIGN_OR_RAISE(auto orderedTable, MultiDimensionalPartitioning::sortByOrderKey(table, intraPartitionOrder,
+                                                                                                 intraPartitionColumns));
+            auto rowGroupSize = MultiDimensionalPartitioning::getOrderedRowGroupSize(orderedTable->num_rows());
+            return storage::DataWriter::WriteTableToDisk(orderedTable, rewrittenPath, rowGroupSize);
+        }
+        return storage::DataWriter::WriteTableToDisk(table, rewrittenPath);
+    }
+
+    std::filesystem::path LayoutAppender::getRewrittenPath(uint32_t partitionId) {
+        return folder / stagingFolderName / rewrittenFolderName / (std::to_string(partitionId) + common::Settings::fileExtension);
+    }
+
+}
@@ -1,5 +1,22 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <sstream>
+#include <typeinfo>
+#include <unordered_map>
+
 #include "common/Exception.h"
+#include "common/KeyView.h"
+#include "common/TaskScheduler.h"
+#include "partitioning/HilbertCurvePartitioning.h"
 #include "partitioning/Partitioning.h"
+#include "partitioning/ZOrderCurvePartitioning.h"
+#include "storage/BloomFilterIndex.h"
+#include "storage/DataWriter.h"
+#include "storage/SpillFormat.h"
+#include "storage/WriterPool.h"
 
 namespace partitioning {
 
@@ -70,89 +87,275 @@ namespace partitioning {
         return arrow::Status::OK();
     }
 
+    // Late materialization: where a row goes only depends on the partitioning columns. The splits then work on a
+    // narrow copy of the dataset with these columns and the row id (position of the row in the source file)
+    arrow::Status MultiDimensionalPartitioning::writeNarrowProjection() {
+        if (isCheckpointed(narrowProjectionStep)) {
+            std::cout << "[Partitioning] Narrow projection already written" << std::endl;
+            return arrow::Status::OK();
+        }
+        std::vector<int> columnIndexes;
+        for (const auto &column: columns) {
+            ARROW_ASSIGN_OR_RAISE(auto columnIndex, dataReader->getColumnIndex(column));
+            columnIndexes.emplace_back(columnIndex);
+        }
+        // The row id is the position of the row, so the batches must come in file order whatever the read mode
+        ARROW_ASSIGN_OR_RAISE(auto narrowReader, dataReader->getOrderedBatchReader(columnIndexes));
+        auto rowIdField = arrow::field(rowIdColumn, arrow::uint64());
+        ARROW_ASSIGN_OR_RAISE(auto narrowSchema, narrowReader->schema()->AddField(narrowReader->schema()->num_fields(),
+                                                                                  rowIdField));
+        auto narrowPath = folder / ("0" + fileExtension);
+        ARROW_ASSIGN_OR_RAISE(auto outFile, arrow::io::FileOutputStream::Open(narrowPath));
+        ARROW_ASSIGN_OR_RAISE(auto writer, parquet::arrow::FileWriter::Open(*narrowSchema,
+                                                                            arrow::default_memory_pool(),
+                                                                            outFile,
+                                                                            storage::DataWriter::getWriterProperties(),
+                                                                            storage::DataWriter::getArrowWriterProperties()));
+        uint64_t nextRowId = 0;
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> recordBatch;
+            ARROW_RETURN_NOT_OK(narrowReader->ReadNext(&recordBatch));
+            if (recordBatch == nullptr) {
+                break;
+            }
+            // The splits place a row by its keys, a row with a null key has no region
+            for (int j = 0; j < recordBatch->num_columns(); ++j) {
+                if (recordBatch->column(j)->null_count() > 0) {
+                    return arrow::Status::Invalid("Partitioning column <", recordBatch->schema()->field(j)->name(),
+                                                  "> has ", recordBatch->column(j)->null_count(), " null keys");
+                }
+            }
+            std::vector<uint64_t> rowIds(recordBatch->num_rows());
+            std::iota(rowIds.begin(), rowIds.end(), nextRowId);
+            nextRowId += recordBatch->num_rows();
+            arrow::UInt64Builder rowIdsBuilder;
+            ARROW_RETURN_NOT_OK(rowIdsBuilder.AppendValues(rowIds));
+            ARROW_ASSIGN_OR_RAISE(auto rowIdsArray, rowIdsBuilder.Finish());
+            ARROW_ASSIGN_OR_RAISE(auto narrowBatch, recordBatch->AddColumn(recordBatch->num_columns(), rowIdField, rowIdsArray));
+            ARROW_ASSIGN_OR_RAISE(auto narrowTable, arrow::Table::FromRecordBatches({narrowBatch}));
+            ARROW_RETURN_NOT_OK(writer->WriteTable(*narrowTable, common::Settings::rowGroupSize));
+        }
+        ARROW_RETURN_NOT_OK(writer->Close());
+        ARROW_RETURN_NOT_OK(outFile->Close());
+        std::cout << "[Partitioning] Written narrow projection of " << nextRowId << " rows and "
+                  << narrowSchema->num_fields() << " columns" << std::endl;
+        return checkpoint(narrowProjectionStep);
+    }
+
+    // Final pass of the late materialization. The narrow partitions 0..N-1 in the output folder give the row id ->
+    // partition mapping. The full rows are then read once from the source file and scattered to their partition.
+    // Rows keep their order in the source file, an explicit intra-partition order is applied by orderPartitions.
+    // The narrow partitions are moved aside first and only deleted once all the full partitions are written, so
+    // that an interrupted materialization can start over
+    arrow::Status MultiDimensionalPartitioning::materializePartitions(std::filesystem::path &sourceFile) {
+        if (isCheckpointed(materializedStep)) {
+            // The ids of the regions may have changed when empty narrow partitions were skipped
+            partitionRegions.clear();
+            std::filesystem::remove_all(folder / narrowFolderName);
+            return arrow::Status::OK();
+        }
+        auto narrowFolder = folder / narrowFolderName;
+        if (!isCheckpointed(narrowFilesMovedStep)) {
+            std::filesystem::create_directories(narrowFolder);
+            for (uint32_t narrowId = 0; ; ++narrowId) {
+                auto narrowFileName = std::to_string(narrowId) + fileExtension;
+                if (std::filesystem::exists(folder / narrowFileName)) {
+                    std::filesystem::rename(folder / narrowFileName, narrowFolder / narrowFileName);
+                } else if (!std::filesystem::exists(narrowFolder / narrowFileName)) {
+                    break;
+                }
+            }
+            ARROW_RETURN_NOT_OK(checkpoint(narrowFilesMovedStep));
+        } else {
+            // Partitions left over by an interrupted materialization
+            for (const auto &file: std::filesystem::directory_iterator(folder)) {
+                if (file.is_regular_file() && file.path().extension() == fileExtension) {
+                    std::filesystem::remove(file.path());
+                }
+            }
+            std::filesystem::remove_all(folder / "_parts");
+        }
+
+        const auto unassigned = std::numeric_limits<uint32_t>::max();
+        // The map holds one partition id per row of the source, it cannot be spilled
+        auto rowMapBytes = (int64_t) (numRows * sizeof(uint32_t));
+        auto rowMapReservation = common::MemoryGovernor::getInstance().reserve("Row to partition map", rowMapBytes,
+                                                                              rowMapBytes);
+        std::vector<uint32_t> rowToPartition(numRows, unassigned);
+        std::vector<std::optional<structures::PartitionRegion>> materializedRegions;
+        uint32_t numPartitions = 0;
+        for (uint32_t narrowId = 0; ; ++narrowId) {
+            auto narrowPath = narrowFolder / (std::to_string(narrowId) + fileExtension);
+            if (!std::filesystem::exists(narrowPath)) {
+                break;
+            }
+            ARROW_ASSIGN_OR_RAISE(auto narrowTable, storage::DataReader::getTable(narrowPath));
+            if (narrowTable->num_rows() == 0) {
+                continue;
+            }
+            for (const auto &chunk: narrowTable->GetColumnByName(rowIdColumn)->chunks()) {
+                auto rowIdsChunk = std::static_pointer_cast<arrow::UInt64Array>(chunk);
+                for (int64_t i = 0; i < rowIdsChunk->length(); ++i) {
+                    auto rowId = rowIdsChunk->Value(i);
+                    if (rowId >= numRows) {
+                        return arrow::Status::Invalid("Row id ", rowId, " out of range in narrow partition ", narrowId);
+                    }
+                    rowToPartition[rowId] = numPartitions;
+                }
+            }
+            materializedRegions.emplace_back(narrowId < partitionRegions.size() ? partitionRegions[narrowId] : std::nullopt);
+            numPartitions += 1;
+        }
+        partitionRegions = std::move(materializedRegions);
+
+        // Scatter the full rows of every batch, grouped by partition
+        auto sourceReader = std::make_shared<storage::DataReader>();
+        ARROW_RETURN_NOT_OK(sourceReader->load(sourceFile));
+        // Rows are numbered as in the narrow projection: by their position in the file
+        ARROW_ASSIGN_OR_RAISE(auto orderedReader, sourceReader->getOrderedBatchReader());
+        auto wideReader = std::make_shared<storage::BatchPrefetcher>(orderedReader);
+        storage::WriterPool writerPool(folder);
+        uint64_t nextRowId = 0;
+        uint64_t numUnassignedRows = 0;
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> recordBatch;
+            ARROW_RETURN_NOT_OK(wideReader->ReadNext(&recordBatch));
+            if (recordBatch == nullptr) {
+                break;
+            }
+            auto batchRows = recordBatch->num_rows();
+            std::vector<uint32_t> batchPartitions(batchRows);
+            for (int64_t i = 0; i < batchRows; ++i) {
+                batchPartitions[i] = rowToPartition[nextRowId + i];
+                numUnassignedRows += batchPartitions[i] == unassigned;
+            }
+            nextRowId += batchRows;
+            std::vector<uint64_t> batchOrder(batchRows);
+            std::iota(batchOrder.begin(), batchOrder.end(), 0);
+            std::stable_sort(batchOrder.begin(), batchOrder.end(), [&batchPartitions](uint64_t a, uint64_t b) {
+                return batchPartitions[a] < batchPartitions[b];
+            });
+            arrow::UInt64Builder batchOrderBuilder;
+            ARROW_RETURN_NOT_OK(batchOrderBuilder.AppendValues(batchOrder));
+            ARROW_ASSIGN_OR_RAISE(auto batchOrderArray, batchOrderBuilder.Finish());
+            ARROW_ASSIGN_OR_RAISE(arrow::Datum gathered, arrow::compute::Take(recordBatch, batchOrderArray));
+            auto groupedBatch = gathered.record_batch();
+            // Unassigned rows (filtered out by the splits) sort last and are not written
+            int64_t runBegin = 0;
+            for (int64_t i = 1; i <= batchRows; ++i) {
+                if (i == batchRows || batchPartitions[batchOrder[i]] != batchPartitions[batchOrder[runBegin]]) {
+                    auto partitionId = batchPartitions[batchOrder[runBegin]];
+                    if (partitionId != unassigned) {
+                        ARROW_RETURN_NOT_OK(writerPool.append(partitionId, groupedBatch->Slice(runBegin, i - runBegin)));
+                    }
+                    runBegin = i;
+                }
+            }
+        }
+        ARROW_RETURN_NOT_OK(writerPool.finish());
+        if (nextRowId != numRows) {
+            return arrow::Status::Invalid("Materialized ", nextRowId, " rows, expected ", numRows);
+        }
+        // A row left out by the splits would be lost, the run must not be journaled as finished
+        if (numUnassignedRows > 0) {
+            return arrow::Status::Invalid(numUnassignedRows, " rows not assigned to any partition");
+        }
+
+        std::cout << "[Partitioning] Materialized " << numPartitions << " partitions" << std::endl;
+        ARROW_RETURN_NOT_OK(checkpoint(materializedStep));
+        std::filesystem::remove_all(narrowFolder);
+        return arrow::Status::OK();
+    }
+
     bool MultiDimensionalPartitioning::isFinished() {
         return finished;
     }
 
     // Splitting method to divide a table into sub-tables according to the partition ids
-    // Also useful: https://stackoverflow.com/questions/73118363/how-can-i-partition-an-arrow-table-by-value-in-one-pass
-    // Can slice like in https://github.com/apache/arrow/blob/353139680311e809d2413ea46e17e1656069ac5e/cpp/src/arrow/dataset/partition.cc#L90C20-L90C20
+    // Single-pass scatter: a counting sort over the partition ids gives one permutation that groups the rows of the
+    // same partition together. The table is gathered once with that permutation and every partition is then a
+    // contiguous slice, which is written straight to its own Parquet file.
+    // Similar to https://github.com/apache/arrow/blob/353139680311e809d2413ea46e17e1656069ac5e/cpp/src/arrow/dataset/partition.cc#L90C20-L90C20
     arrow::Status MultiDimensionalPartitioning::writeOutPartitions(std::shared_ptr<arrow::Table> &table,
                                             std::shared_ptr<arrow::Array> &partitionIds,
                                             const std::filesystem::path &outputFolder) {
-        // Extract the distinct values of partitions ids.
-        // Split the table into a set of different tables, one for each partition:
-        // For each distinct partition_id we filter the table by that partition_id (the newly created column)
-
-        // Extract the partition ids
-        // Create a new table with the current schema + a new column with the partition ids
         auto numRows = table->num_rows();
-        std::shared_ptr<arrow::Table> combined = table->CombineChunks().ValueOrDie();
-        std::vector<std::shared_ptr<arrow::Array>> columnArrays;
-        std::vector<std::shared_ptr<arrow::Field>> columnFields;
-        for (int i = 0; i < table->num_columns(); ++i) {
-            auto combinedColumnChunks = combined->columns().at(i)->chunks();
-            for (const auto &chunk: combinedColumnChunks) {
-                columnArrays.push_back(chunk);
-            }
-            columnFields.push_back(table->schema()->field(i));
-        }
-        columnFields.push_back(arrow::field("partition_id", arrow::uint32()));
-        columnArrays.push_back(partitionIds);
-        std::shared_ptr<arrow::Schema> newSchema = arrow::schema(columnFields);
-        std::shared_ptr<arrow::RecordBatch> batch = arrow::RecordBatch::Make(newSchema, table->num_rows(),
-                                                                             std::move(columnArrays));
-        auto newTablePreview = batch->ToString();
-        // Retrieve the distinct partition ids
-        auto arrow_array = std::static_pointer_cast<arrow::UInt32Array>(partitionIds);
-        std::set<uint32_t> uniquePartitionIds;
-        for (uint32_t i = 0; i < partitionIds->length(); ++i) {
-            uniquePartitionIds.insert(arrow_array->Value(i));
-        }
-        auto numPartitions = uniquePartitionIds.size();
+        if (partitionIds->length() != numRows) {
+            return arrow::Status::Invalid("Expected one partition id per row, got ", partitionIds->length(),
+                                          " ids for ", numRows, " rows");
+        }
+        auto ids = std::static_pointer_cast<arrow::UInt32Array>(partitionIds);
+
+        // 1. Histogram of the partition ids. Ids are remapped to a dense range [0, numPartitions) first, so that
+        //    sparse ids (e.g. cell indexes) do not blow up the size of the histogram
+        std::unordered_map<uint32_t, uint32_t> idToSlot;
+        std::vector<uint32_t> slotToId;
+        std::vector<uint32_t> rowSlots(numRows);
+        std::vector<int64_t> counts;
+        for (int64_t i = 0; i < numRows; ++i) {
+            auto partitionId = ids->Value(i);
+            auto slot = idToSlot.find(partitionId);
+            if (slot == idToSlot.end()) {
+                slot = idToSlot.emplace(partitionId, (uint32_t) slotToId.size()).first;
+                slotToId.emplace_back(partitionId);
+                counts.emplace_back(0);
+            }
+            rowSlots[i] = slot->second;
+            counts[slot->second] += 1;
+        }
+        auto numPartitions = slotToId.size();
         std::cout << "[Partitioning] Computed " << numPartitions << " unique partition ids" << std::endl;
-        assert(("Number of partitions is too high, component might freeze or crash", numPartitions < 100000));
-        // For each distinct partition_id we filter the table by that partition_id (the newly created column)
-        // Construct new table with the partitioning column from the record batches and
-        // Wrap the Table in a Dataset, so we can use a Scanner
-        int partitionedTablesNumRows = 0;
+
+        // 2. Prefix sum over the histogram: start offset of every partition in the permuted table
+        std::vector<int64_t> offsets(numPartitions + 1, 0);
+        for (size_t slot = 0; slot < numPartitions; ++slot) {
+            offsets[slot + 1] = offsets[slot] + counts[slot];
+        }
+
+        // 3. Counting sort: place every row index at the next free position of its partition
+        ARROW_ASSIGN_OR_RAISE(std::shared_ptr<arrow::Buffer> permutationBuffer,
+                              arrow::AllocateBuffer(numRows * (int64_t) sizeof(uint64_t)));
+        auto permutation = reinterpret_cast<uint64_t*>(permutationBuffer->mutable_data());
+        ARROW_ASSIGN_OR_RAISE(std::shared_ptr<arrow::Buffer> sortedIdsBuffer,
+                              arrow::AllocateBuffer(numRows * (int64_t) sizeof(uint32_t)));
+        auto sortedIds = reinterpret_cast<uint32_t*>(sortedIdsBuffer->mutable_data());
+        std::vector<int64_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (int64_t i = 0; i < numRows; ++i) {
+            auto position = cursors[rowSlots[i]]++;
+            permutation[position] = i;
+            sortedIds[position] = slotToId[rowSlots[i]];
+        }
+        rowSlots.clear();
+        rowSlots.shrink_to_fit();
+
+        // 4. Gather the whole table once, then append the partition ids column (already in permuted order)
+        auto permutationArray = std::make_shared<arrow::UInt64Array>(numRows, permutationBuffer);
+        ARROW_ASSIGN_OR_RAISE(arrow::Datum gathered, arrow::compute::Take(table, permutationArray));
+        std::shared_ptr<arrow::Table> sortedTable = gathered.table();
+        auto sortedIdsArray = std::make_shared<arrow::UInt32Array>(numRows, sortedIdsBuffer);
+        ARROW_ASSIGN_OR_RAISE(sortedTable, sortedTable->AddColumn(sortedTable->num_columns(),
+                                                                  arrow::field("partition_id", arrow::uint32()),
+                                                                  std::make_shared<arrow::ChunkedArray>(sortedIdsArray)));
+
+        // 5. Write every contiguous range to its partition file, through a bounded pool of open writers
+        storage::WriterPool writerPool(outputFolder, common::Settings::maxOpenWriters,
+                                       common::Settings::writerPoolBufferBytes, storage::DataWriter::getWriterProperties());
+        int64_t partitionedTablesNumRows = 0;
         uint32_t completedPartitions = 0;
-        for (const auto &partitionId: uniquePartitionIds) {
-            auto writeTable = arrow::Table::FromRecordBatches({batch}).ValueOrDie();
-            std::shared_ptr<arrow::dataset::Dataset> dataset = std::make_shared<arrow::dataset::InMemoryDataset>(
-                    writeTable);
-            // Build ScannerOptions for a Scanner to do a basic filter operation
-            auto options = std::make_shared<arrow::dataset::ScanOptions>();
-            options->filter = arrow::compute::equal(
-                    arrow::compute::field_ref("partition_id"),
-                    arrow::compute::literal(partitionId));
-            auto builder = arrow::dataset::ScannerBuilder(dataset, options);
-            auto scanner = builder.Finish();
-            std::shared_ptr<arrow::Table> partitionedTable = scanner.ValueOrDie()->ToTable().ValueOrDie();
+        for (size_t slot = 0; slot < numPartitions; ++slot) {
+            auto partitionedTable = sortedTable->Slice(offsets[slot], counts[slot]);
             partitionedTablesNumRows += partitionedTable->num_rows();
-            auto outfile = arrow::io::FileOutputStream::Open(
-                    outputFolder.string() + "/" + std::to_string(partitionId) + ".parquet");
-            std::unique_ptr<parquet::arrow::FileWriter> writer;
-            std::shared_ptr<parquet::WriterProperties> props = parquet::WriterProperties::Builder()
-                    .max_row_group_length(100000)
-                    ->created_by("Optimal Layout Partitioner")
-                    ->version(parquet::ParquetVersion::PARQUET_2_6)
-                    ->data_page_version(parquet::ParquetDataPageVersion::V2)
-                    ->compression(arrow::Compression::SNAPPY)
-                    ->build();
-            // Options to store Arrow schema for easier reads back into Arrow
-            std::shared_ptr<parquet::ArrowWriterProperties> arrow_props = parquet::ArrowWriterProperties::Builder().store_schema()->build();
-            PARQUET_THROW_NOT_OK(parquet::arrow::WriteTable(*partitionedTable, arrow::default_memory_pool(), *outfile,
-                                                            table->num_rows(), props, arrow_props));
+            ARROW_RETURN_NOT_OK(writerPool.append(slotToId[slot], partitionedTable));
             completedPartitions += 1;
-            std::cout << "[Partitioning] Generate partitioned table with " << partitionedTable->num_rows() << " rows"
-                      << std::endl;
-            int progress = float(completedPartitions) / float(numPartitions) * 100;
-            std::cout << "[Partitioning] Progress: " << progress << " %" << std::endl;
+            if (completedPartitions % 1000 == 0 || completedPartitions == numPartitions) {
+                int progress = float(completedPartitions) / float(numPartitions) * 100;
+                std::cout << "[Partitioning] Progress: " << progress << " %" << std::endl;
+            }
         }
+        ARROW_RETURN_NOT_OK(writerPool.finish());
         if (numRows != partitionedTablesNumRows) {
-            throw std::runtime_error(
-                    "Numbers of rows of the original table and the sum of the rows of the partitioned table should match");
+            return arrow::Status::Invalid("Numbers of rows of the original table (", numRows, ") and the sum of the rows "
+                                          "of the partitioned table (", partitionedTablesNumRows, ") should match");
         }
         std::cout << "[Partitioning] Split table into " << numPartitions << " partitions" << std::endl;
         return arrow::Status::OK();
@@ -170,16 +373,559 @@ namespace partitioning {
         dataReader = reader;
     }
 
+    void MultiDimensionalPartitioning::setMemoryBudget(const int64_t budgetBytes) {
+        memoryBudget = budgetBytes;
+    }
+
+    void MultiDimensionalPartitioning::setResume(const bool resumeRun) {
+        resume = resumeRun;
+    }
+
+    void MultiDimensionalPartitioning::setSchemeName(const std::string &name) {
+        schemeName = name;
+    }
+
+    void MultiDimensionalPartitioning::setBuildMode(TreeBuildMode mode) {
+        buildMode = mode;
+    }
+
+    void MultiDimensionalPartitioning::setIntraPartitionOrder(IntraPartitionOrder order,
+                                                              const std::vector<std::string> &orderColumns) {
+        intraPartitionOrder = order;
+        intraPartitionColumns = orderColumns;
+    }
+
+    // Start the progress journal of this run. When resuming, the checkpoints of the interrupted run are kept only
+    // if it had the same fingerprint, otherwise its leftovers are removed and the run starts from scratch
+    arrow::Status MultiDimensionalPartitioning::openJournal() {
+        journal = std::make_shared<storage::ProgressJournal>(folder);
+        ARROW_RETURN_NOT_OK(journal->open(getRunFingerprint(), resume));
+        if (resume && !journal->isResumed()) {
+            storage::DataWriter::cleanUpFolder(folder);
+            deleteSubfolders();
+        }
+        return arrow::Status::OK();
+    }
+
+    // Everything that changes the files written by the run: a journal is only reused when all of it matches
+    std::string MultiDimensionalPartitioning::getRunFingerprint() {
+        std::stringstream fingerprint;
+        fingerprint << typeid(*this).name() << "|" << dataReader->getReaderPath().string() << "|" << numRows
+                    << "|" << partitionSize << "|" << dataReader->getBatchSize() << "|" << memoryBudget;
+        for (const auto &column: columns) {
+            fingerprint << "|" << column;
+        }
+        fingerprint << "|" << mapOrderToName.at(intraPartitionOrder) << "|" << storage::DataWriter::getWriterProfile().name
+                    << "|" << mapBuildModeToName.at(buildMode);
+        for (const auto &column: intraPartitionColumns) {
+            fingerprint << "|" << column;
+        }
+        return fingerprint.str();
+    }
+
+    // Files are identified by their path relative to the output folder
+    bool MultiDimensionalPartitioning::isCheckpointed(const std::string &step, const std::filesystem::path &file) {
+        if (journal == nullptr) {
+            return false;
+        }
+        return journal->contains(step, file.empty() ? "" : file.lexically_relative(folder).string());
+    }
+
+    arrow::Status MultiDimensionalPartitioning::checkpoint(const std::string &step, const std::filesystem::path &file) {
+        if (journal == nullptr) {
+            return arrow::Status::OK();
+        }
+        return journal->record(step, file.empty() ? "" : file.lexically_relative(folder).string());
+    }
+
+    // Remove the files of the output folder that are not checkpointed for the given step, e.g. a sorted run
+    // that was being written when the previous run was interrupted
+    void MultiDimensionalPartitioning::discardUncheckpointedFiles(const std::string &step) {
+        for (const auto &file: std::filesystem::directory_iterator(folder)) {
+            bool isDataFile = file.path().extension() == fileExtension ||
+                              file.path().extension() == storage::SpillFormat::ipcExtension;
+            if (file.is_regular_file() && isDataFile && !isCheckpointed(step, file.path())) {
+                std::cout << "[Partitioning] Discarding incomplete file " << file.path().string() << std::endl;
+                std::filesystem::remove(file.path());
+            }
+        }
+    }
+
+    // Columns the regions of the layout are defined on, the partitioning columns unless the scheme derives a key
+    std::vector<std::string> MultiDimensionalPartitioning::getRoutingColumns() {
+        return columns;
+    }
+
+    std::map<std::string, double> MultiDimensionalPartitioning::getLayoutParameters() {
+        return {};
+    }
+
+    void MultiDimensionalPartitioning::setNodeRegion(const std::filesystem::path &nodeFile,
+                                                     const structures::PartitionRegion &region) {
+        std::lock_guard<std::mutex> lock(nodeRegionsMutex);
+        nodeRegions[nodeFile.lexically_relative(folder).string()] = region;
+    }
+
+    std::optional<structures::PartitionRegion> MultiDimensionalPartitioning::getNodeRegion(const std::filesystem::path &nodeFile) {
+        std::lock_guard<std::mutex> lock(nodeRegionsMutex);
+        auto nodeRegion = nodeRegions.find(nodeFile.lexically_relative(folder).string());
+        if (nodeRegion == nodeRegions.end()) {
+            return std::nullopt;
+        }
+        return nodeRegion->second;
+    }
+
+    // Persist the layout of the partitions. Partitions without a region from the splits (curves, grids, in-memory
+    // runs, resumed subtrees) get the bounding box of their rows
+    arrow::Status MultiDimensionalPartitioning::writeLayout(const std::vector<structures::PartitionRegion> &boundingRegions) {
+        structures::PartitionLayout layout;
+        layout.scheme = schemeName;
+        layout.columns = columns;
+        layout.routingColumns = getRoutingColumns();
+        layout.partitionSize = partitionSize;
+        layout.parameters = getLayoutParameters();
+        uint32_t numSplitRegions = 0;
+        for (uint32_t partitionId = 0; partitionId < boundingRegions.size(); ++partitionId) {
+            if (partitionId < partitionRegions.size() && partitionRegions[partitionId].has_value()) {
+                layout.regions.emplace_back(partitionRegions[partitionId].value());
+                numSplitRegions += 1;
+            } else {
+                layout.regions.emplace_back(boundingRegions[partitionId]);
+            }
+        }
+        std::cout << "[Partitioning] Layout has " << numSplitRegions << " regions from the splits, "
+                  << layout.regions.size() - numSplitRegions << " bounding boxes" << std::endl;
+        return layout.save(folder);
+    }
+
+    // Summarize the partitions 0..N-1 once for the manifest and the layout: the files are read a single time, on
+    // the partitioning columns and the routing columns of the scheme
+    arrow::Status MultiDimensionalPartitioning::writeManifestAndLayout() {
+        auto routingColumns = getRoutingColumns();
+        std::vector<std::string> summaryColumns = columns;
+        for (const auto &column: routingColumns) {
+            if (std::find(summaryColumns.begin(), summaryColumns.end(), column) == summaryColumns.end()) {
+                summaryColumns.emplace_back(column);
+            }
+        }
+        structures::PartitionManifest manifest;
+        manifest.scheme = schemeName;
+        manifest.columns = columns;
+        manifest.partitionSize = partitionSize;
+        manifest.order = mapOrderToName.at(intraPartitionOrder);
+        manifest.writerProfile = storage::DataWriter::getWriterProfile().name;
+        if (intraPartitionOrder != SPLIT_ORDER) {
+            manifest.orderColumns = intraPartitionColumns.empty() ? columns : intraPartitionColumns;
+        }
+        std::vector<structures::PartitionRegion> boundingRegions;
+        for (uint32_t partitionId = 0; ; ++partitionId) {
+            auto partitionPath = folder / (std::to_string(partitionId) + fileExtension);
+            if (!std::filesystem::exists(partitionPath)) {
+                break;
+            }
+            ARROW_ASSIGN_OR_RAISE(auto summary, structures::PartitionManifest::summarize(partitionPath, summaryColumns));
+            structures::PartitionRegion boundingRegion;
+            for (const auto &column: routingColumns) {
+                auto summaryIndex = std::find(summaryColumns.begin(), summaryColumns.end(), column) - summaryColumns.begin();
+                boundingRegion.lower.emplace_back(summary.min.at(summaryIndex));
+                boundingRegion.upper.emplace_back(summary.max.at(summaryIndex));
+            }
+            boundingRegions.emplace_back(boundingRegion);
+            summary.min.resize(numColumns);
+            summary.max.resize(numColumns);
+            manifest.partitions.emplace_back(summary);
+        }
+        ARROW_RETURN_NOT_OK(manifest.save(folder));
+        return writeLayout(boundingRegions);
+    }
+
+    arrow::Status MultiDimensionalPartitioning::finishRun() {
+        ARROW_RETURN_NOT_OK(orderPartitions());
+        ARROW_RETURN_NOT_OK(writeBloomFilters());
+        ARROW_RETURN_NOT_OK(writeManifestAndLayout());
+        return checkpoint(storage::ProgressJournal::finishedStep);
+    }
+
+    // Every scheme ends with the partitions 0..N-1 in the output folder, whatever the path that produced them:
+    // they are sorted here, one partition per task, before they are summarized
+    arrow::Status MultiDimensionalPartitioning::orderPartitions() {
+        if (intraPartitionOrder == SPLIT_ORDER) {
+            return arrow::Status::OK();
+        }
+        auto orderColumns = intraPartitionColumns.empty() ? columns : intraPartitionColumns;
+        common::TaskGroup orderTasks;
+        uint32_t numPartitions = 0;
+        for (uint32_t partitionId = 0; ; ++partitionId) {
+            auto partitionPath = folder / (std::to_string(partitionId) + fileExtension);
+            if (!std::filesystem::exists(partitionPath)) {
+                break;
+            }
+            numPartitions += 1;
+            if (isCheckpointed(orderedPartitionStep, partitionPath)) {
+                continue;
+            }
+            orderTasks.run([this, partitionPath, orderColumns]() -> arrow::Status {
+                auto path = partitionPath;
+                ARROW_ASSIGN_OR_RAISE(auto partitionTable, storage::DataReader::getTable(path));
+                ARROW_ASSIGN_OR_RAISE(auto orderedTable, sortByOrderKey(partitionTable, intraPartitionOrder, orderColumns));
+                // Written next to the partition, then renamed over it: an interrupted write leaves the partition intact
+                std::filesystem::path temporaryPath = path.string() + ".tmp";
+                ARROW_RETURN_NOT_OK(storage::DataWriter::WriteTableToDisk(orderedTable, temporaryPath,
+                                                                          getOrderedRowGroupSize(orderedTable->num_rows())));
+                std::filesystem::rename(temporaryPath, path);
+                return checkpoint(orderedPartitionStep, path);
+            });
+        }
+        ARROW_RETURN_NOT_OK(orderTasks.wait());
+        std::cout << "[Partitioning] Sorted the rows of " << numPartitions << " partitions by "
+                  << mapOrderToName.at(intraPartitionOrder) << " key" << std::endl;
+        return arrow::Status::OK();
+    }
+
+    arrow::Status MultiDimensionalPartitioning::writeBloomFilters() {
+        auto writerProfile = storage::DataWriter::getWriterProfile();
+        auto bloomFilterColumns = writerProfile.getBloomFilterColumns();
+        common::TaskGroup bloomFilterTasks;
+        uint32_t numPartitions = 0;
+        for (uint32_t partitionId = 0; ; ++partitionId) {
+            auto partitionPath = folder / (std::to_string(partitionId) + fileExtension);
+            if (!std::filesystem::exists(partitionPath)) {
+                break;
+            }
+            if (bloomFilterColumns.empty()) {
+                // Filters left by a previous run over the same folder would describe other rows
+                std::filesystem::remove(storage::BloomFilterIndex::getPath(partitionPath));
+                continue;
+            }
+            numPartitions += 1;
+            bloomFilterTasks.run([partitionPath, bloomFilterColumns, writerProfile]() -> arrow::Status {
+                return storage::BloomFilterIndex::write(partitionPath, bloomFilterColumns, writerProfile.bloomFilterFpp);
+            });
+        }
+        ARROW_RETURN_NOT_OK(bloomFilterTasks.wait());
+        if (numPartitions == 0) {
+            return arrow::Status::OK();
+        }
+        std::cout << "[Partitioning] Written the bloom filters of " << numPartitions << " partitions" << std::endl;
+        return arrow::Status::OK();
+    }
+
+    // Sort the rows of a table by the secondary key. The curve keys are computed on the fly and not kept
+    arrow::Result<std::shared_ptr<arrow::Table>> MultiDimensionalPartitioning::sortByOrderKey(const std::shared_ptr<arrow::Table> &table,
+                                                                                              IntraPartitionOrder order,
+                                                                                              const std::vector<std::string> &orderColumns) {
+        if (order == SPLIT_ORDER || table->num_rows() < 2) {
+            return table;
+        }
+        for (const auto &column: orderColumns) {
+            if (table->GetColumnByName(column) == nullptr) {
+                return arrow::Status::Invalid("Order column <", column, "> not found in partition");
+            }
+        }
+        std::shared_ptr<arrow::Array> sortIndices;
+        if (order == COLUMNS_KEY) {
+            std::vector<arrow::compute::SortKey> sortKeys;
+            for (const auto &column: orderColumns) {
+                sortKeys.emplace_back(column);
+            }
+            arrow::compute::SortOptions sortOptions(sortKeys);
+            ARROW_ASSIGN_OR_RAISE(sortIndices, arrow::compute::SortIndices(arrow::Datum(table), sortOptions));
+        } else {
+            // Only the order columns are needed to compute the key
+            std::vector<std::shared_ptr<arrow::Field>> orderFields;
+            std::vector<std::shared_ptr<arrow::ChunkedArray>> orderData;
+            for (const auto &column: orderColumns) {
+                orderFields.emplace_back(table->schema()->GetFieldByName(column));
+                orderData.emplace_back(table->GetColumnByName(column));
+            }
+            auto orderTable = arrow::Table::Make(arrow::schema(orderFields), orderData);
+            ARROW_ASSIGN_OR_RAISE(auto orderBatch, orderTable->CombineChunksToBatch());
+            std::shared_ptr<arrow::RecordBatch> keyedBatch;
+            if (order == Z_ORDER_KEY) {
+                ARROW_ASSIGN_OR_RAISE(keyedBatch, ZOrderCurvePartitioning::addCurveValues(orderBatch, orderColumns));
+            } else {
+                ARROW_ASSIGN_OR_RAISE(keyedBatch, HilbertCurvePartitioning::addCurveValues(orderBatch, orderColumns));
+            }
+            // The curve value is the first column of the keyed batch
+            ARROW_ASSIGN_OR_RAISE(sortIndices, arrow::compute::SortIndices(*keyedBatch->column(0)));
+        }
+        ARROW_ASSIGN_OR_RAISE(arrow::Datum sorted, arrow::compute::Take(table, sortIndices));
+        return sorted.table();
+    }
+
+    // About orderedRowGroupsPerPartition row groups per partition: fewer and the statistics of a row group span most
+    // of the partition, more and the per row group overhead (footer, page headers) dominates the small reads
+    int64_t MultiDimensionalPartitioning::getOrderedRowGroupSize(int64_t partitionRows) {
+        auto rowGroupSize = (partitionRows + common::Settings::orderedRowGroupsPerPartition - 1) /
+                            common::Settings::orderedRowGroupsPerPartition;
+        return std::clamp(rowGroupSize, common::Settings::minRowGroupSize, common::Settings::rowGroupSize);
+    }
+
+    // The dataset can be partitioned in memory when its decoded size, estimated from the footer, fits the budget
+    bool MultiDimensionalPartitioning::fitsInMemory() {
+        if (memoryBudget <= 0) {
+            return false;
+        }
+        auto estimatedBytes = (int64_t) numRows * dataReader->getRowWidth();
+        std::cout << "[Partitioning] Estimated dataset size " << estimatedBytes << " bytes, memory budget "
+                  << memoryBudget << " bytes" << std::endl;
+        return estimatedBytes <= memoryBudget;
+    }
+
+    // Load the table a single time and let the scheme split a permutation of the row indexes instead of the files.
+    // Every partition is a contiguous range [begin, end) of the permutation: the table is gathered once with it and
+    // each range is written to its own file, numbered in the order the ranges were produced
+    arrow::Status MultiDimensionalPartitioning::partitionInMemory() {
+        std::cout << "[Partitioning] Dataset fits the memory budget, partitioning in memory" << std::endl;
+        auto datasetPath = dataReader->getReaderPath();
+        ARROW_ASSIGN_OR_RAISE(auto table, storage::DataReader::getTable(datasetPath));
+
+        // Partitioning columns converted to double, the only values looked at by the splits
+        ARROW_ASSIGN_OR_RAISE(auto columnsData, getColumnsData(table));
+
+        // Split the row indexes
+        std::vector<uint64_t> rowIndexes(table->num_rows());
+        std::iota(rowIndexes.begin(), rowIndexes.end(), 0);
+        std::vector<std::pair<size_t, size_t>> partitionRanges;
+        ARROW_RETURN_NOT_OK(splitInMemory(rowIndexes, columnsData, partitionRanges));
+        columnsData.clear();
+
+        // Gather the table once and write out the final partitions
+        arrow::UInt64Builder rowIndexesBuilder;
+        ARROW_RETURN_NOT_OK(rowIndexesBuilder.AppendValues(rowIndexes));
+        ARROW_ASSIGN_OR_RAISE(auto rowIndexesArray, rowIndexesBuilder.Finish());
+        rowIndexes.clear();
+        rowIndexes.shrink_to_fit();
+        ARROW_ASSIGN_OR_RAISE(arrow::Datum gathered, arrow::compute::Take(table, rowIndexesArray));
+        table.reset();
+        auto sortedTable = gathered.table();
+        storage::WriterPool writerPool(folder);
+        for (uint32_t partitionId = 0; partitionId < partitionRanges.size(); ++partitionId) {
+            auto [begin, end] = partitionRanges.at(partitionId);
+            ARROW_RETURN_NOT_OK(writerPool.append(partitionId, sortedTable->Slice(begin, end - begin)));
+        }
+        ARROW_RETURN_NOT_OK(writerPool.finish());
+        std::cout << "[Partitioning] Written " << partitionRanges.size() << " partitions from memory" << std::endl;
+        return arrow::Status::OK();
+    }
+
+    arrow::Status MultiDimensionalPartitioning::splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                                              const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                              std::vector<std::pair<size_t, size_t>> &partitionRanges) {
+        return arrow::Status::NotImplemented("In-memory partitioning not available for this scheme");
+    }
+
+    // Partitioning columns of a table converted to double, one vector per column. The keys of every chunk are read
+    // in place and written once into the vector. The splits compare keys of different columns and types and index
+    // them by row many times over, so one flat double per key is kept for them. A null key has no region, the
+    // table is Invalid
+    arrow::Result<std::vector<std::shared_ptr<std::vector<double>>>> MultiDimensionalPartitioning::getColumnsData(
+            const std::shared_ptr<arrow::Table> &table) {
+        std::vector<std::shared_ptr<std::vector<double>>> columnsData;
+        for (const auto &column: columns) {
+            auto chunkedColumn = table->GetColumnByName(column);
+            if (chunkedColumn == nullptr) {
+                return arrow::Status::Invalid("Partitioning column <", column, "> not found");
+            }
+            if (chunkedColumn->null_count() > 0) {
+                return arrow::Status::Invalid("Partitioning column <", column, "> has ", chunkedColumn->null_count(),
+                                              " null keys");
+            }
+            auto columnData = std::make_shared<std::vector<double>>();
+            columnData->reserve(chunkedColumn->length());
+            for (const auto &chunk: chunkedColumn->chunks()) {
+                ARROW_RETURN_NOT_OK(common::visitKeys(*chunk, [&columnData](const auto &keys) {
+                    for (int64_t i = 0; i < keys.size(); i++) {
+                        columnData->emplace_back(static_cast<double>(keys[i]));
+                    }
+                    return arrow::Status::OK();
+                }));
+            }
+            columnsData.emplace_back(columnData);
+        }
+        return columnsData;
+    }
+
+    // Two passes over the dataset, instead of one per level of the tree. The leaves are scattered in a folder of
+    // their own, which is dropped whatever the outcome: a failed run leaves no partition behind, so the scheme can
+    // fall back to the level by level build
+    arrow::Status MultiDimensionalPartitioning::partitionSampled() {
+        if (isCheckpointed(scatteredStep)) {
+            std::cout << "[Partitioning] Sampled partitions already scattered" << std::endl;
+            return arrow::Status::OK();
+        }
+        auto scatterFolder = folder / scatterFolderName;
+        auto scatterStatus = scatterToLeaves(scatterFolder);
+        std::filesystem::remove_all(scatterFolder);
+        if (!scatterStatus.ok()) {
+            discardUncheckpointedFiles(scatteredStep);
+            partitionRegions.clear();
+            return scatterStatus;
+        }
+        return checkpoint(scatteredStep);
+    }
+
+    // 1. Sample the partitioning columns, batch by batch, and let the scheme build its whole split tree on the sample,
+    //    with the leaf capacity scaled by the sampling rate
+    // 2. Route every row of the dataset to its leaf, streaming the batches into a writer pool
+    // 3. Fix up the leaves the sample got wrong: sibling leaves under the tolerance are merged, leaves over it are
+    //    split again in memory by the scheme. The partitions are then numbered 0..N-1 in the order of the leaves
+    arrow::Status MultiDimensionalPartitioning::scatterToLeaves(const std::filesystem::path &scatterFolder) {
+        // Build the split tree on the sample
+        auto sampleSize = std::min(numRows, std::max(common::Settings::sampledBuildSampleSize,
+                                                     numRows / std::max(partitionSize, (size_t) 1) *
+                                                     common::Settings::sampledRowsPerLeaf));
+        ARROW_ASSIGN_OR_RAISE(auto sample, dataReader->getStratifiedSample(columns, sampleSize));
+        ARROW_ASSIGN_OR_RAISE(auto sampleData, getColumnsData(sample));
+        double samplingRate = numRows > 0 ? (double) sample->num_rows() / (double) numRows : 1;
+        auto leafCapacity = (size_t) std::max(std::llround((double) partitionSize * samplingRate), 1LL);
+        std::vector<uint64_t> sampleIndexes(sample->num_rows());
+        std::iota(sampleIndexes.begin(), sampleIndexes.end(), 0);
+        structures::SplitTree splitTree(numColumns);
+        ARROW_RETURN_NOT_OK(buildSplitTree(sampleIndexes, sampleData, leafCapacity, splitTree));
+        splitTree.finalize();
+        std::cout << "[Partitioning] Built " << splitTree.getNumLeaves() << " leaves on " << sample->num_rows()
+                  << " sampled rows, leaf capacity " << leafCapacity << std::endl;
+        sampleData.clear();
+        sampleIndexes.clear();
+        sampleIndexes.shrink_to_fit();
+        sample.reset();
+
+        // Scatter the dataset to the leaves, rows of the same leaf keep the order of the file
+        std::filesystem::remove_all(scatterFolder);
+        std::filesystem::create_directories(scatterFolder);
+        storage::WriterPool leafPool(scatterFolder);
+        ARROW_ASSIGN_OR_RAISE(auto prefetchingReader, dataReader->getPrefetchingBatchReader());
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> recordBatch;
+            ARROW_RETURN_NOT_OK(prefetchingReader->ReadNext(&recordBatch));
+            if (recordBatch == nullptr) {
+                break;
+            }
+            ARROW_ASSIGN_OR_RAISE(auto batchTable, arrow::Table::FromRecordBatches({recordBatch}));
+            ARROW_ASSIGN_OR_RAISE(auto batchData, getColumnsData(batchTable));
+            auto batchRows = recordBatch->num_rows();
+            std::vector<uint32_t> batchLeaves(batchRows);
+            for (int64_t i = 0; i < batchRows; ++i) {
+                batchLeaves[i] = splitTree.route(batchData, i);
+            }
+            std::vector<uint64_t> batchOrder(batchRows);
+            std::iota(batchOrder.begin(), batchOrder.end(), 0);
+            std::stable_sort(batchOrder.begin(), batchOrder.end(), [&batchLeaves](uint64_t a, uint64_t b) {
+                return batchLeaves[a] < batchLeaves[b];
+            });
+            arrow::UInt64Builder batchOrderBuilder;
+            ARROW_RETURN_NOT_OK(batchOrderBuilder.AppendValues(batchOrder));
+            ARROW_ASSIGN_OR_RAISE(auto batchOrderArray, batchOrderBuilder.Finish());
+            ARROW_ASSIGN_OR_RAISE(arrow::Datum gathered, arrow::compute::Take(recordBatch, batchOrderArray));
+            auto groupedBatch = gathered.record_batch();
+            int64_t runBegin = 0;
+            for (int64_t i = 1; i <= batchRows; ++i) {
+                if (i == batchRows || batchLeaves[batchOrder[i]] != batchLeaves[batchOrder[runBegin]]) {
+                    auto leafId = batchLeaves[batchOrder[runBegin]];
+                    ARROW_RETURN_NOT_OK(leafPool.append(leafId, groupedBatch->Slice(runBegin, i - runBegin)));
+                    runBegin = i;
+                }
+            }
+        }
+        ARROW_RETURN_NOT_OK(leafPool.finish());
+
+        // Fix up the leaves outside of the tolerance
+        std::vector<int64_t> leafRows(splitTree.getNumLeaves(), 0);
+        for (const auto &[leafId, numLeafRows]: leafPool.getPartitionsNumRows()) {
+            leafRows.at(leafId) = numLeafRows;
+        }
+        auto minRows = (int64_t) std::floor((1 - common::Settings::sampledLeafTolerance) * (double) partitionSize);
+        auto maxRows = (int64_t) std::ceil((1 + common::Settings::sampledLeafTolerance) * (double) partitionSize);
+        auto leafGroups = splitTree.mergeLeaves(leafRows, minRows, maxRows);
+        partitionRegions.clear();
+        uint32_t partitionId = 0;
+        uint32_t numMergedGroups = 0;
+        uint32_t numSplitLeaves = 0;
+        for (const auto &leafGroup: leafGroups) {
+            std::vector<uint32_t> filledLeaves;
+            int64_t groupRows = 0;
+            auto groupRegion = splitTree.getLeafRegion(leafGroup.front());
+            for (auto leafId: leafGroup) {
+                groupRegion.extend(splitTree.getLeafRegion(leafId).lower);
+                groupRegion.extend(splitTree.getLeafRegion(leafId).upper);
+                if (leafRows.at(leafId) > 0) {
+                    filledLeaves.emplace_back(leafId);
+                    groupRows += leafRows.at(leafId);
+                }
+            }
+            if (filledLeaves.empty()) {
+                continue;
+            }
+            if (filledLeaves.size() == 1 && groupRows <= maxRows) {
+                std::filesystem::rename(leafPool.getPartitionPath(filledLeaves.front()),
+                                        folder / (std::to_string(partitionId) + fileExtension));
+                partitionRegions.emplace_back(groupRegion);
+                partitionId += 1;
+                continue;
+            }
+            std::vector<std::shared_ptr<arrow::Table>> leafTables;
+            for (auto leafId: filledLeaves) {
+                auto leafPath = leafPool.getPartitionPath(leafId);
+                ARROW_ASSIGN_OR_RAISE(auto leafTable, storage::DataReader::getTable(leafPath));
+                leafTables.emplace_back(leafTable);
+                std::filesystem::remove(leafPath);
+            }
+            ARROW_ASSIGN_OR_RAISE(auto groupTable, arrow::ConcatenateTables(leafTables));
+            leafTables.clear();
+            if (groupRows <= maxRows) {
+                // Underfilled siblings, merged into the region of their parent
+                auto partitionPath = folder / (std::to_string(partitionId) + fileExtension);
+                ARROW_RETURN_NOT_OK(storage::DataWriter::WriteTableToDisk(groupTable, partitionPath));
+                partitionRegions.emplace_back(groupRegion);
+                partitionId += 1;
+                numMergedGroups += 1;
+                continue;
+            }
+            // Overfilled leaf, split again on its own rows. The pieces get the bounding box of their rows
+            ARROW_ASSIGN_OR_RAISE(auto groupData, getColumnsData(groupTable));
+            std::vector<uint64_t> rowIndexes(groupTable->num_rows());
+            std::iota(rowIndexes.begin(), rowIndexes.end(), 0);
+            std::vector<std::pair<size_t, size_t>> pieceRanges;
+            ARROW_RETURN_NOT_OK(splitInMemory(rowIndexes, groupData, pieceRanges));
+            groupData.clear();
+            arrow::UInt64Builder rowIndexesBuilder;
+            ARROW_RETURN_NOT_OK(rowIndexesBuilder.AppendValues(rowIndexes));
+            ARROW_ASSIGN_OR_RAISE(auto rowIndexesArray, rowIndexesBuilder.Finish());
+            ARROW_ASSIGN_OR_RAISE(arrow::Datum gathered, arrow::compute::Take(groupTable, rowIndexesArray));
+            auto splitTable = gathered.table();
+            for (const auto &[begin, end]: pieceRanges) {
+                auto pieceTable = splitTable->Slice((int64_t) begin, (int64_t) (end - begin));
+                auto partitionPath = folder / (std::to_string(partitionId) + fileExtension);
+                ARROW_RETURN_NOT_OK(storage::DataWriter::WriteTableToDisk(pieceTable, partitionPath));
+                partitionRegions.emplace_back(std::nullopt);
+                partitionId += 1;
+            }
+            numSplitLeaves += 1;
+        }
+        std::cout << "[Partitioning] Scattered " << numRows << " rows to " << partitionId << " partitions, "
+                  << numMergedGroups << " groups of leaves merged, " << numSplitLeaves << " leaves split again"
+                  << std::endl;
+        return arrow::Status::OK();
+    }
+
+    arrow::Status MultiDimensionalPartitioning::buildSplitTree(std::vector<uint64_t> &rowIndexes,
+                                                               const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                               size_t leafCapacity,
+                                                               structures::SplitTree &splitTree) {
+        return arrow::Status::NotImplemented("Sample-then-scatter build not available for this scheme");
+    }
+
     // Regex for checking whether the file is finalized slice already
     bool MultiDimensionalPartitioning::isFileCompleted(const std::filesystem::path &partitionFile) {
         auto completedRegex = std::regex{R"(.*completed.*\.parquet)"};
         return std::regex_match(partitionFile.string(), completedRegex);
     }
 
-    // Delete intermediate files
+    // Delete intermediate files (the progress journal is not a data file and stays)
     void MultiDimensionalPartitioning::deleteIntermediateFiles() {
         for (const auto &file : std::filesystem::recursive_directory_iterator(folder)) {
-            if (file.is_regular_file() && !isFileCompleted(file)) {
+            if (file.is_regular_file() && file.path().extension() == fileExtension && !isFileCompleted(file)) {
                 try {
                     std::filesystem::remove(file.path());
                 } catch (std::exception& e) {
@@ -201,11 +947,21 @@ namespace partitioning {
     }
 
     // Rename completed files to partition ids
+    // Files are renamed in order: after an interruption, the numbering continues after the last renamed file
     void MultiDimensionalPartitioning::moveCompletedFiles() {
         auto completedFiles = getCompletedFiles();
         uint32_t partitionId = 0;
+        while (std::filesystem::exists(folder / (std::to_string(partitionId) + fileExtension))) {
+            partitionId += 1;
+        }
         for (const auto &completedFile: completedFiles){
             std::filesystem::rename(completedFile, folder / (std::to_string(partitionId) + fileExtension));
+            // The leaf keeps the region of the node it was completed from
+            auto nodeFile = completedFile.parent_path() / completedFile.filename().string().substr(completedPrefix.size());
+            if (partitionRegions.size() <= partitionId) {
+                partitionRegions.resize(partitionId + 1);
+            }
+            partitionRegions[partitionId] = getNodeRegion(nodeFile);
             partitionId += 1;
         }
     }
@@ -223,4 +979,19 @@ namespace partitioning {
         }
     }
 
-}
\ No newline at end of file
+    // Turn the leaves of a tree scheme into the partitions 0..N-1. Resumed runs skip the steps already done:
+    // once the intermediate files are deleted, only the completed files are left to rename
+    arrow::Status MultiDimensionalPartitioning::finalizeCompletedFiles() {
+        if (isCheckpointed(treeFinalizedStep)) {
+            return arrow::Status::OK();
+        }
+        if (!isCheckpointed(intermediateFilesDeletedStep)) {
+            deleteIntermediateFiles();
+            ARROW_RETURN_NOT_OK(checkpoint(intermediateFilesDeletedStep));
+        }
+        moveCompletedFiles();
+        deleteSubfolders();
+        return checkpoint(treeFinalizedStep);
+    }
+
+}
@@ -1,3 +1,6 @@
+#include <cmath>
+#include <limits>
+
 #include "partitioning/QuadTreePartitioning.h"
 
 namespace partitioning {
@@ -12,12 +15,36 @@ namespace partitioning {
          * 5. Repeat recursively from step 3 until we reach partition size
          */
 
-        // Copy original files to destination and work there
+        // Record the progress, to resume from the last checkpoint if the run gets interrupted
+        ARROW_RETURN_NOT_OK(openJournal());
+
+        // Fast path: the whole dataset fits the memory budget, split the row indexes instead of the files
+        if (fitsInMemory()) {
+            auto inMemoryStatus = partitionInMemory();
+            if (inMemoryStatus.ok()) {
+                return finishRun();
+            }
+            std::cout << "[QuadTreePartitioning] Falling back to disk, " << inMemoryStatus.ToString() << std::endl;
+        }
+
+        // Two passes: build the splits on a sample of the partitioning columns, then scatter the rows to the leaves
+        if (buildMode == SAMPLE_SCATTER) {
+            auto sampledStatus = partitionSampled();
+            if (sampledStatus.ok()) {
+                return finishRun();
+            }
+            std::cout << "[QuadTreePartitioning] Falling back to the level by level build, " << sampledStatus.ToString()
+                      << std::endl;
+        }
+
+        // Work on a narrow copy (partitioning columns + row id) of the original file in the destination folder
         // This way all the batch readers will point to the right folder from the start
-        ARROW_RETURN_NOT_OK(copyOriginalToDestination());
+        auto sourceFile = dataReader->getReaderPath();
+        ARROW_RETURN_NOT_OK(writeNarrowProjection());
 
         // Initialize the reader, slice size and column index
         auto datasetFile = folder / ("0" + fileExtension);
+        setNodeRegion(datasetFile, structures::PartitionRegion::unbounded(numColumns));
 
         // Read the metadata from the indexing columns
         std::string columnX = columns.at(0);
@@ -25,15 +52,18 @@ namespace partitioning {
         std::string columnY = columns.at(1);
         std::pair<double_t, double_t> columnStatsY = dataReader->getColumnStats(columnY).ValueOrDie();
 
-        // Call the recursive quadrant slicing method
-        std::ignore = partitionQuadrants(datasetFile, columnStatsX, columnStatsY, 0);
+        // Call the recursive quadrant slicing method, a resumed run skips the quadrants already split
+        if (!isCheckpointed(intermediateFilesDeletedStep)) {
+            ARROW_RETURN_NOT_OK(partitionQuadrants(datasetFile, columnStatsX, columnStatsY, 0));
+        }
 
         // Finalize the files
-        deleteIntermediateFiles();
-        moveCompletedFiles();
-        deleteSubfolders();
+        ARROW_RETURN_NOT_OK(finalizeCompletedFiles());
 
-        return arrow::Status::OK();
+        // Write the full rows once, following the row ids of the narrow partitions
+        ARROW_RETURN_NOT_OK(materializePartitions(sourceFile));
+
+        return finishRun();
     }
 
     arrow::Status QuadTreePartitioning::partitionQuadrants(std::filesystem::path &datasetFile,
@@ -41,9 +71,12 @@ namespace partitioning {
                                                            std::pair<double_t, double_t> columnStatsY,
                                                            uint32_t depth){
 
+        // Quadrants are processed as concurrent tasks: use a reader local to this quadrant
+        auto quadrantReader = std::make_shared<storage::DataReader>();
+
         // Base case: created a quadrant of size = partition size
-        std::ignore = dataReader->load(datasetFile);
-        auto quadrantSize = dataReader->getNumRows();
+        ARROW_RETURN_NOT_OK(quadrantReader->load(datasetFile));
+        auto quadrantSize = quadrantReader->getNumRows();
         if (quadrantSize <= partitionSize){
             // Rename the processed quadrant file
             auto basePath = datasetFile.parent_path();
@@ -76,10 +109,11 @@ namespace partitioning {
 
         // Read the table in batches
         uint32_t batchId = 0;
+        auto spillFormat = storage::DataWriter::getSpillFormat();
 
         // Update readers for current file
-        std::ignore = dataReader->load(datasetFile);
-        auto currentBatchReader = dataReader->getBatchReader().ValueOrDie();
+        ARROW_RETURN_NOT_OK(quadrantReader->load(datasetFile));
+        auto currentBatchReader = quadrantReader->getBatchReader().ValueOrDie();
 
         // Extract partition id from the file name
         std::string filename = datasetFile.filename();
@@ -89,13 +123,19 @@ namespace partitioning {
         // Generate new sub folder (with this partition id) for this processing iteration
         auto baseFolder = datasetFile.parent_path();
         auto subFolder = baseFolder / partitionId;
+        // A quadrant split before an interruption only needs its children to be processed
+        bool isAlreadySplit = isCheckpointed(splitStep, datasetFile);
+        if (!isAlreadySplit && std::filesystem::exists(subFolder)) {
+            // Partial output of an interrupted split
+            std::filesystem::remove_all(subFolder);
+        }
         if (!std::filesystem::exists(subFolder)) {
             std::filesystem::create_directory(subFolder);
         }
 
         std::vector<arrow::Expression> filterExpressions;
         // Load and sort batches
-        while (true) {
+        while (!isAlreadySplit) {
 
             // Try to load a new batch, when possible
             std::shared_ptr<arrow::RecordBatch> recordBatch;
@@ -115,7 +155,7 @@ namespace partitioning {
             auto toInt32 = arrow::compute::CastOptions::Safe(arrow::int32());
             auto toInt64 = arrow::compute::CastOptions::Safe(arrow::int64());
             arrow::Expression columnXExpression;
-            auto columnXType = recordBatch->column(dataReader->getColumnIndex(columnX).ValueOrDie())->type();
+            auto columnXType = recordBatch->column(quadrantReader->getColumnIndex(columnX).ValueOrDie())->type();
             if (columnXType->id() == arrow::date32()->id()) {
                 columnXExpression = arrow::compute::call("cast",
                                                         {arrow::compute::field_ref(columnX)},
@@ -131,7 +171,7 @@ namespace partitioning {
             }
             // Possibly cast date to int64 - for column Y
             arrow::Expression columnYExpression;
-            auto columnYType = recordBatch->column(dataReader->getColumnIndex(columnY).ValueOrDie())->type();
+            auto columnYType = recordBatch->column(quadrantReader->getColumnIndex(columnY).ValueOrDie())->type();
             if (columnYType->id() == arrow::date32()->id()) {
                 columnYExpression = arrow::compute::call("cast",
                                                          {arrow::compute::field_ref(columnY)},
@@ -230,9 +270,9 @@ namespace partitioning {
                     if (!std::filesystem::exists(filteredQuadrantPath)) {
                         std::filesystem::create_directory(filteredQuadrantPath);
                     }
-                    std::filesystem::path filteredBatchPath = filteredQuadrantPath / (std::to_string(batchId) + fileExtension);
-                    // Write out filtered batch
-                    ARROW_RETURN_NOT_OK(storage::DataWriter::WriteTableToDisk(filteredBatchTable, filteredBatchPath));
+                    std::filesystem::path filteredBatchPath = filteredQuadrantPath / (std::to_string(batchId) + spillFormat.getExtension());
+                    // Write out filtered batch, as an intermediate file read back by the merge below
+                    ARROW_RETURN_NOT_OK(spillFormat.writeTable(filteredBatchTable, filteredBatchPath));
                     std::cout << "[QuadTreePartitioning] Exported quadrant " << std::to_string(i) << " for batch " << batchId << std::endl;
                 }
             }
@@ -246,7 +286,7 @@ namespace partitioning {
             if (std::filesystem::exists(quadrantPartsPath)) {
                 std::string rootPath;
                 ARROW_ASSIGN_OR_RAISE(auto fs, arrow::fs::FileSystemFromUriOrPath(quadrantPartsPath, &rootPath));
-                ARROW_RETURN_NOT_OK(storage::DataWriter::mergeBatchesInFolder(fs, rootPath));
+                ARROW_RETURN_NOT_OK(storage::DataWriter::mergeBatchesInFolder(fs, rootPath, spillFormat));
                 try {
                     std::filesystem::remove_all(quadrantPartsPath);
                     std::cout << "[QuadTreePartitioning] Merged batches into 4 quadrants" << std::endl;
@@ -255,6 +295,21 @@ namespace partitioning {
                 }
             }
         }
+        if (!isAlreadySplit) {
+            ARROW_RETURN_NOT_OK(checkpoint(splitStep, datasetFile));
+            // Regions of the quadrants, from the same comparisons as the filters (strict on the lower side)
+            auto nodeRegion = getNodeRegion(datasetFile);
+            if (nodeRegion.has_value()) {
+                auto belowMeanX = std::nextafter(meanDimX, -std::numeric_limits<double>::infinity());
+                auto belowMeanY = std::nextafter(meanDimY, -std::numeric_limits<double>::infinity());
+                auto westRegion = nodeRegion->withUpper(columnIndexX, belowMeanX);
+                auto eastRegion = nodeRegion->withLower(columnIndexX, meanDimX);
+                setNodeRegion(subFolder / ("0" + fileExtension), westRegion.withLower(columnIndexY, meanDimY));
+                setNodeRegion(subFolder / ("1" + fileExtension), eastRegion.withLower(columnIndexY, meanDimY));
+                setNodeRegion(subFolder / ("2" + fileExtension), westRegion.withUpper(columnIndexY, belowMeanY));
+                setNodeRegion(subFolder / ("3" + fileExtension), eastRegion.withUpper(columnIndexY, belowMeanY));
+            }
+        }
 
         // Determine partitions to process next from the current folder
         std::vector<std::filesystem::path> partitionPaths;
@@ -294,7 +349,8 @@ namespace partitioning {
                                    std::make_pair(columnStatsY.first, meanDimY))}
         };
 
-        // Recursively split the files in the folder
+        // Recursively split the files in the folder, one task per quadrant
+        common::TaskGroup subtrees;
         for (int i = 0; i < partitionPaths.size(); ++i) {
             auto partitionPath = partitionPaths.at(i);
             // Only for files still to be processed
@@ -316,10 +372,125 @@ namespace partitioning {
                     std::cout << "[QuadTreePartitioning] Exporting partition that cannot be split further" << std::endl;
                     return arrow::Status::OK();
                 }
-                std::ignore = partitionQuadrants(partitionFile, newColumnStatsX, newColumnStatsY, depth + 1);
+                subtrees.run([this, partitionFile, newColumnStatsX, newColumnStatsY, depth]() {
+                    std::filesystem::path quadrantFile = partitionFile;
+                    return partitionQuadrants(quadrantFile, newColumnStatsX, newColumnStatsY, depth + 1);
+                });
             }
         }
+        return subtrees.wait();
+    }
+
+    arrow::Status QuadTreePartitioning::splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                                      const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                      std::vector<std::pair<size_t, size_t>> &partitionRanges) {
+        // Same initial bounds as the disk version: min-max of the first two indexing columns
+        auto [minX, maxX] = std::minmax_element(columnsData.at(0)->begin(), columnsData.at(0)->end());
+        auto [minY, maxY] = std::minmax_element(columnsData.at(1)->begin(), columnsData.at(1)->end());
+        splitQuadrantInMemory(rowIndexes, columnsData, partitionRanges, 0, rowIndexes.size(),
+                              std::make_pair(*minX, *maxX), std::make_pair(*minY, *maxY), 0, partitionSize);
+        return arrow::Status::OK();
+    }
+
+    arrow::Status QuadTreePartitioning::buildSplitTree(std::vector<uint64_t> &rowIndexes,
+                                                       const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                       size_t leafCapacity,
+                                                       structures::SplitTree &splitTree) {
+        if (rowIndexes.empty()) {
+            return arrow::Status::OK();
+        }
+        auto [minX, maxX] = std::minmax_element(columnsData.at(0)->begin(), columnsData.at(0)->end());
+        auto [minY, maxY] = std::minmax_element(columnsData.at(1)->begin(), columnsData.at(1)->end());
+        std::vector<std::pair<size_t, size_t>> leafRanges;
+        splitQuadrantInMemory(rowIndexes, columnsData, leafRanges, 0, rowIndexes.size(),
+                              std::make_pair(*minX, *maxX), std::make_pair(*minY, *maxY), 0, leafCapacity,
+                              &splitTree, structures::SplitTree::getRoot());
         return arrow::Status::OK();
     }
 
-}
\ No newline at end of file
+    // Same split as partitionQuadrants, on the range [begin, end) of the row indexes. The rows are stably grouped by
+    // quadrant (NW, NE, SW, SE), so the rows of a leaf keep their original order. The splits are also recorded in
+    // the split tree, if any
+    void QuadTreePartitioning::splitQuadrantInMemory(std::vector<uint64_t> &rowIndexes,
+                                                     const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                     std::vector<std::pair<size_t, size_t>> &partitionRanges,
+                                                     size_t begin,
+                                                     size_t end,
+                                                     std::pair<double_t, double_t> columnStatsX,
+                                                     std::pair<double_t, double_t> columnStatsY,
+                                                     uint32_t depth,
+                                                     size_t leafCapacity,
+                                                     structures::SplitTree *splitTree,
+                                                     uint32_t nodeId) {
+        // Base case: created a quadrant of size = partition size
+        if (end - begin <= leafCapacity) {
+            partitionRanges.emplace_back(begin, end);
+            return;
+        }
+
+        // Determine the columns to use for the split, rotating when there are more than 2 indexing columns
+        uint32_t columnIndexX = numColumns == 2 ? 0 : depth % numColumns;
+        uint32_t columnIndexY = numColumns == 2 ? 1 : (depth + 1) % numColumns;
+        const auto &valuesX = *columnsData.at(columnIndexX);
+        const auto &valuesY = *columnsData.at(columnIndexY);
+        double meanDimX = (columnStatsX.first + columnStatsX.second) / 2;
+        double meanDimY = (columnStatsY.first + columnStatsY.second) / 2;
+
+        // Group the rows by quadrant
+        std::vector<std::vector<uint64_t>> quadrants(4);
+        for (size_t i = begin; i < end; ++i) {
+            auto rowIndex = rowIndexes[i];
+            int quadrantId = (valuesX[rowIndex] >= meanDimX ? 1 : 0) + (valuesY[rowIndex] < meanDimY ? 2 : 0);
+            quadrants[quadrantId].emplace_back(rowIndex);
+        }
+
+        // Only one quadrant with data: cannot partition further, set as completed
+        for (const auto &quadrant: quadrants) {
+            if (quadrant.size() == end - begin) {
+                partitionRanges.emplace_back(begin, end);
+                return;
+            }
+        }
+
+        std::map<int, std::pair<std::pair<double_t, double_t>, std::pair<double_t, double_t>>> newColumnStats = {
+                {0, std::make_pair(std::make_pair(columnStatsX.first, meanDimX),
+                                   std::make_pair(meanDimY, columnStatsY.second))},
+                {1, std::make_pair(std::make_pair(meanDimX, columnStatsX.second),
+                                   std::make_pair(meanDimY, columnStatsY.second))},
+                {2, std::make_pair(std::make_pair(columnStatsX.first, meanDimX),
+                                   std::make_pair(columnStatsY.first, meanDimY))},
+                {3, std::make_pair(std::make_pair(meanDimX, columnStatsX.second),
+                                   std::make_pair(columnStatsY.first, meanDimY))}
+        };
+
+        std::vector<uint32_t> children = {0, 0, 0, 0};
+        if (splitTree != nullptr) {
+            children = splitTree->split(nodeId, structures::QUADRANTS, columnIndexX, meanDimX, columnIndexY, meanDimY);
+        }
+
+        // Recursively split the quadrants
+        size_t quadrantBegin = begin;
+        for (int quadrantId = 0; quadrantId < 4; ++quadrantId) {
+            auto &quadrant = quadrants[quadrantId];
+            if (quadrant.empty()) {
+                continue;
+            }
+            std::copy(quadrant.begin(), quadrant.end(), rowIndexes.begin() + quadrantBegin);
+            size_t quadrantEnd = quadrantBegin + quadrant.size();
+            quadrant.clear();
+            quadrant.shrink_to_fit();
+            auto newColumnStatsX = newColumnStats[quadrantId].first;
+            auto newColumnStatsY = newColumnStats[quadrantId].second;
+            // If we cannot split further
+            if (newColumnStatsX.first == newColumnStatsX.second ||
+                newColumnStatsY.first == newColumnStatsY.second) {
+                partitionRanges.emplace_back(quadrantBegin, quadrantEnd);
+            } else {
+                splitQuadrantInMemory(rowIndexes, columnsData, partitionRanges, quadrantBegin, quadrantEnd,
+                                      newColumnStatsX, newColumnStatsY, depth + 1, leafCapacity, splitTree,
+                                      children[quadrantId]);
+            }
+            quadrantBegin = quadrantEnd;
+        }
+    }
+}
@@ -30,26 +30,44 @@ namespace partitioning {
          * 5. Repeat until we get a partition size <= desired partition size
          */
 
-        // Copy original files to destination and work there
+        // Record the progress, to resume from the last checkpoint if the run gets interrupted
+        ARROW_RETURN_NOT_OK(openJournal());
+
+        // Fast path: the whole dataset fits the memory budget, sort and slice the row indexes instead of the files
+        if (fitsInMemory()) {
+            auto inMemoryStatus = partitionInMemory();
+            if (inMemoryStatus.ok()) {
+                std::cout << "[STRTreePartitioning] Completed" << std::endl;
+                return finishRun();
+            }
+            std::cout << "[STRTreePartitioning] Falling back to disk, " << inMemoryStatus.ToString() << std::endl;
+        }
+
+        // Work on a narrow copy (partitioning columns + row id) of the original file in the destination folder
         // This way all the batch readers will point to the right folder from the start
-        ARROW_RETURN_NOT_OK(copyOriginalToDestination());
+        auto sourceFile = dataReader->getReaderPath();
+        ARROW_RETURN_NOT_OK(writeNarrowProjection());
 
         // Initialize the reader, slice size and column index
         auto datasetFile = folder / ("0" + fileExtension);
         size_t sliceSize = numRows;
         uint32_t columnIndex = 0;
+        setNodeRegion(datasetFile, structures::PartitionRegion::unbounded(numColumns));
 
-        // Call the recursive slicing method
-        std::ignore = slicePartition(datasetFile, sliceSize, columnIndex);
+        // Call the recursive slicing method, a resumed run skips the slices already split
+        if (!isCheckpointed(intermediateFilesDeletedStep)) {
+            ARROW_RETURN_NOT_OK(slicePartition(datasetFile, sliceSize, columnIndex));
+        }
 
         // Finalize the files
-        deleteIntermediateFiles();
-        moveCompletedFiles();
-        deleteSubfolders();
+        ARROW_RETURN_NOT_OK(finalizeCompletedFiles());
+
+        // Write the full rows once, following the row ids of the narrow partitions
+        ARROW_RETURN_NOT_OK(materializePartitions(sourceFile));
 
         // Finished
         std::cout << "[STRTreePartitioning] Completed" << std::endl;
-        return arrow::Status::OK();
+        return finishRun();
     }
 
     arrow::Status STRTreePartitioning::slicePartition(std::filesystem::path &datasetFile,
@@ -65,9 +83,10 @@ namespace partitioning {
             return arrow::Status::OK();
         }
 
-        // Update readers for current file
-        std::ignore = dataReader->load(datasetFile);
-        auto numRows = dataReader->getNumRows();
+        // Update readers for current file, local to this slice since slices are processed as concurrent tasks
+        auto sliceReader = std::make_shared<storage::DataReader>();
+        ARROW_RETURN_NOT_OK(sliceReader->load(datasetFile));
+        auto numRows = sliceReader->getNumRows();
 
         // Extract partition id from the file name
         std::string filename = datasetFile.filename();
@@ -77,13 +96,15 @@ namespace partitioning {
         // Generate new sub folder (with this partition id) for this processing iteration
         auto baseFolder = datasetFile.parent_path();
         auto subFolder = baseFolder / partitionId;
+        // A slice split before an interruption only needs its children to be processed
+        bool isAlreadySplit = isCheckpointed(splitStep, datasetFile);
+        if (!isAlreadySplit && std::filesystem::exists(subFolder)) {
+            // Partial output of an interrupted split
+            std::filesystem::remove_all(subFolder);
+        }
         if (!std::filesystem::exists(subFolder)) {
             std::filesystem::create_directory(subFolder);
         }
-        // Copy current file to sub folder, where it will be split
-        std::filesystem::path source = dataReader->getReaderPath();
-        std::filesystem::path destination = subFolder / "0.parquet";
-        std::filesystem::copy(source, destination, std::filesystem::copy_options::overwrite_existing);
 
         // Determine column index
         columnIndex = columnIndex % k;
@@ -92,10 +113,19 @@ namespace partitioning {
         // Update the slice size and the column index
         sliceSize = std::max(std::ceil(numRows / S), (double) 1);
 
-        // Sort-merge the files to create sorted partitions
-        ARROW_RETURN_NOT_OK(external::ExternalMerge::sortMergeFiles(subFolder, columnName, sliceSize));
-        std::cout << "[STRTreePartitioning] Merged batches with sliceSize " << sliceSize << " and column name "
-                  << columnName << std::endl;
+        if (!isAlreadySplit) {
+            // Copy current file to sub folder, where it will be split
+            std::filesystem::path source = sliceReader->getReaderPath();
+            std::filesystem::path destination = subFolder / "0.parquet";
+            std::filesystem::copy(source, destination, std::filesystem::copy_options::overwrite_existing);
+
+            // Sort-merge the files to create sorted partitions
+            ARROW_RETURN_NOT_OK(external::ExternalMerge::sortMergeFiles(subFolder, columnName, sliceSize));
+            std::cout << "[STRTreePartitioning] Merged batches with sliceSize " << sliceSize << " and column name "
+                      << columnName << std::endl;
+            ARROW_RETURN_NOT_OK(checkpoint(splitStep, datasetFile));
+            ARROW_RETURN_NOT_OK(setSliceRegions(datasetFile, subFolder, columnIndex));
+        }
 
         // Determine partitions to process next from the current folder
         std::vector<std::filesystem::path> partitionPaths;
@@ -105,16 +135,88 @@ namespace partitioning {
             }
         }
 
-        // Recursively split the files in the folder
+        // Recursively split the files in the folder, one task per slice
+        common::TaskGroup slices;
         for (auto &partitionPath: partitionPaths){
             // Only for files still to be processed
             bool isValidFile = partitionPath.extension() == common::Settings::fileExtension;
             bool isAlreadyCompleted = isFileCompleted(partitionPath);
             if (isValidFile && !isAlreadyCompleted) {
-                std::filesystem::path partitionFile = partitionPath;
-                std::ignore = slicePartition(partitionFile, sliceSize, columnIndex + 1);
+                slices.run([this, partitionPath, sliceSize, columnIndex]() {
+                    std::filesystem::path partitionFile = partitionPath;
+                    return slicePartition(partitionFile, sliceSize, columnIndex + 1);
+                });
+            }
+        }
+        return slices.wait();
+    }
+
+    // The slices are sorted runs of the column: each one starts at its first value and ends where the next one starts
+    arrow::Status STRTreePartitioning::setSliceRegions(const std::filesystem::path &datasetFile,
+                                                       const std::filesystem::path &subFolder,
+                                                       uint32_t columnIndex) {
+        auto nodeRegion = getNodeRegion(datasetFile);
+        if (!nodeRegion.has_value()) {
+            return arrow::Status::OK();
+        }
+        std::vector<double> sliceBegins;
+        for (uint32_t sliceId = 0; ; ++sliceId) {
+            auto slicePath = subFolder / (std::to_string(sliceId) + fileExtension);
+            if (!std::filesystem::exists(slicePath)) {
+                break;
             }
+            auto sliceReader = std::make_shared<storage::DataReader>();
+            ARROW_RETURN_NOT_OK(sliceReader->load(slicePath));
+            ARROW_ASSIGN_OR_RAISE(auto sliceStats, sliceReader->getColumnStats(columns.at(columnIndex)));
+            sliceBegins.emplace_back(sliceStats.first);
+        }
+        for (uint32_t sliceId = 0; sliceId < sliceBegins.size(); ++sliceId) {
+            auto sliceRegion = nodeRegion.value();
+            if (sliceId > 0) {
+                sliceRegion = sliceRegion.withLower(columnIndex, sliceBegins[sliceId]);
+            }
+            if (sliceId + 1 < sliceBegins.size()) {
+                sliceRegion = sliceRegion.withUpper(columnIndex, sliceBegins[sliceId + 1]);
+            }
+            setNodeRegion(subFolder / (std::to_string(sliceId) + fileExtension), sliceRegion);
         }
         return arrow::Status::OK();
     }
-}
\ No newline at end of file
+
+    arrow::Status STRTreePartitioning::splitInMemory(std::vector<uint64_t> &rowIndexes,
+                                                     const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                                     std::vector<std::pair<size_t, size_t>> &partitionRanges) {
+        sliceInMemory(rowIndexes, columnsData, partitionRanges, 0, rowIndexes.size(), numRows, 0);
+        return arrow::Status::OK();
+    }
+
+    // Same slicing as slicePartition, on the range [begin, end) of the row indexes: sort by the current column and
+    // cut the sorted range into runs of sliceSize rows. The rows of a leaf stay sorted by the last column
+    void STRTreePartitioning::sliceInMemory(std::vector<uint64_t> &rowIndexes,
+                                            const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                                            std::vector<std::pair<size_t, size_t>> &partitionRanges,
+                                            size_t begin,
+                                            size_t end,
+                                            size_t sliceSize,
+                                            uint32_t columnIndex) {
+        // Base case: created a slice of size = partition size
+        if (sliceSize <= partitionSize) {
+            partitionRanges.emplace_back(begin, end);
+            return;
+        }
+
+        // Sort the slice by the current column
+        columnIndex = columnIndex % k;
+        const auto &values = *columnsData.at(columnIndex);
+        std::stable_sort(rowIndexes.begin() + begin, rowIndexes.begin() + end,
+                         [&values](uint64_t a, uint64_t b) { return values[a] < values[b]; });
+
+        // Update the slice size and recurse on every run
+        size_t numSliceRows = end - begin;
+        sliceSize = std::max(std::ceil(numSliceRows / S), (double) 1);
+        for (size_t sliceBegin = begin; sliceBegin < end; sliceBegin += sliceSize) {
+            size_t sliceEnd = std::min(sliceBegin + sliceSize, end);
+            sliceInMemory(rowIndexes, columnsData, partitionRanges, sliceBegin, sliceEnd, sliceSize, columnIndex + 1);
+        }
+    }
+}
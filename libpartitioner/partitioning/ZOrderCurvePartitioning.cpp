@@ -9,7 +9,11 @@ namespace partitioning {
          * 3. Sort-merge the sorted batches
         */
 
-        // Read the table in batches
+        // Record the progress, to resume from the last checkpoint if the run gets interrupted
+        ARROW_RETURN_NOT_OK(openJournal());
+
+        // Read the table in batches, decoding the next ones while the current one is processed
+        ARROW_ASSIGN_OR_RAISE(auto prefetchingReader, dataReader->getPrefetchingBatchReader());
         uint64_t batchId = 0;
         uint64_t totalNumRows = 0;
 
@@ -17,7 +21,7 @@ namespace partitioning {
 
             // Try to read a record batch
             std::shared_ptr<arrow::RecordBatch> record_batch;
-            ARROW_RETURN_NOT_OK(batchReader->ReadNext(&record_batch));
+            ARROW_RETURN_NOT_OK(prefetchingReader->ReadNext(&record_batch));
             if (record_batch == nullptr) {
                 break;
             }
@@ -25,58 +29,77 @@ namespace partitioning {
             totalNumRows += record_batch->num_rows();
 
             // Work on current batch
-            ARROW_RETURN_NOT_OK(partitionBatch(batchId, record_batch, dataReader));
+            // A resumed run skips the sorted runs already written
+            auto sortedRunPath = folder / ("s" + std::to_string(batchId) + fileExtension);
+            if (!isCheckpointed(sortedRunStep, sortedRunPath)) {
+                ARROW_RETURN_NOT_OK(partitionBatch(batchId, record_batch, dataReader));
+                ARROW_RETURN_NOT_OK(checkpoint(sortedRunStep, sortedRunPath));
+            }
             std::cout << "[ZOrderCurvePartitioning] Batch " << batchId << " completed" << std::endl;
             std::cout << "[ZOrderCurvePartitioning] Imported " << totalNumRows << " out of " << numRows << " rows" << std::endl;
             batchId += 1;
         }
         assert(totalNumRows == numRows);
         // Merge the files to create globally sorted partitions
-        ARROW_RETURN_NOT_OK(external::ExternalMerge::sortMergeFiles(folder, "z_order_curve", partitionSize));
+        // Files without a checkpoint are leftovers of an interrupted batch or merge, the merge starts over without them
+        if (!isCheckpointed(mergedStep)) {
+            discardUncheckpointedFiles(sortedRunStep);
+            ARROW_RETURN_NOT_OK(external::ExternalMerge::sortMergeFiles(folder, curveColumn, partitionSize));
+            ARROW_RETURN_NOT_OK(checkpoint(mergedStep));
+        }
         std::cout << "[ZOrderCurvePartitioning] Partitioning of " << batchId << " batches completed" << std::endl;
-        return arrow::Status::OK();
+        return finishRun();
     }
 
     arrow::Status ZOrderCurvePartitioning::partitionBatch(const uint64_t &batchId,
                                                            std::shared_ptr<arrow::RecordBatch> &recordBatch,
                                                            std::shared_ptr<storage::DataReader> &dataReader) {
+        // Add to the record batch the new column with the Z Order values
+        ARROW_ASSIGN_OR_RAISE(auto updatedRecordBatch, addCurveValues(recordBatch, columns));
+        std::cout << "[ZOrderCurvePartitioning] Added column with Z Order curve values " << std::endl;
+
+        // Write out a sorted batch
+        std::filesystem::path sortedBatchPath = folder / ("s" + std::to_string(batchId) + fileExtension);
+        ARROW_RETURN_NOT_OK(
+                external::ExternalSort::writeSortedBatch(updatedRecordBatch, curveColumn, sortedBatchPath));
+        return arrow::Status::OK();
+    }
+
+    // Compute the Z Order value of every row on the given columns, added as the first column of the batch.
+    // Shared with the append mode, which routes new rows by the same values
+    arrow::Result<std::shared_ptr<arrow::RecordBatch>> ZOrderCurvePartitioning::addCurveValues(
+            const std::shared_ptr<arrow::RecordBatch> &recordBatch,
+            const std::vector<std::string> &curveColumns) {
         std::vector<std::shared_ptr<arrow::Array>> batchColumns;
-        batchColumns.reserve(columns.size());
-        for (const auto &columnName: columns){
-            batchColumns.emplace_back(recordBatch->column(dataReader->getColumnIndex(columnName).ValueOrDie()));
+        batchColumns.reserve(curveColumns.size());
+        for (const auto &columnName: curveColumns){
+            auto batchColumn = recordBatch->GetColumnByName(columnName);
+            if (batchColumn == nullptr) {
+                return arrow::Status::Invalid("Column <", columnName, "> not found in batch");
+            }
+            batchColumns.emplace_back(batchColumn);
         }
-        auto converter = common::ColumnDataConverter();
-        auto columnData = converter.toInt64(batchColumns).ValueOrDie();
-        std::shared_ptr<arrow::Array> partitionIdsArrow;
-        auto batchNumRows = recordBatch->num_rows();
-        assert(columnData.size() == numColumns);
-        assert(batchNumRows == columnData[0]->size());
+        auto numCurveColumns = curveColumns.size();
 
-        // Columnar to row layout: vector of columns is transformed into a vector of points (rows)
-        std::vector<std::shared_ptr<common::Point>> rows = common::ColumnDataConverter::toRows(columnData);
+        // Columnar to row layout: the coordinates of every row are next to each other, as the encoder reads them
+        ARROW_ASSIGN_OR_RAISE(auto rows, common::ColumnDataConverter::toRows<int64_t>(batchColumns, common::ROW_MAJOR));
         std::vector<int64_t> zOrderValues = {};
+        zOrderValues.reserve(rows.size());
         auto zOrderCurve = structures::ZOrderCurve();
-        for (auto &row: rows){
-            double pointArr[numColumns];
-            std::copy(row->begin(), row->end(), pointArr);
-            uint64_t zOrderValue = zOrderCurve.encode(pointArr, (int) numColumns);
+        for (size_t i = 0; i < rows.size(); i++){
+            uint64_t zOrderValue = zOrderCurve.encode(rows.rowData(i), (int) numCurveColumns);
             zOrderValues.emplace_back(zOrderValue);
         }
 
-        // Add to the record batch the new column with the Z Order values
         arrow::Int64Builder int64Builder;
         ARROW_RETURN_NOT_OK(int64Builder.AppendValues(zOrderValues));
-        std::shared_ptr<arrow::Array> hilbertValuesArrow;
-        ARROW_ASSIGN_OR_RAISE(hilbertValuesArrow, int64Builder.Finish());
-        std::shared_ptr<arrow::RecordBatch> updatedRecordBatch;
-        ARROW_ASSIGN_OR_RAISE(updatedRecordBatch, recordBatch->AddColumn(0, "z_order_curve", hilbertValuesArrow));
-        std::cout << "[ZOrderCurvePartitioning] Added column with Z Order curve values " << std::endl;
+        std::shared_ptr<arrow::Array> zOrderValuesArrow;
+        ARROW_ASSIGN_OR_RAISE(zOrderValuesArrow, int64Builder.Finish());
+        return recordBatch->AddColumn(0, curveColumn, zOrderValuesArrow);
+    }
 
-        // Write out a sorted batch
-        std::filesystem::path sortedBatchPath = folder / ("s" + std::to_string(batchId) + fileExtension);
-        ARROW_RETURN_NOT_OK(
-                external::ExternalSort::writeSortedBatch(updatedRecordBatch, "z_order_curve", sortedBatchPath));
-        return arrow::Status::OK();
+    std::vector<std::string> ZOrderCurvePartitioning::getRoutingColumns() {
+        return {curveColumn};
     }
 
 }
\ No newline at end of file
@@ -0,0 +1,338 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#include <arrow/compute/api.h>
+
+#include "common/ColumnDataConverter.h"
+#include "query/LayoutCostModel.h"
+#include "structures/KDTree.h"
+#include "structures/QuadTree.h"
+
+namespace query {
+
+    LayoutCostModel::LayoutCostModel(const std::shared_ptr<storage::DataReader> &reader,
+                                     const std::vector<std::string> &partitionColumns,
+                                     size_t maxSampleSize) {
+        dataReader = reader;
+        columns = partitionColumns;
+        sampleSize = std::max(maxSampleSize, (size_t) 1);
+    }
+
+    size_t LayoutCostModel::getSampleSize() const {
+        return samplePoints.size();
+    }
+
+    // Algorithm L (Li, 1994): the positions kept are a uniform sample without replacement, the random skips make
+    // it cost O(k log(n / k)) instead of one draw per row. The seed is fixed, so the estimates are reproducible
+    std::vector<uint64_t> LayoutCostModel::drawSamplePositions() const {
+        auto reservoirSize = (uint64_t) std::min<uint64_t>(sampleSize, numRows);
+        std::vector<uint64_t> positions(reservoirSize);
+        std::iota(positions.begin(), positions.end(), 0);
+        if (reservoirSize == 0 || numRows <= reservoirSize) {
+            return positions;
+        }
+        std::mt19937_64 generator(common::Settings::samplingSeed);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+        std::uniform_int_distribution<uint64_t> slot(0, reservoirSize - 1);
+        // Draws in (0, 1], the logarithms stay finite
+        auto draw = [&generator, &uniform]() { return 1.0 - uniform(generator); };
+        double weight = std::exp(std::log(draw()) / (double) reservoirSize);
+        uint64_t position = reservoirSize - 1;
+        while (true) {
+            position += (uint64_t) std::floor(std::log(draw()) / std::log(1 - weight)) + 1;
+            if (position >= numRows) {
+                break;
+            }
+            positions[slot(generator)] = position;
+            weight *= std::exp(std::log(draw()) / (double) reservoirSize);
+        }
+        std::sort(positions.begin(), positions.end());
+        return positions;
+    }
+
+    arrow::Status LayoutCostModel::load() {
+        numRows = dataReader->getNumRows();
+        if (numRows == 0) {
+            return arrow::Status::Invalid("Cannot sample the empty dataset ", dataReader->getReaderPath().string());
+        }
+        bytesPerRow = (double) std::filesystem::file_size(dataReader->getReaderPath()) / (double) numRows;
+        std::vector<int> columnIndexes;
+        for (const auto &column: columns) {
+            ARROW_ASSIGN_OR_RAISE(auto columnIndex, dataReader->getColumnIndex(column));
+            if (columnIndex == -1) {
+                return arrow::Status::Invalid("Column <", column, "> not found");
+            }
+            columnIndexes.emplace_back(columnIndex);
+        }
+
+        // Gather the sampled rows, batch by batch, reading only the partitioning columns
+        auto positions = drawSamplePositions();
+        numSampledRows = positions.size();
+        ARROW_ASSIGN_OR_RAISE(auto batchReader, dataReader->getBatchReader(columnIndexes));
+        std::vector<std::shared_ptr<arrow::RecordBatch>> sampledBatches;
+        uint64_t batchOffset = 0;
+        auto nextPosition = positions.begin();
+        while (nextPosition != positions.end()) {
+            std::shared_ptr<arrow::RecordBatch> recordBatch;
+            ARROW_RETURN_NOT_OK(batchReader->ReadNext(&recordBatch));
+            if (recordBatch == nullptr) {
+                break;
+            }
+            uint64_t batchEnd = batchOffset + recordBatch->num_rows();
+            arrow::UInt64Builder indexesBuilder;
+            for (; nextPosition != positions.end() && *nextPosition < batchEnd; ++nextPosition) {
+                ARROW_RETURN_NOT_OK(indexesBuilder.Append(*nextPosition - batchOffset));
+            }
+            if (indexesBuilder.length() > 0) {
+                ARROW_ASSIGN_OR_RAISE(auto indexes, indexesBuilder.Finish());
+                ARROW_ASSIGN_OR_RAISE(auto sampledBatch, arrow::compute::Take(recordBatch, indexes));
+                sampledBatches.emplace_back(sampledBatch.record_batch());
+            }
+            batchOffset = batchEnd;
+        }
+        if (sampledBatches.empty()) {
+            return arrow::Status::Invalid("No rows sampled from ", dataReader->getReaderPath().string());
+        }
+        ARROW_ASSIGN_OR_RAISE(auto sampleTable, arrow::Table::FromRecordBatches(sampledBatches));
+        // Rows with nulls cannot be placed by the splits, they are left out of the sample
+        ARROW_ASSIGN_OR_RAISE(auto nonNullTable, arrow::compute::DropNull(sampleTable));
+        ARROW_ASSIGN_OR_RAISE(sampleBatch, nonNullTable.table()->CombineChunksToBatch());
+        if (sampleBatch->num_rows() == 0) {
+            return arrow::Status::Invalid("Partitioning columns of ", dataReader->getReaderPath().string(),
+                                          " only hold nulls in the sample");
+        }
+
+        std::vector<std::shared_ptr<arrow::Array>> sampleColumns;
+        for (const auto &column: columns) {
+            sampleColumns.emplace_back(sampleBatch->GetColumnByName(column));
+        }
+        ARROW_ASSIGN_OR_RAISE(samplePoints, common::ColumnDataConverter::toRows(sampleColumns));
+        std::cout << "[LayoutCostModel] Sampled " << samplePoints.size() << " out of " << numRows << " rows" << std::endl;
+        return arrow::Status::OK();
+    }
+
+    std::vector<LayoutCostModel::Points> LayoutCostModel::splitKDTree(size_t leafSize) {
+        auto tree = structures::KDTree(samplePoints, leafSize);
+        std::vector<Points> groups;
+        for (const auto &leaf: tree.getLeaves()) {
+            groups.emplace_back(leaf->data);
+        }
+        return groups;
+    }
+
+    std::vector<LayoutCostModel::Points> LayoutCostModel::splitQuadTree(size_t leafSize) {
+        auto tree = structures::QuadTree(samplePoints, leafSize, columns.size());
+        std::vector<Points> groups;
+        for (const auto &leaf: tree.getLeaves()) {
+            groups.emplace_back(leaf->data);
+        }
+        return groups;
+    }
+
+    // Same slicing as the STR tree scheme: P leaves, S = ceil(sqrt(P)) slices per column, in turn
+    std::vector<LayoutCostModel::Points> LayoutCostModel::splitSTRTree(size_t leafSize) {
+        auto points = samplePoints.getRowIds();
+        auto numLeaves = std::max(points.size() / leafSize, (size_t) 1);
+        auto numSlices = (size_t) std::ceil(std::sqrt((double) numLeaves));
+        std::vector<Points> groups;
+        sliceSTR(points, 0, points.size(), points.size(), leafSize, numSlices, 0, groups);
+        return groups;
+    }
+
+    void LayoutCostModel::sliceSTR(Points &points, size_t begin, size_t end, size_t sliceSize, size_t leafSize,
+                                   size_t numSlices, uint32_t columnIndex, std::vector<Points> &groups) {
+        if (sliceSize <= leafSize) {
+            groups.emplace_back(points.begin() + (int64_t) begin, points.begin() + (int64_t) end);
+            return;
+        }
+        columnIndex = columnIndex % columns.size();
+        samplePoints.sortRows(points.begin() + (int64_t) begin, points.begin() + (int64_t) end, columnIndex,
+                              /*stable=*/true);
+        sliceSize = std::max((size_t) std::ceil((double) (end - begin) / (double) numSlices), (size_t) 1);
+        for (size_t sliceBegin = begin; sliceBegin < end; sliceBegin += sliceSize) {
+            size_t sliceEnd = std::min(sliceBegin + sliceSize, end);
+            sliceSTR(points, sliceBegin, sliceEnd, sliceSize, leafSize, numSlices, columnIndex + 1, groups);
+        }
+    }
+
+    // Same halving of the linear scales as the grid file scheme, starting from the ranges of the sample
+    std::vector<LayoutCostModel::Points> LayoutCostModel::splitGridFile(size_t leafSize) {
+        auto points = samplePoints.getRowIds();
+        std::vector<std::pair<double, double>> dimensionRanges(columns.size(),
+                                                               {std::numeric_limits<double>::max(),
+                                                                std::numeric_limits<double>::lowest()});
+        for (const auto &point: samplePoints) {
+            for (size_t i = 0; i < columns.size(); ++i) {
+                dimensionRanges[i].first = std::min(dimensionRanges[i].first, point[i]);
+                dimensionRanges[i].second = std::max(dimensionRanges[i].second, point[i]);
+            }
+        }
+        std::vector<Points> groups;
+        halveGridCell(points, 0, points.size(), leafSize, 0, dimensionRanges, groups);
+        return groups;
+    }
+
+    void LayoutCostModel::halveGridCell(Points &points, size_t begin, size_t end, size_t leafSize, uint32_t depth,
+                                        std::vector<std::pair<double, double>> dimensionRanges,
+                                        std::vector<Points> &groups) {
+        if (begin == end) {
+            return;
+        }
+        if (end - begin <= leafSize || depth > maxGridFileDepth) {
+            groups.emplace_back(points.begin() + (int64_t) begin, points.begin() + (int64_t) end);
+            return;
+        }
+        uint32_t columnIndex = depth % columns.size();
+        double midValue = (dimensionRanges[columnIndex].first + dimensionRanges[columnIndex].second) / 2;
+        auto splitPosition = std::stable_partition(points.begin() + (int64_t) begin, points.begin() + (int64_t) end,
+                                                   [this, columnIndex, midValue](uint32_t rowId) {
+                                                       return samplePoints.value(rowId, columnIndex) <= midValue;
+                                                   });
+        size_t split = splitPosition - points.begin();
+        auto lowerRanges = dimensionRanges;
+        lowerRanges[columnIndex].second = midValue;
+        dimensionRanges[columnIndex].first = midValue;
+        halveGridCell(points, begin, split, leafSize, depth + 1, lowerRanges, groups);
+        halveGridCell(points, split, end, leafSize, depth + 1, dimensionRanges, groups);
+    }
+
+    // Cell index of every sampled row, with the cell width and domains the fixed grid scheme derives from the dataset
+    arrow::Result<std::shared_ptr<arrow::RecordBatch>> LayoutCostModel::addFixedGridKeys() {
+        std::vector<double_t> columnDomains;
+        double_t maxColumnDomain = 0;
+        for (const auto &column: columns) {
+            ARROW_ASSIGN_OR_RAISE(auto columnStats, dataReader->getColumnStats(column));
+            double_t columnDomain = std::max(columnStats.second - columnStats.first, 1.0) * 1.1;
+            columnDomains.emplace_back(columnDomain);
+            maxColumnDomain = std::max(maxColumnDomain, columnDomain);
+        }
+        return partitioning::FixedGridPartitioning::addCellIndexes(sampleBatch, columns, maxColumnDomain / 10,
+                                                                   columnDomains);
+    }
+
+    // Curve and grid schemes: rows sorted by the key in the first column, cut into runs of the partition size
+    arrow::Result<std::vector<LayoutCostModel::Points>> LayoutCostModel::splitByKey(
+            const std::shared_ptr<arrow::RecordBatch> &keyedBatch, size_t leafSize) {
+        ARROW_ASSIGN_OR_RAISE(auto sortIndexes, arrow::compute::SortIndices(*keyedBatch->column(0)));
+        auto sortedIndexes = std::static_pointer_cast<arrow::UInt64Array>(sortIndexes);
+        std::vector<Points> groups;
+        for (int64_t begin = 0; begin < sortedIndexes->length(); begin += (int64_t) leafSize) {
+            auto end = std::min(begin + (int64_t) leafSize, sortedIndexes->length());
+            Points group;
+            for (int64_t i = begin; i < end; ++i) {
+                group.emplace_back((uint32_t) sortedIndexes->Value(i));
+            }
+            groups.emplace_back(group);
+        }
+        return groups;
+    }
+
+    arrow::Result<SampledLayout> LayoutCostModel::buildLayout(partitioning::PartitioningScheme scheme,
+                                                              size_t partitionSize) {
+        if (samplePoints.empty()) {
+            return arrow::Status::Invalid("The cost model has no sample, call load() first");
+        }
+        // Partition size scaled to the sample, at least one sampled row per partition
+        auto scale = (double) numSampledRows / (double) numRows;
+        auto leafSize = std::max((size_t) std::llround((double) partitionSize * scale), (size_t) 1);
+
+        std::vector<Points> groups;
+        switch (scheme) {
+            case partitioning::NO_PARTITION:
+                groups.emplace_back(samplePoints.getRowIds());
+                break;
+            case partitioning::KD_TREE:
+                groups = splitKDTree(leafSize);
+                break;
+            case partitioning::QUAD_TREE:
+                groups = splitQuadTree(leafSize);
+                break;
+            case partitioning::STR_TREE:
+                groups = splitSTRTree(leafSize);
+                break;
+            case partitioning::GRID_FILE:
+                groups = splitGridFile(leafSize);
+                break;
+            case partitioning::FIXED_GRID: {
+                ARROW_ASSIGN_OR_RAISE(auto keyedBatch, addFixedGridKeys());
+                ARROW_ASSIGN_OR_RAISE(groups, splitByKey(keyedBatch, leafSize));
+                break;
+            }
+            case partitioning::HILBERT_CURVE: {
+                ARROW_ASSIGN_OR_RAISE(auto keyedBatch, partitioning::HilbertCurvePartitioning::addCurveValues(sampleBatch, columns));
+                ARROW_ASSIGN_OR_RAISE(groups, splitByKey(keyedBatch, leafSize));
+                break;
+            }
+            case partitioning::Z_ORDER_CURVE: {
+                ARROW_ASSIGN_OR_RAISE(auto keyedBatch, partitioning::ZOrderCurvePartitioning::addCurveValues(sampleBatch, columns));
+                ARROW_ASSIGN_OR_RAISE(groups, splitByKey(keyedBatch, leafSize));
+                break;
+            }
+            default:
+                return arrow::Status::NotImplemented("No cost model for the scheme ", scheme);
+        }
+
+        // Every sampled row stands for numRows / numSampledRows rows of the dataset
+        SampledLayout layout;
+        layout.scheme = scheme;
+        layout.partitionSize = partitionSize;
+        for (const auto &group: groups) {
+            if (group.empty()) {
+                continue;
+            }
+            structures::PartitionRegion region;
+            region.lower = samplePoints[group.front()].toVector();
+            region.upper = region.lower;
+            for (auto rowId: group) {
+                for (size_t i = 0; i < region.lower.size(); ++i) {
+                    region.lower[i] = std::min(region.lower[i], samplePoints.value(rowId, i));
+                    region.upper[i] = std::max(region.upper[i], samplePoints.value(rowId, i));
+                }
+            }
+            layout.regions.emplace_back(region);
+            layout.regionRows.emplace_back((double) group.size() / scale);
+        }
+        std::cout << "[LayoutCostModel] Built " << layout.regions.size() << " "
+                  << partitioning::mapSchemeToName.at(scheme) << " partitions of " << leafSize << " sampled rows"
+                  << std::endl;
+        return layout;
+    }
+
+    // Only the ranges on the partitioning columns prune, as for the manifest in the pruner
+    LayoutEstimate LayoutCostModel::estimate(const SampledLayout &layout, const RangePredicate &predicate) const {
+        std::vector<std::pair<size_t, const ColumnRange *>> boundedRanges;
+        for (const auto &range: predicate) {
+            auto column = std::find(columns.begin(), columns.end(), range.column);
+            if (column != columns.end()) {
+                boundedRanges.emplace_back(column - columns.begin(), &range);
+            }
+        }
+        LayoutEstimate layoutEstimate;
+        layoutEstimate.totalPartitions = layout.regions.size();
+        for (size_t p = 0; p < layout.regions.size(); ++p) {
+            const auto &region = layout.regions[p];
+            bool overlaps = std::all_of(boundedRanges.begin(), boundedRanges.end(), [&region](const auto &boundedRange) {
+                const auto &[columnIndex, range] = boundedRange;
+                return range->overlaps(region.lower[columnIndex], region.upper[columnIndex]);
+            });
+            if (overlaps) {
+                layoutEstimate.numPartitions += 1;
+                layoutEstimate.numRows += layout.regionRows[p];
+            }
+        }
+        layoutEstimate.numBytes = layoutEstimate.numRows * bytesPerRow;
+        auto matchingPoints = std::count_if(samplePoints.begin(), samplePoints.end(), [&boundedRanges](const auto &point) {
+            return std::all_of(boundedRanges.begin(), boundedRanges.end(), [&point](const auto &boundedRange) {
+                const auto &[columnIndex, range] = boundedRange;
+                return range->overlaps(point[columnIndex], point[columnIndex]);
+            });
+        });
+        layoutEstimate.matchingRows = (double) matchingPoints * (double) numRows / (double) numSampledRows;
+        return layoutEstimate;
+    }
+
+}
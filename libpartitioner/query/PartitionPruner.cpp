@@ -0,0 +1,409 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <type_traits>
+
+#include <arrow/io/file.h>
+#include <parquet/exception.h>
+#include <parquet/file_reader.h>
+#include <parquet/metadata.h>
+#include <parquet/arrow/schema.h>
+#include <parquet/page_index.h>
+#include <parquet/properties.h>
+#include <parquet/schema.h>
+#include <parquet/statistics.h>
+
+#include "query/PartitionPruner.h"
+#include "storage/ColumnStatistics.h"
+
+namespace query {
+
+    bool ColumnRange::overlaps(double minValue, double maxValue) const {
+        // An empty partition (or a column with only nulls) has min > max and matches nothing
+        if (minValue > maxValue) {
+            return false;
+        }
+        if (maxValue < lower || (maxValue == lower && !lowerInclusive)) {
+            return false;
+        }
+        if (minValue > upper || (minValue == upper && !upperInclusive)) {
+            return false;
+        }
+        return true;
+    }
+
+    bool ColumnRange::isEquality() const {
+        return lower == upper && lowerInclusive && upperInclusive;
+    }
+
+    PartitionPruner::PartitionPruner(const std::filesystem::path &partitionedFolder) {
+        folder = partitionedFolder;
+    }
+
+    arrow::Status PartitionPruner::load() {
+        ARROW_ASSIGN_OR_RAISE(manifest, structures::PartitionManifest::load(folder));
+        columnIndexes.clear();
+        for (size_t i = 0; i < manifest.columns.size(); ++i) {
+            columnIndexes.emplace(manifest.columns[i], i);
+        }
+        auto numColumns = manifest.columns.size();
+        partitionBounds.assign(manifest.partitions.size() * numColumns * 2, 0);
+        for (size_t p = 0; p < manifest.partitions.size(); ++p) {
+            const auto &partition = manifest.partitions[p];
+            for (size_t i = 0; i < numColumns; ++i) {
+                partitionBounds[(p * numColumns + i) * 2] = partition.min.at(i);
+                partitionBounds[(p * numColumns + i) * 2 + 1] = partition.max.at(i);
+            }
+        }
+        std::lock_guard<std::mutex> lock(footerCacheMutex);
+        footerCache.clear();
+        std::cout << "[PartitionPruner] Loaded bounds of " << manifest.partitions.size() << " partitions from "
+                  << folder << std::endl;
+        return arrow::Status::OK();
+    }
+
+    size_t PartitionPruner::getNumPartitions() const {
+        return manifest.partitions.size();
+    }
+
+    // One pass over the flat bounds, only the predicate columns that are partitioning columns can prune
+    std::vector<uint32_t> PartitionPruner::prunePartitions(const RangePredicate &predicate) const {
+        std::vector<std::pair<size_t, const ColumnRange *>> boundedRanges;
+        for (const auto &range: predicate) {
+            auto columnIndex = columnIndexes.find(range.column);
+            if (columnIndex != columnIndexes.end()) {
+                boundedRanges.emplace_back(columnIndex->second, &range);
+            }
+        }
+        auto numColumns = manifest.columns.size();
+        std::vector<uint32_t> partitionIds;
+        for (size_t p = 0; p < manifest.partitions.size(); ++p) {
+            if (manifest.partitions[p].numRows == 0) {
+                continue;
+            }
+            const double *bounds = partitionBounds.data() + p * numColumns * 2;
+            bool matches = true;
+            for (const auto &[columnIndex, range]: boundedRanges) {
+                if (!range->overlaps(bounds[columnIndex * 2], bounds[columnIndex * 2 + 1])) {
+                    matches = false;
+                    break;
+                }
+            }
+            if (matches) {
+                partitionIds.emplace_back((uint32_t) p);
+            }
+        }
+        return partitionIds;
+    }
+
+    arrow::Result<std::vector<PartitionMatch>> PartitionPruner::prune(const RangePredicate &predicate) {
+        std::vector<PartitionMatch> matches;
+        for (const auto &partitionId: prunePartitions(predicate)) {
+            ARROW_ASSIGN_OR_RAISE(auto footerStats, getFooterStats(partitionId));
+            PartitionMatch match;
+            match.partitionId = partitionId;
+            match.file = folder / manifest.partitions[partitionId].fileName;
+            if (footerStats->bloomFilters) {
+                bool mightMatch = std::all_of(predicate.begin(), predicate.end(), [&footerStats](const auto &range) {
+                    return !range.isEquality() || footerStats->bloomFilters->mightContain(range.column, range.lower);
+                });
+                if (!mightMatch) {
+                    continue;
+                }
+            }
+            for (int rowGroup = 0; rowGroup < footerStats->numRowGroups; ++rowGroup) {
+                bool matchesRowGroup = true;
+                for (const auto &range: predicate) {
+                    auto columnBounds = footerStats->columnBounds.find(range.column);
+                    if (columnBounds == footerStats->columnBounds.end()) {
+                        continue;
+                    }
+                    const auto &[minValue, maxValue] = columnBounds->second[rowGroup];
+                    if (!range.overlaps(minValue, maxValue)) {
+                        matchesRowGroup = false;
+                        break;
+                    }
+                }
+                if (matchesRowGroup) {
+                    match.rowGroups.emplace_back(rowGroup);
+                    match.numRows += footerStats->rowGroupRows[rowGroup];
+                    match.numBytes += footerStats->rowGroupBytes[rowGroup];
+                    countPages(*footerStats, predicate, rowGroup, match);
+                }
+            }
+            if (!match.rowGroups.empty()) {
+                matches.emplace_back(match);
+            }
+        }
+        return matches;
+    }
+
+    // Pages are counted once per predicate column, a page is skipped when one of the ranges on its column excludes it
+    void PartitionPruner::countPages(const FooterStats &footerStats, const RangePredicate &predicate, int rowGroup,
+                                     PartitionMatch &match) {
+        std::set<std::string> countedColumns;
+        for (const auto &range: predicate) {
+            auto pageBounds = footerStats.pageBounds.find(range.column);
+            if (pageBounds == footerStats.pageBounds.end() || !countedColumns.insert(range.column).second) {
+                continue;
+            }
+            for (const auto &[minValue, maxValue]: pageBounds->second[rowGroup]) {
+                bool skipped = std::any_of(predicate.begin(), predicate.end(), [&](const auto &columnRange) {
+                    return columnRange.column == range.column && !columnRange.overlaps(minValue, maxValue);
+                });
+                match.numPages += 1;
+                match.numSkippedPages += skipped;
+            }
+        }
+    }
+
+    arrow::Result<std::shared_ptr<PartitionPruner::FooterStats>> PartitionPruner::getFooterStats(uint32_t partitionId) {
+        {
+            std::lock_guard<std::mutex> lock(footerCacheMutex);
+            auto cached = footerCache.find(partitionId);
+            if (cached != footerCache.end()) {
+                return cached->second;
+            }
+        }
+        ARROW_ASSIGN_OR_RAISE(auto footerStats, readFooterStats(folder / manifest.partitions[partitionId].fileName));
+        std::lock_guard<std::mutex> lock(footerCacheMutex);
+        footerCache.emplace(partitionId, footerStats);
+        return footerStats;
+    }
+
+    template<typename ColumnIndexType, typename ValueType>
+    static std::vector<std::pair<double, double>> getTypedPageBounds(const std::shared_ptr<parquet::ColumnIndex> &columnIndex,
+                                                                     bool isUnsigned) {
+        auto typedColumnIndex = std::static_pointer_cast<ColumnIndexType>(columnIndex);
+        const auto &nullPages = typedColumnIndex->null_pages();
+        const auto &minValues = typedColumnIndex->min_values();
+        const auto &maxValues = typedColumnIndex->max_values();
+        std::vector<std::pair<double, double>> bounds;
+        bounds.reserve(nullPages.size());
+        for (size_t page = 0; page < nullPages.size(); ++page) {
+            if (nullPages[page]) {
+                // Only nulls, no range predicate matches them
+                bounds.emplace_back(std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity());
+                continue;
+            }
+            if constexpr (std::is_integral_v<ValueType>) {
+                if (isUnsigned) {
+                    using UnsignedType = std::make_unsigned_t<ValueType>;
+                    bounds.emplace_back((double) (UnsignedType) minValues[page], (double) (UnsignedType) maxValues[page]);
+                    continue;
+                }
+            }
+            bounds.emplace_back((double) minValues[page], (double) maxValues[page]);
+        }
+        return bounds;
+    }
+
+    static std::vector<std::pair<double, double>> getStoredPageBounds(const parquet::ColumnDescriptor *descriptor,
+                                                                      const std::shared_ptr<parquet::ColumnIndex> &columnIndex) {
+        bool isUnsigned = descriptor->sort_order() == parquet::SortOrder::UNSIGNED;
+        switch (descriptor->physical_type()) {
+            case parquet::Type::INT32:
+                return getTypedPageBounds<parquet::Int32ColumnIndex, int32_t>(columnIndex, isUnsigned);
+            case parquet::Type::INT64:
+                return getTypedPageBounds<parquet::Int64ColumnIndex, int64_t>(columnIndex, isUnsigned);
+            case parquet::Type::FLOAT:
+                return getTypedPageBounds<parquet::FloatColumnIndex, float>(columnIndex, false);
+            case parquet::Type::DOUBLE:
+                return getTypedPageBounds<parquet::DoubleColumnIndex, double>(columnIndex, false);
+            default:
+                return {};
+        }
+    }
+
+    // Min/max of the pages of a column chunk, in the domain of the Arrow type as the row group bounds. Empty for
+    // the types without bounds usable as numbers and for decimals
+    static std::vector<std::pair<double, double>> getPageBounds(const parquet::ColumnDescriptor *descriptor,
+                                                                const arrow::DataType &type,
+                                                                const std::shared_ptr<parquet::ColumnIndex> &columnIndex) {
+        if (!columnIndex || arrow::is_decimal(type.id())) {
+            return {};
+        }
+        auto bounds = getStoredPageBounds(descriptor, columnIndex);
+        for (auto &[minValue, maxValue]: bounds) {
+            // Pages of nulls only keep their empty range
+            if (minValue <= maxValue) {
+                minValue = storage::ColumnStatistics::toArrowDomain(*descriptor, type, minValue);
+                maxValue = storage::ColumnStatistics::toArrowDomain(*descriptor, type, maxValue);
+            }
+        }
+        return bounds;
+    }
+
+    // Only the footer, the page index and the bloom filter file are read, never the pages
+    arrow::Result<std::shared_ptr<PartitionPruner::FooterStats>> PartitionPruner::readFooterStats(const std::filesystem::path &partitionFile) {
+        ARROW_ASSIGN_OR_RAISE(auto input, arrow::io::ReadableFile::Open(partitionFile.string()));
+        std::shared_ptr<parquet::FileMetaData> fileMetadata;
+        std::shared_ptr<parquet::PageIndexReader> pageIndexReader;
+        std::unique_ptr<parquet::ParquetFileReader> fileReader;
+        try {
+            fileReader = parquet::ParquetFileReader::Open(input);
+            fileMetadata = fileReader->metadata();
+            pageIndexReader = fileReader->GetPageIndexReader();
+        } catch (const parquet::ParquetException &exception) {
+            return arrow::Status::IOError("Could not read the footer of ", partitionFile.string(), ": ",
+                                          exception.what());
+        }
+        auto footerStats = std::make_shared<FooterStats>();
+        footerStats->numRowGroups = fileMetadata->num_row_groups();
+        for (int rowGroup = 0; rowGroup < footerStats->numRowGroups; ++rowGroup) {
+            auto rowGroupMetadata = fileMetadata->RowGroup(rowGroup);
+            footerStats->rowGroupRows.emplace_back(rowGroupMetadata->num_rows());
+            footerStats->rowGroupBytes.emplace_back(rowGroupMetadata->total_compressed_size());
+        }
+        // The bounds are compared in the domain of the Arrow types restored by the readers (timestamps in their
+        // unit, date64 in milliseconds), as the statistics of the DataReader and the bounds of the manifest
+        const auto *schemaDescriptor = fileMetadata->schema();
+        std::shared_ptr<arrow::Schema> arrowSchema;
+        ARROW_RETURN_NOT_OK(parquet::arrow::FromParquetSchema(schemaDescriptor, parquet::default_arrow_reader_properties(),
+                                                              fileMetadata->key_value_metadata(), &arrowSchema));
+        auto unbounded = std::make_pair(-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity());
+        for (const auto &field: arrowSchema->fields()) {
+            // Nested columns have no single leaf to take the bounds from
+            if (schemaDescriptor->ColumnIndex(field->name()) < 0) {
+                continue;
+            }
+            auto &bounds = footerStats->columnBounds[field->name()];
+            bounds.reserve(footerStats->numRowGroups);
+            for (int rowGroup = 0; rowGroup < footerStats->numRowGroups; ++rowGroup) {
+                ARROW_ASSIGN_OR_RAISE(auto rowGroupBounds,
+                                      storage::ColumnStatistics::getRowGroupBounds(*fileMetadata, field, rowGroup));
+                bounds.emplace_back(rowGroupBounds.value_or(unbounded));
+            }
+        }
+        if (pageIndexReader) {
+            try {
+                for (int rowGroup = 0; rowGroup < footerStats->numRowGroups; ++rowGroup) {
+                    auto rowGroupIndexReader = pageIndexReader->RowGroup(rowGroup);
+                    for (int c = 0; rowGroupIndexReader && c < fileMetadata->num_columns(); ++c) {
+                        const auto *descriptor = schemaDescriptor->Column(c);
+                        auto field = arrowSchema->GetFieldByName(descriptor->name());
+                        if (field == nullptr) {
+                            continue;
+                        }
+                        auto pageBounds = getPageBounds(descriptor, *field->type(), rowGroupIndexReader->GetColumnIndex(c));
+                        if (pageBounds.empty()) {
+                            continue;
+                        }
+                        auto &columnPageBounds = footerStats->pageBounds[descriptor->name()];
+                        columnPageBounds.resize(footerStats->numRowGroups);
+                        columnPageBounds[rowGroup] = std::move(pageBounds);
+                    }
+                }
+            } catch (const parquet::ParquetException &exception) {
+                return arrow::Status::IOError("Could not read the page index of ", partitionFile.string(), ": ",
+                                              exception.what());
+            }
+        }
+        if (storage::BloomFilterIndex::exists(partitionFile)) {
+            ARROW_ASSIGN_OR_RAISE(footerStats->bloomFilters, storage::BloomFilterIndex::load(partitionFile));
+        }
+        return footerStats;
+    }
+
+    static std::string trim(const std::string &text) {
+        auto begin = text.find_first_not_of(" \t\r\n");
+        if (begin == std::string::npos) {
+            return "";
+        }
+        auto end = text.find_last_not_of(" \t\r\n");
+        return text.substr(begin, end - begin + 1);
+    }
+
+    static std::string unquote(const std::string &text) {
+        if (text.size() >= 2 && (text.front() == '\'' || text.front() == '"') && text.back() == text.front()) {
+            return text.substr(1, text.size() - 2);
+        }
+        return text;
+    }
+
+    // Days since the epoch of a YYYY-MM-DD date, the value of a date32 column
+    static bool parseDate(const std::string &text, double &days) {
+        int year, month, day;
+        char separator1, separator2;
+        std::istringstream dateStream(text);
+        if (!(dateStream >> year >> separator1 >> month >> separator2 >> day) || separator1 != '-' || separator2 != '-') {
+            return false;
+        }
+        year -= month <= 2;
+        int era = (year >= 0 ? year : year - 399) / 400;
+        int yearOfEra = year - era * 400;
+        int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        days = era * 146097 + dayOfEra - 719468;
+        return true;
+    }
+
+    static arrow::Result<double> parseLiteral(const std::string &literal) {
+        auto value = trim(literal);
+        std::string lowerValue = value;
+        std::transform(lowerValue.begin(), lowerValue.end(), lowerValue.begin(), ::tolower);
+        if (lowerValue.rfind("date ", 0) == 0) {
+            double days;
+            if (parseDate(unquote(trim(value.substr(5))), days)) {
+                return days;
+            }
+            return arrow::Status::Invalid("Invalid date literal <", literal, ">");
+        }
+        value = unquote(value);
+        try {
+            size_t parsedLength = 0;
+            double number = std::stod(value, &parsedLength);
+            if (parsedLength == value.size()) {
+                return number;
+            }
+        } catch (const std::exception &) {}
+        return arrow::Status::Invalid("Predicate value <", trim(literal), "> is not a number");
+    }
+
+    arrow::Result<RangePredicate> PartitionPruner::parsePredicate(const std::string &whereClause) {
+        std::vector<std::string> terms;
+        std::string lowerClause = whereClause;
+        std::transform(lowerClause.begin(), lowerClause.end(), lowerClause.begin(), ::tolower);
+        size_t termStart = 0;
+        for (size_t position = 0; position + 3 <= lowerClause.size(); ++position) {
+            bool isSeparated = (position == 0 || std::isspace(lowerClause[position - 1])) &&
+                               (position + 3 == lowerClause.size() || std::isspace(lowerClause[position + 3]));
+            if (isSeparated && lowerClause.compare(position, 3, "and") == 0) {
+                terms.emplace_back(whereClause.substr(termStart, position - termStart));
+                termStart = position + 3;
+            }
+        }
+        terms.emplace_back(whereClause.substr(termStart));
+
+        RangePredicate predicate;
+        for (const auto &term: terms) {
+            auto operatorPosition = term.find_first_of("<>=");
+            if (operatorPosition == std::string::npos) {
+                return arrow::Status::Invalid("Predicate term <", trim(term), "> is not a comparison");
+            }
+            auto operatorLength = (operatorPosition + 1 < term.size() && term[operatorPosition + 1] == '=') ? 2 : 1;
+            auto comparison = term.substr(operatorPosition, operatorLength);
+            ColumnRange range;
+            range.column = unquote(trim(term.substr(0, operatorPosition)));
+            ARROW_ASSIGN_OR_RAISE(auto value, parseLiteral(term.substr(operatorPosition + operatorLength)));
+            if (comparison == ">" || comparison == ">=") {
+                range.lower = value;
+                range.lowerInclusive = comparison == ">=";
+            } else if (comparison == "<" || comparison == "<=") {
+                range.upper = value;
+                range.upperInclusive = comparison == "<=";
+            } else if (comparison == "=" || comparison == "==") {
+                range.lower = value;
+                range.upper = value;
+            } else {
+                return arrow::Status::Invalid("Unsupported comparison <", comparison, ">");
+            }
+            predicate.emplace_back(range);
+        }
+        return predicate;
+    }
+
+}
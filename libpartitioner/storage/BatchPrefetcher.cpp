@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <iostream>
+
+#include "storage/BatchPrefetcher.h"
+
+namespace storage {
+
+    BatchPrefetcher::BatchPrefetcher(std::shared_ptr<arrow::RecordBatchReader> sourceReader, size_t queueDepth) {
+        source = std::move(sourceReader);
+        maxQueuedBatches = std::max(queueDepth, (size_t) 1);
+        prefetchThread = std::thread([this]() { prefetchLoop(); });
+    }
+
+    BatchPrefetcher::~BatchPrefetcher() {
+        stop();
+    }
+
+    std::shared_ptr<arrow::Schema> BatchPrefetcher::schema() const {
+        return source->schema();
+    }
+
+    // Background thread: keep the queue filled until the source is exhausted, fails or the reader is closed
+    void BatchPrefetcher::prefetchLoop() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(queueMutex);
+                queueNotFull.wait(lock, [this]() { return stopping || queue.size() < maxQueuedBatches; });
+                if (stopping) {
+                    break;
+                }
+            }
+            std::shared_ptr<arrow::RecordBatch> batch;
+            auto start = std::chrono::steady_clock::now();
+            auto status = source->ReadNext(&batch);
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            std::lock_guard<std::mutex> lock(queueMutex);
+            decodeTime += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed);
+            if (!status.ok() || batch == nullptr) {
+                sourceStatus = status;
+                sourceFinished = true;
+                queueNotEmpty.notify_all();
+                break;
+            }
+            queue.emplace_back(std::move(batch));
+            queueNotEmpty.notify_one();
+        }
+    }
+
+    arrow::Status BatchPrefetcher::ReadNext(std::shared_ptr<arrow::RecordBatch> *batch) {
+        auto start = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock(queueMutex);
+        queueNotEmpty.wait(lock, [this]() { return stopping || sourceFinished || !queue.empty(); });
+        waitTime += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        if (!queue.empty()) {
+            *batch = std::move(queue.front());
+            queue.pop_front();
+            numBatches += 1;
+            queueNotFull.notify_one();
+            return arrow::Status::OK();
+        }
+        // End of stream (or error): the queue has been drained
+        *batch = nullptr;
+        if (sourceFinished && sourceStatus.ok()) {
+            std::cout << "[BatchPrefetcher] Read " << numBatches << " batches, decode time " << getDecodeSeconds()
+                      << " s, wait time " << getWaitSeconds() << " s, overlap " << getOverlap() * 100 << " %"
+                      << std::endl;
+        }
+        return sourceStatus;
+    }
+
+    arrow::Status BatchPrefetcher::Close() {
+        stop();
+        return source->Close();
+    }
+
+    void BatchPrefetcher::stop() {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            stopping = true;
+            queue.clear();
+        }
+        queueNotFull.notify_all();
+        queueNotEmpty.notify_all();
+        if (prefetchThread.joinable()) {
+            prefetchThread.join();
+        }
+    }
+
+    double BatchPrefetcher::getDecodeSeconds() {
+        return std::chrono::duration<double>(decodeTime).count();
+    }
+
+    double BatchPrefetcher::getWaitSeconds() {
+        return std::chrono::duration<double>(waitTime).count();
+    }
+
+    double BatchPrefetcher::getOverlap() {
+        if (decodeTime.count() == 0) {
+            return 1;
+        }
+        double waitedFraction = getWaitSeconds() / getDecodeSeconds();
+        return std::clamp(1 - waitedFraction, 0.0, 1.0);
+    }
+
+} // storage
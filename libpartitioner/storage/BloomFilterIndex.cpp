@@ -0,0 +1,170 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+
+#include <arrow/compute/api.h>
+#include <arrow/io/memory.h>
+#include <parquet/properties.h>
+
+#include "storage/BloomFilterIndex.h"
+#include "storage/DataReader.h"
+
+namespace storage {
+
+    std::filesystem::path BloomFilterIndex::getPath(const std::filesystem::path &partitionFile) {
+        return partitionFile.string() + fileSuffix;
+    }
+
+    bool BloomFilterIndex::exists(const std::filesystem::path &partitionFile) {
+        return std::filesystem::exists(getPath(partitionFile));
+    }
+
+    // Layout: magic, number of columns, then per column its name, whether it is hashed as integer and the filter
+    // serialized as in a Parquet file (header + bitset)
+    arrow::Status BloomFilterIndex::write(const std::filesystem::path &partitionFile,
+                                          const std::vector<std::string> &filterColumns,
+                                          double falsePositiveProbability) {
+        auto partitionPath = partitionFile;
+        auto partitionReader = std::make_shared<storage::DataReader>();
+        ARROW_RETURN_NOT_OK(partitionReader->load(partitionPath));
+        std::vector<std::string> presentColumns;
+        for (const auto &column: filterColumns) {
+            ARROW_ASSIGN_OR_RAISE(auto columnIndex, partitionReader->getColumnIndex(column));
+            if (columnIndex != -1) {
+                presentColumns.emplace_back(column);
+            }
+        }
+        ARROW_ASSIGN_OR_RAISE(auto columnsData, partitionReader->getColumns(presentColumns));
+        auto numDistinctValues = (uint32_t) std::max<int64_t>(partitionReader->getNumRows(), 1);
+
+        std::vector<std::pair<std::string, std::shared_ptr<arrow::Buffer>>> serializedFilters;
+        std::vector<bool> integerColumns;
+        for (size_t i = 0; i < presentColumns.size(); ++i) {
+            const auto &columnData = columnsData[i];
+            auto type = columnData->type();
+            bool isInteger = arrow::is_integer(type->id()) || arrow::is_temporal(type->id());
+            // Float values widened to double would not match the double literals of the predicates
+            if (!isInteger && type->id() != arrow::Type::DOUBLE) {
+                std::cout << "[BloomFilterIndex] Column <" << presentColumns[i] << "> of type " << type->ToString()
+                          << " is not filtered" << std::endl;
+                continue;
+            }
+            // Temporal types only cast to the integer of their own width
+            arrow::Datum castData(columnData);
+            if (arrow::is_temporal(type->id())) {
+                auto bitWidth = std::static_pointer_cast<arrow::FixedWidthType>(type)->bit_width();
+                ARROW_ASSIGN_OR_RAISE(castData, arrow::compute::Cast(castData, bitWidth == 32 ? arrow::int32() : arrow::int64()));
+            }
+            ARROW_ASSIGN_OR_RAISE(castData, arrow::compute::Cast(castData, isInteger ? arrow::int64() : arrow::float64()));
+            parquet::BlockSplitBloomFilter filter;
+            filter.Init(parquet::BlockSplitBloomFilter::OptimalNumOfBytes(numDistinctValues, falsePositiveProbability));
+            for (const auto &chunk: castData.chunked_array()->chunks()) {
+                for (int64_t j = 0; j < chunk->length(); ++j) {
+                    if (chunk->IsNull(j)) {
+                        continue;
+                    }
+                    if (isInteger) {
+                        filter.InsertHash(filter.Hash(std::static_pointer_cast<arrow::Int64Array>(chunk)->Value(j)));
+                    } else {
+                        filter.InsertHash(filter.Hash(std::static_pointer_cast<arrow::DoubleArray>(chunk)->Value(j)));
+                    }
+                }
+            }
+            ARROW_ASSIGN_OR_RAISE(auto stream, arrow::io::BufferOutputStream::Create());
+            filter.WriteTo(stream.get());
+            ARROW_ASSIGN_OR_RAISE(auto serializedFilter, stream->Finish());
+            serializedFilters.emplace_back(presentColumns[i], serializedFilter);
+            integerColumns.emplace_back(isInteger);
+        }
+
+        auto path = getPath(partitionFile);
+        std::ofstream file(path.string() + ".tmp", std::ios::binary | std::ios::trunc);
+        auto numColumns = (uint32_t) serializedFilters.size();
+        file.write(reinterpret_cast<const char *>(&magic), sizeof(magic));
+        file.write(reinterpret_cast<const char *>(&numColumns), sizeof(numColumns));
+        for (size_t i = 0; i < serializedFilters.size(); ++i) {
+            const auto &[column, serializedFilter] = serializedFilters[i];
+            auto nameLength = (uint32_t) column.size();
+            auto isInteger = (uint8_t) integerColumns[i];
+            auto filterLength = (uint32_t) serializedFilter->size();
+            file.write(reinterpret_cast<const char *>(&nameLength), sizeof(nameLength));
+            file.write(column.data(), nameLength);
+            file.write(reinterpret_cast<const char *>(&isInteger), sizeof(isInteger));
+            file.write(reinterpret_cast<const char *>(&filterLength), sizeof(filterLength));
+            file.write(reinterpret_cast<const char *>(serializedFilter->data()), filterLength);
+        }
+        file.close();
+        if (!file.good()) {
+            return arrow::Status::IOError("Could not write bloom filters ", path.string());
+        }
+        std::filesystem::rename(path.string() + ".tmp", path);
+        return arrow::Status::OK();
+    }
+
+    arrow::Result<std::shared_ptr<BloomFilterIndex>> BloomFilterIndex::load(const std::filesystem::path &partitionFile) {
+        auto path = getPath(partitionFile);
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return arrow::Status::IOError("No bloom filters found for ", partitionFile.string());
+        }
+        uint32_t fileMagic = 0;
+        uint32_t numColumns = 0;
+        file.read(reinterpret_cast<char *>(&fileMagic), sizeof(fileMagic));
+        file.read(reinterpret_cast<char *>(&numColumns), sizeof(numColumns));
+        if (!file || fileMagic != magic) {
+            return arrow::Status::Invalid("Unsupported bloom filters file ", path.string());
+        }
+        auto bloomFilterIndex = std::make_shared<BloomFilterIndex>();
+        for (uint32_t i = 0; i < numColumns; ++i) {
+            uint32_t nameLength = 0;
+            uint8_t isInteger = 0;
+            uint32_t filterLength = 0;
+            std::string column;
+            file.read(reinterpret_cast<char *>(&nameLength), sizeof(nameLength));
+            column.resize(nameLength);
+            file.read(column.data(), nameLength);
+            file.read(reinterpret_cast<char *>(&isInteger), sizeof(isInteger));
+            file.read(reinterpret_cast<char *>(&filterLength), sizeof(filterLength));
+            if (!file) {
+                return arrow::Status::Invalid("Bloom filters file ", path.string(), " is truncated");
+            }
+            ARROW_ASSIGN_OR_RAISE(auto serializedFilter, arrow::AllocateBuffer(filterLength));
+            file.read(reinterpret_cast<char *>(serializedFilter->mutable_data()), filterLength);
+            if (!file) {
+                return arrow::Status::Invalid("Bloom filters file ", path.string(), " is truncated");
+            }
+            arrow::io::BufferReader filterReader(std::move(serializedFilter));
+            ColumnFilter columnFilter;
+            columnFilter.isInteger = isInteger != 0;
+            columnFilter.filter = std::make_shared<parquet::BlockSplitBloomFilter>(
+                    parquet::BlockSplitBloomFilter::Deserialize(parquet::default_reader_properties(), &filterReader));
+            bloomFilterIndex->filters.emplace(column, columnFilter);
+        }
+        return bloomFilterIndex;
+    }
+
+    std::vector<std::string> BloomFilterIndex::getColumns() const {
+        std::vector<std::string> columns;
+        for (const auto &[column, columnFilter]: filters) {
+            columns.emplace_back(column);
+        }
+        return columns;
+    }
+
+    bool BloomFilterIndex::mightContain(const std::string &column, double value) const {
+        auto columnFilter = filters.find(column);
+        if (columnFilter == filters.end()) {
+            return true;
+        }
+        const auto &filter = columnFilter->second.filter;
+        if (columnFilter->second.isInteger) {
+            // An integer column cannot hold a fractional value
+            if (std::trunc(value) != value) {
+                return false;
+            }
+            return filter->FindHash(filter->Hash((int64_t) value));
+        }
+        return filter->FindHash(filter->Hash(value));
+    }
+
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <arrow/type_traits.h>
+#include <arrow/util/decimal.h>
+
+#include "storage/ColumnStatistics.h"
+
+namespace storage {
+
+    static double getArrowUnitsPerSecond(arrow::TimeUnit::type unit) {
+        switch (unit) {
+            case arrow::TimeUnit::SECOND:
+                return 1;
+            case arrow::TimeUnit::MILLI:
+                return 1e3;
+            case arrow::TimeUnit::MICRO:
+                return 1e6;
+            default:
+                return 1e9;
+        }
+    }
+
+    static double getParquetUnitsPerSecond(parquet::LogicalType::TimeUnit::unit unit) {
+        switch (unit) {
+            case parquet::LogicalType::TimeUnit::MILLIS:
+                return 1e3;
+            case parquet::LogicalType::TimeUnit::MICROS:
+                return 1e6;
+            default:
+                return 1e9;
+        }
+    }
+
+    // Unscaled value of a decimal stored as big-endian two's complement bytes
+    static arrow::Result<double> decodeDecimal(const uint8_t *bytes, int32_t length, int32_t precision) {
+        if (precision <= arrow::Decimal128Type::kMaxPrecision) {
+            ARROW_ASSIGN_OR_RAISE(auto value, arrow::Decimal128::FromBigEndian(bytes, length));
+            return value.ToDouble(0);
+        }
+        ARROW_ASSIGN_OR_RAISE(auto value, arrow::Decimal256::FromBigEndian(bytes, length));
+        return value.ToDouble(0);
+    }
+
+    // Min/max of a column chunk as stored in the footer. Empty for the types without an order usable as a number
+    // (strings, booleans, INT96 timestamps)
+    static arrow::Result<std::optional<std::pair<double, double>>> getStoredBounds(
+            const parquet::ColumnDescriptor &descriptor,
+            const arrow::DataType &type,
+            const std::shared_ptr<parquet::Statistics> &statistics) {
+        bool isUnsigned = descriptor.sort_order() == parquet::SortOrder::UNSIGNED;
+        switch (descriptor.physical_type()) {
+            case parquet::Type::INT32: {
+                auto typedStatistics = std::static_pointer_cast<parquet::Int32Statistics>(statistics);
+                if (isUnsigned) {
+                    return std::make_pair((double) (uint32_t) typedStatistics->min(),
+                                          (double) (uint32_t) typedStatistics->max());
+                }
+                return std::make_pair((double) typedStatistics->min(), (double) typedStatistics->max());
+            }
+            case parquet::Type::INT64: {
+                auto typedStatistics = std::static_pointer_cast<parquet::Int64Statistics>(statistics);
+                if (isUnsigned) {
+                    return std::make_pair((double) (uint64_t) typedStatistics->min(),
+                                          (double) (uint64_t) typedStatistics->max());
+                }
+                return std::make_pair((double) typedStatistics->min(), (double) typedStatistics->max());
+            }
+            case parquet::Type::FLOAT: {
+                auto typedStatistics = std::static_pointer_cast<parquet::FloatStatistics>(statistics);
+                return std::make_pair((double) typedStatistics->min(), (double) typedStatistics->max());
+            }
+            case parquet::Type::DOUBLE: {
+                auto typedStatistics = std::static_pointer_cast<parquet::DoubleStatistics>(statistics);
+                return std::make_pair(typedStatistics->min(), typedStatistics->max());
+            }
+            case parquet::Type::FIXED_LEN_BYTE_ARRAY: {
+                if (!arrow::is_decimal(type.id())) {
+                    return std::nullopt;
+                }
+                auto precision = static_cast<const arrow::DecimalType &>(type).precision();
+                auto typedStatistics = std::static_pointer_cast<parquet::FLBAStatistics>(statistics);
+                ARROW_ASSIGN_OR_RAISE(auto minValue, decodeDecimal(typedStatistics->min().ptr,
+                                                                   descriptor.type_length(), precision));
+                ARROW_ASSIGN_OR_RAISE(auto maxValue, decodeDecimal(typedStatistics->max().ptr,
+                                                                   descriptor.type_length(), precision));
+                return std::make_pair(minValue, maxValue);
+            }
+            case parquet::Type::BYTE_ARRAY: {
+                if (!arrow::is_decimal(type.id())) {
+                    return std::nullopt;
+                }
+                auto precision = static_cast<const arrow::DecimalType &>(type).precision();
+                auto typedStatistics = std::static_pointer_cast<parquet::ByteArrayStatistics>(statistics);
+                ARROW_ASSIGN_OR_RAISE(auto minValue, decodeDecimal(typedStatistics->min().ptr,
+                                                                   (int32_t) typedStatistics->min().len, precision));
+                ARROW_ASSIGN_OR_RAISE(auto maxValue, decodeDecimal(typedStatistics->max().ptr,
+                                                                   (int32_t) typedStatistics->max().len, precision));
+                return std::make_pair(minValue, maxValue);
+            }
+            default:
+                return std::nullopt;
+        }
+    }
+
+    // From the stored value to the domain of the Arrow type: decimals are scaled, date64 is stored in days and
+    // timestamps may be stored in another unit (e.g. seconds are written as milliseconds)
+    double ColumnStatistics::toArrowDomain(const parquet::ColumnDescriptor &descriptor, const arrow::DataType &type,
+                                           double value) {
+        switch (type.id()) {
+            case arrow::Type::DECIMAL128:
+            case arrow::Type::DECIMAL256:
+                return value / std::pow(10.0, static_cast<const arrow::DecimalType &>(type).scale());
+            case arrow::Type::DATE64:
+                return value * 86400000.0;
+            case arrow::Type::TIMESTAMP: {
+                const auto &logicalType = descriptor.logical_type();
+                if (logicalType == nullptr || !logicalType->is_timestamp()) {
+                    return value;
+                }
+                auto storedUnit = std::static_pointer_cast<const parquet::TimestampLogicalType>(logicalType)->time_unit();
+                auto arrowUnit = static_cast<const arrow::TimestampType &>(type).unit();
+                return value / getParquetUnitsPerSecond(storedUnit) * getArrowUnitsPerSecond(arrowUnit);
+            }
+            default:
+                return value;
+        }
+    }
+
+    // Nulls are counted from the row groups with statistics. The range is only reported when every row group with
+    // values has a min/max
+    arrow::Result<ColumnStatistics> ColumnStatistics::fromFooter(const parquet::FileMetaData &metadata,
+                                                                 const std::shared_ptr<arrow::Field> &field) {
+        auto leafIndex = metadata.schema()->ColumnIndex(field->name());
+        if (leafIndex < 0) {
+            return arrow::Status::Invalid("Column <", field->name(), "> not found in the footer");
+        }
+        const auto *descriptor = metadata.schema()->Column(leafIndex);
+        ColumnStatistics columnStatistics;
+        columnStatistics.type = field->type();
+        double minValue = std::numeric_limits<double>::infinity();
+        double maxValue = -std::numeric_limits<double>::infinity();
+        bool boundsComplete = true;
+        bool distinctComplete = metadata.num_row_groups() > 0;
+        int64_t distinctCount = 0;
+        for (int rowGroup = 0; rowGroup < metadata.num_row_groups(); ++rowGroup) {
+            auto rowGroupMetadata = metadata.RowGroup(rowGroup);
+            auto columnChunk = rowGroupMetadata->ColumnChunk(leafIndex);
+            auto statistics = columnChunk->is_stats_set() ? columnChunk->statistics() : nullptr;
+            if (statistics == nullptr) {
+                boundsComplete = boundsComplete && rowGroupMetadata->num_rows() == 0;
+                distinctComplete = false;
+                continue;
+            }
+            int64_t chunkNulls = statistics->HasNullCount() ? statistics->null_count() : 0;
+            columnStatistics.nullCount += chunkNulls;
+            if (statistics->HasDistinctCount()) {
+                distinctCount += statistics->distinct_count();
+            } else {
+                distinctComplete = false;
+            }
+            // A row group of nulls only has no min/max, and nothing to add to the range
+            if (!statistics->HasMinMax()) {
+                boundsComplete = boundsComplete && statistics->HasNullCount() &&
+                                 chunkNulls == rowGroupMetadata->num_rows();
+                continue;
+            }
+            ARROW_ASSIGN_OR_RAISE(auto storedBounds, getStoredBounds(*descriptor, *field->type(), statistics));
+            if (!storedBounds.has_value()) {
+                boundsComplete = false;
+                continue;
+            }
+            minValue = std::min(minValue, toArrowDomain(*descriptor, *field->type(), storedBounds->first));
+            maxValue = std::max(maxValue, toArrowDomain(*descriptor, *field->type(), storedBounds->second));
+        }
+        columnStatistics.hasMinMax = boundsComplete && minValue <= maxValue;
+        if (columnStatistics.hasMinMax) {
+            columnStatistics.min = minValue;
+            columnStatistics.max = maxValue;
+        }
+        if (distinctComplete) {
+            columnStatistics.distinctCount = distinctCount;
+        }
+        return columnStatistics;
+    }
+
+    arrow::Result<std::optional<std::pair<double, double>>> ColumnStatistics::getRowGroupBounds(
+            const parquet::FileMetaData &metadata,
+            const std::shared_ptr<arrow::Field> &field,
+            int rowGroup) {
+        auto leafIndex = metadata.schema()->ColumnIndex(field->name());
+        if (leafIndex < 0) {
+            return arrow::Status::Invalid("Column <", field->name(), "> not found in the footer");
+        }
+        const auto *descriptor = metadata.schema()->Column(leafIndex);
+        auto rowGroupMetadata = metadata.RowGroup(rowGroup);
+        auto columnChunk = rowGroupMetadata->ColumnChunk(leafIndex);
+        auto statistics = columnChunk->is_stats_set() ? columnChunk->statistics() : nullptr;
+        if (statistics == nullptr) {
+            return std::nullopt;
+        }
+        if (!statistics->HasMinMax()) {
+            if (statistics->HasNullCount() && statistics->null_count() == rowGroupMetadata->num_rows()) {
+                return std::make_pair(std::numeric_limits<double>::infinity(),
+                                      -std::numeric_limits<double>::infinity());
+            }
+            return std::nullopt;
+        }
+        ARROW_ASSIGN_OR_RAISE(auto storedBounds, getStoredBounds(*descriptor, *field->type(), statistics));
+        if (!storedBounds.has_value()) {
+            return std::nullopt;
+        }
+        return std::make_pair(toArrowDomain(*descriptor, *field->type(), storedBounds->first),
+                              toArrowDomain(*descriptor, *field->type(), storedBounds->second));
+    }
+
+    double ColumnStatistics::toEpochSeconds(const arrow::DataType &type, double value) {
+        switch (type.id()) {
+            case arrow::Type::DATE32:
+                return value * 86400.0;
+            case arrow::Type::DATE64:
+                return value / 1000.0;
+            case arrow::Type::TIMESTAMP:
+                return value / getArrowUnitsPerSecond(static_cast<const arrow::TimestampType &>(type).unit());
+            default:
+                return value;
+        }
+    }
+
+    bool ColumnStatistics::isTemporal(const arrow::DataType &type) {
+        return type.id() == arrow::Type::DATE32 || type.id() == arrow::Type::DATE64 ||
+               type.id() == arrow::Type::TIMESTAMP;
+    }
+} // storage
@@ -1,6 +1,11 @@
+#include <algorithm>
 #include <ctime>
 #include <filesystem>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <random>
 #include <string>
 
 #include <arrow/compute/kernel.h>
@@ -8,7 +13,11 @@
 
 #include <arrow/io/api.h>
 #include <parquet/arrow/reader.h>
+#include "common/KeyView.h"
+#include "common/QuantileSketch.h"
+#include "common/TaskScheduler.h"
 #include "storage/DataReader.h"
+#include "storage/DataWriter.h"
 
 namespace storage {
 
@@ -20,24 +29,37 @@ namespace storage {
 
             arrow::MemoryPool* pool = arrow::default_memory_pool();
 
-            // Enable parallel column decoding
-            auto reader_properties = parquet::ReaderProperties(pool);
+            // Buffered stream, memory map or coalesced reads, depending on the read mode of the process
+            readMode = getReadMode();
+            auto reader_properties = readMode.getReaderProperties();
 
-            reader_properties.set_buffer_size(common::Settings::bufferSize);
-            reader_properties.enable_buffered_stream();
+            parquet::arrow::FileReaderBuilder reader_builder;
+            ARROW_RETURN_NOT_OK(reader_builder.OpenFile(path, readMode.memoryMap, reader_properties));
+            metadata = reader_builder.raw_reader()->metadata();
+            {
+                std::lock_guard<std::mutex> lock(columnStatisticsMutex);
+                columnStatistics.clear();
+            }
 
             // Configure Arrow-specific Parquet reader settings
-            auto arrow_reader_props = parquet::ArrowReaderProperties(/*use_threads=*/false);
-            arrow_reader_props.set_batch_size(common::Settings::batchSize);  // default 64 * 1024
+            // The batch size depends on the width of the rows and on the memory granted to the batches held at once,
+            // for batches of comparable size in memory. The previous reservation is given back first
+            auto rowWidth = getRowWidth();
+            batchReservation.reset();
+            batchReservation = std::make_unique<common::MemoryReservation>(
+                    common::MemoryGovernor::getInstance().reserveBatches("Record batches of " + path.string(), rowWidth,
+                                                                         batchesInMemory));
+            batchSize = common::MemoryGovernor::getBatchSize(*batchReservation, rowWidth, batchesInMemory);
+            std::cout << "[DataReader] Batch size is " << batchSize << " rows" << std::endl;
+            auto arrow_reader_props = readMode.getArrowReaderProperties((int64_t) batchSize);
 
-            parquet::arrow::FileReaderBuilder reader_builder;
-            ARROW_RETURN_NOT_OK(reader_builder.OpenFile(path, /*memory_map=*/false, reader_properties));
             reader_builder.memory_pool(pool);
             reader_builder.properties(arrow_reader_props);
 
             ARROW_ASSIGN_OR_RAISE(reader, reader_builder.Build());
 
-            std::cout << "[DataReader] Loaded file reader for file " << path << std::endl;
+            std::cout << "[DataReader] Loaded file reader for file " << path << " (read mode " << readMode.name << ")"
+                      << std::endl;
 
             metadata = reader->parquet_reader()->metadata();
 
@@ -65,8 +87,21 @@ namespace storage {
         return metadata->num_rows();
     }
 
+    // Average in-memory size of a row, from the uncompressed sizes of the row groups stored in the footer
+    int64_t DataReader::getRowWidth() {
+        int64_t totalBytes = 0;
+        for (int i = 0; i < metadata->num_row_groups(); ++i) {
+            totalBytes += metadata->RowGroup(i)->total_byte_size();
+        }
+        return std::max(totalBytes / std::max(metadata->num_rows(), (int64_t) 1), (int64_t) 1);
+    }
+
+    size_t DataReader::getBatchSize() {
+        return batchSize;
+    }
+
     int64_t DataReader::getExpectedNumBatches(){
-        return (int64_t) std::ceil((float) getNumRows() / (float) common::Settings::batchSize);
+        return (int64_t) std::ceil((float) getNumRows() / (float) batchSize);
     }
 
     arrow::Result<std::shared_ptr<arrow::Table>> DataReader::getTable(std::filesystem::path &inputFile){
@@ -91,12 +126,103 @@ namespace storage {
     // TODO: reduce memory usage, see:
     //  https://github.com/lsst/qserv/blob/a5dbf4175159b874da1cb0907533ba6e3ffd5e7d/src/partition/ParquetInterface.cc#L114
     arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> DataReader::getBatchReader() {
+        if (readMode.parallelRowGroups) {
+            std::vector<int> columnIndexes(metadata->num_columns());
+            std::iota(columnIndexes.begin(), columnIndexes.end(), 0);
+            return getParallelBatchReader(columnIndexes, readMode.orderedBatches);
+        }
         std::shared_ptr<arrow::RecordBatchReader> recordBatchReader;
         ARROW_RETURN_NOT_OK(reader->GetRecordBatchReader(&recordBatchReader));
         std::cout << "[DataReader] Obtained record batch reader" << std::endl;
         return recordBatchReader;
     }
 
+    // Batch reader over a projection of the columns, only the requested column chunks are read and decoded
+    arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> DataReader::getBatchReader(const std::vector<int> &columnIndexes) {
+        if (readMode.parallelRowGroups) {
+            return getParallelBatchReader(columnIndexes, readMode.orderedBatches);
+        }
+        std::vector<int> rowGroups(metadata->num_row_groups());
+        std::iota(rowGroups.begin(), rowGroups.end(), 0);
+        std::shared_ptr<arrow::RecordBatchReader> recordBatchReader;
+        ARROW_RETURN_NOT_OK(reader->GetRecordBatchReader(rowGroups, columnIndexes, &recordBatchReader));
+        std::cout << "[DataReader] Obtained record batch reader for " << columnIndexes.size() << " columns" << std::endl;
+        return recordBatchReader;
+    }
+
+    // Same rows as getBatchReader, but the unordered read modes still deliver the batches in file order
+    arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> DataReader::getOrderedBatchReader() {
+        std::vector<int> columnIndexes(metadata->num_columns());
+        std::iota(columnIndexes.begin(), columnIndexes.end(), 0);
+        return getOrderedBatchReader(columnIndexes);
+    }
+
+    arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> DataReader::getOrderedBatchReader(const std::vector<int> &columnIndexes) {
+        if (readMode.parallelRowGroups) {
+            return getParallelBatchReader(columnIndexes, true);
+        }
+        return getBatchReader(columnIndexes);
+    }
+
+    // Batch reader over the row groups decoded in parallel, every decoding thread opens its own reader of the file
+    arrow::Result<std::shared_ptr<::arrow::RecordBatchReader>> DataReader::getParallelBatchReader(const std::vector<int> &columnIndexes,
+                                                                                                  bool orderedBatches) {
+        std::shared_ptr<arrow::Schema> schema;
+        ARROW_RETURN_NOT_OK(reader->GetSchema(&schema));
+        std::vector<std::shared_ptr<arrow::Field>> fields;
+        for (auto columnIndex: columnIndexes) {
+            fields.emplace_back(schema->field(columnIndex));
+        }
+        std::vector<int> rowGroups(metadata->num_row_groups());
+        std::iota(rowGroups.begin(), rowGroups.end(), 0);
+        // Every decoding thread holds its batches on top of the queued ones, they get their own reservation. It lives
+        // as long as the factory, i.e. as long as the parallel reader
+        auto rowWidth = getRowWidth();
+        auto numBatches = (int64_t) (common::Settings::numWorkers * (common::Settings::prefetchDepth + 1));
+        auto parallelReservation = std::make_shared<common::MemoryReservation>(
+                common::MemoryGovernor::getInstance().reserveBatches("Parallel record batches of " + path.string(),
+                                                                     rowWidth, numBatches));
+        auto filePath = path;
+        auto mode = readMode;
+        auto readerBatchSize = (int64_t) common::MemoryGovernor::getBatchSize(*parallelReservation, rowWidth, numBatches);
+        auto readerFactory = [filePath, mode, readerBatchSize, parallelReservation]() {
+            return openFileReader(filePath, mode, readerBatchSize);
+        };
+        std::cout << "[DataReader] Obtained parallel batch reader for " << columnIndexes.size() << " columns ("
+                  << (orderedBatches ? "ordered" : "unordered") << " batches)" << std::endl;
+        std::shared_ptr<arrow::RecordBatchReader> parallelReader = std::make_shared<ParallelBatchReader>(
+                readerFactory, arrow::schema(fields, schema->metadata()), rowGroups, columnIndexes, orderedBatches);
+        return parallelReader;
+    }
+
+    arrow::Result<std::unique_ptr<parquet::arrow::FileReader>> DataReader::openFileReader(const std::filesystem::path &filePath,
+                                                                                          const ReadMode &mode,
+                                                                                          int64_t readerBatchSize) {
+        parquet::arrow::FileReaderBuilder readerBuilder;
+        ARROW_RETURN_NOT_OK(readerBuilder.OpenFile(filePath, mode.memoryMap, mode.getReaderProperties()));
+        readerBuilder.properties(mode.getArrowReaderProperties(readerBatchSize));
+        return readerBuilder.Build();
+    }
+
+    void DataReader::setReadMode(const ReadMode &mode) {
+        std::lock_guard<std::mutex> lock(readModeMutex);
+        processReadMode = mode;
+        std::cout << "[DataReader] Using read mode " << mode.name << std::endl;
+    }
+
+    ReadMode DataReader::getReadMode() {
+        std::lock_guard<std::mutex> lock(readModeMutex);
+        return processReadMode;
+    }
+
+    // Batch reader decoding the next batches on a background thread while the caller processes the current one.
+    // The underlying file reader must not be used by anyone else until the prefetcher is exhausted or closed
+    arrow::Result<std::shared_ptr<BatchPrefetcher>> DataReader::getPrefetchingBatchReader(size_t queueDepth) {
+        ARROW_ASSIGN_OR_RAISE(auto recordBatchReader, getBatchReader());
+        std::cout << "[DataReader] Prefetching up to " << queueDepth << " batches" << std::endl;
+        return std::make_shared<BatchPrefetcher>(recordBatchReader, queueDepth);
+    }
+
     arrow::Result<std::vector<std::shared_ptr<arrow::ChunkedArray>>> DataReader::getColumns(const std::vector<std::string> &columns){
         std::vector<std::shared_ptr<arrow::ChunkedArray>> columnsArray;
         columnsArray.reserve(columns.size());
@@ -124,117 +250,288 @@ namespace storage {
         return schema->GetFieldIndex(columnName);
     }
 
+    // Every batch of the file is a stratum and contributes a uniform sample of its rows, in proportion to its size.
+    // Unlike a global sample, no region of the file (e.g. a time range of data sorted by time) is over or under
+    // represented. Single pass over the requested columns, with a fixed seed
+    arrow::Result<std::shared_ptr<arrow::Table>> DataReader::getStratifiedSample(const std::vector<std::string> &columns,
+                                                                                 size_t sampleSize){
+        std::vector<int> columnIndexes;
+        for (const auto &column: columns) {
+            ARROW_ASSIGN_OR_RAISE(auto columnIndex, getColumnIndex(column));
+            if (columnIndex == -1) {
+                return arrow::Status::Invalid("Column name <" + column + "> not found in schema");
+            }
+            columnIndexes.emplace_back(columnIndex);
+        }
+        ARROW_ASSIGN_OR_RAISE(auto recordBatchReader, getBatchReader(columnIndexes));
+        auto totalRows = getNumRows();
+        double samplingRate = totalRows > 0 ? std::min(1.0, (double) sampleSize / (double) totalRows) : 0;
+        std::mt19937_64 generator(common::Settings::samplingSeed);
+        std::vector<std::shared_ptr<arrow::RecordBatch>> sampledBatches;
+        // Fractions of a row are carried over to the next stratum, so the sample gets about sampleSize rows
+        double carriedRows = 0;
+        std::shared_ptr<arrow::RecordBatch> batch;
+        while (true) {
+            ARROW_RETURN_NOT_OK(recordBatchReader->ReadNext(&batch));
+            if (batch == nullptr) {
+                break;
+            }
+            carriedRows += samplingRate * (double) batch->num_rows();
+            auto stratumSize = std::min((int64_t) carriedRows, batch->num_rows());
+            carriedRows -= (double) stratumSize;
+            if (stratumSize == 0) {
+                continue;
+            }
+            std::vector<uint64_t> positions(batch->num_rows());
+            std::iota(positions.begin(), positions.end(), 0);
+            std::vector<uint64_t> stratum;
+            stratum.reserve(stratumSize);
+            // Selection sampling keeps the positions sorted
+            std::sample(positions.begin(), positions.end(), std::back_inserter(stratum), stratumSize, generator);
+            arrow::UInt64Builder positionsBuilder;
+            ARROW_RETURN_NOT_OK(positionsBuilder.AppendValues(stratum));
+            ARROW_ASSIGN_OR_RAISE(auto positionsArray, positionsBuilder.Finish());
+            ARROW_ASSIGN_OR_RAISE(auto sampledDatum, arrow::compute::Take(batch, positionsArray));
+            sampledBatches.emplace_back(sampledDatum.record_batch());
+        }
+        ARROW_ASSIGN_OR_RAISE(auto sample, arrow::Table::FromRecordBatches(recordBatchReader->schema(), sampledBatches));
+        std::cout << "[DataReader] Sampled " << sample->num_rows() << " rows out of " << totalRows << std::endl;
+        return sample;
+    }
+
+    // Min/max of a column from the typed statistics of the footer
     arrow::Result<std::pair<double_t, double_t>> DataReader::getColumnStats(const std::string &columnName){
+        ARROW_ASSIGN_OR_RAISE(auto statistics, getColumnStatistics(columnName));
+        if (!statistics.hasMinMax) {
+            return arrow::Status::Invalid("No min/max statistics for column <" + columnName + ">");
+        }
+        return std::make_pair(statistics.min, statistics.max);
+    }
 
-        duckdb::DuckDB db(nullptr);
-        duckdb::Connection con(db);
-
-        std::string datasetFilePath = getReaderPath();
-        const std::string query = "SELECT stats_min, stats_max "
-                                  "FROM parquet_metadata('" + datasetFilePath + "') "
-                                  "WHERE path_in_schema = '" + columnName + "'";
-        auto results = con.Query(query);
-
-        std::vector<double> minValues;
-        std::vector<double> maxValues;
-
-        for (const auto &row : *results) {
-            double currentMin;
-            double currentMax;
-            // TODO: check column type int96 instead of name of column
-            // int96/timestamp and parquet are not a good match, see
-            // https://issues.apache.org/jira/browse/PARQUET-840
-            std::set<std::string> timeColumns = {"tpep_pickup_datetime", "tpep_dropoff_datetime",
-                                                 "created_at",
-                                                 "o_orderdate", "l_shipdate"};
-            if (timeColumns.find(columnName) != timeColumns.end()){
-                std::string sMin{row.GetValue<std::string>(0)};
-                std::string sMax{row.GetValue<std::string>(1)};
-                std::tm tmMin{};
-                std::tm tmMax{};
-                std::istringstream ssMin(sMin);
-                std::istringstream ssMax(sMax);
-
-                ssMin >> std::get_time(&tmMin, "%Y-%m-%d %H:%M:%S");
-                ssMax >> std::get_time(&tmMax, "%Y-%m-%d %H:%M:%S");
-
-                auto tMin = mktime(&tmMin);
-                auto tMax = mktime(&tmMax);
-                currentMin = static_cast<double>(tMin);
-                currentMax = static_cast<double>(tMax);
+    // Statistics of a column from the footer already loaded, computed once per column. Columns whose footer lacks a
+    // min/max (no statistics written, INT96 timestamps) fall back to a scan of the column
+    arrow::Result<ColumnStatistics> DataReader::getColumnStatistics(const std::string &columnName){
+        {
+            std::lock_guard<std::mutex> lock(columnStatisticsMutex);
+            auto cached = columnStatistics.find(columnName);
+            if (cached != columnStatistics.end()) {
+                return cached->second;
+            }
+        }
+        std::shared_ptr<arrow::Schema> schema;
+        ARROW_RETURN_NOT_OK(reader->GetSchema(&schema));
+        auto field = schema->GetFieldByName(columnName);
+        if (field == nullptr) {
+            return arrow::Status::Invalid("Column name <" + columnName + "> not found in schema");
+        }
+        ARROW_ASSIGN_OR_RAISE(auto statistics, ColumnStatistics::fromFooter(*metadata, field));
+        if (!statistics.hasMinMax && statistics.nullCount < metadata->num_rows()) {
+            std::cout << "[DataReader] No footer statistics for column <" << columnName << ">, scanning it" << std::endl;
+            ARROW_ASSIGN_OR_RAISE(auto columnArray, getColumn(columnName));
+            double minValue = std::numeric_limits<double>::infinity();
+            double maxValue = -std::numeric_limits<double>::infinity();
+            auto scanStatus = arrow::Status::OK();
+            for (const auto &columnChunk: columnArray->chunks()) {
+                scanStatus = common::visitKeys(*columnChunk, [&minValue, &maxValue](const auto &keys) {
+                    for (int64_t i = 0; i < keys.size(); i++) {
+                        if (keys.isValid(i)) {
+                            minValue = std::min(minValue, static_cast<double>(keys[i]));
+                            maxValue = std::max(maxValue, static_cast<double>(keys[i]));
+                        }
+                    }
+                    return arrow::Status::OK();
+                });
+                if (!scanStatus.ok()) {
+                    break;
+                }
             }
-            else{
-                currentMin = row.GetValue<double>(0);
-                currentMax = row.GetValue<double>(1);
+            if (scanStatus.ok()) {
+                statistics.min = minValue;
+                statistics.max = maxValue;
+                statistics.hasMinMax = statistics.min <= statistics.max;
+                statistics.nullCount = columnArray->null_count();
             }
-            minValues.emplace_back(currentMin);
-            maxValues.emplace_back(currentMax);
         }
+        std::lock_guard<std::mutex> lock(columnStatisticsMutex);
+        columnStatistics.emplace(columnName, statistics);
+        return statistics;
+    }
 
-        double minValue = *std::min_element(std::begin(minValues), std::end(minValues));
-        double maxValue = *std::max_element(std::begin(maxValues), std::end(maxValues));
-
-        return std::make_pair(minValue, maxValue);
+    // Every row group is read by its own file reader on the task scheduler, projected on the column, and streamed
+    // batch by batch into its sketch. Values are in the domain of common::ColumnDataConverter, nulls are ignored
+    arrow::Result<std::vector<double>> DataReader::getQuantiles(const std::string &columnName,
+                                                                const std::vector<double> &quantiles,
+                                                                double rankError){
+        ARROW_ASSIGN_OR_RAISE(auto columnIndex, getColumnIndex(columnName));
+        if (columnIndex == -1){
+            return arrow::Status::Invalid("Column name <" + columnName + "> not found in schema");
+        }
+        auto k = common::QuantileSketch::getK(rankError);
+        auto numRowGroups = metadata->num_row_groups();
+        // One seed per row group, the sketches are merged below
+        std::vector<common::QuantileSketch> sketches;
+        sketches.reserve(numRowGroups);
+        for (int rowGroup = 0; rowGroup < numRowGroups; ++rowGroup) {
+            sketches.emplace_back(k, common::Settings::samplingSeed ^ (uint64_t) rowGroup);
+        }
+        auto filePath = path;
+        auto mode = readMode;
+        auto rowWidth = getRowWidth();
+        common::TaskGroup rowGroupTasks;
+        for (int rowGroup = 0; rowGroup < numRowGroups; ++rowGroup) {
+            rowGroupTasks.run([&sketches, filePath, mode, rowWidth, rowGroup, columnIndex]() -> arrow::Status {
+                // The row groups are read concurrently, each task reserves the memory of its own batch
+                auto rowGroupReservation = common::MemoryGovernor::getInstance().reserveBatches(
+                        "Quantile sketch of " + filePath.string(), rowWidth, 1);
+                auto readerBatchSize = (int64_t) common::MemoryGovernor::getBatchSize(rowGroupReservation, rowWidth, 1);
+                ARROW_ASSIGN_OR_RAISE(auto rowGroupReader, openFileReader(filePath, mode, readerBatchSize));
+                std::shared_ptr<arrow::RecordBatchReader> recordBatchReader;
+                ARROW_RETURN_NOT_OK(rowGroupReader->GetRecordBatchReader({rowGroup}, {columnIndex}, &recordBatchReader));
+                auto &sketch = sketches.at(rowGroup);
+                std::shared_ptr<arrow::RecordBatch> batch;
+                while (true) {
+                    ARROW_RETURN_NOT_OK(recordBatchReader->ReadNext(&batch));
+                    if (batch == nullptr) {
+                        break;
+                    }
+                    ARROW_RETURN_NOT_OK(common::visitKeys(*batch->column(0), [&sketch](const auto &keys) {
+                        for (int64_t i = 0; i < keys.size(); i++) {
+                            if (keys.isValid(i)) {
+                                sketch.update(static_cast<double>(keys[i]));
+                            }
+                        }
+                        return arrow::Status::OK();
+                    }));
+                }
+                return arrow::Status::OK();
+            });
+        }
+        ARROW_RETURN_NOT_OK(rowGroupTasks.wait());
+        common::QuantileSketch mergedSketch(k);
+        for (const auto &sketch: sketches) {
+            mergedSketch.merge(sketch);
+        }
+        if (mergedSketch.isEmpty()) {
+            return arrow::Status::Invalid("No values in column <" + columnName + "> to compute quantiles");
+        }
+        return mergedSketch.getQuantiles(quantiles);
     }
 
     arrow::Result<double_t> DataReader::getMedian(const std::string &columnName){
+        ARROW_ASSIGN_OR_RAISE(auto median, getQuantiles(columnName, {0.5}));
+        return median.front();
+    }
 
-        duckdb::DuckDB db(nullptr);
-        duckdb::Connection con(db);
-
-        std::string datasetFilePath = getReaderPath();
-
-        // Load parquet file into memory and sort it
-        std::string loadQuery = "CREATE TABLE tbl AS "
-                                "SELECT * FROM read_parquet('" + datasetFilePath + "') "
-                                "ORDER BY '" + columnName + "'";
-        auto loadQueryResult = con.Query(loadQuery);
-
-        // Extract median rows
-        int64_t numRows = getNumRows();
-        int64_t limit = (numRows % 2 == 0) ? 2 : 1;
-
-        std::string limitQuery = "SELECT AVG(" + columnName + ") "
-                                 "FROM tbl "
-                                 "LIMIT " + std::to_string(limit) +
-                                 "OFFSET " + std::to_string(numRows / 2) + " )";
-
-        auto limitQueryResult = con.Query(limitQuery);
+    // Values of a column as compared by the range filter, in the domain of common::ColumnDataConverter: dates and
+    // timestamps as their integer count, decimals as doubles
+    static arrow::Result<arrow::Datum> getComparableValues(const std::shared_ptr<arrow::Array> &array) {
+        switch (array->type_id()) {
+            case arrow::Type::DATE32:
+            case arrow::Type::TIME32:
+                return arrow::compute::Cast(arrow::Datum(array), arrow::int32());
+            case arrow::Type::DATE64:
+            case arrow::Type::TIMESTAMP:
+            case arrow::Type::TIME64:
+            case arrow::Type::DURATION:
+                return arrow::compute::Cast(arrow::Datum(array), arrow::int64());
+            case arrow::Type::DECIMAL128:
+            case arrow::Type::DECIMAL256:
+                return arrow::compute::Cast(arrow::Datum(array), arrow::float64());
+            default:
+                return arrow::Datum(array);
+        }
+    }
 
-        double medianValue;
+    // Single streaming pass: the row groups left by the statistics are decoded batch by batch, filtered with the
+    // comparison kernels and appended to the output, which holds at most one row group in memory
+    arrow::Status DataReader::rangeFilter(const std::map<std::string, std::pair<double, double>> &box,
+                                          const std::filesystem::path &destinationFile){
+        std::shared_ptr<arrow::Schema> schema;
+        ARROW_RETURN_NOT_OK(reader->GetSchema(&schema));
+        std::vector<std::shared_ptr<arrow::Field>> boxFields;
+        for (const auto &[column, range]: box) {
+            auto field = schema->GetFieldByName(column);
+            if (field == nullptr) {
+                return arrow::Status::Invalid("Column name <" + column + "> not found in schema");
+            }
+            boxFields.emplace_back(field);
+        }
 
-        for (const auto &row : *limitQueryResult) {
-            medianValue = row.GetValue<double>(0);
+        // Skip the row groups whose min/max on some column of the box lies outside its range
+        std::vector<int> rowGroups;
+        for (int rowGroup = 0; rowGroup < metadata->num_row_groups(); ++rowGroup) {
+            bool overlapsBox = true;
+            size_t fieldIndex = 0;
+            for (const auto &[column, range]: box) {
+                ARROW_ASSIGN_OR_RAISE(auto bounds, ColumnStatistics::getRowGroupBounds(*metadata, boxFields[fieldIndex++],
+                                                                                       rowGroup));
+                if (bounds.has_value() && (bounds->second < range.first || bounds->first > range.second)) {
+                    overlapsBox = false;
+                    break;
+                }
+            }
+            if (overlapsBox) {
+                rowGroups.emplace_back(rowGroup);
+            }
         }
 
-        return medianValue;
+        std::shared_ptr<arrow::io::FileOutputStream> outFile;
+        ARROW_ASSIGN_OR_RAISE(outFile, arrow::io::FileOutputStream::Open(destinationFile.string()));
+        std::unique_ptr<parquet::arrow::FileWriter> writer;
+        ARROW_ASSIGN_OR_RAISE(writer, parquet::arrow::FileWriter::Open(*schema,
+                                                                       arrow::default_memory_pool(),
+                                                                       outFile,
+                                                                       DataWriter::getWriterProperties(),
+                                                                       DataWriter::getArrowWriterProperties()));
+        int64_t numMatchingRows = 0;
+        if (!rowGroups.empty()) {
+            std::vector<int> columnIndexes(schema->num_fields());
+            std::iota(columnIndexes.begin(), columnIndexes.end(), 0);
+            std::shared_ptr<arrow::RecordBatchReader> recordBatchReader;
+            ARROW_RETURN_NOT_OK(reader->GetRecordBatchReader(rowGroups, columnIndexes, &recordBatchReader));
+            std::shared_ptr<arrow::RecordBatch> batch;
+            while (true) {
+                ARROW_RETURN_NOT_OK(recordBatchReader->ReadNext(&batch));
+                if (batch == nullptr) {
+                    break;
+                }
+                // Conjunction of the ranges, rows with a null on a column of the box are dropped
+                arrow::Datum selection;
+                for (const auto &[column, range]: box) {
+                    ARROW_ASSIGN_OR_RAISE(auto values, getComparableValues(batch->GetColumnByName(column)));
+                    ARROW_ASSIGN_OR_RAISE(auto aboveLower, arrow::compute::CallFunction("greater_equal",
+                                                                                        {values, arrow::Datum(range.first)}));
+                    ARROW_ASSIGN_OR_RAISE(auto belowUpper, arrow::compute::CallFunction("less_equal",
+                                                                                        {values, arrow::Datum(range.second)}));
+                    ARROW_ASSIGN_OR_RAISE(auto inRange, arrow::compute::And(aboveLower, belowUpper));
+                    if (selection.kind() == arrow::Datum::NONE) {
+                        selection = inRange;
+                    } else {
+                        ARROW_ASSIGN_OR_RAISE(selection, arrow::compute::And(selection, inRange));
+                    }
+                }
+                auto matchingBatch = batch;
+                if (selection.kind() != arrow::Datum::NONE) {
+                    ARROW_ASSIGN_OR_RAISE(auto filtered, arrow::compute::Filter(batch, selection));
+                    matchingBatch = filtered.record_batch();
+                }
+                if (matchingBatch->num_rows() == 0) {
+                    continue;
+                }
+                numMatchingRows += matchingBatch->num_rows();
+                ARROW_RETURN_NOT_OK(writer->WriteRecordBatch(*matchingBatch));
+            }
+        }
+        ARROW_RETURN_NOT_OK(writer->Close());
+        std::cout << "[DataReader] Range filter read " << rowGroups.size() << " of " << metadata->num_row_groups()
+                  << " row groups, written " << numMatchingRows << " rows to " << destinationFile << std::endl;
+        return arrow::Status::OK();
     }
 
     arrow::Status DataReader::rangeFilter(const std::string &columnName,
                                           const std::filesystem::path &destinationFile,
                                           const std::pair<double, double> range){
-
-        duckdb::DuckDB db(nullptr);
-        duckdb::Connection con(db);
-
-        std::string datasetFilePath = getReaderPath();
-
-        // Load parquet file into memory and sort it
-        std::string loadQuery = "CREATE TABLE tbl AS "
-                                "SELECT * FROM read_parquet('" + datasetFilePath + "')";
-        auto loadQueryResult = con.Query(loadQuery);
-
-        // Apply filter
-        std::string filterQuery = "COPY (SELECT * "
-                                  "      FROM tbl "
-                                  "      WHERE " + columnName + " >= " + std::to_string(range.first) + " AND "
-                                                 + columnName + " <= " + std::to_string(range.second) + ") "
-                                  "TO '" + destinationFile.string() + ".parquet'"
-                                  "(FORMAT PARQUET, COMPRESSION SNAPPY, "
-                                  " ROW_GROUP_SIZE " + std::to_string(common::Settings::rowGroupSize) + ")";
-        auto filterQueryResult = con.Query(filterQuery);
-
-        return arrow::Status::OK();
+        return rangeFilter(std::map<std::string, std::pair<double, double>>{{columnName, range}}, destinationFile);
     }
 
 } // storage
\ No newline at end of file
@@ -1,16 +1,24 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <arrow/csv/api.h>
 #include <arrow/io/api.h>
 #include <filesystem>
 #include <iostream>
 #include <parquet/arrow/writer.h>
 
+#include "common/MemoryGovernor.h"
+#include "common/TaskScheduler.h"
+#include "storage/BloomFilterIndex.h"
 #include "storage/DataWriter.h"
+#include "storage/ParquetConcatenator.h"
 
 namespace storage {
 
     // Write to disk a table, given its pointer and the output path
     arrow::Status DataWriter::WriteTableToDisk(std::shared_ptr<arrow::Table>& table,
-                                               std::filesystem::path &outputPath) {
+                                               std::filesystem::path &outputPath,
+                                               int64_t rowGroupSize) {
         // Prepare the output file
         std::shared_ptr<arrow::io::FileOutputStream> outfile;
         ARROW_ASSIGN_OR_RAISE(outfile, arrow::io::FileOutputStream::Open(outputPath.string()));
@@ -19,28 +27,41 @@ namespace storage {
         ARROW_ASSIGN_OR_RAISE(writer, parquet::arrow::FileWriter::Open(*table->schema(),
                                                                        arrow::default_memory_pool(),
                                                                        outfile,
-                                                                       storage::DataWriter::getWriterProperties(),
+                                                                       storage::DataWriter::getWriterProperties(rowGroupSize),
                                                                        storage::DataWriter::getArrowWriterProperties()));
         // Write the batch and close the file
         std::cout << "[DataWriter] Writing " << table->num_rows() << " rows" << std::endl;
-        ARROW_RETURN_NOT_OK(writer->WriteTable(*table));
+        ARROW_RETURN_NOT_OK(writer->WriteTable(*table, rowGroupSize));
         ARROW_RETURN_NOT_OK(writer->Close());
         std::cout << "[DataWriter] Completed, written table to file " << outputPath << std::endl;
         return arrow::Status::OK();
     }
 
-    // Define common writer properties within the project
-    std::shared_ptr<parquet::WriterProperties> DataWriter::getWriterProperties(){
-        std::shared_ptr<parquet::WriterProperties> props = parquet::WriterProperties::Builder()
-                // Optimal row group length is around 120000 according to several sources
-                .max_row_group_length(common::Settings::rowGroupSize)
-                ->created_by(common::Settings::libraryName)
-                ->version(common::Settings::version)
-                ->data_page_version(parquet::ParquetDataPageVersion::V2)
-                // Worse compression ratio than zstd but faster reads
-                ->compression(common::Settings::compression)
-                ->build();
-        return props;
+    // Define common writer properties within the project, from the current writer profile
+    std::shared_ptr<parquet::WriterProperties> DataWriter::getWriterProperties(int64_t rowGroupSize){
+        return getWriterProfile().getWriterProperties(rowGroupSize);
+    }
+
+    void DataWriter::setWriterProfile(const WriterProfile &profile){
+        std::lock_guard<std::mutex> lock(writerProfileMutex);
+        writerProfile = profile;
+        std::cout << "[DataWriter] Using writer profile " << profile.name << std::endl;
+    }
+
+    WriterProfile DataWriter::getWriterProfile(){
+        std::lock_guard<std::mutex> lock(writerProfileMutex);
+        return writerProfile;
+    }
+
+    void DataWriter::setSpillFormat(const SpillFormat &format){
+        std::lock_guard<std::mutex> lock(spillFormatMutex);
+        spillFormat = format;
+        std::cout << "[DataWriter] Using spill format " << format.name << std::endl;
+    }
+
+    SpillFormat DataWriter::getSpillFormat(){
+        std::lock_guard<std::mutex> lock(spillFormatMutex);
+        return spillFormat;
     }
 
     // Define common arrow writer properties
@@ -58,26 +79,53 @@ namespace storage {
         //    -- b0.parquet
         //    -- b1.parquet
         //    -- b2.parquet
-        auto numPartitions = partitionIds.size();
-        for (const uint32_t &partitionId: partitionIds){
-            std::string rootPath;
-            std::filesystem::path subPartitionsFolder = basePath / std::to_string(partitionId);
-            // Merge batches for a batch folder
-            if (std::filesystem::exists(subPartitionsFolder)) {
-                ARROW_ASSIGN_OR_RAISE(auto fs, arrow::fs::FileSystemFromUriOrPath(subPartitionsFolder, &rootPath));
-                std::cout << "[DataWriter] Start merging batches for partition id " << partitionId << std::endl;
-                auto statusPartitionMerge = mergeBatchesInFolder(fs, rootPath);
-                if (statusPartitionMerge == arrow::Status::OK()){
-                    std::cout << "[DataWriter] Partition " << partitionId << " (out of " << numPartitions <<
-                                 " ) merged :" << statusPartitionMerge.ToString() << std::endl;
-                } else{
-                    std::cout << "[DataWriter] Failed partition merge :" << statusPartitionMerge.ToString() << std::endl;
+        // The partitions are independent: a few merges run at the same time, each one claiming the next partition
+        std::vector<uint32_t> pendingIds(partitionIds.begin(), partitionIds.end());
+        auto numPartitions = pendingIds.size();
+        auto numMerges = getNumConcurrentMerges(numPartitions);
+        std::cout << "[DataWriter] Merging " << numPartitions << " partitions, " << numMerges << " at a time" << std::endl;
+        std::atomic<size_t> nextPartition{0};
+        std::atomic<size_t> numMerged{0};
+        std::atomic<int64_t> mergedBytes{0};
+        auto start = std::chrono::steady_clock::now();
+        common::TaskGroup merges;
+        for (size_t i = 0; i < numMerges; ++i) {
+            merges.run([&]() {
+                for (auto index = nextPartition.fetch_add(1); index < numPartitions; index = nextPartition.fetch_add(1)) {
+                    auto partitionId = pendingIds[index];
+                    std::filesystem::path subPartitionsFolder = basePath / std::to_string(partitionId);
+                    if (!std::filesystem::exists(subPartitionsFolder)) {
+                        std::cout << "[DataWriter] Batch folder empty for partition id " << partitionId << std::endl;
+                        continue;
+                    }
+                    int64_t folderBytes = 0;
+                    for (const auto &file: std::filesystem::recursive_directory_iterator(subPartitionsFolder)) {
+                        if (file.is_regular_file()) {
+                            folderBytes += (int64_t) file.file_size();
+                        }
+                    }
+                    // A merge holds the batch being read and the row group being encoded, never more than its fragments
+                    auto reservation = common::MemoryGovernor::getInstance().reserve(
+                            "Partition merge", std::min(folderBytes, mergeReservationBytes));
+                    std::string rootPath;
+                    ARROW_ASSIGN_OR_RAISE(auto fs, arrow::fs::FileSystemFromUriOrPath(subPartitionsFolder, &rootPath));
+                    auto statusPartitionMerge = mergeBatchesInFolder(fs, rootPath);
+                    if (!statusPartitionMerge.ok()) {
+                        // The fragments stay on disk: wait() reports the failure before any folder is deleted
+                        std::cout << "[DataWriter] Failed partition merge :" << statusPartitionMerge.ToString() << std::endl;
+                        return statusPartitionMerge;
+                    }
+                    auto merged = numMerged.fetch_add(1) + 1;
+                    auto totalBytes = mergedBytes.fetch_add(folderBytes) + folderBytes;
+                    auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                    std::cout << "[DataWriter] Partition " << partitionId << " merged (" << merged << " out of "
+                              << numPartitions << "), " << (double) totalBytes / megabyte << " MB at "
+                              << (double) totalBytes / megabyte / std::max(seconds, 1e-9) << " MB/s" << std::endl;
                 }
-            }
-            else{
-                std::cout << "[DataWriter] Batch folder empty for partition id " << partitionId << std::endl;
-            }
+                return arrow::Status::OK();
+            });
         }
+        ARROW_RETURN_NOT_OK(merges.wait());
         std::cout << "[DataWriter] Partitioned batches have been merged into partitions" << std::endl;
         // Delete all the folders and their content once the merged tables are ready
         for (const auto &partitionId: partitionIds){
@@ -92,15 +140,46 @@ namespace storage {
         return arrow::Status::OK();
     }
 
+    // Merges running at the same time: bounded by the workers, by the requests the disk serves in parallel and by
+    // the memory budget left for one reservation per merge
+    size_t DataWriter::getNumConcurrentMerges(size_t numPartitions) {
+        auto byMemory = (size_t) std::max(common::MemoryGovernor::getInstance().getAvailable() / mergeReservationBytes,
+                                          (int64_t) 1);
+        auto numMerges = std::min({common::Settings::numWorkers, common::Settings::diskQueueDepth, byMemory});
+        return std::clamp(numMerges, (size_t) 1, std::max(numPartitions, (size_t) 1));
+    }
+
     arrow::Status DataWriter::mergeBatchesInFolder(const std::shared_ptr<arrow::fs::FileSystem> &filesystem,
-                                                   const std::string &base_dir) {
+                                                   const std::string &base_dir,
+                                                   const SpillFormat &fragmentFormat) {
+        // The fragments are in the spill format, the merged file is a Parquet file like the partitions
+        std::filesystem::path mergedFragmentsFilePath = base_dir + common::Settings::fileExtension;
+        // Parquet fragments with the same schema are concatenated as they are, without decoding them.
+        // They are taken in path order, like the dataset below
+        if (fragmentFormat.isParquet() && filesystem->type_name() == "local") {
+            std::vector<std::filesystem::path> fragmentPaths;
+            for (const auto &file: std::filesystem::directory_iterator(base_dir)) {
+                if (file.is_regular_file() && file.path().extension() == common::Settings::fileExtension) {
+                    fragmentPaths.emplace_back(file.path());
+                }
+            }
+            std::sort(fragmentPaths.begin(), fragmentPaths.end());
+            ARROW_ASSIGN_OR_RAISE(auto isConcatenated,
+                                  ParquetConcatenator::concatenate(fragmentPaths, mergedFragmentsFilePath));
+            if (isConcatenated) {
+                std::cout << "[DataWriter] Concatenated " << fragmentPaths.size() << " fragments from folder "
+                          << base_dir << std::endl;
+                return arrow::Status::OK();
+            }
+        }
+        // Otherwise the fragments are re-encoded, one batch at a time
         arrow::fs::FileSelector selector;
         selector.base_dir = base_dir;
         ARROW_ASSIGN_OR_RAISE(auto factory,
                               arrow::dataset::FileSystemDatasetFactory::Make(
-                                      filesystem,
+                                      fragmentFormat.getFileSystem(filesystem),
                                       selector,
-                                      std::make_shared<arrow::dataset::ParquetFileFormat>(),
+                                      fragmentFormat.getFileFormat(),
                                       arrow::dataset::FileSystemFactoryOptions()
                               )
         );
@@ -111,25 +190,40 @@ namespace storage {
         }
         ARROW_ASSIGN_OR_RAISE(auto scan_builder, dataset->NewScan());
         ARROW_ASSIGN_OR_RAISE(auto scanner, scan_builder->Finish());
-        auto mergedTable = scanner->ToTable();
-        if (mergedTable.status() == arrow::Status::OK()){
-            std::filesystem::path mergedFragmentsFilePath = base_dir + common::Settings::fileExtension;
-            std::cout << "[DataWriter] Exporting merged batches from folder " << base_dir << std::endl;
-            std::cout << "[DataWriter] Merged table has " << mergedTable.ValueOrDie()->num_rows() << " rows" << std::endl;
-            ARROW_RETURN_NOT_OK(storage::DataWriter::WriteTableToDisk(*mergedTable, mergedFragmentsFilePath));
-            mergedTable->reset();
-        } else{
-            std::cout << "[DataWriter] Error while scanning merged table " << mergedTable.status().ToString() << std::endl;
+        ARROW_ASSIGN_OR_RAISE(auto batchReader, scanner->ToRecordBatchReader());
+        std::cout << "[DataWriter] Exporting merged batches from folder " << base_dir << std::endl;
+        ARROW_ASSIGN_OR_RAISE(auto outfile, arrow::io::FileOutputStream::Open(mergedFragmentsFilePath.string()));
+        std::unique_ptr<parquet::arrow::FileWriter> writer;
+        ARROW_ASSIGN_OR_RAISE(writer, parquet::arrow::FileWriter::Open(*batchReader->schema(),
+                                                                       arrow::default_memory_pool(),
+                                                                       outfile,
+                                                                       getWriterProperties(),
+                                                                       getArrowWriterProperties()));
+        int64_t numRows = 0;
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> batch;
+            ARROW_RETURN_NOT_OK(batchReader->ReadNext(&batch));
+            if (batch == nullptr) {
+                break;
+            }
+            // Batches are buffered into row groups of the writer properties
+            ARROW_RETURN_NOT_OK(writer->WriteRecordBatch(*batch));
+            numRows += batch->num_rows();
         }
+        ARROW_RETURN_NOT_OK(writer->Close());
+        std::cout << "[DataWriter] Merged table has " << numRows << " rows" << std::endl;
         return arrow::Status::OK();
     }
 
-    // Restore a clean state by removing all Parquet files from a specified folder
+    // Restore a clean state by removing all Parquet files (and their bloom filters) from a specified folder, together
+    // with the intermediate files left in the IPC spill format
     void DataWriter::cleanUpFolder(const std::filesystem::path &folder){
         if (std::filesystem::is_directory(folder)){
             for (const auto &folderIter : std::filesystem::recursive_directory_iterator(folder))
             {
-                if (folderIter.path().extension() == common::Settings::fileExtension)
+                if (folderIter.path().extension() == common::Settings::fileExtension ||
+                    folderIter.path().extension() == BloomFilterIndex::fileSuffix ||
+                    folderIter.path().extension() == SpillFormat::ipcExtension)
                 {
                     try {
                         std::filesystem::remove(folderIter.path());
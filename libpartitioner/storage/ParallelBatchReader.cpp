@@ -0,0 +1,153 @@
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+
+#include "storage/ParallelBatchReader.h"
+
+namespace storage {
+
+    ParallelBatchReader::ParallelBatchReader(FileReaderFactory readerFactory,
+                                             std::shared_ptr<arrow::Schema> schema,
+                                             std::vector<int> rowGroups,
+                                             std::vector<int> columnIndexes,
+                                             bool orderedBatches,
+                                             size_t numThreads,
+                                             size_t maxQueuedBatches) {
+        factory = std::move(readerFactory);
+        outputSchema = std::move(schema);
+        rowGroupIndexes = std::move(rowGroups);
+        columns = std::move(columnIndexes);
+        ordered = orderedBatches;
+        maxQueued = std::max(maxQueuedBatches, (size_t) 1);
+        auto numDecoders = std::min(std::max(numThreads, (size_t) 1), rowGroupIndexes.size());
+        for (size_t i = 0; i < numDecoders; ++i) {
+            decoders.emplace_back([this]() { decodeLoop(); });
+        }
+    }
+
+    ParallelBatchReader::~ParallelBatchReader() {
+        stop();
+    }
+
+    std::shared_ptr<arrow::Schema> ParallelBatchReader::schema() const {
+        return outputSchema;
+    }
+
+    // Decoding thread: claim row groups until none is left, the reader is closed or another thread failed
+    void ParallelBatchReader::decodeLoop() {
+        auto fileReader = factory();
+        if (!fileReader.ok()) {
+            std::lock_guard<std::mutex> lock(mutex);
+            decodeStatus = fileReader.status();
+            batchReady.notify_all();
+            return;
+        }
+        while (true) {
+            size_t position;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping || !decodeStatus.ok() || nextClaimed >= rowGroupIndexes.size()) {
+                    break;
+                }
+                position = nextClaimed++;
+                pending[position];
+            }
+            std::shared_ptr<arrow::RecordBatchReader> rowGroupReader;
+            auto status = fileReader.ValueOrDie()->GetRecordBatchReader({rowGroupIndexes[position]}, columns,
+                                                                        &rowGroupReader);
+            while (status.ok()) {
+                std::shared_ptr<arrow::RecordBatch> batch;
+                status = rowGroupReader->ReadNext(&batch);
+                if (!status.ok() || batch == nullptr) {
+                    break;
+                }
+                std::unique_lock<std::mutex> lock(mutex);
+                // The row group being delivered always goes through, the queue is drained by the caller anyway
+                queueNotFull.wait(lock, [this, position]() {
+                    return stopping || queuedBatches < maxQueued || (ordered && position == nextDelivered);
+                });
+                if (stopping) {
+                    return;
+                }
+                pending[position].batches.emplace_back(std::move(batch));
+                queuedBatches += 1;
+                batchReady.notify_all();
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!status.ok() && decodeStatus.ok()) {
+                decodeStatus = status;
+            }
+            if (stopping) {
+                return;
+            }
+            pending[position].finished = true;
+            batchReady.notify_all();
+        }
+    }
+
+    arrow::Status ParallelBatchReader::ReadNext(std::shared_ptr<arrow::RecordBatch> *batch) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            if (!decodeStatus.ok()) {
+                *batch = nullptr;
+                return decodeStatus;
+            }
+            if (stopping) {
+                *batch = nullptr;
+                return arrow::Status::OK();
+            }
+            auto rowGroup = ordered ? pending.find(nextDelivered) : pending.begin();
+            while (rowGroup != pending.end()) {
+                if (!rowGroup->second.batches.empty()) {
+                    *batch = std::move(rowGroup->second.batches.front());
+                    rowGroup->second.batches.pop_front();
+                    queuedBatches -= 1;
+                    numBatches += 1;
+                    queueNotFull.notify_all();
+                    return arrow::Status::OK();
+                }
+                if (!rowGroup->second.finished) {
+                    rowGroup = ordered ? pending.end() : std::next(rowGroup);
+                    continue;
+                }
+                // A row group fully delivered
+                rowGroup = pending.erase(rowGroup);
+                if (ordered) {
+                    nextDelivered += 1;
+                    queueNotFull.notify_all();
+                    rowGroup = pending.find(nextDelivered);
+                }
+            }
+            bool claimedAll = nextClaimed >= rowGroupIndexes.size();
+            if ((ordered && nextDelivered >= rowGroupIndexes.size()) || (!ordered && claimedAll && pending.empty())) {
+                *batch = nullptr;
+                std::cout << "[ParallelBatchReader] Read " << numBatches << " batches from " << rowGroupIndexes.size()
+                          << " row groups on " << decoders.size() << " threads" << std::endl;
+                return arrow::Status::OK();
+            }
+            batchReady.wait(lock);
+        }
+    }
+
+    arrow::Status ParallelBatchReader::Close() {
+        stop();
+        return arrow::Status::OK();
+    }
+
+    void ParallelBatchReader::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            pending.clear();
+            queuedBatches = 0;
+        }
+        queueNotFull.notify_all();
+        batchReady.notify_all();
+        for (auto &decoder: decoders) {
+            if (decoder.joinable()) {
+                decoder.join();
+            }
+        }
+    }
+
+} // storage
@@ -0,0 +1,354 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include <arrow/io/api.h>
+#include <parquet/exception.h>
+#include <parquet/file_reader.h>
+
+#include "storage/ParquetConcatenator.h"
+
+namespace storage {
+
+    namespace {
+        const std::string parquetMagic = "PAR1";
+
+        // Copy of a serialized footer (Thrift compact protocol) with the offsets of every row group moved by the
+        // shift of its file. Only the fields holding offsets are decoded, the rest is copied as it is. The field ids
+        // are the ones of parquet.thrift
+        class FooterRewriter {
+        public:
+            FooterRewriter(const uint8_t *footerData, int64_t footerSize, const std::vector<int64_t> &rowGroupShifts) :
+                    data(footerData), size(footerSize), shifts(rowGroupShifts) {}
+
+            // NotImplemented when the footer points outside the row groups (page index, bloom filters, encryption)
+            arrow::Result<std::string> rewrite() {
+                ARROW_RETURN_NOT_OK(copyStruct(FILE_METADATA));
+                if (position != size) {
+                    return arrow::Status::Invalid("Unexpected bytes after the footer");
+                }
+                return output;
+            }
+
+        private:
+            enum StructKind { FILE_METADATA, ROW_GROUP, COLUMN_CHUNK, COLUMN_METADATA, OTHER };
+            enum CompactType : uint8_t {
+                BOOLEAN_TRUE = 1, BOOLEAN_FALSE = 2, BYTE = 3, I16 = 4, I32 = 5, I64 = 6, DOUBLE = 7, BINARY = 8,
+                LIST = 9, SET = 10, MAP = 11, STRUCT = 12
+            };
+
+            arrow::Result<uint8_t> readByte() {
+                if (position >= size) {
+                    return arrow::Status::Invalid("Truncated footer");
+                }
+                return data[position++];
+            }
+
+            arrow::Result<uint64_t> readVarint() {
+                uint64_t value = 0;
+                for (int shift = 0; shift < 64; shift += 7) {
+                    ARROW_ASSIGN_OR_RAISE(auto byte, readByte());
+                    value |= (uint64_t) (byte & 0x7F) << shift;
+                    if ((byte & 0x80) == 0) {
+                        return value;
+                    }
+                }
+                return arrow::Status::Invalid("Malformed varint in the footer");
+            }
+
+            void writeVarint(uint64_t value) {
+                while (value >= 0x80) {
+                    output.push_back((char) ((value & 0x7F) | 0x80));
+                    value >>= 7;
+                }
+                output.push_back((char) value);
+            }
+
+            arrow::Status copyBytes(int64_t numBytes) {
+                if (numBytes < 0 || position + numBytes > size) {
+                    return arrow::Status::Invalid("Truncated footer");
+                }
+                output.append((const char *) data + position, numBytes);
+                position += numBytes;
+                return arrow::Status::OK();
+            }
+
+            arrow::Status copyVarint() {
+                auto begin = position;
+                ARROW_RETURN_NOT_OK(readVarint());
+                output.append((const char *) data + begin, position - begin);
+                return arrow::Status::OK();
+            }
+
+            arrow::Status shiftOffset() {
+                ARROW_ASSIGN_OR_RAISE(auto encoded, readVarint());
+                auto offset = (int64_t) (encoded >> 1) ^ -(int64_t) (encoded & 1);
+                offset += shifts[rowGroup];
+                writeVarint(((uint64_t) offset << 1) ^ (uint64_t) (offset >> 63));
+                return arrow::Status::OK();
+            }
+
+            // Row groups come from several files, the ordinal is the position in the new file
+            arrow::Status writeOrdinal() {
+                ARROW_RETURN_NOT_OK(readVarint());
+                auto ordinal = (int64_t) rowGroup;
+                writeVarint(((uint64_t) ordinal << 1) ^ (uint64_t) (ordinal >> 63));
+                return arrow::Status::OK();
+            }
+
+            arrow::Status copyStruct(StructKind kind) {
+                int16_t fieldId = 0;
+                while (true) {
+                    ARROW_ASSIGN_OR_RAISE(auto header, readByte());
+                    output.push_back((char) header);
+                    if (header == 0) {
+                        return arrow::Status::OK();
+                    }
+                    auto type = (uint8_t) (header & 0x0F);
+                    auto delta = (uint8_t) (header >> 4);
+                    if (delta == 0) {
+                        auto begin = position;
+                        ARROW_ASSIGN_OR_RAISE(auto encodedId, readVarint());
+                        output.append((const char *) data + begin, position - begin);
+                        fieldId = (int16_t) ((encodedId >> 1) ^ -(int64_t) (encodedId & 1));
+                    } else {
+                        fieldId = (int16_t) (fieldId + delta);
+                    }
+                    if (type == BOOLEAN_TRUE || type == BOOLEAN_FALSE) {
+                        continue;
+                    }
+                    ARROW_RETURN_NOT_OK(copyField(kind, fieldId, type));
+                }
+            }
+
+            arrow::Status copyField(StructKind kind, int16_t fieldId, uint8_t type) {
+                switch (kind) {
+                    case FILE_METADATA:
+                        // 4: row_groups, 8: encryption_algorithm
+                        if (fieldId == 4 && type == LIST) {
+                            return copyList(ROW_GROUP);
+                        }
+                        if (fieldId == 8 || fieldId == 9) {
+                            return arrow::Status::NotImplemented("Encrypted footer");
+                        }
+                        break;
+                    case ROW_GROUP:
+                        // 1: columns, 5: file_offset, 7: ordinal
+                        if (fieldId == 1 && type == LIST) {
+                            return copyList(COLUMN_CHUNK);
+                        }
+                        if (fieldId == 5 && type == I64) {
+                            return shiftOffset();
+                        }
+                        if (fieldId == 7 && type == I16) {
+                            return writeOrdinal();
+                        }
+                        break;
+                    case COLUMN_CHUNK:
+                        // 1: file_path, 2: file_offset, 3: meta_data, 4-7: page index, 8-9: encryption
+                        if (fieldId == 2 && type == I64) {
+                            return shiftOffset();
+                        }
+                        if (fieldId == 3 && type == STRUCT) {
+                            return copyStruct(COLUMN_METADATA);
+                        }
+                        if (fieldId == 1 || (fieldId >= 4 && fieldId <= 9)) {
+                            return arrow::Status::NotImplemented("Column chunk with data outside its row group");
+                        }
+                        break;
+                    case COLUMN_METADATA:
+                        // 9: data_page_offset, 10: index_page_offset, 11: dictionary_page_offset, 14-15: bloom filter
+                        if ((fieldId == 9 || fieldId == 10 || fieldId == 11) && type == I64) {
+                            return shiftOffset();
+                        }
+                        if (fieldId == 14 || fieldId == 15) {
+                            return arrow::Status::NotImplemented("Column chunk with a bloom filter");
+                        }
+                        break;
+                    case OTHER:
+                        break;
+                }
+                return copyValue(type, OTHER);
+            }
+
+            arrow::Status copyList(StructKind elementKind) {
+                ARROW_ASSIGN_OR_RAISE(auto header, readByte());
+                output.push_back((char) header);
+                uint64_t numElements = header >> 4;
+                if (numElements == 15) {
+                    auto begin = position;
+                    ARROW_ASSIGN_OR_RAISE(numElements, readVarint());
+                    output.append((const char *) data + begin, position - begin);
+                }
+                auto elementType = (uint8_t) (header & 0x0F);
+                for (uint64_t i = 0; i < numElements; ++i) {
+                    if (elementKind == ROW_GROUP) {
+                        if (i >= shifts.size()) {
+                            return arrow::Status::Invalid("More row groups in the footer than in the files");
+                        }
+                        rowGroup = i;
+                    }
+                    ARROW_RETURN_NOT_OK(copyValue(elementType, elementKind));
+                }
+                return arrow::Status::OK();
+            }
+
+            arrow::Status copyValue(uint8_t type, StructKind structKind) {
+                switch (type) {
+                    case BOOLEAN_TRUE:
+                    case BOOLEAN_FALSE:
+                        // An element of a list, the fields of a struct keep the value in their header
+                        return copyBytes(1);
+                    case BYTE:
+                        return copyBytes(1);
+                    case I16:
+                    case I32:
+                    case I64:
+                        return copyVarint();
+                    case DOUBLE:
+                        return copyBytes(8);
+                    case BINARY: {
+                        auto begin = position;
+                        ARROW_ASSIGN_OR_RAISE(auto length, readVarint());
+                        output.append((const char *) data + begin, position - begin);
+                        return copyBytes((int64_t) length);
+                    }
+                    case LIST:
+                    case SET:
+                        return copyList(OTHER);
+                    case MAP: {
+                        auto begin = position;
+                        ARROW_ASSIGN_OR_RAISE(auto numEntries, readVarint());
+                        output.append((const char *) data + begin, position - begin);
+                        if (numEntries == 0) {
+                            return arrow::Status::OK();
+                        }
+                        ARROW_ASSIGN_OR_RAISE(auto types, readByte());
+                        output.push_back((char) types);
+                        for (uint64_t i = 0; i < numEntries; ++i) {
+                            ARROW_RETURN_NOT_OK(copyValue((uint8_t) (types >> 4), OTHER));
+                            ARROW_RETURN_NOT_OK(copyValue((uint8_t) (types & 0x0F), OTHER));
+                        }
+                        return arrow::Status::OK();
+                    }
+                    case STRUCT:
+                        return copyStruct(structKind);
+                    default:
+                        return arrow::Status::Invalid("Unknown type ", (int) type, " in the footer");
+                }
+            }
+
+            const uint8_t *data;
+            int64_t size;
+            const std::vector<int64_t> &shifts;
+            int64_t position = 0;
+            size_t rowGroup = 0;
+            std::string output;
+        };
+    }
+
+    arrow::Result<bool> ParquetConcatenator::concatenate(const std::vector<std::filesystem::path> &inputPaths,
+                                                         const std::filesystem::path &outputPath) {
+        if (inputPaths.empty()) {
+            return false;
+        }
+        // Footers of the files, and the size of the row groups between the leading magic and the footer
+        std::vector<std::shared_ptr<arrow::io::ReadableFile>> inputFiles;
+        std::vector<std::shared_ptr<parquet::FileMetaData>> metadata;
+        std::vector<int64_t> dataSizes;
+        for (const auto &inputPath: inputPaths) {
+            ARROW_ASSIGN_OR_RAISE(auto inputFile, arrow::io::ReadableFile::Open(inputPath.string()));
+            ARROW_ASSIGN_OR_RAISE(auto fileSize, inputFile->GetSize());
+            try {
+                metadata.emplace_back(parquet::ReadMetaData(inputFile));
+            } catch (const parquet::ParquetException &e) {
+                return arrow::Status::IOError("Could not read the footer of ", inputPath.string(), ": ", e.what());
+            }
+            auto dataSize = fileSize - (int64_t) metadata.back()->size() - 8 - (int64_t) parquetMagic.size();
+            if (dataSize < 0) {
+                return arrow::Status::Invalid("Invalid Parquet file ", inputPath.string());
+            }
+            inputFiles.emplace_back(inputFile);
+            dataSizes.emplace_back(dataSize);
+        }
+        if (!haveSameSchema(metadata)) {
+            std::cout << "[ParquetConcatenator] Files with different schemas, they need to be re-encoded" << std::endl;
+            return false;
+        }
+
+        // The row groups of a file move by the size of the row groups of the files before it
+        std::vector<int64_t> rowGroupShifts;
+        int64_t dataOffset = 0;
+        for (size_t i = 0; i < metadata.size(); ++i) {
+            rowGroupShifts.insert(rowGroupShifts.end(), metadata[i]->num_row_groups(), dataOffset);
+            dataOffset += dataSizes[i];
+        }
+        auto mergedMetadata = metadata.front();
+        std::shared_ptr<arrow::Buffer> serializedMetadata;
+        try {
+            for (size_t i = 1; i < metadata.size(); ++i) {
+                mergedMetadata->AppendRowGroups(*metadata[i]);
+            }
+            ARROW_ASSIGN_OR_RAISE(auto metadataStream, arrow::io::BufferOutputStream::Create());
+            mergedMetadata->WriteTo(metadataStream.get());
+            ARROW_ASSIGN_OR_RAISE(serializedMetadata, metadataStream->Finish());
+        } catch (const parquet::ParquetException &e) {
+            std::cout << "[ParquetConcatenator] Footers cannot be merged: " << e.what() << std::endl;
+            return false;
+        }
+        FooterRewriter footerRewriter(serializedMetadata->data(), serializedMetadata->size(), rowGroupShifts);
+        auto footer = footerRewriter.rewrite();
+        if (footer.status().IsNotImplemented()) {
+            std::cout << "[ParquetConcatenator] " << footer.status().message() << ", the files need to be re-encoded"
+                      << std::endl;
+            return false;
+        }
+        ARROW_RETURN_NOT_OK(footer.status());
+
+        // Magic, row groups of every file, footer, footer length and magic again
+        ARROW_ASSIGN_OR_RAISE(auto outfile, arrow::io::FileOutputStream::Open(outputPath.string()));
+        ARROW_RETURN_NOT_OK(outfile->Write(parquetMagic.data(), (int64_t) parquetMagic.size()));
+        for (size_t i = 0; i < inputFiles.size(); ++i) {
+            auto position = (int64_t) parquetMagic.size();
+            auto end = position + dataSizes[i];
+            while (position < end) {
+                ARROW_ASSIGN_OR_RAISE(auto chunk, inputFiles[i]->ReadAt(position, std::min(copyBufferSize, end - position)));
+                if (chunk->size() == 0) {
+                    return arrow::Status::IOError("Unexpected end of file ", inputPaths[i].string());
+                }
+                ARROW_RETURN_NOT_OK(outfile->Write(chunk));
+                position += chunk->size();
+            }
+            ARROW_RETURN_NOT_OK(inputFiles[i]->Close());
+        }
+        const auto &footerBytes = footer.ValueUnsafe();
+        ARROW_RETURN_NOT_OK(outfile->Write(footerBytes.data(), (int64_t) footerBytes.size()));
+        auto footerLength = (uint32_t) footerBytes.size();
+        uint8_t footerLengthBytes[4] = {(uint8_t) footerLength, (uint8_t) (footerLength >> 8),
+                                        (uint8_t) (footerLength >> 16), (uint8_t) (footerLength >> 24)};
+        ARROW_RETURN_NOT_OK(outfile->Write(footerLengthBytes, 4));
+        ARROW_RETURN_NOT_OK(outfile->Write(parquetMagic.data(), (int64_t) parquetMagic.size()));
+        ARROW_RETURN_NOT_OK(outfile->Close());
+        std::cout << "[ParquetConcatenator] Concatenated " << inputPaths.size() << " files with "
+                  << rowGroupShifts.size() << " row groups into " << outputPath << std::endl;
+        return true;
+    }
+
+    // Same columns and same Arrow schema stored in the key value metadata
+    bool ParquetConcatenator::haveSameSchema(const std::vector<std::shared_ptr<parquet::FileMetaData>> &metadata) {
+        const auto &first = metadata.front();
+        for (size_t i = 1; i < metadata.size(); ++i) {
+            if (!metadata[i]->schema()->Equals(*first->schema())) {
+                return false;
+            }
+            auto keyValues = metadata[i]->key_value_metadata();
+            auto firstKeyValues = first->key_value_metadata();
+            if ((keyValues == nullptr) != (firstKeyValues == nullptr) ||
+                (keyValues != nullptr && !keyValues->Equals(*firstKeyValues))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,127 @@
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include "storage/ProgressJournal.h"
+
+namespace storage {
+
+    ProgressJournal::ProgressJournal(const std::filesystem::path &outputFolder) {
+        journalPath = outputFolder / fileName;
+    }
+
+    ProgressJournal::~ProgressJournal() {
+        if (fileDescriptor >= 0) {
+            ::close(fileDescriptor);
+        }
+    }
+
+    // One entry per line, <step>\t<key>. A line without its newline was cut by a crash and is ignored
+    std::vector<std::pair<std::string, std::string>> ProgressJournal::readEntries(const std::filesystem::path &path,
+                                                                                  size_t &validLength) {
+        std::vector<std::pair<std::string, std::string>> journalEntries;
+        validLength = 0;
+        std::ifstream journalFile(path, std::ios::binary);
+        std::stringstream content;
+        content << journalFile.rdbuf();
+        std::string journalContent = content.str();
+        size_t lineBegin = 0;
+        while (true) {
+            auto lineEnd = journalContent.find('\n', lineBegin);
+            if (lineEnd == std::string::npos) {
+                break;
+            }
+            auto line = journalContent.substr(lineBegin, lineEnd - lineBegin);
+            auto separator = line.find('\t');
+            if (separator == std::string::npos) {
+                break;
+            }
+            journalEntries.emplace_back(line.substr(0, separator), line.substr(separator + 1));
+            lineBegin = lineEnd + 1;
+            validLength = lineBegin;
+        }
+        return journalEntries;
+    }
+
+    arrow::Status ProgressJournal::open(const std::string &runFingerprint, bool resume) {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        resumed = false;
+        size_t validLength = 0;
+        if (resume && std::filesystem::exists(journalPath)) {
+            auto journalEntries = readEntries(journalPath, validLength);
+            bool sameRun = !journalEntries.empty() && journalEntries.front().first == fingerprintStep &&
+                           journalEntries.front().second == runFingerprint;
+            if (sameRun) {
+                entries.insert(journalEntries.begin() + 1, journalEntries.end());
+                resumed = true;
+                std::cout << "[ProgressJournal] Resuming run from " << entries.size() << " journal entries" << std::endl;
+            } else {
+                std::cout << "[ProgressJournal] Journal belongs to a different run, starting from scratch" << std::endl;
+            }
+        }
+
+        int flags = O_WRONLY | O_CREAT | O_APPEND;
+        if (!resumed) {
+            flags |= O_TRUNC;
+        }
+        fileDescriptor = ::open(journalPath.c_str(), flags, 0644);
+        if (fileDescriptor < 0) {
+            return arrow::Status::IOError("Could not open progress journal ", journalPath.string());
+        }
+        if (resumed) {
+            // Drop the entry cut by the crash, if any, before appending after it
+            if (::ftruncate(fileDescriptor, (off_t) validLength) != 0) {
+                return arrow::Status::IOError("Could not truncate progress journal ", journalPath.string());
+            }
+            return arrow::Status::OK();
+        }
+        std::string line = fingerprintStep + "\t" + runFingerprint + "\n";
+        if (::write(fileDescriptor, line.data(), line.size()) != (ssize_t) line.size() || ::fsync(fileDescriptor) != 0) {
+            return arrow::Status::IOError("Could not write progress journal ", journalPath.string());
+        }
+        return arrow::Status::OK();
+    }
+
+    // Append an entry and sync it, the step counts as done only once this returns
+    arrow::Status ProgressJournal::record(const std::string &step, const std::string &key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (fileDescriptor < 0) {
+            return arrow::Status::Invalid("Progress journal not open");
+        }
+        std::string line = step + "\t" + key + "\n";
+        if (::write(fileDescriptor, line.data(), line.size()) != (ssize_t) line.size() || ::fsync(fileDescriptor) != 0) {
+            return arrow::Status::IOError("Could not write progress journal ", journalPath.string());
+        }
+        entries.emplace(step, key);
+        return arrow::Status::OK();
+    }
+
+    bool ProgressJournal::contains(const std::string &step, const std::string &key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return entries.find({step, key}) != entries.end();
+    }
+
+    bool ProgressJournal::isResumed() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return resumed;
+    }
+
+    bool ProgressJournal::canResume(const std::filesystem::path &outputFolder) {
+        auto path = outputFolder / fileName;
+        if (!std::filesystem::exists(path)) {
+            return false;
+        }
+        size_t validLength = 0;
+        auto journalEntries = readEntries(path, validLength);
+        for (const auto &[step, key]: journalEntries) {
+            if (step == finishedStep) {
+                return false;
+            }
+        }
+        return !journalEntries.empty();
+    }
+
+} // storage
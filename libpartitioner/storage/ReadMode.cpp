@@ -0,0 +1,61 @@
+#include "storage/ReadMode.h"
+
+namespace storage {
+
+    ReadMode ReadMode::getDefaultMode() {
+        return {};
+    }
+
+    arrow::Result<ReadMode> ReadMode::fromName(const std::string &modeName) {
+        ReadMode mode;
+        mode.name = modeName;
+        if (modeName == defaultName) {
+            return mode;
+        }
+        if (modeName == memoryMapName) {
+            // Pages are served from the mapping, a buffered copy would only add a memcpy
+            mode.memoryMap = true;
+            mode.bufferedStream = false;
+            return mode;
+        }
+        if (modeName == preBufferName) {
+            // Coalesced reads of whole column chunks replace the many small reads of the buffered stream
+            mode.preBuffer = true;
+            mode.bufferedStream = false;
+            return mode;
+        }
+        if (modeName == parallelName || modeName == parallelUnorderedName) {
+            mode.preBuffer = true;
+            mode.bufferedStream = false;
+            mode.parallelRowGroups = true;
+            mode.orderedBatches = modeName == parallelName;
+            return mode;
+        }
+        return arrow::Status::Invalid("Unknown read mode <", modeName, ">");
+    }
+
+    std::vector<std::string> ReadMode::getNames() {
+        return {defaultName, memoryMapName, preBufferName, parallelName, parallelUnorderedName};
+    }
+
+    parquet::ReaderProperties ReadMode::getReaderProperties() const {
+        auto readerProperties = parquet::ReaderProperties(arrow::default_memory_pool());
+        if (bufferedStream) {
+            readerProperties.set_buffer_size(bufferSize);
+            readerProperties.enable_buffered_stream();
+        }
+        return readerProperties;
+    }
+
+    parquet::ArrowReaderProperties ReadMode::getArrowReaderProperties(int64_t batchSize) const {
+        // Columns are decoded on the calling thread, the parallel modes run one reader per row group instead
+        auto arrowReaderProperties = parquet::ArrowReaderProperties(/*use_threads=*/false);
+        arrowReaderProperties.set_batch_size(batchSize);
+        arrowReaderProperties.set_pre_buffer(preBuffer);
+        if (preBuffer) {
+            arrowReaderProperties.set_cache_options(arrow::io::CacheOptions::LazyDefaults());
+        }
+        return arrowReaderProperties;
+    }
+
+}
@@ -0,0 +1,160 @@
+#include <iostream>
+
+#include <arrow/io/api.h>
+#include <parquet/arrow/reader.h>
+
+#include "common/Settings.h"
+#include "storage/DataWriter.h"
+#include "storage/SpillFormat.h"
+
+namespace storage {
+
+    namespace {
+        // Batches of an IPC file, one per batch written
+        class IpcFileBatchReader : public arrow::RecordBatchReader {
+        public:
+            explicit IpcFileBatchReader(std::shared_ptr<arrow::ipc::RecordBatchFileReader> reader) :
+                    fileReader(std::move(reader)) {}
+            std::shared_ptr<arrow::Schema> schema() const override {
+                return fileReader->schema();
+            }
+            arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch> *batch) override {
+                if (nextBatch >= fileReader->num_record_batches()) {
+                    *batch = nullptr;
+                    return arrow::Status::OK();
+                }
+                ARROW_ASSIGN_OR_RAISE(*batch, fileReader->ReadRecordBatch(nextBatch));
+                nextBatch += 1;
+                return arrow::Status::OK();
+            }
+        private:
+            std::shared_ptr<arrow::ipc::RecordBatchFileReader> fileReader;
+            int nextBatch = 0;
+        };
+
+        // Batches of a Parquet file, the batch reader does not keep its file reader alive
+        class ParquetFileBatchReader : public arrow::RecordBatchReader {
+        public:
+            ParquetFileBatchReader(std::unique_ptr<parquet::arrow::FileReader> reader,
+                                   std::shared_ptr<arrow::RecordBatchReader> recordBatchReader) :
+                    fileReader(std::move(reader)), batchReader(std::move(recordBatchReader)) {}
+            std::shared_ptr<arrow::Schema> schema() const override {
+                return batchReader->schema();
+            }
+            arrow::Status ReadNext(std::shared_ptr<arrow::RecordBatch> *batch) override {
+                return batchReader->ReadNext(batch);
+            }
+        private:
+            std::unique_ptr<parquet::arrow::FileReader> fileReader;
+            std::shared_ptr<arrow::RecordBatchReader> batchReader;
+        };
+    }
+
+    SpillFormat SpillFormat::getDefaultFormat() {
+        return {};
+    }
+
+    arrow::Result<SpillFormat> SpillFormat::fromName(const std::string &formatName) {
+        SpillFormat format;
+        format.name = formatName;
+        if (formatName == parquetName) {
+            return format;
+        }
+        if (formatName == ipcName || formatName == ipcLz4Name || formatName == ipcMemoryMapName) {
+            format.ipc = true;
+            if (formatName == ipcLz4Name) {
+                format.compression = arrow::Compression::LZ4_FRAME;
+            }
+            // Compressed buffers are copied when decompressed anyway, only the uncompressed ones gain from a mapping
+            format.memoryMap = formatName == ipcMemoryMapName;
+            return format;
+        }
+        return arrow::Status::Invalid("Unknown spill format <", formatName, ">");
+    }
+
+    std::vector<std::string> SpillFormat::getNames() {
+        return {parquetName, ipcName, ipcLz4Name, ipcMemoryMapName};
+    }
+
+    bool SpillFormat::isParquet() const {
+        return !ipc;
+    }
+
+    std::string SpillFormat::getExtension() const {
+        return ipc ? ipcExtension : common::Settings::fileExtension;
+    }
+
+    arrow::Status SpillFormat::writeTable(const std::shared_ptr<arrow::Table> &table,
+                                          const std::filesystem::path &outputPath) const {
+        if (!ipc) {
+            auto parquetTable = table;
+            auto parquetPath = outputPath;
+            return DataWriter::WriteTableToDisk(parquetTable, parquetPath);
+        }
+        auto options = arrow::ipc::IpcWriteOptions::Defaults();
+        if (compression != arrow::Compression::UNCOMPRESSED) {
+            ARROW_ASSIGN_OR_RAISE(options.codec, arrow::util::Codec::Create(compression));
+        }
+        ARROW_ASSIGN_OR_RAISE(auto outfile, arrow::io::FileOutputStream::Open(outputPath.string()));
+        ARROW_ASSIGN_OR_RAISE(auto writer, arrow::ipc::MakeFileWriter(outfile, table->schema(), options));
+        std::cout << "[SpillFormat] Writing " << table->num_rows() << " rows as " << name << std::endl;
+        ARROW_RETURN_NOT_OK(writer->WriteTable(*table));
+        ARROW_RETURN_NOT_OK(writer->Close());
+        // The IPC writer leaves its sink open
+        ARROW_RETURN_NOT_OK(outfile->Close());
+        return arrow::Status::OK();
+    }
+
+    arrow::Status SpillFormat::writeBatch(const std::shared_ptr<arrow::RecordBatch> &recordBatch,
+                                          const std::filesystem::path &outputPath) const {
+        ARROW_ASSIGN_OR_RAISE(auto table, arrow::Table::FromRecordBatches({recordBatch}));
+        return writeTable(table, outputPath);
+    }
+
+    arrow::Result<std::shared_ptr<arrow::RecordBatchReader>> SpillFormat::openReader(
+            const std::filesystem::path &inputPath, int64_t batchSize) const {
+        if (ipc) {
+            std::shared_ptr<arrow::io::RandomAccessFile> infile;
+            if (memoryMap) {
+                ARROW_ASSIGN_OR_RAISE(infile, arrow::io::MemoryMappedFile::Open(inputPath.string(),
+                                                                                arrow::io::FileMode::READ));
+            } else {
+                ARROW_ASSIGN_OR_RAISE(infile, arrow::io::ReadableFile::Open(inputPath.string()));
+            }
+            ARROW_ASSIGN_OR_RAISE(auto fileReader, arrow::ipc::RecordBatchFileReader::Open(infile));
+            return std::make_shared<IpcFileBatchReader>(fileReader);
+        }
+        auto readerProperties = parquet::ReaderProperties(arrow::default_memory_pool());
+        readerProperties.set_buffer_size(common::Settings::bufferSize);
+        readerProperties.enable_buffered_stream();
+        auto arrowReaderProperties = parquet::ArrowReaderProperties();
+        arrowReaderProperties.set_batch_size(batchSize);
+        parquet::arrow::FileReaderBuilder readerBuilder;
+        ARROW_RETURN_NOT_OK(readerBuilder.OpenFile(inputPath.string(), /*memory_map=*/false, readerProperties));
+        readerBuilder.memory_pool(arrow::default_memory_pool());
+        readerBuilder.properties(arrowReaderProperties);
+        ARROW_ASSIGN_OR_RAISE(auto fileReader, readerBuilder.Build());
+        std::shared_ptr<arrow::RecordBatchReader> batchReader;
+        ARROW_RETURN_NOT_OK(fileReader->GetRecordBatchReader(&batchReader));
+        return std::make_shared<ParquetFileBatchReader>(std::move(fileReader), batchReader);
+    }
+
+    std::shared_ptr<arrow::dataset::FileFormat> SpillFormat::getFileFormat() const {
+        if (ipc) {
+            return std::make_shared<arrow::dataset::IpcFileFormat>();
+        }
+        return std::make_shared<arrow::dataset::ParquetFileFormat>();
+    }
+
+    // The local file system maps the files it opens when asked to, the other ones are kept as they are
+    std::shared_ptr<arrow::fs::FileSystem> SpillFormat::getFileSystem(
+            const std::shared_ptr<arrow::fs::FileSystem> &filesystem) const {
+        if (!memoryMap || filesystem->type_name() != "local") {
+            return filesystem;
+        }
+        auto options = arrow::fs::LocalFileSystemOptions::Defaults();
+        options.use_mmap = true;
+        return std::make_shared<arrow::fs::LocalFileSystem>(options);
+    }
+
+}
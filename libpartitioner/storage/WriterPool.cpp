@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <iostream>
+
+#include <arrow/array/concatenate.h>
+#include <arrow/util/byte_size.h>
+
+#include "storage/DataWriter.h"
+#include "storage/ParquetConcatenator.h"
+#include "storage/WriterPool.h"
+
+namespace storage {
+
+    // Keep at most maxOpenWriters Parquet writers open at the same time. Rows are buffered per partition and written
+    // as a row group when the row group threshold (or the memory budget of the buffers) is reached. When a writer is
+    // evicted its file is closed and becomes a sealed part: the parts of the same partition are concatenated in finish()
+    WriterPool::WriterPool(const std::filesystem::path &outputFolder,
+                           size_t maxOpenWriters,
+                           int64_t maxBufferedBytes,
+                           std::shared_ptr<parquet::WriterProperties> writerProperties) :
+            bufferReservation(common::MemoryGovernor::getInstance().reserve("WriterPool", maxBufferedBytes)) {
+        folder = outputFolder;
+        partsFolder = outputFolder / "_parts";
+        maxWriters = std::max(maxOpenWriters, (size_t) 1);
+        maxBytes = bufferReservation.getBytes();
+        properties = writerProperties != nullptr ? writerProperties : DataWriter::getWriterProperties();
+        arrowProperties = DataWriter::getArrowWriterProperties();
+        rowGroupSize = properties->max_row_group_length();
+    }
+
+    // A pool dropped before finish() completed, e.g. on an error path, leaves no writer open and no part behind
+    WriterPool::~WriterPool() {
+        if (!finished) {
+            abort();
+        }
+    }
+
+    arrow::Status WriterPool::append(uint32_t partitionId, const std::shared_ptr<arrow::RecordBatch> &rows) {
+        ARROW_ASSIGN_OR_RAISE(auto table, arrow::Table::FromRecordBatches({rows}));
+        return append(partitionId, table);
+    }
+
+    arrow::Status WriterPool::append(uint32_t partitionId, const std::shared_ptr<arrow::Table> &rows) {
+        if (finished || aborted) {
+            return arrow::Status::Invalid("Writer pool already ", finished ? "finished" : "aborted");
+        }
+        if (rows->num_rows() == 0) {
+            return arrow::Status::OK();
+        }
+        auto &sink = sinks[partitionId];
+        sink.totalRows += rows->num_rows();
+        // Large inputs skip the buffer and are written directly, split into row groups by the writer
+        if (sink.bufferedRows == 0 && rows->num_rows() >= rowGroupSize) {
+            sink.bufferedTables.emplace_back(rows);
+            sink.bufferedRows = rows->num_rows();
+            return flush(partitionId);
+        }
+        // Small inputs are often slices of a much larger batch: compact them so that the buffer does not keep the
+        // whole parent batch alive
+        std::vector<std::shared_ptr<arrow::ChunkedArray>> compactedColumns;
+        for (const auto &column: rows->columns()) {
+            ARROW_ASSIGN_OR_RAISE(auto compacted, arrow::Concatenate(column->chunks()));
+            compactedColumns.emplace_back(std::make_shared<arrow::ChunkedArray>(compacted));
+        }
+        auto compactedRows = arrow::Table::Make(rows->schema(), compactedColumns, rows->num_rows());
+        auto compactedBytes = (int64_t) arrow::util::TotalBufferSize(*compactedRows);
+        sink.bufferedTables.emplace_back(compactedRows);
+        sink.bufferedRows += compactedRows->num_rows();
+        sink.bufferedBytes += compactedBytes;
+        totalBufferedBytes += compactedBytes;
+        if (sink.bufferedRows >= rowGroupSize) {
+            ARROW_RETURN_NOT_OK(flush(partitionId));
+        }
+        if (totalBufferedBytes > maxBytes) {
+            ARROW_RETURN_NOT_OK(flushLargestBuffers());
+        }
+        return arrow::Status::OK();
+    }
+
+    // Write out the buffered rows of a partition, opening (and possibly evicting) a writer
+    arrow::Status WriterPool::flush(uint32_t partitionId) {
+        auto &sink = sinks.at(partitionId);
+        if (sink.bufferedRows == 0) {
+            return arrow::Status::OK();
+        }
+        ARROW_ASSIGN_OR_RAISE(auto table, arrow::ConcatenateTables(sink.bufferedTables));
+        if (sink.writer == nullptr) {
+            ARROW_RETURN_NOT_OK(openWriter(partitionId, table->schema()));
+        } else {
+            // Mark as most recently used
+            openWriters.splice(openWriters.begin(), openWriters, sink.lruPosition);
+        }
+        ARROW_RETURN_NOT_OK(sink.writer->WriteTable(*table, rowGroupSize));
+        totalBufferedBytes -= sink.bufferedBytes;
+        sink.bufferedTables.clear();
+        sink.bufferedRows = 0;
+        sink.bufferedBytes = 0;
+        return arrow::Status::OK();
+    }
+
+    // Release memory when the buffers exceed the budget, starting from the partitions holding the most data
+    arrow::Status WriterPool::flushLargestBuffers() {
+        std::vector<std::pair<int64_t, uint32_t>> bufferSizes;
+        for (const auto &[partitionId, sink]: sinks) {
+            if (sink.bufferedBytes > 0) {
+                bufferSizes.emplace_back(sink.bufferedBytes, partitionId);
+            }
+        }
+        std::sort(bufferSizes.rbegin(), bufferSizes.rend());
+        for (const auto &bufferSize: bufferSizes) {
+            if (totalBufferedBytes <= maxBytes / 2) {
+                break;
+            }
+            ARROW_RETURN_NOT_OK(flush(bufferSize.second));
+        }
+        return arrow::Status::OK();
+    }
+
+    arrow::Status WriterPool::openWriter(uint32_t partitionId, const std::shared_ptr<arrow::Schema> &schema) {
+        // Evict the least recently used writer when the pool is full
+        if (openWriters.size() >= maxWriters) {
+            ARROW_RETURN_NOT_OK(closeWriter(openWriters.back()));
+        }
+        if (!std::filesystem::exists(partsFolder)) {
+            std::filesystem::create_directories(partsFolder);
+        }
+        auto &sink = sinks.at(partitionId);
+        ARROW_ASSIGN_OR_RAISE(sink.outFile, arrow::io::FileOutputStream::Open(getPartPath(partitionId, sink.numParts)));
+        ARROW_ASSIGN_OR_RAISE(sink.writer, parquet::arrow::FileWriter::Open(*schema,
+                                                                            arrow::default_memory_pool(),
+                                                                            sink.outFile,
+                                                                            properties,
+                                                                            arrowProperties));
+        openWriters.push_front(partitionId);
+        sink.lruPosition = openWriters.begin();
+        return arrow::Status::OK();
+    }
+
+    // Close the writer of a partition: the current part file gets its footer and is sealed
+    arrow::Status WriterPool::closeWriter(uint32_t partitionId) {
+        auto &sink = sinks.at(partitionId);
+        if (sink.writer == nullptr) {
+            return arrow::Status::OK();
+        }
+        ARROW_RETURN_NOT_OK(sink.writer->Close());
+        ARROW_RETURN_NOT_OK(sink.outFile->Close());
+        sink.writer.reset();
+        sink.outFile.reset();
+        sink.numParts += 1;
+        openWriters.erase(sink.lruPosition);
+        return arrow::Status::OK();
+    }
+
+    // Flush every buffer, seal all parts and produce one file per partition
+    arrow::Status WriterPool::finish() {
+        if (finished) {
+            return arrow::Status::OK();
+        }
+        if (aborted) {
+            return arrow::Status::Invalid("Writer pool already aborted");
+        }
+        std::vector<uint32_t> partitionIds;
+        partitionIds.reserve(sinks.size());
+        for (const auto &sink: sinks) {
+            partitionIds.emplace_back(sink.first);
+        }
+        std::sort(partitionIds.begin(), partitionIds.end());
+        for (const auto &partitionId: partitionIds) {
+            ARROW_RETURN_NOT_OK(flush(partitionId));
+            ARROW_RETURN_NOT_OK(closeWriter(partitionId));
+            ARROW_RETURN_NOT_OK(mergeParts(partitionId));
+        }
+        std::filesystem::remove_all(partsFolder);
+        finished = true;
+        std::cout << "[WriterPool] Completed, written " << partitionIds.size() << " partitions" << std::endl;
+        return arrow::Status::OK();
+    }
+
+    // Drop the rows not yet written and the parts not yet merged. The partitions already merged by finish() stay
+    void WriterPool::abort() {
+        if (finished || aborted) {
+            return;
+        }
+        for (auto &[partitionId, sink]: sinks) {
+            // The part is discarded, an error while closing it is only reported
+            if (sink.writer != nullptr) {
+                auto closeStatus = sink.writer->Close();
+                closeStatus &= sink.outFile->Close();
+                if (!closeStatus.ok()) {
+                    std::cout << "[WriterPool] Could not close the part of partition " << partitionId << ": "
+                              << closeStatus.ToString() << std::endl;
+                }
+                sink.writer.reset();
+                sink.outFile.reset();
+            }
+            sink.bufferedTables.clear();
+            sink.bufferedRows = 0;
+            sink.bufferedBytes = 0;
+        }
+        openWriters.clear();
+        totalBufferedBytes = 0;
+        std::error_code removeError;
+        std::filesystem::remove_all(partsFolder, removeError);
+        aborted = true;
+        std::cout << "[WriterPool] Aborted, removed the parts of " << sinks.size() << " partitions" << std::endl;
+    }
+
+    // A partition with a single part is simply moved into place. Parts with the same schema are concatenated as they
+    // are, without decoding them. Otherwise (e.g. parts with a page index), they are streamed one row group at a time
+    // into the final file, so that memory stays bounded by the row group size
+    arrow::Status WriterPool::mergeParts(uint32_t partitionId) {
+        auto &sink = sinks.at(partitionId);
+        auto partitionPath = getPartitionPath(partitionId);
+        if (sink.numParts == 1) {
+            std::filesystem::rename(getPartPath(partitionId, 0), partitionPath);
+            return arrow::Status::OK();
+        }
+        std::vector<std::filesystem::path> partPaths;
+        for (uint32_t partIndex = 0; partIndex < sink.numParts; ++partIndex) {
+            partPaths.emplace_back(getPartPath(partitionId, partIndex));
+        }
+        ARROW_ASSIGN_OR_RAISE(auto isConcatenated, ParquetConcatenator::concatenate(partPaths, partitionPath));
+        if (isConcatenated) {
+            for (const auto &partPath: partPaths) {
+                std::filesystem::remove(partPath);
+            }
+            std::cout << "[WriterPool] Concatenated " << sink.numParts << " parts into partition " << partitionId
+                      << std::endl;
+            return arrow::Status::OK();
+        }
+        std::shared_ptr<arrow::io::FileOutputStream> outFile;
+        std::unique_ptr<parquet::arrow::FileWriter> writer;
+        ARROW_ASSIGN_OR_RAISE(outFile, arrow::io::FileOutputStream::Open(partitionPath));
+        for (const auto &partPath: partPaths) {
+            ARROW_ASSIGN_OR_RAISE(auto input, arrow::io::ReadableFile::Open(partPath));
+            std::unique_ptr<parquet::arrow::FileReader> reader;
+            ARROW_RETURN_NOT_OK(parquet::arrow::OpenFile(input, arrow::default_memory_pool(), &reader));
+            if (writer == nullptr) {
+                std::shared_ptr<arrow::Schema> schema;
+                ARROW_RETURN_NOT_OK(reader->GetSchema(&schema));
+                ARROW_ASSIGN_OR_RAISE(writer, parquet::arrow::FileWriter::Open(*schema,
+                                                                               arrow::default_memory_pool(),
+                                                                               outFile,
+                                                                               properties,
+                                                                               arrowProperties));
+            }
+            for (int rowGroup = 0; rowGroup < reader->num_row_groups(); ++rowGroup) {
+                std::shared_ptr<arrow::Table> rowGroupTable;
+                ARROW_RETURN_NOT_OK(reader->ReadRowGroup(rowGroup, &rowGroupTable));
+                ARROW_RETURN_NOT_OK(writer->WriteTable(*rowGroupTable, rowGroupSize));
+            }
+            ARROW_RETURN_NOT_OK(input->Close());
+            std::filesystem::remove(partPath);
+        }
+        ARROW_RETURN_NOT_OK(writer->Close());
+        ARROW_RETURN_NOT_OK(outFile->Close());
+        std::cout << "[WriterPool] Merged " << sink.numParts << " parts into partition " << partitionId << std::endl;
+        return arrow::Status::OK();
+    }
+
+    std::map<uint32_t, int64_t> WriterPool::getPartitionsNumRows() {
+        std::map<uint32_t, int64_t> partitionsNumRows;
+        for (const auto &[partitionId, sink]: sinks) {
+            partitionsNumRows[partitionId] = sink.totalRows;
+        }
+        return partitionsNumRows;
+    }
+
+    std::filesystem::path WriterPool::getPartitionPath(uint32_t partitionId) {
+        return folder / (std::to_string(partitionId) + common::Settings::fileExtension);
+    }
+
+    std::filesystem::path WriterPool::getPartPath(uint32_t partitionId, uint32_t partIndex) {
+        return partsFolder / (std::to_string(partitionId) + "_" + std::to_string(partIndex) + common::Settings::fileExtension);
+    }
+
+} // storage
@@ -0,0 +1,71 @@
+#include "storage/WriterProfile.h"
+
+namespace storage {
+
+    WriterProfile WriterProfile::getDefaultProfile() {
+        return {};
+    }
+
+    WriterProfile WriterProfile::getPruningProfile(const std::vector<std::string> &partitioningColumns) {
+        WriterProfile profile;
+        profile.name = pruningName;
+        profile.pageIndex = true;
+        profile.dataPageSize = pruningDataPageSize;
+        profile.dictionaryPageSizeLimit = pruningDictionaryPageSizeLimit;
+        for (const auto &column: partitioningColumns) {
+            profile.columnOptions[column].bloomFilter = true;
+        }
+        return profile;
+    }
+
+    arrow::Result<WriterProfile> WriterProfile::fromName(const std::string &profileName,
+                                                         const std::vector<std::string> &partitioningColumns) {
+        if (profileName == defaultName) {
+            return getDefaultProfile();
+        }
+        if (profileName == pruningName) {
+            return getPruningProfile(partitioningColumns);
+        }
+        return arrow::Status::Invalid("Unknown writer profile <", profileName, ">");
+    }
+
+    std::shared_ptr<parquet::WriterProperties> WriterProfile::getWriterProperties(int64_t rowGroupSize) const {
+        parquet::WriterProperties::Builder builder;
+        // Optimal row group length is around 120000 according to several sources
+        builder.max_row_group_length(rowGroupSize)
+                ->created_by(common::Settings::libraryName)
+                ->version(common::Settings::version)
+                ->data_page_version(parquet::ParquetDataPageVersion::V2)
+                // Worse compression ratio than zstd but faster reads
+                ->compression(common::Settings::compression)
+                ->data_pagesize(dataPageSize)
+                ->dictionary_pagesize_limit(dictionaryPageSizeLimit);
+        if (pageIndex) {
+            builder.enable_write_page_index();
+        }
+        for (const auto &[column, options]: columnOptions) {
+            if (options.dictionary.has_value() && options.dictionary.value()) {
+                builder.enable_dictionary(column);
+            } else if (options.dictionary.has_value()) {
+                builder.disable_dictionary(column);
+            }
+            if (options.pageIndex.has_value() && options.pageIndex.value()) {
+                builder.enable_write_page_index(column);
+            } else if (options.pageIndex.has_value()) {
+                builder.disable_write_page_index(column);
+            }
+        }
+        return builder.build();
+    }
+
+    std::vector<std::string> WriterProfile::getBloomFilterColumns() const {
+        std::vector<std::string> bloomFilterColumns;
+        for (const auto &[column, options]: columnOptions) {
+            if (options.bloomFilter) {
+                bloomFilterColumns.emplace_back(column);
+            }
+        }
+        return bloomFilterColumns;
+    }
+
+}
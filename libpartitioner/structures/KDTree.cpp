@@ -2,17 +2,17 @@
 
 namespace structures {
 
-    KDTree::KDTree(std::vector<std::shared_ptr<common::Point>> &rows, size_t partitionSize) {
+    KDTree::KDTree(const common::PointSet &rows, size_t partitionSize) : points(rows) {
         // Construct the tree from the given points and store the root
         leafSize = partitionSize;
         std::cout << "[KDTree] Start building a kd-tree for " << rows.size() << " points and partition size " << partitionSize << std::endl;
-        points = rows;
-        pointDimensions = points[0]->size();
-        root = buildTree(points.begin(), points.end(), 0);
+        pointDimensions = points.numDimensions();
+        rowIds = points.getRowIds();
+        root = buildTree(rowIds.begin(), rowIds.end(), 0);
     }
 
-    std::shared_ptr<KDNode> KDTree::buildTree(std::vector<std::shared_ptr<common::Point>>::iterator start,
-                                              std::vector<std::shared_ptr<common::Point>>::iterator end,
+    std::shared_ptr<KDNode> KDTree::buildTree(common::PointSet::RowIds::iterator start,
+                                              common::PointSet::RowIds::iterator end,
                                               uint32_t depth){
         uint32_t pointsSize = std::distance(start, end);
         std::cout << "[KDTree] Reached depth " << depth << " with " << pointsSize << " elements" << std::endl;
@@ -23,23 +23,21 @@ namespace structures {
         // When we reach the desired leaf size (which is the number of rows per parquet partition)
         // We should store the node and exit the recursion
         if (pointsSize <= leafSize){
-            auto node = std::make_shared<KDNode>(std::vector<std::shared_ptr<common::Point>>(start, end));
+            auto node = std::make_shared<KDNode>(common::PointSet::RowIds(start, end));
             leaves.emplace_back(node);
             return node;
         }
         // At each level we choose the dimension to split, in a circular fashion
         uint32_t dimension = depth % pointDimensions;
-        // Sort the points by the dimension
-        std::sort(start, end,
-                  [&](const std::shared_ptr<common::Point> &a, const std::shared_ptr<common::Point> & b) {
-                      return a->at(dimension) < b->at(dimension);
-                  });
+        // Sort the points by the dimension, only their row ids move
+        points.sortRows(start, end, dimension);
         // Pick the median point for the split
         // Data partitioning kd-tree: pick median
         // Space partitioning kd-tree: (max-min) / 2
         uint32_t medianIdx = pointsSize / 2;
         // Create a split node (no data is passed, only the split value)
-        auto node = std::make_shared<KDNode>(points[medianIdx]->at(dimension));
+        double medianValue = points.value(*(start + medianIdx), dimension);
+        auto node = std::make_shared<KDNode>(medianValue);
         // Assign the values bigger and smaller than the median point to the respective arrays
         // Recursive call to the right and left children, pass increased depth and values
         node->left = buildTree(start, start + medianIdx, depth + 1);
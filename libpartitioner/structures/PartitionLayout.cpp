@@ -0,0 +1,251 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "common/KeyView.h"
+#include "structures/PartitionLayout.h"
+
+namespace structures {
+
+    PartitionRegion PartitionRegion::unbounded(size_t numDimensions) {
+        PartitionRegion region;
+        region.lower.assign(numDimensions, -std::numeric_limits<double>::infinity());
+        region.upper.assign(numDimensions, std::numeric_limits<double>::infinity());
+        return region;
+    }
+
+    bool PartitionRegion::contains(const std::vector<double> &point) const {
+        for (size_t i = 0; i < point.size(); ++i) {
+            if (point[i] < lower[i] || point[i] > upper[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double PartitionRegion::distance(const std::vector<double> &point) const {
+        double totalDistance = 0;
+        for (size_t i = 0; i < point.size(); ++i) {
+            if (point[i] < lower[i]) {
+                totalDistance += lower[i] - point[i];
+            } else if (point[i] > upper[i]) {
+                totalDistance += point[i] - upper[i];
+            }
+        }
+        return totalDistance;
+    }
+
+    void PartitionRegion::extend(const std::vector<double> &point) {
+        for (size_t i = 0; i < point.size(); ++i) {
+            lower[i] = std::min(lower[i], point[i]);
+            upper[i] = std::max(upper[i], point[i]);
+        }
+    }
+
+    PartitionRegion PartitionRegion::withLower(size_t dimension, double value) const {
+        PartitionRegion region = *this;
+        region.lower[dimension] = std::max(region.lower[dimension], value);
+        return region;
+    }
+
+    PartitionRegion PartitionRegion::withUpper(size_t dimension, double value) const {
+        PartitionRegion region = *this;
+        region.upper[dimension] = std::min(region.upper[dimension], value);
+        return region;
+    }
+
+    // Linear scan: the append mode routes each new row once, the cost grows with new rows x partitions
+    uint32_t PartitionLayout::route(const std::vector<double> &point) const {
+        uint32_t closestPartition = 0;
+        double closestDistance = std::numeric_limits<double>::infinity();
+        for (uint32_t partitionId = 0; partitionId < regions.size(); ++partitionId) {
+            auto regionDistance = regions[partitionId].distance(point);
+            if (regionDistance == 0) {
+                return partitionId;
+            }
+            if (regionDistance < closestDistance) {
+                closestDistance = regionDistance;
+                closestPartition = partitionId;
+            }
+        }
+        return closestPartition;
+    }
+
+    static std::string joinNames(const std::vector<std::string> &names) {
+        std::string joined;
+        for (const auto &name: names) {
+            joined += (joined.empty() ? "" : ",") + name;
+        }
+        return joined;
+    }
+
+    static std::vector<std::string> splitNames(const std::string &joined) {
+        std::vector<std::string> names;
+        std::string name;
+        std::stringstream namesStream(joined);
+        while (std::getline(namesStream, name, ',')) {
+            names.emplace_back(name);
+        }
+        return names;
+    }
+
+    // Plain text, one region per line. Written to a temporary file first, so that the layout is replaced atomically
+    arrow::Status PartitionLayout::save(const std::filesystem::path &folder) const {
+        auto layoutPath = folder / fileName;
+        auto temporaryPath = folder / (fileName + ".tmp");
+        {
+            std::ofstream layoutFile(temporaryPath, std::ios::trunc);
+            layoutFile << std::setprecision(std::numeric_limits<double>::max_digits10);
+            layoutFile << "scheme " << scheme << "\n";
+            layoutFile << "columns " << joinNames(columns) << "\n";
+            layoutFile << "routing_columns " << joinNames(routingColumns) << "\n";
+            layoutFile << "partition_size " << partitionSize << "\n";
+            for (const auto &[name, value]: parameters) {
+                layoutFile << "parameter " << name << " " << value << "\n";
+            }
+            layoutFile << "partitions " << regions.size() << "\n";
+            for (const auto &region: regions) {
+                for (size_t i = 0; i < region.lower.size(); ++i) {
+                    layoutFile << (i == 0 ? "" : " ") << region.lower[i] << " " << region.upper[i];
+                }
+                layoutFile << "\n";
+            }
+            if (!layoutFile.good()) {
+                return arrow::Status::IOError("Could not write layout ", temporaryPath.string());
+            }
+        }
+        std::filesystem::rename(temporaryPath, layoutPath);
+        std::cout << "[PartitionLayout] Saved layout of " << regions.size() << " partitions to " << layoutPath << std::endl;
+        return arrow::Status::OK();
+    }
+
+    arrow::Result<PartitionLayout> PartitionLayout::load(const std::filesystem::path &folder) {
+        auto layoutPath = folder / fileName;
+        std::ifstream layoutFile(layoutPath);
+        if (!layoutFile.is_open()) {
+            return arrow::Status::IOError("No partition layout found in ", folder.string());
+        }
+        PartitionLayout layout;
+        size_t numPartitions = 0;
+        std::string line;
+        while (std::getline(layoutFile, line)) {
+            std::stringstream lineStream(line);
+            std::string key;
+            lineStream >> key;
+            if (key == "scheme") {
+                lineStream >> layout.scheme;
+            } else if (key == "columns") {
+                std::string names;
+                lineStream >> names;
+                layout.columns = splitNames(names);
+            } else if (key == "routing_columns") {
+                std::string names;
+                lineStream >> names;
+                layout.routingColumns = splitNames(names);
+            } else if (key == "partition_size") {
+                lineStream >> layout.partitionSize;
+            } else if (key == "parameter") {
+                std::string name;
+                std::string value;
+                lineStream >> name >> value;
+                layout.parameters[name] = std::stod(value);
+            } else if (key == "partitions") {
+                lineStream >> numPartitions;
+                break;
+            }
+        }
+        // std::stod, unlike the stream extraction, parses inf and -inf
+        auto numDimensions = layout.routingColumns.size();
+        for (size_t partitionId = 0; partitionId < numPartitions; ++partitionId) {
+            if (!std::getline(layoutFile, line)) {
+                return arrow::Status::Invalid("Layout ", layoutPath.string(), " is truncated");
+            }
+            std::stringstream lineStream(line);
+            PartitionRegion region;
+            std::string lowerValue;
+            std::string upperValue;
+            while (lineStream >> lowerValue >> upperValue) {
+                region.lower.emplace_back(std::stod(lowerValue));
+                region.upper.emplace_back(std::stod(upperValue));
+            }
+            if (region.lower.size() != numDimensions) {
+                return arrow::Status::Invalid("Region of partition ", partitionId, " has ", region.lower.size(),
+                                              " dimensions, expected ", numDimensions);
+            }
+            layout.regions.emplace_back(region);
+        }
+        return layout;
+    }
+
+    bool PartitionLayout::exists(const std::filesystem::path &folder) {
+        return std::filesystem::exists(folder / fileName);
+    }
+
+    // Column converted to double, the keys of every chunk are read in place and written once
+    static arrow::Result<std::shared_ptr<std::vector<double>>> toDoubleValues(const std::shared_ptr<arrow::ChunkedArray> &chunkedColumn) {
+        auto columnValues = std::make_shared<std::vector<double>>();
+        columnValues->reserve(chunkedColumn->length());
+        for (const auto &chunk: chunkedColumn->chunks()) {
+            ARROW_RETURN_NOT_OK(common::visitKeys(*chunk, [&columnValues](const auto &keys) {
+                for (int64_t i = 0; i < keys.size(); i++) {
+                    columnValues->emplace_back(static_cast<double>(keys[i]));
+                }
+                return arrow::Status::OK();
+            }));
+        }
+        return columnValues;
+    }
+
+    arrow::Result<std::vector<std::shared_ptr<std::vector<double>>>> PartitionLayout::getRoutingValues(
+            const std::shared_ptr<arrow::Table> &table, const std::vector<std::string> &routingColumns) {
+        std::vector<std::shared_ptr<std::vector<double>>> routingValues;
+        for (const auto &column: routingColumns) {
+            auto chunkedColumn = table->GetColumnByName(column);
+            if (chunkedColumn == nullptr) {
+                return arrow::Status::Invalid("Routing column <", column, "> not found");
+            }
+            // Every row needs a value to be routed
+            if (chunkedColumn->null_count() > 0) {
+                return arrow::Status::Invalid("Routing column <", column, "> has ", chunkedColumn->null_count(),
+                                              " null keys");
+            }
+            ARROW_ASSIGN_OR_RAISE(auto columnValues, toDoubleValues(chunkedColumn));
+            routingValues.emplace_back(columnValues);
+        }
+        return routingValues;
+    }
+
+    // Nulls do not take part in the bounding box
+    arrow::Result<PartitionRegion> PartitionLayout::getBoundingRegion(const std::shared_ptr<arrow::Table> &table,
+                                                                      const std::vector<std::string> &routingColumns) {
+        PartitionRegion region;
+        for (const auto &column: routingColumns) {
+            auto chunkedColumn = table->GetColumnByName(column);
+            if (chunkedColumn == nullptr) {
+                return arrow::Status::Invalid("Column <", column, "> not found");
+            }
+            // An empty (or all null) column gives the empty range [+inf, -inf]
+            auto minValue = std::numeric_limits<double>::infinity();
+            auto maxValue = -std::numeric_limits<double>::infinity();
+            for (const auto &chunk: chunkedColumn->chunks()) {
+                ARROW_RETURN_NOT_OK(common::visitKeys(*chunk, [&minValue, &maxValue](const auto &keys) {
+                    for (int64_t i = 0; i < keys.size(); i++) {
+                        if (keys.isValid(i)) {
+                            auto value = static_cast<double>(keys[i]);
+                            minValue = std::min(minValue, value);
+                            maxValue = std::max(maxValue, value);
+                        }
+                    }
+                    return arrow::Status::OK();
+                }));
+            }
+            region.lower.emplace_back(minValue);
+            region.upper.emplace_back(maxValue);
+        }
+        return region;
+    }
+
+}
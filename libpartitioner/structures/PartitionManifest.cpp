@@ -0,0 +1,225 @@
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "storage/DataReader.h"
+#include "structures/PartitionLayout.h"
+#include "structures/PartitionManifest.h"
+
+namespace structures {
+
+    static void writeValue(std::ofstream &file, const void *value, size_t size) {
+        file.write(reinterpret_cast<const char *>(value), (std::streamsize) size);
+    }
+
+    static void writeString(std::ofstream &file, const std::string &value) {
+        auto length = (uint32_t) value.size();
+        writeValue(file, &length, sizeof(length));
+        file.write(value.data(), (std::streamsize) value.size());
+    }
+
+    template<typename T>
+    static bool readValue(std::ifstream &file, T &value) {
+        return (bool) file.read(reinterpret_cast<char *>(&value), sizeof(T));
+    }
+
+    static bool readString(std::ifstream &file, std::string &value) {
+        uint32_t length = 0;
+        if (!readValue(file, length)) {
+            return false;
+        }
+        value.resize(length);
+        return (bool) file.read(value.data(), length);
+    }
+
+    // JSON has no infinity, the bounds of an empty partition are written as null
+    static std::string toJsonNumber(double value) {
+        if (!std::isfinite(value)) {
+            return "null";
+        }
+        std::stringstream number;
+        number << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+        return number.str();
+    }
+
+    static std::string toJsonString(const std::string &value) {
+        std::string escaped = "\"";
+        for (const auto &character: value) {
+            if (character == '"' || character == '\\') {
+                escaped += '\\';
+            }
+            escaped += character;
+        }
+        return escaped + "\"";
+    }
+
+    // Both files are written to a temporary file first, then renamed
+    arrow::Status PartitionManifest::save(const std::filesystem::path &folder) const {
+        auto binaryPath = folder / binaryFileName;
+        auto jsonPath = folder / jsonFileName;
+        ARROW_RETURN_NOT_OK(saveBinary(folder / (binaryFileName + ".tmp")));
+        ARROW_RETURN_NOT_OK(saveJson(folder / (jsonFileName + ".tmp")));
+        std::filesystem::rename(folder / (binaryFileName + ".tmp"), binaryPath);
+        std::filesystem::rename(folder / (jsonFileName + ".tmp"), jsonPath);
+        std::cout << "[PartitionManifest] Saved manifest of " << partitions.size() << " partitions to " << binaryPath
+                  << std::endl;
+        return arrow::Status::OK();
+    }
+
+    // Layout: magic, version, scheme, columns, partition size, order and order columns (since version 2), writer
+    // profile (since version 3), then per
+    // partition its file name, rows, bytes and the min/max pair of every column. Integers and doubles in the native
+    // byte order
+    arrow::Status PartitionManifest::saveBinary(const std::filesystem::path &path) const {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        writeValue(file, &magic, sizeof(magic));
+        writeValue(file, &version, sizeof(version));
+        writeString(file, scheme);
+        auto numColumns = (uint32_t) columns.size();
+        writeValue(file, &numColumns, sizeof(numColumns));
+        for (const auto &column: columns) {
+            writeString(file, column);
+        }
+        writeValue(file, &partitionSize, sizeof(partitionSize));
+        writeString(file, order);
+        auto numOrderColumns = (uint32_t) orderColumns.size();
+        writeValue(file, &numOrderColumns, sizeof(numOrderColumns));
+        for (const auto &column: orderColumns) {
+            writeString(file, column);
+        }
+        writeString(file, writerProfile);
+        auto numPartitions = (uint32_t) partitions.size();
+        writeValue(file, &numPartitions, sizeof(numPartitions));
+        for (const auto &partition: partitions) {
+            writeString(file, partition.fileName);
+            writeValue(file, &partition.numRows, sizeof(partition.numRows));
+            writeValue(file, &partition.numBytes, sizeof(partition.numBytes));
+            for (uint32_t i = 0; i < numColumns; ++i) {
+                writeValue(file, &partition.min.at(i), sizeof(double));
+                writeValue(file, &partition.max.at(i), sizeof(double));
+            }
+        }
+        if (!file.good()) {
+            return arrow::Status::IOError("Could not write manifest ", path.string());
+        }
+        return arrow::Status::OK();
+    }
+
+    arrow::Status PartitionManifest::saveJson(const std::filesystem::path &path) const {
+        std::ofstream file(path, std::ios::trunc);
+        file << "{\n  \"scheme\": " << toJsonString(scheme) << ",\n  \"columns\": [";
+        for (size_t i = 0; i < columns.size(); ++i) {
+            file << (i == 0 ? "" : ", ") << toJsonString(columns[i]);
+        }
+        file << "],\n  \"partition_size\": " << partitionSize << ",\n  \"order\": " << toJsonString(order)
+             << ",\n  \"order_columns\": [";
+        for (size_t i = 0; i < orderColumns.size(); ++i) {
+            file << (i == 0 ? "" : ", ") << toJsonString(orderColumns[i]);
+        }
+        file << "],\n  \"writer_profile\": " << toJsonString(writerProfile) << ",\n  \"partitions\": [";
+        for (size_t p = 0; p < partitions.size(); ++p) {
+            const auto &partition = partitions[p];
+            file << (p == 0 ? "\n" : ",\n") << "    {\"file\": " << toJsonString(partition.fileName)
+                 << ", \"rows\": " << partition.numRows << ", \"bytes\": " << partition.numBytes << ", \"min\": [";
+            for (size_t i = 0; i < partition.min.size(); ++i) {
+                file << (i == 0 ? "" : ", ") << toJsonNumber(partition.min[i]);
+            }
+            file << "], \"max\": [";
+            for (size_t i = 0; i < partition.max.size(); ++i) {
+                file << (i == 0 ? "" : ", ") << toJsonNumber(partition.max[i]);
+            }
+            file << "]}";
+        }
+        file << "\n  ]\n}\n";
+        if (!file.good()) {
+            return arrow::Status::IOError("Could not write manifest ", path.string());
+        }
+        return arrow::Status::OK();
+    }
+
+    arrow::Result<PartitionManifest> PartitionManifest::load(const std::filesystem::path &folder) {
+        auto path = folder / binaryFileName;
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return arrow::Status::IOError("No partition manifest found in ", folder.string());
+        }
+        uint32_t fileMagic = 0;
+        uint32_t fileVersion = 0;
+        if (!readValue(file, fileMagic) || fileMagic != magic || !readValue(file, fileVersion) || fileVersion < 1 ||
+            fileVersion > version) {
+            return arrow::Status::Invalid("Unsupported manifest ", path.string());
+        }
+        PartitionManifest manifest;
+        uint32_t numColumns = 0;
+        uint32_t numPartitions = 0;
+        bool valid = readString(file, manifest.scheme) && readValue(file, numColumns);
+        manifest.columns.resize(numColumns);
+        for (uint32_t i = 0; valid && i < numColumns; ++i) {
+            valid = readString(file, manifest.columns[i]);
+        }
+        valid = valid && readValue(file, manifest.partitionSize);
+        if (valid && fileVersion >= 2) {
+            uint32_t numOrderColumns = 0;
+            valid = readString(file, manifest.order) && readValue(file, numOrderColumns);
+            manifest.orderColumns.resize(valid ? numOrderColumns : 0);
+            for (uint32_t i = 0; valid && i < numOrderColumns; ++i) {
+                valid = readString(file, manifest.orderColumns[i]);
+            }
+        }
+        if (valid && fileVersion >= 3) {
+            valid = readString(file, manifest.writerProfile);
+        }
+        valid = valid && readValue(file, numPartitions);
+        for (uint32_t p = 0; valid && p < numPartitions; ++p) {
+            PartitionSummary partition;
+            valid = readString(file, partition.fileName) && readValue(file, partition.numRows) &&
+                    readValue(file, partition.numBytes);
+            partition.min.resize(numColumns);
+            partition.max.resize(numColumns);
+            for (uint32_t i = 0; valid && i < numColumns; ++i) {
+                valid = readValue(file, partition.min[i]) && readValue(file, partition.max[i]);
+            }
+            manifest.partitions.emplace_back(partition);
+        }
+        if (!valid) {
+            return arrow::Status::Invalid("Manifest ", path.string(), " is truncated");
+        }
+        return manifest;
+    }
+
+    bool PartitionManifest::exists(const std::filesystem::path &folder) {
+        return std::filesystem::exists(folder / binaryFileName);
+    }
+
+    // Only the summary columns are read, nulls do not count in the min/max
+    arrow::Result<PartitionSummary> PartitionManifest::summarize(std::filesystem::path &partitionFile,
+                                                                 const std::vector<std::string> &summaryColumns) {
+        auto partitionReader = std::make_shared<storage::DataReader>();
+        ARROW_RETURN_NOT_OK(partitionReader->load(partitionFile));
+        std::vector<std::shared_ptr<arrow::Field>> summaryFields;
+        for (const auto &column: summaryColumns) {
+            ARROW_ASSIGN_OR_RAISE(auto columnIndex, partitionReader->getColumnIndex(column));
+            if (columnIndex == -1) {
+                return arrow::Status::Invalid("Column <", column, "> not found in ", partitionFile.string());
+            }
+        }
+        ARROW_ASSIGN_OR_RAISE(auto summaryData, partitionReader->getColumns(summaryColumns));
+        for (size_t i = 0; i < summaryData.size(); ++i) {
+            summaryFields.emplace_back(arrow::field(summaryColumns[i], summaryData[i]->type()));
+        }
+        auto summaryTable = arrow::Table::Make(arrow::schema(summaryFields), summaryData);
+        ARROW_ASSIGN_OR_RAISE(auto boundingRegion, PartitionLayout::getBoundingRegion(summaryTable, summaryColumns));
+
+        PartitionSummary summary;
+        summary.fileName = partitionFile.filename().string();
+        summary.numRows = partitionReader->getNumRows();
+        summary.numBytes = std::filesystem::file_size(partitionFile);
+        summary.min = boundingRegion.lower;
+        summary.max = boundingRegion.upper;
+        return summary;
+    }
+
+}
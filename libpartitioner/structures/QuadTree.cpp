@@ -2,24 +2,24 @@
 
 namespace structures {
 
-    QuadTree::QuadTree(std::vector<std::shared_ptr<common::Point>> &rows, size_t partitionSize, size_t numColumns) {
+    QuadTree::QuadTree(const common::PointSet &rows, size_t partitionSize, size_t numColumns) : points(rows) {
         // Construct the tree from the given points and store the root
         leafSize = partitionSize;
         numDims = numColumns;
         std::cout << "[QuadTree] Start building a Quad Tree for " << rows.size() << " points and partition size " << partitionSize << std::endl;
-        points = rows;
-        root = buildTree(points, 0);
+        auto rowIds = points.getRowIds();
+        root = buildTree(rowIds, 0);
     }
 
-    std::shared_ptr<QuadNode> QuadTree::buildTree(std::vector<std::shared_ptr<common::Point>> &points, uint32_t depth){
+    std::shared_ptr<QuadNode> QuadTree::buildTree(common::PointSet::RowIds &rowIds, uint32_t depth){
         // Recursive implementation of QuadTree construction from a set of multidimensional points
-        if (points.empty()) {
+        if (rowIds.empty()) {
             return nullptr;
         }
         // When we reach the desired leaf size (which is the number of rows per parquet partition)
         // We should store the node and exit the recursion
-        if (points.size() <= leafSize){
-            auto node = std::make_shared<QuadNode>(points);
+        if (rowIds.size() <= leafSize){
+            auto node = std::make_shared<QuadNode>(rowIds);
             leaves.emplace_back(node);
             return node;
         }
@@ -36,9 +36,11 @@ namespace structures {
             columnIndexX = depth % numDims;
             columnIndexY = (depth + 1) % numDims;
         }
-        for (auto &point: points){
-            pointsX.emplace_back(point->at(columnIndexX));
-            pointsY.emplace_back(point->at(columnIndexY));
+        pointsX.reserve(rowIds.size());
+        pointsY.reserve(rowIds.size());
+        for (auto rowId: rowIds){
+            pointsX.emplace_back(points.value(rowId, columnIndexX));
+            pointsY.emplace_back(points.value(rowId, columnIndexY));
         }
         // Compute the mean point of both dimensions for the split
         auto minmaxX = std::minmax_element(pointsX.begin(), pointsX.end());
@@ -49,13 +51,14 @@ namespace structures {
         // Create a split node (no data is passed, only the split value)
         auto node = std::make_shared<QuadNode>(meanDims);
         // Assign the values bigger and smaller than the median point to the respective arrays
-        std::vector<std::shared_ptr<common::Point>> northWestPoints;
-        std::vector<std::shared_ptr<common::Point>> northEastPoints;
-        std::vector<std::shared_ptr<common::Point>> southWestPoints;
-        std::vector<std::shared_ptr<common::Point>> southEastPoints;
-        for (auto &point: points){
-            auto x = point->at(columnIndexX);
-            auto y = point->at(columnIndexY);
+        common::PointSet::RowIds northWestPoints;
+        common::PointSet::RowIds northEastPoints;
+        common::PointSet::RowIds southWestPoints;
+        common::PointSet::RowIds southEastPoints;
+        for (size_t i = 0; i < rowIds.size(); ++i){
+            auto point = rowIds[i];
+            auto x = pointsX[i];
+            auto y = pointsY[i];
             if (x <= meanDimX && y >= meanDimY){
                 northWestPoints.emplace_back(point);
             }
@@ -69,6 +72,14 @@ namespace structures {
                 southEastPoints.emplace_back(point);
             }
         }
+        // All the points in one quadrant (e.g. duplicates): cannot partition further, keep them in a leaf
+        for (const auto *quadrantPoints: {&northWestPoints, &northEastPoints, &southWestPoints, &southEastPoints}) {
+            if (quadrantPoints->size() == rowIds.size()) {
+                auto leaf = std::make_shared<QuadNode>(rowIds);
+                leaves.emplace_back(leaf);
+                return leaf;
+            }
+        }
         // Recursive call to the right and left children, pass increased depth and values
         node->northWest = buildTree(northWestPoints, depth + 1);
         node->northEast = buildTree(northEastPoints, depth + 1);
@@ -0,0 +1,139 @@
+#include "structures/SplitTree.h"
+
+namespace structures {
+
+    SplitTree::SplitTree(size_t numDimensions) {
+        SplitNode root;
+        root.region = PartitionRegion::unbounded(numDimensions);
+        nodes.emplace_back(root);
+    }
+
+    uint32_t SplitTree::getRoot() {
+        return 0;
+    }
+
+    std::vector<uint32_t> SplitTree::split(uint32_t nodeId, SplitKind kind, uint32_t columnX, double valueX,
+                                           uint32_t columnY, double valueY) {
+        // Copy the region, adding the children can reallocate the nodes
+        auto region = nodes.at(nodeId).region;
+        std::vector<PartitionRegion> childRegions;
+        switch (kind) {
+            case GREATER_EQUAL_FIRST:
+                childRegions = {region.withLower(columnX, valueX), region.withUpper(columnX, valueX)};
+                break;
+            case LESS_EQUAL_FIRST:
+                childRegions = {region.withUpper(columnX, valueX), region.withLower(columnX, valueX)};
+                break;
+            case QUADRANTS:
+                childRegions = {region.withUpper(columnX, valueX).withLower(columnY, valueY),
+                                region.withLower(columnX, valueX).withLower(columnY, valueY),
+                                region.withUpper(columnX, valueX).withUpper(columnY, valueY),
+                                region.withLower(columnX, valueX).withUpper(columnY, valueY)};
+                break;
+        }
+        std::vector<uint32_t> children;
+        for (const auto &childRegion: childRegions) {
+            SplitNode child;
+            child.region = childRegion;
+            children.emplace_back(nodes.size());
+            nodes.emplace_back(child);
+        }
+        auto &node = nodes.at(nodeId);
+        node.kind = kind;
+        node.columnX = columnX;
+        node.valueX = valueX;
+        node.columnY = columnY;
+        node.valueY = valueY;
+        node.children = children;
+        return children;
+    }
+
+    void SplitTree::finalize() {
+        leaves.clear();
+        numberLeaves(getRoot());
+    }
+
+    void SplitTree::numberLeaves(uint32_t nodeId) {
+        auto &node = nodes.at(nodeId);
+        if (node.children.empty()) {
+            node.leafId = (int32_t) leaves.size();
+            leaves.emplace_back(nodeId);
+            return;
+        }
+        for (auto childId: node.children) {
+            numberLeaves(childId);
+        }
+    }
+
+    size_t SplitTree::getNumLeaves() const {
+        return leaves.size();
+    }
+
+    const PartitionRegion &SplitTree::getLeafRegion(uint32_t leafId) const {
+        return nodes.at(leaves.at(leafId)).region;
+    }
+
+    uint32_t SplitTree::route(const std::vector<std::shared_ptr<std::vector<double>>> &columnsData,
+                              size_t rowIndex) const {
+        const SplitNode *node = &nodes[getRoot()];
+        while (!node->children.empty()) {
+            double x = (*columnsData[node->columnX])[rowIndex];
+            size_t childIndex = 0;
+            switch (node->kind) {
+                case GREATER_EQUAL_FIRST:
+                    childIndex = x >= node->valueX ? 0 : 1;
+                    break;
+                case LESS_EQUAL_FIRST:
+                    childIndex = x <= node->valueX ? 0 : 1;
+                    break;
+                case QUADRANTS: {
+                    double y = (*columnsData[node->columnY])[rowIndex];
+                    childIndex = (x >= node->valueX ? 1 : 0) + (y < node->valueY ? 2 : 0);
+                    break;
+                }
+            }
+            node = &nodes[node->children[childIndex]];
+        }
+        return node->leafId;
+    }
+
+    std::vector<std::vector<uint32_t>> SplitTree::mergeLeaves(const std::vector<int64_t> &leafRows,
+                                                              int64_t minRows,
+                                                              int64_t maxRows) const {
+        return mergeNode(getRoot(), leafRows, minRows, maxRows);
+    }
+
+    std::vector<std::vector<uint32_t>> SplitTree::mergeNode(uint32_t nodeId, const std::vector<int64_t> &leafRows,
+                                                            int64_t minRows, int64_t maxRows) const {
+        const auto &node = nodes.at(nodeId);
+        if (node.children.empty()) {
+            return {{(uint32_t) node.leafId}};
+        }
+        std::vector<std::vector<uint32_t>> groups;
+        bool childrenMerged = true;
+        bool hasUnderfilledChild = false;
+        int64_t totalRows = 0;
+        for (auto childId: node.children) {
+            auto childGroups = mergeNode(childId, leafRows, minRows, maxRows);
+            childrenMerged = childrenMerged && childGroups.size() == 1;
+            for (auto &childGroup: childGroups) {
+                int64_t groupRows = 0;
+                for (auto leafId: childGroup) {
+                    groupRows += leafRows.at(leafId);
+                }
+                hasUnderfilledChild = hasUnderfilledChild || groupRows < minRows;
+                totalRows += groupRows;
+                groups.emplace_back(std::move(childGroup));
+            }
+        }
+        // Only whole subtrees are merged, so that a group stays a single region of the space
+        if (!childrenMerged || !hasUnderfilledChild || totalRows > maxRows) {
+            return groups;
+        }
+        std::vector<uint32_t> mergedGroup;
+        for (const auto &group: groups) {
+            mergedGroup.insert(mergedGroup.end(), group.begin(), group.end());
+        }
+        return {mergedGroup};
+    }
+}
@@ -4,6 +4,7 @@
 
 #include "experimentsConfig.cpp"
 #include "include/storage/DataReader.h"
+#include "partitioning/LayoutAppender.h"
 #include "partitioning/PartitioningFactory.h"
 
 int main(int argc, char **argv) {
@@ -12,7 +13,11 @@ int main(int argc, char **argv) {
     if (argc < 6){
         std::cout << "Insufficient number of arguments\n" << std::endl;
         std::cout << "Expected syntax: partitioner <dataset_base_path> <dataset_name> <partitioning_scheme>"
-                     " <partition_size> <columns>\n" << std::endl;
+                     " <partition_size> <columns> [--memory-budget=<bytes>] [--no-resume] [--append=<file>]"
+                     " [--order=<z-order|hilbert|columns>] [--order-columns=<columns>]"
+                     " [--writer-profile=<default|pruning>] [--build=<levels|sample-scatter>]"
+                     " [--read-mode=<default|mmap|prebuffer|parallel|parallel-unordered>]"
+                     " [--spill-format=<parquet|ipc|ipc-lz4|ipc-mmap>]\n" << std::endl;
         exit(1);
     }
 
@@ -52,6 +57,91 @@ int main(int argc, char **argv) {
         partitioningColumns.push_back(segment);
     }
 
+    // Optional memory budget, for partitioning in memory the datasets that fit in it
+    // It also bounds the memory handed out by the memory governor (batches, sorts, merges and writers)
+    // An interrupted run is resumed from its progress journal, unless --no-resume is given
+    // With --append, the rows of the given file are added to the existing partitions instead of partitioning
+    // With --order, the rows inside every partition are sorted by a secondary key, over the partitioning columns or
+    // over --order-columns
+    // With --writer-profile=pruning, the partitions get a page index and bloom filters on the partitioning columns
+    // With --build=sample-scatter, the tree schemes build their splits on a sample and scatter the rows in one pass
+    // With --read-mode, the Parquet files are memory mapped, read with coalesced ranges or decoded in parallel
+    // With --spill-format, the intermediate files (sorted runs, fragments of a split) are written as Arrow IPC
+    int64_t memoryBudget = common::Settings::memoryBudget;
+    bool allowResume = true;
+    std::filesystem::path appendFilePath;
+    partitioning::IntraPartitionOrder intraPartitionOrder = partitioning::SPLIT_ORDER;
+    std::vector<std::string> orderColumns;
+    std::string writerProfileName = storage::WriterProfile::defaultName;
+    partitioning::TreeBuildMode buildMode = partitioning::LEVEL_BY_LEVEL;
+    std::string readModeName = storage::ReadMode::defaultName;
+    std::string spillFormatName = storage::SpillFormat::parquetName;
+    const std::string memoryBudgetOption = "--memory-budget=";
+    const std::string noResumeOption = "--no-resume";
+    const std::string appendOption = "--append=";
+    const std::string orderOption = "--order=";
+    const std::string orderColumnsOption = "--order-columns=";
+    const std::string writerProfileOption = "--writer-profile=";
+    const std::string buildOption = "--build=";
+    const std::string readModeOption = "--read-mode=";
+    const std::string spillFormatOption = "--spill-format=";
+    for (int i = 6; i < argc; ++i) {
+        std::string argOption = argv[i];
+        if (argOption.rfind(memoryBudgetOption, 0) == 0) {
+            memoryBudget = std::stoll(argOption.substr(memoryBudgetOption.size()));
+        } else if (argOption == noResumeOption) {
+            allowResume = false;
+        } else if (argOption.rfind(appendOption, 0) == 0) {
+            appendFilePath = argOption.substr(appendOption.size());
+        } else if (argOption.rfind(orderOption, 0) == 0) {
+            auto orderName = argOption.substr(orderOption.size());
+            if (partitioning::mapNameToOrder.find(orderName) == partitioning::mapNameToOrder.end()) {
+                std::cout << "Partition order not available/recognized" << std::endl;
+                exit(1);
+            }
+            intraPartitionOrder = partitioning::mapNameToOrder.at(orderName);
+        } else if (argOption.rfind(orderColumnsOption, 0) == 0) {
+            std::stringstream orderColumnsStream(argOption.substr(orderColumnsOption.size()));
+            while (std::getline(orderColumnsStream, segment, ',')) {
+                orderColumns.push_back(segment);
+            }
+        } else if (argOption.rfind(writerProfileOption, 0) == 0) {
+            writerProfileName = argOption.substr(writerProfileOption.size());
+        } else if (argOption.rfind(buildOption, 0) == 0) {
+            auto buildName = argOption.substr(buildOption.size());
+            if (partitioning::mapNameToBuildMode.find(buildName) == partitioning::mapNameToBuildMode.end()) {
+                std::cout << "Build mode not available/recognized" << std::endl;
+                exit(1);
+            }
+            buildMode = partitioning::mapNameToBuildMode.at(buildName);
+        } else if (argOption.rfind(readModeOption, 0) == 0) {
+            readModeName = argOption.substr(readModeOption.size());
+        } else if (argOption.rfind(spillFormatOption, 0) == 0) {
+            spillFormatName = argOption.substr(spillFormatOption.size());
+        }
+    }
+    if (memoryBudget > 0) {
+        common::MemoryGovernor::getInstance().setBudget(memoryBudget);
+    }
+    auto writerProfile = storage::WriterProfile::fromName(writerProfileName, partitioningColumns);
+    if (!writerProfile.ok()) {
+        std::cout << "Writer profile not available/recognized" << std::endl;
+        exit(1);
+    }
+    storage::DataWriter::setWriterProfile(writerProfile.ValueOrDie());
+    auto readMode = storage::ReadMode::fromName(readModeName);
+    if (!readMode.ok()) {
+        std::cout << "Read mode not available/recognized" << std::endl;
+        exit(1);
+    }
+    storage::DataReader::setReadMode(readMode.ValueOrDie());
+    auto spillFormat = storage::SpillFormat::fromName(spillFormatName);
+    if (!spillFormat.ok()) {
+        std::cout << "Spill format not available/recognized" << std::endl;
+        exit(1);
+    }
+    storage::DataWriter::setSpillFormat(spillFormat.ValueOrDie());
+
     // Validate the actual dataset file
     std::filesystem::path datasetFilePath = argDatasetPath / ExperimentsConfig::noPartition / (argDatasetName + ExperimentsConfig::fileExtension);
     if (!std::filesystem::exists(datasetFilePath)){
@@ -59,9 +149,28 @@ int main(int argc, char **argv) {
         exit(1);
     }
 
-    // Remove files from the folder before starting
+    // Resume an interrupted run from the last checkpoint, otherwise remove files from the folder before starting
     std::filesystem::path outputPath = argDatasetPath / argPartitioningScheme;
-    storage::DataWriter::cleanUpFolder(outputPath);
+    if (!appendFilePath.empty()) {
+        if (!std::filesystem::exists(appendFilePath)) {
+            std::cout << "File to append " << appendFilePath << " not found" << std::endl;
+            exit(1);
+        }
+        partitioning::LayoutAppender appender(outputPath);
+        arrow::Status status = appender.append(appendFilePath);
+        if (!status.ok()) {
+            std::cout << "ERROR, APPEND FAILED - Got status " << status.ToString() << std::endl;
+            exit(1);
+        }
+        std::cout << "[Partitioner] Appended " << appendFilePath << " to " << outputPath << std::endl;
+        return 0;
+    }
+    bool resume = allowResume && storage::ProgressJournal::canResume(outputPath);
+    if (resume) {
+        std::cout << "[Partitioner] Found the journal of an interrupted run in " << outputPath << ", resuming it" << std::endl;
+    } else {
+        storage::DataWriter::cleanUpFolder(outputPath);
+    }
 
     // Load dataset file
     auto dataReader = std::make_shared<storage::DataReader>();
@@ -70,6 +179,10 @@ int main(int argc, char **argv) {
 
     // Load partitioning scheme
     auto partitioningScheme = partitioning::PartitioningFactory::create(scheme, dataReader, partitioningColumns, partitionSize, outputPath);
+    partitioningScheme->setMemoryBudget(memoryBudget);
+    partitioningScheme->setResume(resume);
+    partitioningScheme->setIntraPartitionOrder(intraPartitionOrder, orderColumns);
+    partitioningScheme->setBuildMode(buildMode);
 
     // Apply the partitioning
     if (!partitioningScheme->isFinished()){
@@ -6,6 +6,7 @@
 #include "gtest/gtest.h"
 
 #include "storage/DataReader.h"
+#include "storage/SpillFormat.h"
 #include "experimentsConfig.cpp"
 
 
@@ -35,7 +36,8 @@ public:
         if (std::filesystem::is_directory(folder)){
             for (const auto & folderIter : std::filesystem::recursive_directory_iterator(folder))
             {
-                if (folderIter.path().extension() == ExperimentsConfig::fileExtension)
+                if (folderIter.path().extension() == ExperimentsConfig::fileExtension ||
+                    folderIter.path().extension() == storage::SpillFormat::ipcExtension)
                 {
                     try {
                         std::filesystem::remove(folderIter.path());
@@ -55,6 +55,41 @@ TEST_F(TestOptimalLayoutFixture, TestExternalMergeSort){
     ASSERT_EQ(std::filesystem::exists(folder / ("3" + fileExtension)), false);
 }
 
+TEST_F(TestOptimalLayoutFixture, TestExternalMergeSortIpcRuns){
+    auto folder = ExperimentsConfig::testsFolder / "external-merge-sort";
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetCities);
+    cleanUpFolder(folder);
+    // Sorted runs written as Arrow IPC and memory mapped by the merge, the merged partition is a Parquet file
+    auto spillFormat = storage::SpillFormat::fromName(storage::SpillFormat::ipcMemoryMapName).ValueOrDie();
+    auto runExtension = spillFormat.getExtension();
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto batchReader = dataReader->getBatchReader().ValueOrDie();
+    while (true) {
+        std::shared_ptr<arrow::RecordBatch> record_batch;
+        ASSERT_EQ(batchReader->ReadNext(&record_batch), arrow::Status::OK());
+        if (record_batch == nullptr) {
+            break;
+        }
+        ASSERT_EQ(external::ExternalSort::writeSortedBatch(record_batch->Slice(2, 2), "x",
+                                                           folder / ("s0" + runExtension), spillFormat), arrow::Status::OK());
+        ASSERT_EQ(external::ExternalSort::writeSortedBatch(record_batch->Slice(4, 2), "x",
+                                                           folder / ("s1" + runExtension), spillFormat), arrow::Status::OK());
+        ASSERT_EQ(external::ExternalSort::writeSortedBatch(record_batch->Slice(0, 2), "x",
+                                                           folder / ("s2" + runExtension), spillFormat), arrow::Status::OK());
+        ASSERT_EQ(external::ExternalSort::writeSortedBatch(record_batch->Slice(6, 2), "x",
+                                                           folder / ("s3" + runExtension), spillFormat), arrow::Status::OK());
+    }
+    auto partitionSize = 8;
+    ASSERT_EQ(external::ExternalMerge::mergeFilesFromSortedBatches(folder, "x", partitionSize, spillFormat), arrow::Status::OK());
+
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("0" + fileExtension), "x", std::vector<int32_t>({5, 27, 35, 52, 62, 82, 85, 90})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::StringArray>(folder / ("0" + fileExtension), "city", std::vector<std::string>({"Dublin", "Oslo", "Copenhagen", "Moscow", "Tallinn", "Berlin", "Amsterdam", "Madrid"})), arrow::Status::OK());
+    ASSERT_EQ(std::filesystem::exists(folder / ("s0" + runExtension)), false);
+    ASSERT_EQ(std::filesystem::exists(folder / ("1" + fileExtension)), false);
+}
+
 TEST_F(TestOptimalLayoutFixture, TestExternalMergeSortDuckDB) {
     auto folder = ExperimentsConfig::testsFolder / "external-merge-sort";
     auto fileExtension = ExperimentsConfig::fileExtension;
@@ -1,10 +1,12 @@
 #include <arrow/io/api.h>
 #include <filesystem>
+#include <random>
 
 #include "fixture.cpp"
 #include "gtest/gtest.h"
 #include "partitioning/PartitioningFactory.h"
 #include "storage/TableGenerator.h"
+#include "structures/PartitionLayout.h"
 
 
 TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeSchool) {
@@ -30,6 +32,127 @@ TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeSchool) {
     ASSERT_EQ(std::filesystem::exists(folder / ("4" + fileExtension)), false);
 }
 
+TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeSchoolIpcSpill) {
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto partitionSize = 2;
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    // The fragments of the splits are written as Arrow IPC with LZ4, the partitions are the same as with Parquet
+    storage::DataWriter::setSpillFormat(storage::SpillFormat::fromName(storage::SpillFormat::ipcLz4Name).ValueOrDie());
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, partitionSize, folder);
+    auto status = partitioning->partition();
+    storage::DataWriter::setSpillFormat(storage::SpillFormat::getDefaultFormat());
+    ASSERT_EQ(status, arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("0" + fileExtension), "Student_id", std::vector<int32_t>({74, 34})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("1" + fileExtension), "Student_id", std::vector<int32_t>({16, 7})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("2" + fileExtension), "Student_id", std::vector<int32_t>({111, 91})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("3" + fileExtension), "Student_id", std::vector<int32_t>({45, 21})), arrow::Status::OK());
+    ASSERT_EQ(std::filesystem::exists(folder / ("4" + fileExtension)), false);
+    for (const auto &file: std::filesystem::recursive_directory_iterator(folder)) {
+        ASSERT_NE(file.path().extension(), storage::SpillFormat::ipcExtension);
+    }
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeSchoolInMemory) {
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto partitionSize = 2;
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, partitionSize, folder);
+    partitioning->setMemoryBudget((int64_t) 1 << 30);
+    ASSERT_EQ(partitioning->fitsInMemory(), true);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    // Same layout as the disk-based partitioning
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("0" + fileExtension), "Student_id", std::vector<int32_t>({74, 34})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("1" + fileExtension), "Student_id", std::vector<int32_t>({16, 7})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("2" + fileExtension), "Student_id", std::vector<int32_t>({111, 91})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("3" + fileExtension), "Student_id", std::vector<int32_t>({45, 21})), arrow::Status::OK());
+    ASSERT_EQ(std::filesystem::exists(folder / ("4" + fileExtension)), false);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeSchoolSampleScatter) {
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto partitionSize = 2;
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, partitionSize, folder);
+    partitioning->setBuildMode(partitioning::SAMPLE_SCATTER);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    // The whole school is sampled: same splits as the level by level build, rows in the order of the file
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("0" + fileExtension), "Student_id", std::vector<int32_t>({74, 34})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("1" + fileExtension), "Student_id", std::vector<int32_t>({16, 7})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("2" + fileExtension), "Student_id", std::vector<int32_t>({111, 91})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("3" + fileExtension), "Student_id", std::vector<int32_t>({45, 21})), arrow::Status::OK());
+    ASSERT_EQ(std::filesystem::exists(folder / ("4" + fileExtension)), false);
+    ASSERT_EQ(std::filesystem::exists(folder / "_scatter"), false);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeSchoolOrdered) {
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto partitionSize = 2;
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, partitionSize, folder);
+    partitioning->setIntraPartitionOrder(partitioning::COLUMNS_KEY, {"Student_id"});
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    // Same partitions as the unordered layout, rows sorted by Student_id inside each of them
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("0" + fileExtension), "Student_id", std::vector<int32_t>({34, 74})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("0" + fileExtension), "Age", std::vector<int32_t>({37, 41})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("1" + fileExtension), "Student_id", std::vector<int32_t>({7, 16})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("2" + fileExtension), "Student_id", std::vector<int32_t>({91, 111})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("3" + fileExtension), "Student_id", std::vector<int32_t>({21, 45})), arrow::Status::OK());
+    auto manifest = structures::PartitionManifest::load(folder).ValueOrDie();
+    ASSERT_EQ(manifest.order, "columns");
+    ASSERT_EQ(manifest.orderColumns, std::vector<std::string>({"Student_id"}));
+    // About 8 row groups per partition, within the row group size bounds
+    ASSERT_EQ(partitioning::MultiDimensionalPartitioning::getOrderedRowGroupSize(1000000), 125000);
+    ASSERT_EQ(partitioning::MultiDimensionalPartitioning::getOrderedRowGroupSize(2), common::Settings::minRowGroupSize);
+    ASSERT_EQ(partitioning::MultiDimensionalPartitioning::getOrderedRowGroupSize(10000000), common::Settings::rowGroupSize);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestKDTreePointSetSchool) {
+    auto studentIds = std::make_shared<std::vector<double>>(std::vector<double>({21, 45, 91, 111, 7, 16, 34, 74}));
+    auto ages = std::make_shared<std::vector<double>>(std::vector<double>({18, 21, 22, 23, 27, 30, 37, 41}));
+    std::vector<std::shared_ptr<std::vector<double>>> columns = {ages, studentIds};
+    auto points = common::ColumnDataConverter::toRows(columns);
+    ASSERT_EQ(points.size(), 8);
+    ASSERT_EQ(points.numDimensions(), 2);
+    ASSERT_EQ(points[3][1], 111);
+    ASSERT_EQ(points.columnData(1)[3], 111);
+    // Same values in the row-major layout, a row is contiguous
+    auto rows = common::ColumnDataConverter::toRows<int64_t>(columns, common::ROW_MAJOR);
+    ASSERT_EQ(rows.rowData(3)[0], 23);
+    ASSERT_EQ(rows.rowData(3)[1], 111);
+    // The leaves hold the row ids of the points, the points are not copied
+    auto tree = structures::KDTree(points, 2);
+    std::vector<std::vector<double>> leavesStudentIds;
+    for (const auto &leaf: tree.getLeaves()) {
+        std::vector<double> leafStudentIds;
+        for (auto rowId: leaf->data) {
+            leafStudentIds.emplace_back(points[rowId][1]);
+        }
+        leavesStudentIds.emplace_back(leafStudentIds);
+    }
+    ASSERT_EQ(leavesStudentIds, std::vector<std::vector<double>>({{21, 45}, {91, 111}, {7, 16}, {34, 74}}));
+    ASSERT_EQ(tree.getRoot()->splitValue, 27);
+}
+
 TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeCities){
     auto folder = ExperimentsConfig::kdTreeFolder;
     auto fileExtension = ExperimentsConfig::fileExtension;
@@ -112,4 +235,48 @@ TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeOSM){
     auto partitionsTotalRows = folderResults.second;
     ASSERT_EQ(numTotalRows, partitionsTotalRows);
     // ASSERT_EQ(fileCount, 492);
-}
\ No newline at end of file
+}
+TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeUnorderedReadMode) {
+    // Several row groups, decoded in parallel and delivered in any order
+    int64_t numRows = 100000;
+    std::vector<int64_t> xValues(numRows);
+    std::iota(xValues.begin(), xValues.end(), 0);
+    std::vector<int64_t> yValues(xValues);
+    std::shuffle(xValues.begin(), xValues.end(), std::mt19937_64(common::Settings::samplingSeed));
+    std::shuffle(yValues.begin(), yValues.end(), std::mt19937_64(common::Settings::samplingSeed + 1));
+    arrow::Int64Builder xBuilder;
+    ASSERT_EQ(xBuilder.AppendValues(xValues), arrow::Status::OK());
+    arrow::Int64Builder yBuilder;
+    ASSERT_EQ(yBuilder.AppendValues(yValues), arrow::Status::OK());
+    auto table = arrow::Table::Make(arrow::schema({arrow::field("x", arrow::int64()), arrow::field("y", arrow::int64())}),
+                                    {xBuilder.Finish().ValueOrDie(), yBuilder.Finish().ValueOrDie()});
+    std::filesystem::path dataset = ExperimentsConfig::noPartitionFolder / ("unordered" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(storage::DataWriter::WriteTableToDisk(table, dataset, 10000), arrow::Status::OK());
+
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    cleanUpFolder(folder);
+    storage::DataReader::setReadMode(storage::ReadMode::fromName(storage::ReadMode::parallelUnorderedName).ValueOrDie());
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, {"x", "y"}, 25000, folder);
+    auto status = partitioning->partition();
+    storage::DataReader::setReadMode(storage::ReadMode::getDefaultMode());
+    ASSERT_EQ(status, arrow::Status::OK());
+
+    // Every full row is in the partition of its keys: inside the region of the split
+    auto layout = structures::PartitionLayout::load(folder).ValueOrDie();
+    int64_t numPartitionedRows = 0;
+    for (uint32_t partitionId = 0; partitionId < layout.regions.size(); ++partitionId) {
+        std::filesystem::path partitionPath = folder / (std::to_string(partitionId) + ExperimentsConfig::fileExtension);
+        auto partitionTable = storage::DataReader::getTable(partitionPath).ValueOrDie()->CombineChunks().ValueOrDie();
+        auto xColumn = std::static_pointer_cast<arrow::Int64Array>(partitionTable->GetColumnByName("x")->chunk(0));
+        auto yColumn = std::static_pointer_cast<arrow::Int64Array>(partitionTable->GetColumnByName("y")->chunk(0));
+        for (int64_t i = 0; i < partitionTable->num_rows(); ++i) {
+            std::vector<double> point = {(double) xColumn->Value(i), (double) yColumn->Value(i)};
+            ASSERT_EQ(layout.regions[partitionId].contains(point), true);
+        }
+        numPartitionedRows += partitionTable->num_rows();
+    }
+    ASSERT_EQ(numPartitionedRows, numRows);
+    std::filesystem::remove(dataset);
+}
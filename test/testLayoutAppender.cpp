@@ -0,0 +1,42 @@
+#include <filesystem>
+
+#include "fixture.cpp"
+#include "gtest/gtest.h"
+#include "partitioning/LayoutAppender.h"
+#include "partitioning/PartitioningFactory.h"
+#include "structures/PartitionLayout.h"
+
+TEST_F(TestOptimalLayoutFixture, TestAppendKDTreeSchool) {
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto partitionSize = 2;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, partitionSize, folder);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    auto layout = structures::PartitionLayout::load(folder).ValueOrDie();
+    ASSERT_EQ(layout.scheme, "kd-tree");
+    ASSERT_EQ(layout.regions.size(), 4);
+
+    // Append the same rows again: every row lands next to its copy, the full partitions are split in two
+    partitioning::LayoutAppender appender(folder);
+    ASSERT_EQ(appender.append(dataset), arrow::Status::OK());
+    auto [fileCount, partitionsTotalRows] = getFolderResults(dataReader, folder);
+    ASSERT_EQ(fileCount, 8);
+    ASSERT_EQ(partitionsTotalRows, 16);
+    for (uint32_t partitionId = 0; partitionId < fileCount; ++partitionId) {
+        auto partitionPath = folder / (std::to_string(partitionId) + ExperimentsConfig::fileExtension);
+        ASSERT_EQ(dataReader->load(partitionPath), arrow::Status::OK());
+        ASSERT_EQ(dataReader->getNumRows(), partitionSize);
+    }
+    ASSERT_EQ(structures::PartitionLayout::load(folder).ValueOrDie().regions.size(), 8);
+
+    // A repeated call with the same file (e.g. a retry after a crash) does not append the rows twice
+    partitioning::LayoutAppender retriedAppender(folder);
+    ASSERT_EQ(retriedAppender.append(dataset), arrow::Status::OK());
+    auto [retriedFileCount, retriedTotalRows] = getFolderResults(dataReader, folder);
+    ASSERT_EQ(retriedFileCount, 8);
+    ASSERT_EQ(retriedTotalRows, 16);
+}
@@ -0,0 +1,38 @@
+#include <arrow/io/api.h>
+#include <filesystem>
+#include <numeric>
+
+#include "fixture.cpp"
+#include "gtest/gtest.h"
+#include "query/LayoutCostModel.h"
+
+TEST_F(TestOptimalLayoutFixture, TestLayoutCostModelSchool){
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto costModel = query::LayoutCostModel(dataReader, partitioningColumns);
+    ASSERT_EQ(costModel.buildLayout(partitioning::KD_TREE, 2).ok(), false);
+    ASSERT_EQ(costModel.load(), arrow::Status::OK());
+    // The whole school fits the sample
+    ASSERT_EQ(costModel.getSampleSize(), 8);
+    // Same leaves as the kd-tree scheme: students {21, 45}, {91, 111}, {7, 16} and {34, 74}
+    auto kdTreeLayout = costModel.buildLayout(partitioning::KD_TREE, 2).ValueOrDie();
+    ASSERT_EQ(kdTreeLayout.regions.size(), 4);
+    auto predicate = query::PartitionPruner::parsePredicate("Student_id > 100 AND Student_id < 120").ValueOrDie();
+    auto estimate = costModel.estimate(kdTreeLayout, predicate);
+    ASSERT_EQ(estimate.totalPartitions, 4);
+    ASSERT_EQ(estimate.numPartitions, 1);
+    ASSERT_EQ(estimate.numRows, 2);
+    ASSERT_EQ(estimate.matchingRows, 1);
+    ASSERT_GT(estimate.numBytes, 0);
+    auto emptyPredicate = query::PartitionPruner::parsePredicate("Student_id > 1000").ValueOrDie();
+    ASSERT_EQ(costModel.estimate(kdTreeLayout, emptyPredicate).numPartitions, 0);
+    // Every scheme places all the sampled rows
+    for (const auto &[schemeName, scheme]: partitioning::mapNameToScheme) {
+        auto layout = costModel.buildLayout(scheme, 2).ValueOrDie();
+        ASSERT_EQ(std::accumulate(layout.regionRows.begin(), layout.regionRows.end(), 0.0), 8);
+        ASSERT_EQ(costModel.estimate(layout, predicate).matchingRows, 1);
+    }
+    ASSERT_EQ(costModel.buildLayout(partitioning::NO_PARTITION, 2).ValueOrDie().regions.size(), 1);
+}
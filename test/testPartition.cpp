@@ -5,6 +5,10 @@
 #include "fixture.cpp"
 #include "gtest/gtest.h"
 #include "partitioning/PartitioningFactory.h"
+#include "query/PartitionPruner.h"
+#include "storage/BloomFilterIndex.h"
+#include "storage/DataWriter.h"
+#include "structures/PartitionManifest.h"
 
 TEST_F(TestOptimalLayoutFixture, TestPartitioningFailures){
     auto folder = ExperimentsConfig::fixedGridFolder;
@@ -50,3 +54,166 @@ TEST_F(TestOptimalLayoutFixture, TestPartitioningFailures){
      }, InvalidColumn );
 }
 
+TEST_F(TestOptimalLayoutFixture, TestPartitioningNullKeys){
+    // A row with a null partitioning key has no cell, curve value or region: every scheme rejects the dataset
+    arrow::Int64Builder xBuilder;
+    ASSERT_EQ(xBuilder.AppendValues({3, 8, 1, 6, 4, 7, 2, 5}), arrow::Status::OK());
+    arrow::Int64Builder yBuilder;
+    ASSERT_EQ(yBuilder.AppendValues({5, 1, 7, 2}), arrow::Status::OK());
+    ASSERT_EQ(yBuilder.AppendNull(), arrow::Status::OK());
+    ASSERT_EQ(yBuilder.AppendValues({8, 3, 6}), arrow::Status::OK());
+    auto table = arrow::Table::Make(arrow::schema({arrow::field("x", arrow::int64()), arrow::field("y", arrow::int64())}),
+                                    {xBuilder.Finish().ValueOrDie(), yBuilder.Finish().ValueOrDie()});
+    std::filesystem::path dataset = ExperimentsConfig::noPartitionFolder / ("nullKeys" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(storage::DataWriter::WriteTableToDisk(table, dataset), arrow::Status::OK());
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto folder = ExperimentsConfig::fixedGridFolder;
+    for (const auto &scheme: {partitioning::FIXED_GRID, partitioning::GRID_FILE, partitioning::KD_TREE,
+                              partitioning::STR_TREE, partitioning::QUAD_TREE, partitioning::HILBERT_CURVE,
+                              partitioning::Z_ORDER_CURVE}) {
+        cleanUpFolder(folder);
+        auto partitioning = partitioning::PartitioningFactory::create(scheme, dataReader, {"x", "y"}, 2, folder);
+        ASSERT_EQ(partitioning->partition().IsInvalid(), true) << partitioning::mapSchemeToName.at(scheme);
+    }
+    cleanUpFolder(folder);
+    std::filesystem::remove(dataset);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitionManifest){
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, 2, folder);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    auto manifest = structures::PartitionManifest::load(folder).ValueOrDie();
+    ASSERT_EQ(manifest.scheme, "kd-tree");
+    ASSERT_EQ(manifest.columns, partitioningColumns);
+    ASSERT_EQ(manifest.partitionSize, 2);
+    ASSERT_EQ(manifest.partitions.size(), 4);
+    for (const auto &partition: manifest.partitions) {
+        ASSERT_EQ(partition.numRows, 2);
+        ASSERT_EQ(partition.numBytes, std::filesystem::file_size(folder / partition.fileName));
+    }
+    // Partition 0 holds the students 74 and 34
+    ASSERT_EQ(manifest.partitions[0].fileName, "0" + fileExtension);
+    ASSERT_EQ(manifest.partitions[0].min[1], 34);
+    ASSERT_EQ(manifest.partitions[0].max[1], 74);
+    ASSERT_EQ(std::filesystem::exists(folder / structures::PartitionManifest::jsonFileName), true);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitionPruner){
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, 2, folder);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    auto pruner = query::PartitionPruner(folder);
+    ASSERT_EQ(pruner.load(), arrow::Status::OK());
+    ASSERT_EQ(pruner.getNumPartitions(), 4);
+    // Partition 2 holds the students 111 and 91, the only ones in the range
+    auto predicate = query::PartitionPruner::parsePredicate("Student_id > '100' AND Student_id < '120'").ValueOrDie();
+    ASSERT_EQ(predicate.size(), 2);
+    ASSERT_EQ(pruner.prunePartitions(predicate), std::vector<uint32_t>({2}));
+    auto matches = pruner.prune(predicate).ValueOrDie();
+    ASSERT_EQ(matches.size(), 1);
+    ASSERT_EQ(matches[0].file, folder / ("2" + fileExtension));
+    ASSERT_EQ(matches[0].rowGroups, std::vector<int>({0}));
+    // Strict bounds exclude the partition max, inclusive ones do not
+    auto strictPredicate = query::PartitionPruner::parsePredicate("Student_id > 111").ValueOrDie();
+    ASSERT_EQ(pruner.prunePartitions(strictPredicate).empty(), true);
+    auto inclusivePredicate = query::PartitionPruner::parsePredicate("Student_id >= 111").ValueOrDie();
+    ASSERT_EQ(pruner.prunePartitions(inclusivePredicate), std::vector<uint32_t>({2}));
+    ASSERT_EQ(query::PartitionPruner::parsePredicate("Student_id > 'abc'").ok(), false);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitionPrunerTemporalColumns){
+    // Timestamps in seconds are stored as milliseconds, date64 as days and decimals unscaled: the row groups are
+    // pruned in the domain of the column statistics, not on the stored values
+    arrow::Int64Builder xBuilder;
+    ASSERT_EQ(xBuilder.AppendValues({1, 2, 3, 4, 5, 6, 7, 8}), arrow::Status::OK());
+    arrow::Int64Builder yBuilder;
+    ASSERT_EQ(yBuilder.AppendValues({8, 7, 6, 5, 4, 3, 2, 1}), arrow::Status::OK());
+    arrow::TimestampBuilder timestampBuilder(arrow::timestamp(arrow::TimeUnit::SECOND), arrow::default_memory_pool());
+    ASSERT_EQ(timestampBuilder.AppendValues({100, 200, 300, 400, 500, 600, 700, 800}), arrow::Status::OK());
+    int64_t day = 86400000;
+    arrow::Date64Builder dateBuilder;
+    ASSERT_EQ(dateBuilder.AppendValues({day, 2 * day, 3 * day, 4 * day, 5 * day, 6 * day, 7 * day, 8 * day}), arrow::Status::OK());
+    arrow::Decimal128Builder decimalBuilder(arrow::decimal128(10, 2));
+    for (const auto &price: {"1.50", "2.50", "3.50", "4.50", "5.50", "6.50", "7.50", "8.50"}) {
+        ASSERT_EQ(decimalBuilder.Append(arrow::Decimal128(price)), arrow::Status::OK());
+    }
+    auto schema = arrow::schema({arrow::field("x", arrow::int64()), arrow::field("y", arrow::int64()),
+                                 arrow::field("ts", arrow::timestamp(arrow::TimeUnit::SECOND)),
+                                 arrow::field("day", arrow::date64()), arrow::field("price", arrow::decimal128(10, 2))});
+    auto table = arrow::Table::Make(schema, {xBuilder.Finish().ValueOrDie(), yBuilder.Finish().ValueOrDie(),
+                                             timestampBuilder.Finish().ValueOrDie(), dateBuilder.Finish().ValueOrDie(),
+                                             decimalBuilder.Finish().ValueOrDie()});
+    std::filesystem::path dataset = ExperimentsConfig::noPartitionFolder / ("temporal" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(storage::DataWriter::WriteTableToDisk(table, dataset), arrow::Status::OK());
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    cleanUpFolder(folder);
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, {"x", "y"}, 8, folder);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    auto pruner = query::PartitionPruner(folder);
+    ASSERT_EQ(pruner.load(), arrow::Status::OK());
+    std::filesystem::path partitionPath = folder / ("0" + ExperimentsConfig::fileExtension);
+    auto partitionReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(partitionReader->load(partitionPath), arrow::Status::OK());
+    for (const auto &column: {"ts", "day", "price"}) {
+        auto statistics = partitionReader->getColumnStatistics(column).ValueOrDie();
+        ASSERT_EQ(statistics.hasMinMax, true);
+        // Past the max of the column, nothing to read
+        query::ColumnRange laterRange{column, statistics.max, std::numeric_limits<double>::infinity(), false, true};
+        ASSERT_EQ(pruner.prune({laterRange}).ValueOrDie().empty(), true) << column;
+        // The max itself is in the row group
+        query::ColumnRange lastRange{column, statistics.max, std::numeric_limits<double>::infinity(), true, true};
+        auto matches = pruner.prune({lastRange}).ValueOrDie();
+        ASSERT_EQ(matches.size(), 1) << column;
+        ASSERT_EQ(matches[0].rowGroups, std::vector<int>({0})) << column;
+    }
+    ASSERT_EQ(pruner.prune(query::PartitionPruner::parsePredicate("price > 8.5").ValueOrDie()).ValueOrDie().empty(), true);
+    std::filesystem::remove(dataset);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitionPrunerWriterProfile){
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto writerProfile = storage::WriterProfile::fromName("pruning", partitioningColumns).ValueOrDie();
+    ASSERT_EQ(writerProfile.getBloomFilterColumns(), partitioningColumns);
+    ASSERT_EQ(storage::WriterProfile::fromName("fastest", partitioningColumns).ok(), false);
+    storage::DataWriter::setWriterProfile(writerProfile);
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, 2, folder);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    storage::DataWriter::setWriterProfile(storage::WriterProfile::getDefaultProfile());
+    ASSERT_EQ(structures::PartitionManifest::load(folder).ValueOrDie().writerProfile, "pruning");
+    ASSERT_EQ(storage::BloomFilterIndex::exists(folder / ("2" + fileExtension)), true);
+    auto pruner = query::PartitionPruner(folder);
+    ASSERT_EQ(pruner.load(), arrow::Status::OK());
+    // The page index of Student_id has one page in partition 2
+    auto matches = pruner.prune(query::PartitionPruner::parsePredicate("Student_id >= 91 AND Student_id < 100").ValueOrDie()).ValueOrDie();
+    ASSERT_EQ(matches.size(), 1);
+    ASSERT_EQ(matches[0].numPages, 1);
+    ASSERT_EQ(matches[0].numSkippedPages, 0);
+    // 100 is inside the bounds of partition 2 (students 91 and 111), only its bloom filter rules it out
+    auto equalityPredicate = query::PartitionPruner::parsePredicate("Student_id = 100").ValueOrDie();
+    ASSERT_EQ(pruner.prunePartitions(equalityPredicate), std::vector<uint32_t>({2}));
+    ASSERT_EQ(pruner.prune(equalityPredicate).ValueOrDie().empty(), true);
+    auto presentPredicate = query::PartitionPruner::parsePredicate("Student_id = 111").ValueOrDie();
+    ASSERT_EQ(pruner.prune(presentPredicate).ValueOrDie().size(), 1);
+}
@@ -0,0 +1,124 @@
+#include <filesystem>
+#include <fstream>
+
+#include "fixture.cpp"
+#include "gtest/gtest.h"
+#include "partitioning/PartitioningFactory.h"
+#include "storage/ProgressJournal.h"
+
+TEST_F(TestOptimalLayoutFixture, TestProgressJournalResume){
+    auto folder = ExperimentsConfig::testsFolder / "progress-journal";
+    std::filesystem::create_directories(folder);
+    {
+        storage::ProgressJournal journal(folder);
+        ASSERT_EQ(journal.open("run-a", false), arrow::Status::OK());
+        ASSERT_EQ(journal.record("split", "0.parquet"), arrow::Status::OK());
+        ASSERT_EQ(journal.record("split", "0/1.parquet"), arrow::Status::OK());
+    }
+    // Entry cut by a crash while it was being written
+    {
+        std::ofstream journalFile(folder / storage::ProgressJournal::fileName, std::ios::app);
+        journalFile << "split\t0/0.parq";
+    }
+    ASSERT_EQ(storage::ProgressJournal::canResume(folder), true);
+    {
+        storage::ProgressJournal journal(folder);
+        ASSERT_EQ(journal.open("run-a", true), arrow::Status::OK());
+        ASSERT_EQ(journal.isResumed(), true);
+        ASSERT_EQ(journal.contains("split", "0.parquet"), true);
+        ASSERT_EQ(journal.contains("split", "0/1.parquet"), true);
+        ASSERT_EQ(journal.contains("split", "0/0.parq"), false);
+        ASSERT_EQ(journal.record("split", "0/0.parquet"), arrow::Status::OK());
+        ASSERT_EQ(journal.record(storage::ProgressJournal::finishedStep), arrow::Status::OK());
+    }
+    ASSERT_EQ(storage::ProgressJournal::canResume(folder), false);
+    // A journal of a different run is not reused
+    {
+        storage::ProgressJournal journal(folder);
+        ASSERT_EQ(journal.open("run-b", true), arrow::Status::OK());
+        ASSERT_EQ(journal.isResumed(), false);
+        ASSERT_EQ(journal.contains("split", "0.parquet"), false);
+    }
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitioningKDTreeSchoolResume) {
+    auto folder = ExperimentsConfig::kdTreeFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto partitionSize = 2;
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, partitionSize, folder);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    ASSERT_EQ(storage::ProgressJournal::canResume(folder), false);
+
+    // Interrupt the run right before its end: drop the last entry of the journal
+    auto journalPath = folder / storage::ProgressJournal::fileName;
+    std::ifstream journalInput(journalPath);
+    std::vector<std::string> journalLines;
+    for (std::string line; std::getline(journalInput, line);) {
+        journalLines.emplace_back(line);
+    }
+    journalInput.close();
+    ASSERT_EQ(journalLines.back().rfind(storage::ProgressJournal::finishedStep, 0), 0);
+    journalLines.pop_back();
+    std::ofstream journalOutput(journalPath, std::ios::trunc);
+    for (const auto &line: journalLines) {
+        journalOutput << line << "\n";
+    }
+    journalOutput.close();
+    ASSERT_EQ(storage::ProgressJournal::canResume(folder), true);
+
+    // The resumed run keeps the partitions already written
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto resumedPartitioning = partitioning::PartitioningFactory::create(partitioning::KD_TREE, dataReader, partitioningColumns, partitionSize, folder);
+    resumedPartitioning->setResume(true);
+    ASSERT_EQ(resumedPartitioning->partition(), arrow::Status::OK());
+    ASSERT_EQ(storage::ProgressJournal::canResume(folder), false);
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("0" + fileExtension), "Student_id", std::vector<int32_t>({74, 34})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("3" + fileExtension), "Student_id", std::vector<int32_t>({45, 21})), arrow::Status::OK());
+    ASSERT_EQ(std::filesystem::exists(folder / ("4" + fileExtension)), false);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestPartitioningGridFileSchoolResume) {
+    auto folder = ExperimentsConfig::gridFileFolder;
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto partitionSize = 5;
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    cleanUpFolder(folder);
+    std::vector<std::string> partitioningColumns = {"Age", "Student_id"};
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto partitioning = partitioning::PartitioningFactory::create(partitioning::GRID_FILE, dataReader, partitioningColumns, partitionSize, folder);
+    ASSERT_EQ(partitioning->partition(), arrow::Status::OK());
+    ASSERT_EQ(storage::ProgressJournal::canResume(folder), false);
+
+    // Interrupt the run right before its end: drop the last entry of the journal
+    auto journalPath = folder / storage::ProgressJournal::fileName;
+    std::ifstream journalInput(journalPath);
+    std::vector<std::string> journalLines;
+    for (std::string line; std::getline(journalInput, line);) {
+        journalLines.emplace_back(line);
+    }
+    journalInput.close();
+    ASSERT_EQ(journalLines.back().rfind(storage::ProgressJournal::finishedStep, 0), 0);
+    journalLines.pop_back();
+    std::ofstream journalOutput(journalPath, std::ios::trunc);
+    for (const auto &line: journalLines) {
+        journalOutput << line << "\n";
+    }
+    journalOutput.close();
+    ASSERT_EQ(storage::ProgressJournal::canResume(folder), true);
+
+    // The resumed run keeps the cells already split and the partitions already written
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto resumedPartitioning = partitioning::PartitioningFactory::create(partitioning::GRID_FILE, dataReader, partitioningColumns, partitionSize, folder);
+    resumedPartitioning->setResume(true);
+    ASSERT_EQ(resumedPartitioning->partition(), arrow::Status::OK());
+    ASSERT_EQ(storage::ProgressJournal::canResume(folder), false);
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("0" + fileExtension), "Student_id", std::vector<int32_t>({45, 21, 7, 111, 91})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("1" + fileExtension), "Student_id", std::vector<int32_t>({16, 74, 34})), arrow::Status::OK());
+    ASSERT_EQ(std::filesystem::exists(folder / ("2" + fileExtension)), false);
+}
@@ -1,9 +1,13 @@
+#include <algorithm>
 #include <arrow/io/api.h>
 #include <filesystem>
+#include <numeric>
+#include <random>
 
 #include "fixture.cpp"
 #include "gtest/gtest.h"
 #include "partitioning/PartitioningFactory.h"
+#include "storage/ParquetConcatenator.h"
 #include "storage/TableGenerator.h"
 
 
@@ -40,3 +44,262 @@ TEST_F(TestOptimalLayoutFixture, TestReadParquet){
     arrow::Result<std::shared_ptr<arrow::Table>> realDatasetTPCH = getDataset(dataset3);
     ASSERT_EQ(realDatasetTPCH.status(), arrow::Status::OK());
 }
+
+TEST_F(TestOptimalLayoutFixture, TestPrefetchingBatchReader){
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetCities);
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    auto prefetchingReader = dataReader->getPrefetchingBatchReader(1).ValueOrDie();
+    int64_t totalNumRows = 0;
+    while (true) {
+        std::shared_ptr<arrow::RecordBatch> recordBatch;
+        ASSERT_EQ(prefetchingReader->ReadNext(&recordBatch), arrow::Status::OK());
+        if (recordBatch == nullptr) {
+            break;
+        }
+        totalNumRows += recordBatch->num_rows();
+    }
+    ASSERT_EQ(totalNumRows, dataReader->getNumRows());
+    ASSERT_GE(prefetchingReader->getOverlap(), 0);
+    ASSERT_LE(prefetchingReader->getOverlap(), 1);
+    ASSERT_EQ(prefetchingReader->Close(), arrow::Status::OK());
+}
+
+TEST_F(TestOptimalLayoutFixture, TestFooterColumnStatistics){
+    // Temporal and decimal columns, with a null, in the domain of the splits
+    auto timestampType = arrow::timestamp(arrow::TimeUnit::MICRO);
+    arrow::TimestampBuilder timestampBuilder(timestampType, arrow::default_memory_pool());
+    ASSERT_EQ(timestampBuilder.AppendValues({1000000, 5500000, 3000000}), arrow::Status::OK());
+    arrow::Date32Builder dateBuilder;
+    ASSERT_EQ(dateBuilder.AppendValues({19000, 18000, 19500}), arrow::Status::OK());
+    auto decimalType = arrow::decimal128(10, 2);
+    arrow::Decimal128Builder decimalBuilder(decimalType);
+    ASSERT_EQ(decimalBuilder.Append(arrow::Decimal128("-12.50")), arrow::Status::OK());
+    ASSERT_EQ(decimalBuilder.Append(arrow::Decimal128("99.99")), arrow::Status::OK());
+    ASSERT_EQ(decimalBuilder.AppendNull(), arrow::Status::OK());
+    auto schema = arrow::schema({arrow::field("ts", timestampType), arrow::field("day", arrow::date32()),
+                                 arrow::field("price", decimalType)});
+    auto table = arrow::Table::Make(schema, {timestampBuilder.Finish().ValueOrDie(), dateBuilder.Finish().ValueOrDie(),
+                                             decimalBuilder.Finish().ValueOrDie()});
+    std::filesystem::path typedFile = ExperimentsConfig::noPartitionFolder / ("typed_stats" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(storage::DataWriter::WriteTableToDisk(table, typedFile), arrow::Status::OK());
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(typedFile), arrow::Status::OK());
+    auto timestampStats = dataReader->getColumnStatistics("ts").ValueOrDie();
+    ASSERT_EQ(timestampStats.hasMinMax, true);
+    ASSERT_EQ(timestampStats.min, 1000000);
+    ASSERT_EQ(timestampStats.max, 5500000);
+    ASSERT_EQ(storage::ColumnStatistics::toEpochSeconds(*timestampStats.type, timestampStats.max), 5.5);
+    ASSERT_EQ(dataReader->getColumnStats("day").ValueOrDie(), std::make_pair(18000.0, 19500.0));
+    auto decimalStats = dataReader->getColumnStatistics("price").ValueOrDie();
+    ASSERT_DOUBLE_EQ(decimalStats.min, -12.5);
+    ASSERT_DOUBLE_EQ(decimalStats.max, 99.99);
+    ASSERT_EQ(decimalStats.nullCount, 1);
+    ASSERT_EQ(dataReader->getColumnStatistics("missing").ok(), false);
+    std::filesystem::remove(typedFile);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestKeyViews){
+    // Keys read in place, with the offset of a slice and the validity bitmap
+    arrow::Int32Builder int32Builder;
+    ASSERT_EQ(int32Builder.AppendValues({5, 1, 7}), arrow::Status::OK());
+    ASSERT_EQ(int32Builder.AppendNull(), arrow::Status::OK());
+    ASSERT_EQ(int32Builder.Append(9), arrow::Status::OK());
+    auto ints = int32Builder.Finish().ValueOrDie()->Slice(1);
+    std::vector<double> validKeys;
+    int64_t numNulls = 0;
+    auto status = common::visitKeys(*ints, [&validKeys, &numNulls](const auto &keys) {
+        for (int64_t i = 0; i < keys.size(); i++) {
+            if (keys.isValid(i)) {
+                validKeys.emplace_back(keys[i]);
+            }
+        }
+        numNulls = keys.nullCount();
+        return arrow::Status::OK();
+    });
+    ASSERT_EQ(status, arrow::Status::OK());
+    ASSERT_EQ(validKeys, std::vector<double>({1, 7, 9}));
+    ASSERT_EQ(numNulls, 1);
+    // Dates as their count of days, decimals scaled to their value
+    arrow::Date32Builder dateBuilder;
+    ASSERT_EQ(dateBuilder.AppendValues({19000, 18000, 19500, 17000}), arrow::Status::OK());
+    auto dates = dateBuilder.Finish().ValueOrDie();
+    arrow::Decimal128Builder decimalBuilder(arrow::decimal128(10, 2));
+    ASSERT_EQ(decimalBuilder.Append(arrow::Decimal128("-12.50")), arrow::Status::OK());
+    ASSERT_EQ(decimalBuilder.AppendNull(), arrow::Status::OK());
+    ASSERT_EQ(decimalBuilder.Append(arrow::Decimal128("99.99")), arrow::Status::OK());
+    ASSERT_EQ(decimalBuilder.Append(arrow::Decimal128("0.05")), arrow::Status::OK());
+    auto decimals = decimalBuilder.Finish().ValueOrDie();
+    auto converted = common::ColumnDataConverter::toDouble({dates}).ValueOrDie();
+    ASSERT_EQ(*converted[0], std::vector<double>({19000, 18000, 19500, 17000}));
+    // The converted vectors follow the rows, a column with nulls is rejected
+    ASSERT_EQ(common::ColumnDataConverter::toDouble({dates, decimals}).status().IsInvalid(), true);
+    ASSERT_EQ(common::ColumnDataConverter::toInt32({ints}).status().IsInvalid(), true);
+    // A point needs all of its keys, a column with nulls is rejected
+    ASSERT_EQ(common::ColumnDataConverter::toRows({ints, dates, decimals}).status().IsInvalid(), true);
+    auto points = common::ColumnDataConverter::toRows({ints->Slice(3), dates->Slice(3), decimals->Slice(3)}).ValueOrDie();
+    ASSERT_EQ(points.size(), 1);
+    ASSERT_EQ(points[0][0], 9);
+    ASSERT_EQ(points[0][1], 17000);
+    ASSERT_DOUBLE_EQ(points[0][2], 0.05);
+    // No key view for strings
+    arrow::StringBuilder stringBuilder;
+    ASSERT_EQ(stringBuilder.Append("Berlin"), arrow::Status::OK());
+    auto strings = stringBuilder.Finish().ValueOrDie();
+    ASSERT_EQ(common::ColumnDataConverter::toDouble({strings}).status().IsNotImplemented(), true);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestColumnQuantiles){
+    // Exact below the capacity of the sketch: upper median for an even count, like the in-memory splits
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    ASSERT_EQ(dataReader->getQuantiles("Age", {0, 0.5, 1}).ValueOrDie(), std::vector<double>({18, 27, 41}));
+    ASSERT_EQ(dataReader->getMedian("Student_id").ValueOrDie(), 45);
+    ASSERT_EQ(dataReader->getQuantiles("missing", {0.5}).ok(), false);
+    // Several row groups, sketched in parallel and merged: ranks within the error bound
+    int64_t numRows = 300000;
+    std::vector<int64_t> values(numRows);
+    std::iota(values.begin(), values.end(), 0);
+    std::shuffle(values.begin(), values.end(), std::mt19937_64(common::Settings::samplingSeed));
+    arrow::Int64Builder int64Builder;
+    ASSERT_EQ(int64Builder.AppendValues(values), arrow::Status::OK());
+    auto table = arrow::Table::Make(arrow::schema({arrow::field("value", arrow::int64())}),
+                                    {int64Builder.Finish().ValueOrDie()});
+    std::filesystem::path valuesFile = ExperimentsConfig::noPartitionFolder / ("quantiles" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(storage::DataWriter::WriteTableToDisk(table, valuesFile), arrow::Status::OK());
+    ASSERT_EQ(dataReader->load(valuesFile), arrow::Status::OK());
+    auto rankError = 0.01;
+    auto quantiles = dataReader->getQuantiles("value", {0.1, 0.5, 0.9}, rankError).ValueOrDie();
+    ASSERT_NEAR(quantiles[0], 0.1 * numRows, rankError * numRows);
+    ASSERT_NEAR(quantiles[1], 0.5 * numRows, rankError * numRows);
+    ASSERT_NEAR(quantiles[2], 0.9 * numRows, rankError * numRows);
+    std::filesystem::remove(valuesFile);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestRangeFilter){
+    auto dataset = getDatasetPath(ExperimentsConfig::datasetSchool);
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(dataReader->load(dataset), arrow::Status::OK());
+    std::filesystem::path filteredFile = ExperimentsConfig::noPartitionFolder / ("filtered" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(dataReader->rangeFilter("Age", filteredFile, {21, 27}), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(filteredFile, "Age", std::vector<int32_t>({21, 27, 23, 22})), arrow::Status::OK());
+    // Box over two columns of a file with several row groups, sorted on the first one
+    int64_t numRows = 300000;
+    std::vector<int64_t> values(numRows);
+    std::iota(values.begin(), values.end(), 0);
+    std::vector<int64_t> remainders(numRows);
+    std::transform(values.begin(), values.end(), remainders.begin(), [](int64_t value) { return value % 100; });
+    arrow::Int64Builder valuesBuilder;
+    ASSERT_EQ(valuesBuilder.AppendValues(values), arrow::Status::OK());
+    arrow::Int64Builder remaindersBuilder;
+    ASSERT_EQ(remaindersBuilder.AppendValues(remainders), arrow::Status::OK());
+    auto table = arrow::Table::Make(arrow::schema({arrow::field("value", arrow::int64()),
+                                                   arrow::field("remainder", arrow::int64())}),
+                                    {valuesBuilder.Finish().ValueOrDie(), remaindersBuilder.Finish().ValueOrDie()});
+    std::filesystem::path valuesFile = ExperimentsConfig::noPartitionFolder / ("box" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(storage::DataWriter::WriteTableToDisk(table, valuesFile), arrow::Status::OK());
+    ASSERT_EQ(dataReader->load(valuesFile), arrow::Status::OK());
+    ASSERT_EQ(dataReader->rangeFilter({{"value", {140000, 140999}}, {"remainder", {0, 9}}}, filteredFile), arrow::Status::OK());
+    ASSERT_EQ(dataReader->load(filteredFile), arrow::Status::OK());
+    ASSERT_EQ(dataReader->getNumRows(), 100);
+    ASSERT_EQ(dataReader->getColumnStats("value").ValueOrDie(), std::make_pair(140000.0, 140909.0));
+    ASSERT_EQ(dataReader->rangeFilter({{"missing", {0, 1}}}, filteredFile).ok(), false);
+    std::filesystem::remove(valuesFile);
+    std::filesystem::remove(filteredFile);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestReadModes){
+    int64_t numRows = 300000;
+    std::vector<int64_t> values(numRows);
+    std::iota(values.begin(), values.end(), 0);
+    arrow::Int64Builder int64Builder;
+    ASSERT_EQ(int64Builder.AppendValues(values), arrow::Status::OK());
+    auto table = arrow::Table::Make(arrow::schema({arrow::field("value", arrow::int64())}),
+                                    {int64Builder.Finish().ValueOrDie()});
+    std::filesystem::path valuesFile = ExperimentsConfig::noPartitionFolder / ("read_modes" + ExperimentsConfig::fileExtension);
+    // Small row groups, so that the parallel modes have several of them to decode
+    ASSERT_EQ(storage::DataWriter::WriteTableToDisk(table, valuesFile, 20000), arrow::Status::OK());
+    ASSERT_EQ(storage::ReadMode::fromName("unknown").ok(), false);
+    for (const auto &readModeName: storage::ReadMode::getNames()) {
+        auto readMode = storage::ReadMode::fromName(readModeName).ValueOrDie();
+        storage::DataReader::setReadMode(readMode);
+        auto dataReader = std::make_shared<storage::DataReader>();
+        ASSERT_EQ(dataReader->load(valuesFile), arrow::Status::OK());
+        auto batchReader = dataReader->getBatchReader().ValueOrDie();
+        std::vector<int64_t> readValues;
+        while (true) {
+            std::shared_ptr<arrow::RecordBatch> recordBatch;
+            ASSERT_EQ(batchReader->ReadNext(&recordBatch), arrow::Status::OK());
+            if (recordBatch == nullptr) {
+                break;
+            }
+            auto valuesArray = std::static_pointer_cast<arrow::Int64Array>(recordBatch->column(0));
+            readValues.insert(readValues.end(), valuesArray->raw_values(), valuesArray->raw_values() + valuesArray->length());
+        }
+        // Every mode reads all the rows, in file order unless the batches are unordered
+        if (!readMode.orderedBatches) {
+            std::sort(readValues.begin(), readValues.end());
+        }
+        ASSERT_EQ(readValues, values);
+    }
+    storage::DataReader::setReadMode(storage::ReadMode::getDefaultMode());
+    std::filesystem::remove(valuesFile);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestConcatenateFragments){
+    auto folder = ExperimentsConfig::noPartitionFolder / "fragments";
+    std::filesystem::remove_all(folder);
+    std::filesystem::create_directory(folder);
+    // Three fragments of the school table, merged without decoding them
+    auto table = storage::TableGenerator::GenerateSchoolTable().ValueOrDie();
+    std::vector<std::pair<int64_t, int64_t>> slices = {{0, 3}, {3, 3}, {6, 2}};
+    for (size_t i = 0; i < slices.size(); ++i) {
+        auto fragment = table->Slice(slices[i].first, slices[i].second);
+        std::filesystem::path fragmentPath = folder / (std::to_string(i) + ExperimentsConfig::fileExtension);
+        ASSERT_EQ(storage::DataWriter::WriteTableToDisk(fragment, fragmentPath), arrow::Status::OK());
+    }
+    std::string rootPath;
+    auto fs = arrow::fs::FileSystemFromUriOrPath(folder, &rootPath).ValueOrDie();
+    ASSERT_EQ(storage::DataWriter::mergeBatchesInFolder(fs, rootPath), arrow::Status::OK());
+    std::filesystem::path mergedFile = folder.string() + ExperimentsConfig::fileExtension;
+    auto mergedTable = storage::DataReader::getTable(mergedFile).ValueOrDie();
+    ASSERT_TRUE(mergedTable->Equals(*table));
+    // The row groups of the fragments are kept
+    ASSERT_EQ(parquet::ParquetFileReader::OpenFile(mergedFile.string())->metadata()->num_row_groups(), (int) slices.size());
+    // Fragments with different columns cannot be concatenated
+    auto narrowTable = table->SelectColumns({0}).ValueOrDie();
+    std::filesystem::path narrowPath = folder / ("narrow" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(storage::DataWriter::WriteTableToDisk(narrowTable, narrowPath), arrow::Status::OK());
+    std::filesystem::path firstPath = folder / ("0" + ExperimentsConfig::fileExtension);
+    ASSERT_EQ(storage::ParquetConcatenator::concatenate({firstPath, narrowPath}, mergedFile).ValueOrDie(), false);
+    std::filesystem::remove_all(folder);
+    std::filesystem::remove(mergedFile);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestMergeBatches){
+    auto folder = ExperimentsConfig::noPartitionFolder / "merge-batches";
+    std::filesystem::remove_all(folder);
+    std::filesystem::create_directory(folder);
+    // Partitions 0 to 3 with a fragment per batch, partition 4 without fragments
+    auto table = storage::TableGenerator::GenerateSchoolTable().ValueOrDie();
+    std::set<uint32_t> partitionIds = {0, 1, 2, 3, 4};
+    for (uint32_t partitionId = 0; partitionId < 4; ++partitionId) {
+        std::filesystem::create_directory(folder / std::to_string(partitionId));
+        for (int64_t batchId = 0; batchId < 2; ++batchId) {
+            auto fragment = table->Slice(partitionId * 2 + batchId, 1);
+            std::filesystem::path fragmentPath = folder / std::to_string(partitionId) /
+                                                 ("b" + std::to_string(batchId) + ExperimentsConfig::fileExtension);
+            ASSERT_EQ(storage::DataWriter::WriteTableToDisk(fragment, fragmentPath), arrow::Status::OK());
+        }
+    }
+    ASSERT_EQ(storage::DataWriter::mergeBatches(folder, partitionIds), arrow::Status::OK());
+    for (uint32_t partitionId = 0; partitionId < 4; ++partitionId) {
+        std::filesystem::path partitionPath = folder / (std::to_string(partitionId) + ExperimentsConfig::fileExtension);
+        auto partitionTable = storage::DataReader::getTable(partitionPath).ValueOrDie();
+        ASSERT_TRUE(partitionTable->Equals(*table->Slice(partitionId * 2, 2)));
+        ASSERT_EQ(std::filesystem::exists(folder / std::to_string(partitionId)), false);
+    }
+    ASSERT_EQ(std::filesystem::exists(folder / ("4" + ExperimentsConfig::fileExtension)), false);
+    std::filesystem::remove_all(folder);
+}
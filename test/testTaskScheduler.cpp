@@ -0,0 +1,33 @@
+#include <atomic>
+
+#include "fixture.cpp"
+#include "gtest/gtest.h"
+#include "common/TaskScheduler.h"
+
+// Recursive fan-out, similar to the tree partitioners: every task spawns and waits for its own children
+static arrow::Status countLeaves(std::atomic<uint32_t> &leaves, uint32_t depth) {
+    if (depth == 0) {
+        leaves.fetch_add(1);
+        return arrow::Status::OK();
+    }
+    common::TaskGroup children;
+    for (int i = 0; i < 4; ++i) {
+        children.run([&leaves, depth]() { return countLeaves(leaves, depth - 1); });
+    }
+    return children.wait();
+}
+
+TEST_F(TestOptimalLayoutFixture, TestTaskSchedulerRecursion){
+    std::atomic<uint32_t> leaves{0};
+    ASSERT_EQ(countLeaves(leaves, 6), arrow::Status::OK());
+    ASSERT_EQ(leaves.load(), 4096);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestTaskSchedulerErrors){
+    common::TaskScheduler scheduler(2);
+    common::TaskGroup tasks(scheduler);
+    tasks.run([]() { return arrow::Status::OK(); });
+    tasks.run([]() { return arrow::Status::Invalid("Failed task"); });
+    tasks.run([]() -> arrow::Status { throw std::runtime_error("Throwing task"); });
+    ASSERT_EQ(tasks.wait().ok(), false);
+}
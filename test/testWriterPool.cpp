@@ -0,0 +1,76 @@
+#include <arrow/io/api.h>
+#include <filesystem>
+
+#include "fixture.cpp"
+#include "gtest/gtest.h"
+#include "partitioning/PartitioningFactory.h"
+#include "storage/TableGenerator.h"
+#include "storage/WriterPool.h"
+
+TEST_F(TestOptimalLayoutFixture, TestWriterPoolEviction){
+    auto folder = ExperimentsConfig::testsFolder / "writer-pool";
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    std::filesystem::create_directories(folder);
+    cleanUpFolder(folder);
+    std::shared_ptr<arrow::Table> table = storage::TableGenerator::GenerateCitiesTable().ValueOrDie();
+    // One open writer and one row per row group: every switch of partition seals a part file
+    auto props = parquet::WriterProperties::Builder().max_row_group_length(1)->build();
+    auto writerPool = storage::WriterPool(folder, 1, common::Settings::writerPoolBufferBytes, props);
+    for (int64_t i = 0; i < table->num_rows(); ++i) {
+        ASSERT_EQ(writerPool.append(i % 3, table->Slice(i, 1)), arrow::Status::OK());
+    }
+    ASSERT_EQ(writerPool.finish(), arrow::Status::OK());
+    ASSERT_EQ(writerPool.getPartitionsNumRows().at(0), 3);
+    ASSERT_EQ(writerPool.getPartitionsNumRows().at(2), 2);
+    auto dataReader = std::make_shared<storage::DataReader>();
+    auto folderResults = getFolderResults(dataReader, folder);
+    ASSERT_EQ(folderResults.first, 3);
+    ASSERT_EQ(folderResults.second, 8);
+    auto partitionPath0 = writerPool.getPartitionPath(0);
+    auto partition0 = storage::DataReader::getTable(partitionPath0).ValueOrDie();
+    auto cities0 = std::static_pointer_cast<arrow::StringArray>(partition0->GetColumnByName("city")->chunk(0));
+    ASSERT_EQ(partition0->num_rows(), 3);
+    ASSERT_EQ(cities0->GetString(0), "Tallinn");
+    ASSERT_EQ(std::filesystem::exists(folder / "_parts"), false);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestWriterPoolAbort){
+    auto folder = ExperimentsConfig::testsFolder / "writer-pool";
+    std::filesystem::create_directories(folder);
+    cleanUpFolder(folder);
+    std::shared_ptr<arrow::Table> table = storage::TableGenerator::GenerateCitiesTable().ValueOrDie();
+    auto props = parquet::WriterProperties::Builder().max_row_group_length(1)->build();
+    {
+        // Dropped without finish(), as on an error path: the open writer and the sealed parts are removed
+        auto writerPool = storage::WriterPool(folder, 1, common::Settings::writerPoolBufferBytes, props);
+        for (int64_t i = 0; i < table->num_rows(); ++i) {
+            ASSERT_EQ(writerPool.append(i % 3, table->Slice(i, 1)), arrow::Status::OK());
+        }
+        ASSERT_EQ(std::filesystem::exists(folder / "_parts"), true);
+    }
+    ASSERT_EQ(std::filesystem::exists(folder / "_parts"), false);
+    auto dataReader = std::make_shared<storage::DataReader>();
+    ASSERT_EQ(getFolderResults(dataReader, folder).first, 0);
+    // No more rows once aborted
+    auto writerPool = storage::WriterPool(folder, 1, common::Settings::writerPoolBufferBytes, props);
+    ASSERT_EQ(writerPool.append(0, table->Slice(0, 1)), arrow::Status::OK());
+    writerPool.abort();
+    ASSERT_EQ(writerPool.append(0, table->Slice(1, 1)).IsInvalid(), true);
+    ASSERT_EQ(writerPool.finish().IsInvalid(), true);
+    ASSERT_EQ(std::filesystem::exists(folder / "_parts"), false);
+}
+
+TEST_F(TestOptimalLayoutFixture, TestWriteOutPartitions){
+    auto folder = ExperimentsConfig::testsFolder / "write-out-partitions";
+    auto fileExtension = ExperimentsConfig::fileExtension;
+    std::filesystem::create_directories(folder);
+    cleanUpFolder(folder);
+    std::shared_ptr<arrow::Table> table = storage::TableGenerator::GenerateSchoolTable().ValueOrDie();
+    arrow::UInt32Builder partitionIdsBuilder;
+    ASSERT_EQ(partitionIdsBuilder.AppendValues(std::vector<uint32_t>({7, 3, 7, 3, 100000, 3, 7, 100000})), arrow::Status::OK());
+    std::shared_ptr<arrow::Array> partitionIds = partitionIdsBuilder.Finish().ValueOrDie();
+    ASSERT_EQ(partitioning::MultiDimensionalPartitioning::writeOutPartitions(table, partitionIds, folder), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("3" + fileExtension), "Student_id", std::vector<int32_t>({45, 7, 34})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("7" + fileExtension), "Student_id", std::vector<int32_t>({16, 21, 111})), arrow::Status::OK());
+    ASSERT_EQ(checkPartition<arrow::Int32Array>(folder / ("100000" + fileExtension), "Student_id", std::vector<int32_t>({74, 91})), arrow::Status::OK());
+}